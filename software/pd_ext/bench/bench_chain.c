@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////
+// bench_chain.c
+//   エフェクトチェーンをコア数で分割したときの限界段数の測定
+//
+//   Effect_Host（pd~）と同じく、チェーンを連続した区間に分けて
+//   区間ごとに別スレッド（別コア）で処理し、区間の間は
+//   1 ブロックずつ受け渡す（区間数ブロック分の遅延）。
+//   どの区間数でも同じ遅延（BENCH_BUDGET ブロック）を締切とし、
+//   締切に遅れたブロックの割合が BENCH_MISS_RATIO を越えたら音切れ（xrun）とみなす。
+//   オンラインのコア数より多い区間数は測定しない。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#define BENCH_RATE          (44100)         // サンプリング周波数
+#define BENCH_BLOCK         (64)            // Pd のブロックサイズ
+#define BENCH_PERIOD_NS     (1000000000LL * BENCH_BLOCK / BENCH_RATE)
+#define BENCH_TRIAL_MSEC    (1000)          // 1 回の試行の長さ
+#define BENCH_RING          (8)             // 区間の間のブロック数
+#define BENCH_DELAY         (1024)          // ノード内の遅延線（2 の累乗）
+#define BENCH_MAX_NODES     (1 << 16)
+#define BENCH_MAX_STAGES    (4)
+#define BENCH_BUDGET        (BENCH_MAX_STAGES)  // 入力から出力までの締切（ブロック数、全ての区間数で共通）
+#define BENCH_MISS_RATIO    (0.005)         // 音切れとみなす遅れの割合
+
+#ifndef M_PI
+#define M_PI    (3.14159265358979323846)
+#endif
+
+static const int STAGES[] = { 1, 2, 4 };
+
+//
+// 1 ノード（フィルタ＋クリップ＋帰還付き遅延、Effect_Controller 相当の処理量）
+//
+typedef struct {
+    float   b0, b1, b2, a1, a2;
+    float   z1, z2;
+    float   delay[BENCH_DELAY];
+    int     pos;
+    int     tap;
+} BENCH_NODE;
+
+//
+// パイプライン（区間 k は done[k] 個目までのブロックを処理済み）
+//
+typedef struct {
+    BENCH_NODE *    nodes;
+    int             nodeNum;
+    int             stageNum;
+    int             first[BENCH_MAX_STAGES + 1];    // 区間の先頭ノード
+    float           ring[BENCH_RING][BENCH_BLOCK];
+    atomic_long     done[BENCH_MAX_STAGES + 1];     // [0] は入力済みブロック数
+    atomic_int      quit;
+} BENCH_CHAIN;
+
+typedef struct {
+    BENCH_CHAIN *   chain;
+    int             stage;
+} BENCH_WORKER;
+
+// 経過時間（ナノ秒）
+static long long benchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void benchSleepUntil(long long t)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = t / 1000000000LL;
+    ts.tv_nsec = t % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        ;
+    }
+}
+
+// cpu はオンラインのコア数未満であること（main で確かめる）
+static void benchPin(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void benchNodeInit(BENCH_NODE *n, int idx)
+{
+    // 2 次のローパス（RBJ）、ノードごとに少しずつ周波数を変える
+    double w = 2.0 * M_PI * (2000.0 + 37.0 * (idx % 64)) / BENCH_RATE;
+    double alpha = sin(w) / (2.0 * 0.707);
+    double a0 = 1.0 + alpha;
+
+    memset(n, 0, sizeof(BENCH_NODE));
+    n->b0 = (float)((1.0 - cos(w)) / 2.0 / a0);
+    n->b1 = (float)((1.0 - cos(w)) / a0);
+    n->b2 = n->b0;
+    n->a1 = (float)(-2.0 * cos(w) / a0);
+    n->a2 = (float)((1.0 - alpha) / a0);
+    n->tap = 300 + (idx * 17) % 600;
+}
+
+static void benchNodeRun(BENCH_NODE *n, float *buf)
+{
+    int i;
+    float x, y, d;
+
+    for (i = 0; i < BENCH_BLOCK; i++) {
+        x = buf[i];
+        y = n->b0 * x + n->z1;
+        n->z1 = n->b1 * x - n->a1 * y + n->z2;
+        n->z2 = n->b2 * x - n->a2 * y;
+
+        // ソフトクリップ
+        y = y / (1.0f + fabsf(y));
+
+        // 帰還付き遅延（リバーブの 1 タップ分）
+        d = n->delay[(n->pos - n->tap) & (BENCH_DELAY - 1)];
+        n->delay[n->pos] = y + 0.5f * d;
+        n->pos = (n->pos + 1) & (BENCH_DELAY - 1);
+
+        buf[i] = 0.5f * (x + y + d);
+    }
+}
+
+// 区間の処理スレッド
+static void *benchWorker(void *arg)
+{
+    BENCH_WORKER *wk = (BENCH_WORKER *)arg;
+    BENCH_CHAIN *c = wk->chain;
+    int k = wk->stage, i;
+    long blk = 0;
+    float *buf;
+
+    benchPin(k);
+    while (!atomic_load_explicit(&c->quit, memory_order_relaxed)) {
+        // 前の区間が処理したブロックを待つ
+        if (atomic_load_explicit(&c->done[k], memory_order_acquire) <= blk) {
+            sched_yield();
+            continue;
+        }
+        buf = c->ring[blk % BENCH_RING];
+        for (i = c->first[k]; i < c->first[k + 1]; i++) {
+            benchNodeRun(&c->nodes[i], buf);
+        }
+        blk++;
+        atomic_store_explicit(&c->done[k + 1], blk, memory_order_release);
+    }
+
+    return NULL;
+}
+
+//
+// nodeNum 段を stageNum 区間で処理する（0: 間に合った、1: 遅れが BENCH_MISS_RATIO を越えた）
+//
+static int benchTrial(BENCH_CHAIN *c, int nodeNum, int stageNum)
+{
+    pthread_t th[BENCH_MAX_STAGES];
+    BENCH_WORKER wk[BENCH_MAX_STAGES];
+    long periods = (long)BENCH_TRIAL_MSEC * 1000000LL / BENCH_PERIOD_NS;
+    long allow = (long)(periods * BENCH_MISS_RATIO);
+    long t, out, miss = 0;
+    long long start;
+    int i, k;
+
+    for (i = 0; i < nodeNum; i++) {
+        benchNodeInit(&c->nodes[i], i);
+    }
+    c->nodeNum  = nodeNum;
+    c->stageNum = stageNum;
+    for (k = 0; k <= stageNum; k++) {
+        c->first[k] = (int)((long)nodeNum * k / stageNum);
+        atomic_store(&c->done[k], 0);
+    }
+    atomic_store(&c->quit, 0);
+
+    for (k = 0; k < stageNum; k++) {
+        wk[k].chain = c;
+        wk[k].stage = k;
+        pthread_create(&th[k], NULL, benchWorker, &wk[k]);
+    }
+
+    // ブロック周期で入力し、BENCH_BUDGET ブロック後に出力が揃っているか確認
+    start = benchNow() + BENCH_PERIOD_NS;
+    for (t = 0; t < periods + BENCH_BUDGET; t++) {
+        benchSleepUntil(start + t * BENCH_PERIOD_NS);
+        out = t - BENCH_BUDGET;
+        if (out >= 0 && atomic_load_explicit(&c->done[stageNum], memory_order_acquire) <= out) {
+            // 許容数を越えたらそれ以上測らない
+            if (++miss > allow) {
+                break;
+            }
+        }
+        if (t < periods) {
+            for (i = 0; i < BENCH_BLOCK; i++) {
+                c->ring[t % BENCH_RING][i] = (float)sin(2.0 * M_PI * 440.0 * (t * BENCH_BLOCK + i) / BENCH_RATE);
+            }
+            atomic_store_explicit(&c->done[0], t + 1, memory_order_release);
+        }
+    }
+
+    atomic_store(&c->quit, 1);
+    for (k = 0; k < stageNum; k++) {
+        pthread_join(th[k], NULL);
+    }
+
+    return (miss > allow) ? 1 : 0;
+}
+
+//
+// 音切れしない最大段数（倍々で上限を探してから二分探索）
+//
+static int benchMaxNodes(BENCH_CHAIN *c, int stageNum)
+{
+    int lo = 0, hi = stageNum, mid;
+
+    while (hi <= BENCH_MAX_NODES && benchTrial(c, hi, stageNum) == 0) {
+        lo = hi;
+        hi *= 2;
+    }
+    if (hi > BENCH_MAX_NODES) {
+        return lo;
+    }
+    while (hi - lo > 1 && hi - lo > lo / 100) {
+        mid = (lo + hi) / 2;
+        if (benchTrial(c, mid, stageNum) == 0) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+// 1 ノード・1 ブロックあたりの処理時間（マイクロ秒）
+static double benchNodeCost(BENCH_CHAIN *c)
+{
+    float buf[BENCH_BLOCK];
+    long long t0;
+    int i, j, n = 256, loops = 2000;
+
+    for (i = 0; i < BENCH_BLOCK; i++) {
+        buf[i] = (float)sin(2.0 * M_PI * i / BENCH_BLOCK);
+    }
+    for (i = 0; i < n; i++) {
+        benchNodeInit(&c->nodes[i], i);
+    }
+    t0 = benchNow();
+    for (j = 0; j < loops; j++) {
+        for (i = 0; i < n; i++) {
+            benchNodeRun(&c->nodes[i], buf);
+        }
+    }
+
+    return (benchNow() - t0) / 1e3 / ((double)n * loops);
+}
+
+int main(int argc, char *argv[])
+{
+    BENCH_CHAIN *c;
+    int s, nodes, base = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    c = (BENCH_CHAIN *)calloc(1, sizeof(BENCH_CHAIN));
+    if (c == NULL || (c->nodes = (BENCH_NODE *)calloc(BENCH_MAX_NODES, sizeof(BENCH_NODE))) == NULL) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+
+    printf("chain: %d Hz, block %d (%.3f ms), %ld cpu(s), node %.3f us/block\n",
+           BENCH_RATE, BENCH_BLOCK, BENCH_PERIOD_NS / 1e6, ncpu, benchNodeCost(c));
+    printf("budget: %d blocks (%.2f ms) for every configuration, xrun over %.1f%% late blocks\n",
+           BENCH_BUDGET, BENCH_BUDGET * BENCH_PERIOD_NS / 1e6, BENCH_MISS_RATIO * 100.0);
+    printf("%-6s %10s %8s\n", "cores", "max nodes", "speedup");
+    for (s = 0; s < (int)(sizeof(STAGES) / sizeof(STAGES[0])); s++) {
+        // コアが足りなければ同じコアで時分割になるので測らない
+        if (STAGES[s] > ncpu) {
+            printf("%-6d %10s %8s\n", STAGES[s], "n/a", "n/a");
+            continue;
+        }
+        nodes = benchMaxNodes(c, STAGES[s]);
+        if (s == 0) {
+            base = nodes;
+        }
+        printf("%-6d %10d %7.2fx\n", STAGES[s], nodes, (base > 0) ? (double)nodes / base : 0.0);
+    }
+
+    free(c->nodes);
+    free(c);
+    return 0;
+}
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////
+// bench_wsola.c
+//   時間伸縮の処理時間と音質の測定
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "wsola.h"
+
+#define BENCH_RATE          (44100)         // サンプリング周波数
+#define BENCH_SECONDS       (30)            // 入力の長さ（秒）
+#define BENCH_BLOCK         (64)            // Pd のブロックサイズ
+#define BENCH_WARMUP        (1)
+#define BENCH_REPEAT        (5)
+#define BENCH_TONE_HZ       (440.0)         // 音質測定用の正弦波
+
+// 合否の閾値（超えたら非 0 で終了）
+#define BENCH_MAX_CORE      (25.0)          // 1 コアに対する割合（%）Pi Zero でも余裕を残す
+#define BENCH_MAX_CENTS     (5.0)           // ピッチ誤差（cent）
+#define BENCH_MAX_RIPPLE    (0.5)           // レベル変動（dB）
+#define BENCH_MAX_LEN_ERR   (0.5)           // 長さの誤差（%）
+
+#ifndef M_PI
+#define M_PI    (3.14159265358979323846)
+#endif
+
+static const float RATES[] = { 0.5f, 0.75f, 1.0f, 1.25f, 1.5f };
+
+// 経過時間（マイクロ秒）
+static double benchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Pd と同じくブロック単位で入力／出力する
+static int benchRender(WSOLA *w, const float *src, int srcLen, float *dst, int dstCap)
+{
+    int pos = 0, len = 0, n;
+
+    wsolaReset(w);
+    while (len < dstCap) {
+        if (pos < srcLen) {
+            pos += wsolaPush(w, src + pos, srcLen - pos);
+            if (pos >= srcLen) {
+                wsolaFlush(w);
+            }
+        }
+        n = wsolaPull(w, dst + len, (dstCap - len < BENCH_BLOCK) ? dstCap - len : BENCH_BLOCK);
+        if (n == 0 && pos >= srcLen) {
+            break;
+        }
+        len += n;
+    }
+
+    return len;
+}
+
+// 正弦波に対する基準出力（同じ周波数・振幅の正弦波）との比較
+//   ピッチ誤差（セント）、振幅のゆらぎ（dB）、長さの誤差（％）
+static void benchQuality(const float *out, int len, int srcLen, float rate,
+                         double *cents, double *ripple, double *lenErr)
+{
+    int i, crossings = 0, first = -1, last = -1, blk = BENCH_RATE / 50;
+    int skip = 4096;
+    double rms, lo = 1e9, hi = 0.0, hz;
+
+    // 立ち上がり／立ち下がりの過渡を除いた範囲で測る
+    for (i = skip + 1; i < len - skip; i++) {
+        if (out[i - 1] < 0.0f && out[i] >= 0.0f) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+            crossings++;
+        }
+    }
+    hz = (crossings > 1) ? (double)(crossings - 1) * BENCH_RATE / (last - first) : 0.0;
+    *cents = (hz > 0.0) ? 1200.0 * log2(hz / BENCH_TONE_HZ) : 9999.0;
+
+    for (i = skip; i + blk <= len - skip; i += blk) {
+        rms = 0.0;
+        for (int k = 0; k < blk; k++) {
+            rms += (double)out[i + k] * out[i + k];
+        }
+        rms = sqrt(rms / blk);
+        if (rms < lo) {
+            lo = rms;
+        }
+        if (rms > hi) {
+            hi = rms;
+        }
+    }
+    *ripple = (lo > 0.0) ? 20.0 * log10(hi / lo) : 99.0;
+    *lenErr = 100.0 * ((double)len / (srcLen / rate) - 1.0);
+}
+
+int main(void)
+{
+    int i, r, n, len, ng, fail = 0, srcLen = BENCH_RATE * BENCH_SECONDS, dstCap = srcLen * 2 + BENCH_RATE;
+    float *src, *dst;
+    double t, best, total, core, cents, ripple, lenErr;
+    WSOLA w;
+
+    src = malloc(srcLen * sizeof(float));
+    dst = malloc(dstCap * sizeof(float));
+    if (src == NULL || dst == NULL || wsolaInit(&w, WSOLA_FRAME_LEN, WSOLA_SEARCH) < 0) {
+        return 1;
+    }
+
+    // 処理時間：ギターに近い倍音を含む減衰音の連続
+    srand(1);
+    for (i = 0; i < srcLen; i++) {
+        double ph = 2.0 * M_PI * 110.0 * i / BENCH_RATE;
+        double env = exp(-3.0 * (i % (BENCH_RATE / 2)) / (double)BENCH_RATE);
+        src[i] = (float)(env * (0.5 * sin(ph) + 0.25 * sin(2 * ph) + 0.125 * sin(3 * ph)) + 0.001 * (rand() / (double)RAND_MAX - 0.5));
+    }
+    for (r = 0; r < (int)(sizeof(RATES) / sizeof(RATES[0])); r++) {
+        wsolaSetRate(&w, RATES[r]);
+        for (i = 0; i < BENCH_WARMUP; i++) {
+            benchRender(&w, src, srcLen, dst, dstCap);
+        }
+        best  = 1e30;
+        total = 0.0;
+        for (i = 0; i < BENCH_REPEAT; i++) {
+            t = benchNow();
+            len = benchRender(&w, src, srcLen, dst, dstCap);
+            t = benchNow() - t;
+            total += t;
+            if (t < best) {
+                best = t;
+            }
+        }
+        // 出力 1 秒あたりの処理時間
+        n = len / BENCH_RATE;
+        core = total / BENCH_REPEAT / n / 1e4;
+        ng = core > BENCH_MAX_CORE;
+        printf("wsola x%.2f: %.1f us per output second (best %.1f us), %.1f%% of one core%s\n",
+               RATES[r], total / BENCH_REPEAT / n, best / n, core, ng ? " FAIL" : "");
+        fail |= ng;
+    }
+
+    // 音質：正弦波を伸縮して基準（同じ周波数の正弦波）と比べる
+    for (i = 0; i < srcLen; i++) {
+        src[i] = (float)(0.5 * sin(2.0 * M_PI * BENCH_TONE_HZ * i / BENCH_RATE));
+    }
+    for (r = 0; r < (int)(sizeof(RATES) / sizeof(RATES[0])); r++) {
+        wsolaSetRate(&w, RATES[r]);
+        len = benchRender(&w, src, srcLen, dst, dstCap);
+        benchQuality(dst, len, srcLen, RATES[r], &cents, &ripple, &lenErr);
+        ng = fabs(cents) > BENCH_MAX_CENTS || ripple > BENCH_MAX_RIPPLE || fabs(lenErr) > BENCH_MAX_LEN_ERR;
+        printf("wsola x%.2f: pitch %+.2f cent, level ripple %.2f dB, length %+.2f%%%s\n",
+               RATES[r], cents, ripple, lenErr, ng ? " FAIL" : "");
+        fail |= ng;
+    }
+
+    wsolaFree(&w);
+    free(dst);
+    free(src);
+
+    return fail;
+}
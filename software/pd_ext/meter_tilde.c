@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////
+// meter_tilde.c
+//   meter~ : 入力レベル（ピーク／RMS／クリップ数）の測定
+//
+//   meter~ [interval]  interval ミリ秒ごとに集計して出力（省略時 200）
+//
+//   outlet 0: list <クリップ数> <ピーク dBFS> <RMS dBFS>
+//             （sendOSC の先頭引数を整数で送れるようにクリップ数を先に置く）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "m_pd.h"
+
+// 集計周期（ミリ秒）
+#define METER_INTERVAL_DEF  (200)
+#define METER_INTERVAL_MIN  (50)
+
+// クリップとみなすレベル（16bit のフルスケール手前）
+#define METER_CLIP_LEVEL    (0.999f)
+
+// 無音の dBFS
+#define METER_FLOOR_DB      (-100.0f)
+
+static t_class *meter_tilde_class;
+
+typedef struct _meter_tilde {
+    t_object        x_obj;
+    t_float         x_f;                // 信号入力のダミー
+    t_outlet *      x_listout;
+    t_clock *       x_clock;            // DSP スレッドからリストを出すため
+
+    float           x_sr;               // サンプリング周波数
+    float           x_intervalMs;       // 集計周期（ミリ秒）
+    int             x_interval;         // 集計周期（サンプル数）
+    int             x_count;            // 集計中のサンプル数
+    float           x_peak;             // 集計中のピーク
+    double          x_sum;              // 集計中の２乗和
+    int             x_clips;            // 集計中のクリップ数
+
+    float           x_outPeak;          // 確定した値
+    float           x_outRms;
+    int             x_outClips;
+} t_meter_tilde;
+
+static float meter_tilde_db(float v)
+{
+    return (v > 0.00001f) ? 20.0f * log10f(v) : METER_FLOOR_DB;
+}
+
+static void meter_tilde_tick(t_meter_tilde *x)
+{
+    t_atom at[3];
+
+    SETFLOAT(&at[0], x->x_outClips);
+    SETFLOAT(&at[1], meter_tilde_db(x->x_outPeak));
+    SETFLOAT(&at[2], meter_tilde_db(x->x_outRms));
+    outlet_list(x->x_listout, &s_list, 3, at);
+}
+
+// １パスでピーク・２乗和・クリップ数を集計
+static t_int *meter_tilde_perform(t_int *w)
+{
+    t_meter_tilde *x = (t_meter_tilde *)(w[1]);
+    t_sample *in = (t_sample *)(w[2]);
+    int n = (int)(w[3]), i, clips = 0;
+    float v, peak = x->x_peak;
+    double sum = 0.0;
+
+    for (i = 0; i < n; i++) {
+        v = fabsf(in[i]);
+        if (v > peak) {
+            peak = v;
+        }
+        if (v >= METER_CLIP_LEVEL) {
+            clips++;
+        }
+        sum += in[i] * in[i];
+    }
+    x->x_peak   = peak;
+    x->x_sum   += sum;
+    x->x_clips += clips;
+    x->x_count += n;
+
+    if (x->x_count >= x->x_interval) {
+        x->x_outPeak  = x->x_peak;
+        x->x_outRms   = (float)sqrt(x->x_sum / x->x_count);
+        x->x_outClips = x->x_clips;
+        x->x_peak  = 0.0f;
+        x->x_sum   = 0.0;
+        x->x_clips = 0;
+        x->x_count = 0;
+        clock_delay(x->x_clock, 0);
+    }
+
+    return (w + 4);
+}
+
+static void meter_tilde_dsp(t_meter_tilde *x, t_signal **sp)
+{
+    x->x_sr       = sp[0]->s_sr;
+    x->x_interval = (int)(x->x_sr * x->x_intervalMs / 1000.0f);
+    x->x_count    = 0;
+    dsp_add(meter_tilde_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+// 集計周期の変更
+static void meter_tilde_interval(t_meter_tilde *x, t_floatarg f)
+{
+    x->x_intervalMs = (f < METER_INTERVAL_MIN) ? METER_INTERVAL_MIN : f;
+    if (x->x_sr > 0) {
+        x->x_interval = (int)(x->x_sr * x->x_intervalMs / 1000.0f);
+    }
+}
+
+static void *meter_tilde_new(t_floatarg f)
+{
+    t_meter_tilde *x = (t_meter_tilde *)pd_new(meter_tilde_class);
+
+    x->x_listout = outlet_new(&x->x_obj, &s_list);
+    x->x_clock   = clock_new(x, (t_method)meter_tilde_tick);
+    x->x_interval = 0x7fffffff;         // DSP 開始までは出力しない
+    meter_tilde_interval(x, (f > 0) ? f : METER_INTERVAL_DEF);
+
+    return x;
+}
+
+static void meter_tilde_free(t_meter_tilde *x)
+{
+    clock_free(x->x_clock);
+}
+
+void meter_tilde_setup(void)
+{
+    meter_tilde_class = class_new(gensym("meter~"), (t_newmethod)meter_tilde_new,
+        (t_method)meter_tilde_free, sizeof(t_meter_tilde), 0, A_DEFFLOAT, 0);
+
+    CLASS_MAINSIGNALIN(meter_tilde_class, t_meter_tilde, x_f);
+    class_addmethod(meter_tilde_class, (t_method)meter_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(meter_tilde_class, (t_method)meter_tilde_interval, gensym("interval"), A_FLOAT, 0);
+}
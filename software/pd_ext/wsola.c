@@ -0,0 +1,302 @@
+///////////////////////////////////////////////////////////
+// wsola.c
+///////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "wsola.h"
+
+#ifndef M_PI
+#define M_PI    (3.14159265358979323846)
+#endif
+
+static int wsolaSeek(WSOLA *w, int pos);
+static void wsolaHop(WSOLA *w);
+static float wsolaDot(const float * restrict a, const float * restrict b, int n, int step);
+static float wsolaEnergy(const float * restrict a, int n, int step);
+
+//
+// 初期化
+//
+int wsolaInit(WSOLA *w, int frameLen, int search)
+{
+    int i;
+
+    memset(w, 0, sizeof(WSOLA));
+    if (frameLen < 64 || (frameLen & 1) || search < 0) {
+        return -1;
+    }
+
+    w->frameLen = frameLen;
+    w->hop      = frameLen / 2;
+    w->search   = search;
+    w->rate     = 1.0f;
+
+    // 最大速度でも 1 ホップ分＋探索幅＋フレームが収まるだけ確保
+    w->inCap = frameLen * 4 + search * 2 + (int)(w->hop * WSOLA_RATE_MAX) * 2;
+
+    w->win = malloc(frameLen * sizeof(float));
+    w->in  = malloc(w->inCap * sizeof(float));
+    w->ola = malloc(frameLen * sizeof(float));
+    w->out = malloc(w->hop * sizeof(float));
+    if (w->win == NULL || w->in == NULL || w->ola == NULL || w->out == NULL) {
+        wsolaFree(w);
+        return -1;
+    }
+
+    // 50% 重なりで和が 1 になる周期 Hann 窓
+    for (i = 0; i < frameLen; i++) {
+        w->win[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / frameLen);
+    }
+
+    wsolaReset(w);
+
+    return 0;
+}
+
+//
+// 解放
+//
+void wsolaFree(WSOLA *w)
+{
+    free(w->win);
+    free(w->in);
+    free(w->ola);
+    free(w->out);
+    memset(w, 0, sizeof(WSOLA));
+}
+
+//
+// 再生位置を先頭に戻す
+//
+void wsolaReset(WSOLA *w)
+{
+    w->inLen   = 0;
+    w->anaPos  = 0.0;
+    w->tmplPos = -1;
+    w->eof     = 0;
+    w->outLen  = 0;
+    w->outRead = 0;
+    memset(w->ola, 0, w->frameLen * sizeof(float));
+}
+
+//
+// 再生速度の設定
+//
+void wsolaSetRate(WSOLA *w, float rate)
+{
+    if (rate < WSOLA_RATE_MIN) {
+        rate = WSOLA_RATE_MIN;
+    }
+    else if (rate > WSOLA_RATE_MAX) {
+        rate = WSOLA_RATE_MAX;
+    }
+    w->rate = rate;
+}
+
+//
+// 入力の空き容量
+//
+int wsolaSpace(const WSOLA *w)
+{
+    return w->inCap - w->inLen;
+}
+
+//
+// 入力
+//
+int wsolaPush(WSOLA *w, const float *src, int n)
+{
+    if (n > w->inCap - w->inLen) {
+        n = w->inCap - w->inLen;
+    }
+    memcpy(w->in + w->inLen, src, n * sizeof(float));
+    w->inLen += n;
+
+    return n;
+}
+
+//
+// 入力終了
+//
+void wsolaFlush(WSOLA *w)
+{
+    w->eof = 1;
+}
+
+//
+// 出力
+//
+int wsolaPull(WSOLA *w, float *dst, int n)
+{
+    int k, done = 0;
+
+    while (done < n) {
+        if (w->outRead >= w->outLen) {
+            // 次のフレームに必要な入力が揃っていなければ終わり
+            if (w->anaPos + w->search + w->frameLen > w->inLen && w->eof == 0) {
+                break;
+            }
+            if (w->anaPos >= w->inLen) {
+                break;
+            }
+            wsolaHop(w);
+        }
+        k = w->outLen - w->outRead;
+        if (k > n - done) {
+            k = n - done;
+        }
+        memcpy(dst + done, w->out + w->outRead, k * sizeof(float));
+        w->outRead += k;
+        done       += k;
+    }
+
+    return done;
+}
+
+// 前フレームの続きに最も似た位置を探す（分析位置からのずれを返す）
+static int wsolaSeek(WSOLA *w, int pos)
+{
+    int d, lo, hi, best, center, len = w->frameLen - w->hop;
+    float c, e, score, bestScore;
+    const float *tmpl;
+
+    // 等速、または最初のフレームは探索しない
+    if (w->tmplPos < 0 || w->rate == 1.0f) {
+        return (w->tmplPos < 0) ? 0 : w->tmplPos - pos;
+    }
+    tmpl = w->in + w->tmplPos;
+
+    lo = (pos - w->search < 0) ? -pos : -w->search;
+    hi = w->search;
+    if (pos + hi + w->frameLen > w->inLen) {
+        hi = w->inLen - w->frameLen - pos;
+    }
+    if (hi < lo) {
+        return 0;
+    }
+
+    // 粗探索（位置も積和も間引く）
+    best      = 0;
+    bestScore = -1.0f;
+    for (d = lo; d <= hi; d += WSOLA_COARSE_STEP) {
+        c = wsolaDot(w->in + pos + d, tmpl, len, 2);
+        e = wsolaEnergy(w->in + pos + d, len, 2);
+        score = (e > 0.0f) ? c / sqrtf(e) : 0.0f;
+        if (score > bestScore) {
+            bestScore = score;
+            best      = d;
+        }
+    }
+
+    // 粗探索の結果の周辺を詳細探索
+    center = best;
+    for (d = center - WSOLA_COARSE_STEP + 1; d < center + WSOLA_COARSE_STEP; d++) {
+        if (d < lo || d > hi || d == center) {
+            continue;
+        }
+        c = wsolaDot(w->in + pos + d, tmpl, len, 1);
+        e = wsolaEnergy(w->in + pos + d, len, 1);
+        score = (e > 0.0f) ? c / sqrtf(e) : 0.0f;
+        if (score > bestScore) {
+            bestScore = score;
+            best      = d;
+        }
+    }
+
+    return best;
+}
+
+// 1 ホップ分を生成
+static void wsolaHop(WSOLA *w)
+{
+    int i, pos, drop, n;
+    float *src;
+
+    pos = (int)w->anaPos;
+    pos += wsolaSeek(w, pos);
+    src = w->in + pos;
+
+    // 等速に戻したら分析位置を前フレームの続きに揃える
+    if (w->rate == 1.0f) {
+        w->anaPos = pos;
+    }
+
+    // 入力の終わりを越える分は無音として重畳加算
+    n = w->inLen - pos;
+    if (n > w->frameLen) {
+        n = w->frameLen;
+    }
+    for (i = 0; i < n; i++) {
+        w->ola[i] += src[i] * w->win[i];
+    }
+
+    // 前半が確定
+    memcpy(w->out, w->ola, w->hop * sizeof(float));
+    memmove(w->ola, w->ola + w->hop, (w->frameLen - w->hop) * sizeof(float));
+    memset(w->ola + w->frameLen - w->hop, 0, w->hop * sizeof(float));
+    w->outLen  = w->hop;
+    w->outRead = 0;
+
+    // 次のフレーム
+    w->tmplPos = pos + w->hop;
+    w->anaPos += w->hop * w->rate;
+
+    // 使い終わった入力を捨てる
+    drop = (int)w->anaPos - w->search;
+    if (drop > w->tmplPos) {
+        drop = w->tmplPos;
+    }
+    if (drop > w->inLen) {
+        drop = w->inLen;
+    }
+    if (drop >= w->frameLen) {
+        memmove(w->in, w->in + drop, (w->inLen - drop) * sizeof(float));
+        w->inLen   -= drop;
+        w->anaPos  -= drop;
+        w->tmplPos -= drop;
+    }
+}
+
+// 積和（4 本の累積でパイプライン／ベクトル化しやすくする）
+static float wsolaDot(const float * restrict a, const float * restrict b, int n, int step)
+{
+    int i;
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+
+    if (step == 1) {
+        for (i = 0; i + 4 <= n; i += 4) {
+            s0 += a[i]     * b[i];
+            s1 += a[i + 1] * b[i + 1];
+            s2 += a[i + 2] * b[i + 2];
+            s3 += a[i + 3] * b[i + 3];
+        }
+    }
+    else {
+        for (i = 0; i + 4 * step <= n; i += 4 * step) {
+            s0 += a[i]            * b[i];
+            s1 += a[i + step]     * b[i + step];
+            s2 += a[i + step * 2] * b[i + step * 2];
+            s3 += a[i + step * 3] * b[i + step * 3];
+        }
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+// 二乗和
+static float wsolaEnergy(const float * restrict a, int n, int step)
+{
+    int i;
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+
+    for (i = 0; i + 4 * step <= n; i += 4 * step) {
+        s0 += a[i]            * a[i];
+        s1 += a[i + step]     * a[i + step];
+        s2 += a[i + step * 2] * a[i + step * 2];
+        s3 += a[i + step * 3] * a[i + step * 3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////
+// wsola.h
+///////////////////////////////////////////////////////////
+#ifndef __WSOLA_H__
+#define __WSOLA_H__
+
+// 再生速度の範囲
+#define WSOLA_RATE_MIN      (0.5f)
+#define WSOLA_RATE_MAX      (1.5f)
+
+// 既定のフレーム長／探索幅（44.1kHz で約 23ms／±6ms）
+#define WSOLA_FRAME_LEN     (1024)
+#define WSOLA_SEARCH        (256)
+
+// 粗探索の間引き
+#define WSOLA_COARSE_STEP   (4)
+
+//
+// WSOLA（波形相似重畳加算）による時間伸縮
+//   ピッチを変えずに再生速度だけを変える（モノラル）
+//
+typedef struct {
+    int         frameLen;               // フレーム長
+    int         hop;                    // 出力側のホップ長（フレーム長の半分）
+    int         search;                 // 探索幅（±）
+    float       rate;                   // 再生速度
+
+    float *     win;                    // 窓関数（Hann）
+
+    float *     in;                     // 入力バッファ
+    int         inCap;                  // 入力バッファの容量
+    int         inLen;                  // 入力バッファ内のサンプル数
+    double      anaPos;                 // 次の分析位置（in[0] からの位置）
+    int         tmplPos;                // 前フレームの自然な続き（in[0] からの位置、-1 は無し）
+    int         eof;                    // 入力終了
+
+    float *     ola;                    // 重畳加算バッファ（フレーム長）
+    float *     out;                    // 確定した出力（ホップ長）
+    int         outLen;                 // 確定した出力のサンプル数
+    int         outRead;                // 確定した出力の読出し位置
+} WSOLA;
+
+//
+// 初期化／解放
+//
+extern int wsolaInit(WSOLA *w, int frameLen, int search);
+extern void wsolaFree(WSOLA *w);
+
+//
+// 再生位置を先頭に戻す（速度はそのまま）
+//
+extern void wsolaReset(WSOLA *w);
+
+//
+// 再生速度の設定（次のホップから反映）
+//
+extern void wsolaSetRate(WSOLA *w, float rate);
+
+//
+// 入力の空き容量
+//
+extern int wsolaSpace(const WSOLA *w);
+
+//
+// 入力（受け取ったサンプル数を返す）
+//
+extern int wsolaPush(WSOLA *w, const float *src, int n);
+
+//
+// 入力終了（残りを出し切る）
+//
+extern void wsolaFlush(WSOLA *w);
+
+//
+// 出力（出力できたサンプル数を返す、入力が足りなければ n 未満）
+//
+extern int wsolaPull(WSOLA *w, float *dst, int n);
+
+#endif // __WSOLA_H__
@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////
+// wsola_tilde.c
+//   wsola~ : 録音ファイルをピッチを変えずに速度を変えて再生
+//
+//   open <file>  ファイルを開く
+//   start / 1    再生開始
+//   stop  / 0    再生停止
+//   rate <f>     再生速度（0.5 ～ 1.5、再生中も即時反映）
+//
+//   outlet 0: 音声、outlet 1: 再生終了で bang（readsf~ と同じ並び）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "m_pd.h"
+#include "pws_wav.h"
+#include "wsola.h"
+
+// 読込みスレッドのバッファ（約 1.5 秒分）
+#define WSOLA_RING_SIZE     (65536)
+#define WSOLA_READ_FRAMES   (4096)
+
+// 読込みスレッドへの要求
+#define REQ_NOTHING         (0)
+#define REQ_OPEN            (1)
+#define REQ_CLOSE           (2)
+#define REQ_QUIT            (3)
+
+static t_class *wsola_tilde_class;
+
+typedef struct _wsola_tilde {
+    t_object        x_obj;
+    t_outlet *      x_bangout;
+    t_clock *       x_clock;            // DSP スレッドから bang を出すため
+
+    WSOLA           x_ws;
+    float           x_rate;             // 要求された再生速度
+    int             x_playing;          // 再生中
+    int             x_flushed;          // 入力終了を WSOLA へ通知済み
+
+    pthread_t       x_thread;
+    int             x_started;          // 読込みスレッドを作成済み
+    pthread_mutex_t x_mutex;
+    pthread_cond_t  x_cond;
+    int             x_request;          // 読込みスレッドへの要求
+    int             x_opened;           // ファイルを開けた
+    int             x_eof;              // ファイルを読み終えた
+    char            x_path[MAXPDSTRING];
+    float *         x_ring;             // 読込み済みサンプル
+    int             x_head;             // 書込み位置（読込みスレッド）
+    int             x_tail;             // 読出し位置（DSP）
+} t_wsola_tilde;
+
+// リングバッファの読込み済み数（ロック取得済みで呼ぶこと）
+static int wsola_tilde_ringcount(t_wsola_tilde *x)
+{
+    return (x->x_head - x->x_tail + WSOLA_RING_SIZE) % WSOLA_RING_SIZE;
+}
+
+// 読込みスレッド
+static void *wsola_tilde_child(void *arg)
+{
+    t_wsola_tilde *x = (t_wsola_tilde *)arg;
+    int fd = -1, req, ch, i, n, space, frames;
+    uint32_t pos = 0, avail;
+    uint8_t *buf;
+    float *val;
+    char path[MAXPDSTRING];
+    WAV_INFO info;
+
+    buf = malloc(WSOLA_READ_FRAMES * 8 * 4);
+    val = malloc(WSOLA_READ_FRAMES * 8 * sizeof(float));
+
+    pthread_mutex_lock(&x->x_mutex);
+    for (;;) {
+        req = x->x_request;
+        x->x_request = REQ_NOTHING;
+
+        if (req == REQ_QUIT) {
+            break;
+        }
+        // バッファは要求した側で空にしてある
+        if ((req == REQ_OPEN || req == REQ_CLOSE) && fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (req == REQ_OPEN) {
+            strncpy(path, x->x_path, sizeof(path) - 1);
+            path[sizeof(path) - 1] = '\0';
+            pthread_mutex_unlock(&x->x_mutex);
+
+            // ロックを外して開く（SD カードは遅いことがある）
+            fd = open(path, O_RDONLY);
+            if (fd >= 0 && (wavReadHeader(fd, &info) < 0 || info.channels > 8 || info.bits > 32)) {
+                close(fd);
+                fd = -1;
+            }
+            pos = 0;
+
+            pthread_mutex_lock(&x->x_mutex);
+            if (x->x_request != REQ_NOTHING) {
+                // 開いている間に開き直し／停止された
+                continue;
+            }
+            if (fd < 0) {
+                x->x_eof = 1;
+            }
+            x->x_opened = 1;
+            continue;
+        }
+
+        // 空きがあれば読み進める
+        space = WSOLA_RING_SIZE - 1 - wsola_tilde_ringcount(x);
+        if (fd >= 0 && x->x_eof == 0 && space >= WSOLA_READ_FRAMES) {
+            pthread_mutex_unlock(&x->x_mutex);
+
+            avail  = wavDataBytes(&info) - pos;
+            frames = WSOLA_READ_FRAMES;
+            if ((uint32_t)(frames * info.align) > avail) {
+                frames = avail / info.align;
+            }
+            n = (frames > 0) ? pread(fd, buf, frames * info.align, info.dataOfs + pos) : 0;
+            frames = (n > 0) ? n / info.align : 0;
+            pos += frames * info.align;
+            if (frames > 0 && wavToFloat(&info, buf, val, frames * info.channels) < 0) {
+                frames = 0;
+            }
+
+            pthread_mutex_lock(&x->x_mutex);
+            if (x->x_request != REQ_NOTHING) {
+                // 読んでいる間に開き直し／停止された
+                continue;
+            }
+            // 先頭チャンネルだけを使う（Recorder の録音はモノラル）
+            ch = info.channels;
+            for (i = 0; i < frames; i++) {
+                x->x_ring[x->x_head] = val[i * ch];
+                x->x_head = (x->x_head + 1) % WSOLA_RING_SIZE;
+            }
+            if (frames == 0) {
+                x->x_eof = 1;
+            }
+            continue;
+        }
+
+        pthread_cond_wait(&x->x_cond, &x->x_mutex);
+    }
+    pthread_mutex_unlock(&x->x_mutex);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(val);
+    free(buf);
+
+    return NULL;
+}
+
+// 読込み済みのサンプルを捨てる（ロック取得済みで呼ぶこと）
+//   読込みスレッドが要求を受取るまでの間に DSP が前のファイルの続きを出さないよう、要求する側で行う
+static void wsola_tilde_clear(t_wsola_tilde *x)
+{
+    x->x_head   = 0;
+    x->x_tail   = 0;
+    x->x_eof    = 0;
+    x->x_opened = 0;
+}
+
+// 読込みスレッドへ要求
+static void wsola_tilde_request(t_wsola_tilde *x, int req)
+{
+    pthread_mutex_lock(&x->x_mutex);
+    if (req == REQ_CLOSE) {
+        wsola_tilde_clear(x);
+    }
+    x->x_request = req;
+    pthread_cond_signal(&x->x_cond);
+    pthread_mutex_unlock(&x->x_mutex);
+}
+
+static void wsola_tilde_open(t_wsola_tilde *x, t_symbol *s)
+{
+    x->x_playing = 0;
+    pthread_mutex_lock(&x->x_mutex);
+    strncpy(x->x_path, s->s_name, MAXPDSTRING - 1);
+    x->x_path[MAXPDSTRING - 1] = '\0';
+    wsola_tilde_clear(x);
+    x->x_request = REQ_OPEN;
+    pthread_cond_signal(&x->x_cond);
+    pthread_mutex_unlock(&x->x_mutex);
+}
+
+static void wsola_tilde_start(t_wsola_tilde *x)
+{
+    wsolaReset(&x->x_ws);
+    x->x_flushed = 0;
+    x->x_playing = 1;
+}
+
+static void wsola_tilde_stop(t_wsola_tilde *x)
+{
+    x->x_playing = 0;
+    wsola_tilde_request(x, REQ_CLOSE);
+}
+
+static void wsola_tilde_float(t_wsola_tilde *x, t_floatarg f)
+{
+    if (f != 0) {
+        wsola_tilde_start(x);
+    }
+    else {
+        wsola_tilde_stop(x);
+    }
+}
+
+static void wsola_tilde_rate(t_wsola_tilde *x, t_floatarg f)
+{
+    x->x_rate = f;
+}
+
+static void wsola_tilde_tick(t_wsola_tilde *x)
+{
+    outlet_bang(x->x_bangout);
+}
+
+static t_int *wsola_tilde_perform(t_int *w)
+{
+    t_wsola_tilde *x = (t_wsola_tilde *)(w[1]);
+    t_sample *out = (t_sample *)(w[2]);
+    int n = (int)(w[3]);
+    int i, k, done = 0, space;
+
+    if (x->x_playing) {
+        wsolaSetRate(&x->x_ws, x->x_rate);
+
+        // 読込み済みの分を WSOLA へ渡す
+        pthread_mutex_lock(&x->x_mutex);
+        if (x->x_opened) {
+            space = wsolaSpace(&x->x_ws);
+            while (space > 0 && x->x_tail != x->x_head) {
+                k = (x->x_head > x->x_tail) ? x->x_head - x->x_tail : WSOLA_RING_SIZE - x->x_tail;
+                if (k > space) {
+                    k = space;
+                }
+                wsolaPush(&x->x_ws, x->x_ring + x->x_tail, k);
+                x->x_tail = (x->x_tail + k) % WSOLA_RING_SIZE;
+                space -= k;
+            }
+            if (x->x_eof && x->x_tail == x->x_head && x->x_flushed == 0) {
+                wsolaFlush(&x->x_ws);
+                x->x_flushed = 1;
+            }
+            pthread_cond_signal(&x->x_cond);
+        }
+        pthread_mutex_unlock(&x->x_mutex);
+
+        done = wsolaPull(&x->x_ws, out, n);
+
+        // 最後まで出し切ったら終了
+        if (done < n && x->x_flushed) {
+            x->x_playing = 0;
+            clock_delay(x->x_clock, 0);
+        }
+    }
+    for (i = done; i < n; i++) {
+        out[i] = 0;
+    }
+
+    return (w + 4);
+}
+
+static void wsola_tilde_dsp(t_wsola_tilde *x, t_signal **sp)
+{
+    dsp_add(wsola_tilde_perform, 3, x, sp[0]->s_vec, (t_int)sp[0]->s_n);
+}
+
+static void *wsola_tilde_new(void)
+{
+    t_wsola_tilde *x = (t_wsola_tilde *)pd_new(wsola_tilde_class);
+
+    outlet_new(&x->x_obj, &s_signal);
+    x->x_bangout = outlet_new(&x->x_obj, &s_bang);
+    x->x_clock   = clock_new(x, (t_method)wsola_tilde_tick);
+    x->x_rate    = 1.0f;
+
+    pthread_mutex_init(&x->x_mutex, NULL);
+    pthread_cond_init(&x->x_cond, NULL);
+    x->x_request = REQ_NOTHING;
+
+    // 確保できなければオブジェクトを作らない（確保した分は wsola_tilde_free で解放）
+    x->x_ring = getbytes(WSOLA_RING_SIZE * sizeof(float));
+    if (x->x_ring == NULL || wsolaInit(&x->x_ws, WSOLA_FRAME_LEN, WSOLA_SEARCH) < 0) {
+        pd_error(x, "wsola~: out of memory");
+        pd_free((t_pd *)x);
+        return NULL;
+    }
+    if (pthread_create(&x->x_thread, NULL, wsola_tilde_child, x) != 0) {
+        pd_error(x, "wsola~: cannot create reader thread");
+        pd_free((t_pd *)x);
+        return NULL;
+    }
+    x->x_started = 1;
+
+    return x;
+}
+
+static void wsola_tilde_free(t_wsola_tilde *x)
+{
+    if (x->x_started) {
+        wsola_tilde_request(x, REQ_QUIT);
+        pthread_join(x->x_thread, NULL);
+    }
+    pthread_cond_destroy(&x->x_cond);
+    pthread_mutex_destroy(&x->x_mutex);
+
+    clock_free(x->x_clock);
+    wsolaFree(&x->x_ws);
+    if (x->x_ring != NULL) {
+        freebytes(x->x_ring, WSOLA_RING_SIZE * sizeof(float));
+    }
+}
+
+void wsola_tilde_setup(void)
+{
+    wsola_tilde_class = class_new(gensym("wsola~"), (t_newmethod)wsola_tilde_new,
+        (t_method)wsola_tilde_free, sizeof(t_wsola_tilde), 0, 0);
+
+    class_addmethod(wsola_tilde_class, (t_method)wsola_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(wsola_tilde_class, (t_method)wsola_tilde_open, gensym("open"), A_SYMBOL, 0);
+    class_addmethod(wsola_tilde_class, (t_method)wsola_tilde_start, gensym("start"), 0);
+    class_addmethod(wsola_tilde_class, (t_method)wsola_tilde_stop, gensym("stop"), 0);
+    class_addmethod(wsola_tilde_class, (t_method)wsola_tilde_rate, gensym("rate"), A_FLOAT, 0);
+    class_addfloat(wsola_tilde_class, (t_method)wsola_tilde_float);
+}
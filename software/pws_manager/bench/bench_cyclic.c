@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////
+// bench_cyclic.c
+//   アップロード相当の負荷をかけたときの起床遅延の計測（cyclictest 相当）
+//
+//   bench_cyclic [-n 回数] [-i 周期] [-r 役割] [-p 優先度] [-l 負荷の数] [-w 負荷の nice]
+//     -n  計測の回数（既定 10000）
+//     -i  起床の周期（マイクロ秒、既定 1000）
+//     -r  pws_rt.h の役割（button / manager / led / watch / background、既定 button）
+//     -p  役割の設定の代わりに SCHED_FIFO の優先度を指定（0: SCHED_OTHER で比較用）
+//     -l  負荷のプロセス数（既定は CPU の数、0: 負荷なし）
+//     -w  負荷の nice（既定 10、pws-uploader.service と合わせる）
+//
+//   PWS_RT_FILE があればその設定で rtInitialize（mlockall など）してから計る。
+//   負荷は SCHED_BATCH の子プロセスで、アップロードと同じくファイルを読んで
+//   ハッシュを計算し、ループバックへ UDP で送り続ける。
+//   SCHED_FIFO には root（または rtprio の制限の緩和）が必要。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_rt.h"
+
+#define CYC_LOOPS           (10000)
+#define CYC_INTERVAL_US     (1000)
+#define CYC_LOAD_NICE       (10)
+#define CYC_HIST_US         (10000)         // ヒストグラムの範囲（これ以上はまとめる）
+#define CYC_LOAD_CHUNK      (256 * 1024)    // 負荷が１回に読み書きする大きさ
+#define CYC_LOAD_FILE_MB    (16)
+#define CYC_LOAD_PORT       (9)             // UDP の送り先（discard）
+
+static uint32_t CycHist[CYC_HIST_US + 1];
+
+static int CycLoops    = CYC_LOOPS;
+static int CycInterval = CYC_INTERVAL_US;
+static int CycRole     = RT_ROLE_BUTTON;
+static int CycPrio     = -1;                // -1: 役割の設定を使う
+
+static volatile sig_atomic_t CycLoadStop = 0;
+
+// 計測結果
+static struct {
+    int         count;
+    int         policy;
+    int         prio;
+    uint32_t    min, max, last;
+    uint64_t    sum;
+    uint32_t    over;                       // CYC_HIST_US を超えた回数
+} CycResult;
+
+static uint64_t cycNs(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+// 負荷（アップロード相当）の停止
+static void cycLoadSig(int sig)
+{
+    CycLoadStop = 1;
+}
+
+// 負荷のプロセス（ファイルの書込み・読込み、ハッシュ、UDP 送信を繰り返す）
+static void cycLoad(int id, int nice)
+{
+    struct sched_param param;
+    struct sockaddr_in addr;
+    char path[64];
+    uint8_t *buf;
+    uint32_t hash = 2166136261u;
+    int fd, sock, i, n, blocks;
+
+    signal(SIGTERM, cycLoadSig);
+    memset(&param, 0, sizeof(param));
+    sched_setscheduler(0, SCHED_BATCH, &param);
+    setpriority(PRIO_PROCESS, 0, nice);
+
+    buf = malloc(CYC_LOAD_CHUNK);
+    snprintf(path, sizeof(path), "/tmp/bench_cyclic.%d.%d", (int)getppid(), id);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    unlink(path);
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (buf == NULL || fd < 0 || sock < 0) {
+        _exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(CYC_LOAD_PORT);
+
+    for (i = 0; i < CYC_LOAD_CHUNK; i++) {
+        buf[i] = (uint8_t)(i * 31 + id);
+    }
+    blocks = CYC_LOAD_FILE_MB * 1024 * 1024 / CYC_LOAD_CHUNK;
+
+    while (!CycLoadStop) {
+        // 書込み（録音ファイルの作成に相当）
+        lseek(fd, 0, SEEK_SET);
+        for (i = 0; i < blocks && !CycLoadStop; i++) {
+            if (write(fd, buf, CYC_LOAD_CHUNK) < 0) {
+                break;
+            }
+        }
+        fdatasync(fd);
+        // 読込み → ハッシュ → 送信（アップロードに相当）
+        lseek(fd, 0, SEEK_SET);
+        while (!CycLoadStop && (n = read(fd, buf, CYC_LOAD_CHUNK)) > 0) {
+            for (i = 0; i < n; i++) {
+                hash = (hash ^ buf[i]) * 16777619u;
+            }
+            for (i = 0; i + 1400 <= n; i += 1400) {
+                sendto(sock, buf + i, 1400, 0, (struct sockaddr *)&addr, sizeof(addr));
+            }
+        }
+    }
+
+    close(sock);
+    close(fd);
+    _exit(hash == 0);
+}
+
+// 計測スレッド（役割の設定を適用して周期的に起床する）
+static void *cycMeasure(void *arg)
+{
+    int i;
+    uint32_t lat;
+    uint64_t next, now;
+    struct timespec ts;
+    struct sched_param param;
+
+    if (CycPrio < 0) {
+        rtApply(CycRole);
+    }
+    else {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = CycPrio;
+        if (sched_setscheduler(0, (CycPrio > 0) ? SCHED_FIFO : SCHED_OTHER, &param) < 0) {
+            fprintf(stderr, "sched_setscheduler: %s\n", strerror(errno));
+        }
+    }
+    // SCHED_RESET_ON_FORK の分は除く
+    CycResult.policy = sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+    sched_getparam(0, &param);
+    CycResult.prio = param.sched_priority;
+
+    CycResult.min = UINT32_MAX;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    next = cycNs(&ts);
+    for (i = 0; i < CycLoops; i++) {
+        next += (uint64_t)CycInterval * 1000;
+        ts.tv_sec  = next / 1000000000ULL;
+        ts.tv_nsec = next % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = cycNs(&ts);
+
+        lat = (now > next) ? (uint32_t)((now - next) / 1000) : 0;
+        if (lat < CycResult.min) CycResult.min = lat;
+        if (lat > CycResult.max) CycResult.max = lat;
+        CycResult.last = lat;
+        CycResult.sum += lat;
+        CycResult.count++;
+        if (lat > CYC_HIST_US) {
+            CycResult.over++;
+            lat = CYC_HIST_US;
+        }
+        CycHist[lat]++;
+
+        // 遅れが周期を超えたら次の周期から計り直す（cyclictest と同じ）
+        if (now > next + (uint64_t)CycInterval * 1000) {
+            next = now;
+        }
+    }
+
+    return NULL;
+}
+
+// ヒストグラムの分位点（マイクロ秒）
+static uint32_t cycPercentile(double p)
+{
+    uint32_t i;
+    uint64_t acc = 0, target;
+
+    target = (uint64_t)(CycResult.count * p);
+    for (i = 0; i <= CYC_HIST_US; i++) {
+        acc += CycHist[i];
+        if (acc > target) {
+            return i;
+        }
+    }
+    return CYC_HIST_US;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, loads, nice = CYC_LOAD_NICE;
+    pid_t *pid;
+    pthread_t th;
+    RT_PROFILE profile;
+
+    loads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((c = getopt(argc, argv, "n:i:r:p:l:w:")) != -1) {
+        switch (c) {
+        case 'n': CycLoops    = atoi(optarg); break;
+        case 'i': CycInterval = atoi(optarg); break;
+        case 'r': CycRole     = rtFindRole(optarg); break;
+        case 'p': CycPrio     = atoi(optarg); break;
+        case 'l': loads       = atoi(optarg); break;
+        case 'w': nice        = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n loops] [-i interval_us] [-r role] [-p prio] [-l loads] [-w load_nice]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (CycRole < 0 || CycLoops <= 0 || CycInterval <= 0 || loads < 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    // 負荷を先に起動する（mlockall を引継がない）
+    pid = calloc(loads + 1, sizeof(pid_t));
+    for (i = 0; i < loads; i++) {
+        pid[i] = fork();
+        if (pid[i] == 0) {
+            cycLoad(i, nice);
+        }
+    }
+
+    if (rtInitialize() < 0) {
+        fprintf(stderr, "rtInitialize: some settings failed (not root?)\n");
+    }
+    rtGetProfile(CycRole, &profile);
+
+    pthread_create(&th, NULL, cycMeasure, NULL);
+    pthread_join(th, NULL);
+
+    for (i = 0; i < loads; i++) {
+        if (pid[i] > 0) {
+            kill(pid[i], SIGTERM);
+            waitpid(pid[i], NULL, 0);
+        }
+    }
+    free(pid);
+
+    printf("role %s, %s %d, interval %d us, %d loads (nice %d)\n",
+           profile.name, (CycResult.policy == SCHED_FIFO) ? "SCHED_FIFO" : "SCHED_OTHER",
+           CycResult.prio, CycInterval, loads, nice);
+    printf("T: 0 C: %7d Min: %6u Act: %6u Avg: %6u Max: %6u\n",
+           CycResult.count, CycResult.min, CycResult.last,
+           (uint32_t)(CycResult.sum / CycResult.count), CycResult.max);
+    printf("p50 %u  p99 %u  p99.9 %u  over %d us: %u\n",
+           cycPercentile(0.50), cycPercentile(0.99), cycPercentile(0.999), CYC_HIST_US, CycResult.over);
+
+    return 0;
+}
@@ -0,0 +1,526 @@
+///////////////////////////////////////////////////////////
+// bench_e2e.c
+//   操作から LED 表示までの遅延の計測（起動中の pws_manager が相手）
+//
+//   bench_e2e [-n 周回数] [-d ミリ秒] [-D モジュール=ミリ秒,...] [-L]
+//     -n  録音→再生→チューニング→ボリューム→エフェクト を１周として繰返す数（既定 1000）
+//     -d  代役モジュールの応答遅延（既定 5 ms）
+//     -D  モジュールごとの応答遅延（例: -D recorder=50,uploader=200）
+//     -L  LED を見ない（GPIO を読めない環境、wiringPi のスタブで動かすとき）
+//
+//   Pd の各モジュール（8002～8006）とアップローダー（8100）の代わりに、
+//   同じ OSC のやりとりをする代役プロセスを起動してポートを受け持つ。
+//   ボタン監視スレッドと同じメッセージを 8001 へ送り、以下を計測する。
+//     押下 → 代役モジュールが指示を受信
+//     押下 → LED 点灯（開始操作）、完了通知 → LED 消灯（終了操作）
+//   LED は LED Controller が書いた GPIO の値を読んで判定する。
+//
+//   実行前に Pd とアップローダーを止めておくこと（ポートが使用中ならエラー）。
+//   マネージャーはアイドル状態から始める。録音ライブラリには
+//   E2E_TAKE_PATH の１件が登録される（検証用の機器で使う）。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <wiringPi.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_gpio.h"
+#include "pws_manager.h"
+
+#define E2E_ITERATIONS      (1000)
+#define E2E_DELAY_MS        (5)
+#define E2E_TIMEOUT_MS      (2000)          // 指示・完了通知・LED を待つ時間
+#define E2E_SETTLE_US       (2000)          // LED を見ない時に完了通知の後で待つ時間
+#define E2E_LED_POLL_US     (200)           // GPIO を読む間隔
+#define E2E_PENDING_MAX     (16)
+#define E2E_ADDR_LEN        (64)
+#define E2E_TAKE_PATH       "/tmp/pws_e2e_take.wav"
+
+//
+// 代役モジュール
+//
+typedef struct {
+    const char  *name;
+    int          port;
+    int          delay;                     // 応答遅延（ミリ秒）
+    pid_t        pid;
+} E2E_MODULE;
+
+static E2E_MODULE E2eModule[] = {
+    { "recorder"    , PWS_PORT_RECORDER             , -1, -1 },
+    { "player"      , PWS_PORT_PLAYER               , -1, -1 },
+    { "tuner"       , PWS_PORT_TUNER                , -1, -1 },
+    { "effect"      , PWS_PORT_EFFECT_CONTROLLER    , -1, -1 },
+    { "audio_out"   , PWS_PORT_AUDIO_OUT            , -1, -1 },
+    { "uploader"    , PWS_PORT_FILE_UPLOADER        , -1, -1 },
+    { NULL          , 0                             ,  0,  0 },
+};
+
+//
+// 指示に対する応答（Pd の各モジュールとアップローダーと同じもの、引数は pws_schema.def の通り）
+//   step: 応答遅延の何倍後に送るか
+//
+#define E2E_ARG_CODE        (0)             // 結果だけ
+#define E2E_ARG_CODE_PATH   (1)             // 結果と録音ファイルのパス
+#define E2E_ARG_PATH        (2)             // 録音ファイルのパスだけ
+
+static const struct {
+    const char  *cmd;
+    const char  *reply;
+    int          args;
+    int          step;
+} E2eReply[] = {
+    { MSG_REC_START     , MSG_REC_STARTED   , E2E_ARG_CODE     , 1 },   // パスを付けるとピークファイルの生成が始まるので付けない
+    { MSG_REC_STOP      , MSG_REC_STOPPED   , E2E_ARG_CODE_PATH, 1 },
+    { MSG_PLAY_STOP     , MSG_PLAY_STOPPED  , E2E_ARG_CODE     , 1 },
+    { MSG_TUNING_STOP   , MSG_TUNING_STOPPED, E2E_ARG_CODE     , 1 },
+    { MSG_UPLOAD_START  , MSG_UPLOAD_STARTED, E2E_ARG_PATH     , 1 },
+    { MSG_UPLOAD_START  , MSG_UPLOAD_STOPPED, E2E_ARG_CODE_PATH, 2 },
+    { NULL              , NULL              , 0                , 0 },
+};
+
+//
+// 代役モジュールからドライバーへの報告
+//
+#define E2E_RECV            (0)             // 指示を受信
+#define E2E_REPLY           (1)             // 応答を送信
+
+typedef struct {
+    int         port;
+    int         kind;
+    uint64_t    at;                         // CLOCK_MONOTONIC（マイクロ秒）
+    char        addr[E2E_ADDR_LEN];
+} E2E_REPORT;
+
+//
+// 計測の手順（１周分）
+//
+typedef struct {
+    const char  *name;
+    const char  *press;                     // ボタン押下のメッセージ
+    int          port;                      // 指示先
+    const char  *cmd;                       // 指示
+    const char  *done;                      // 完了通知（NULL: 無し）
+    int          ledPin;                    // 見る LED（-1: 見ない）
+    int          ledVal;
+    int          ledFromDone;               // 1: 完了通知から計る、0: 押下から計る
+} E2E_STEP;
+
+static const E2E_STEP E2eStep[] = {
+    { "rec_start"   , MSG_PUSH_REC_BTN      , PWS_PORT_RECORDER         , MSG_REC_START     , MSG_REC_STARTED   , PIN_LED_RED  , PIN_VAL_ON , 0 },
+    { "rec_stop"    , MSG_PUSH_REC_BTN      , PWS_PORT_RECORDER         , MSG_REC_STOP      , MSG_REC_STOPPED   , PIN_LED_RED  , PIN_VAL_OFF, 1 },
+    { "play_start"  , MSG_PUSH_PLAY_BTN     , PWS_PORT_PLAYER           , MSG_PLAY_START    , NULL              , PIN_LED_GREEN, PIN_VAL_ON , 0 },
+    { "play_stop"   , MSG_PUSH_PLAY_BTN     , PWS_PORT_PLAYER           , MSG_PLAY_STOP     , MSG_PLAY_STOPPED  , PIN_LED_GREEN, PIN_VAL_OFF, 1 },
+    { "tune_start"  , MSG_PUSH_TUNING_BTN   , PWS_PORT_TUNER            , MSG_TUNING_START  , NULL              , -1           , 0          , 0 },
+    { "tune_stop"   , MSG_PUSH_TUNING_BTN   , PWS_PORT_TUNER            , MSG_TUNING_STOP   , MSG_TUNING_STOPPED, -1           , 0          , 0 },
+    { "volume"      , MSG_PUSH_VOL_UP_BTN   , PWS_PORT_AUDIO_OUT        , MSG_VOL_UP        , NULL              , -1           , 0          , 0 },
+    { "effect"      , MSG_PUSH_EFFECT_BTN   , PWS_PORT_EFFECT_CONTROLLER, MSG_EFFECT_CHANGE , NULL              , -1           , 0          , 0 },
+    { NULL          , NULL                  , 0                         , NULL              , NULL              , -1           , 0          , 0 },
+};
+#define E2E_STEP_NUM        (8)
+
+//
+// 計測値（手順ごと: 押下→指示、LED）
+//
+typedef struct {
+    uint32_t   *val;
+    int         num;
+} E2E_SAMPLES;
+
+static E2E_SAMPLES  E2eCmd[E2E_STEP_NUM];
+static E2E_SAMPLES  E2eLed[E2E_STEP_NUM];
+
+static int              E2eReportSock = -1;
+static struct sockaddr_in E2eReportAddr;
+static volatile int     E2eFinish;
+
+static uint64_t e2eNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void e2eSigHandler(int sig)
+{
+    E2eFinish = 1;
+}
+
+// OSC メッセージを送信（code と path は省略可: code < -1000 / path == NULL）
+static int e2eSend(int sock, int port, const char *addr, int code, const char *path)
+{
+    OSC_MESSAGE msg;
+    uint8_t buf[SEND_BUF_SIZE];
+    int len;
+    struct sockaddr_in to;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.addr = (char *)addr;
+    if (code > -1000) {
+        msg.data[msg.num].type = 'i'; msg.data[msg.num].dlen = 4; msg.data[msg.num].u.i = code;
+        msg.num++;
+    }
+    if (path != NULL) {
+        msg.data[msg.num].type = 's'; msg.data[msg.num].dlen = strlen(path); msg.data[msg.num].u.s = (char *)path;
+        msg.num++;
+    }
+    if (oscEncode(&msg, buf, &len) < 0) {
+        return -1;
+    }
+
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port        = htons(port);
+
+    return (sendto(sock, buf, len, 0, (struct sockaddr *)&to, sizeof(to)) < 0) ? -1 : 0;
+}
+
+static void e2eReport(int port, int kind, uint64_t at, const char *addr)
+{
+    E2E_REPORT rep;
+
+    memset(&rep, 0, sizeof(rep));
+    rep.port = port;
+    rep.kind = kind;
+    rep.at   = at;
+    snprintf(rep.addr, sizeof(rep.addr), "%s", addr);
+    sendto(E2eReportSock, &rep, sizeof(rep), 0, (struct sockaddr *)&E2eReportAddr, sizeof(E2eReportAddr));
+}
+
+///////////////////////////////////////////////////////////
+// 代役モジュール（子プロセス）
+///////////////////////////////////////////////////////////
+static void e2eModuleRun(const E2E_MODULE *m)
+{
+    struct {
+        uint64_t     at;
+        const char  *reply;
+        int          args;
+    } pending[E2E_PENDING_MAX];
+    int sock, i, n, num = 0, timeout;
+    uint64_t now, next;
+    uint8_t buf[RECV_BUF_SIZE];
+    struct sockaddr_in addr;
+    struct pollfd pfd;
+    OSC_MESSAGE msg;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(m->port);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "%s: port %d is in use (stop the Pd module first)\n", m->name, m->port);
+        _exit(1);
+    }
+
+    pfd.fd     = sock;
+    pfd.events = POLLIN;
+    while (!E2eFinish) {
+        // 次の応答までの時間だけ待つ
+        now = e2eNow();
+        timeout = -1;
+        for (i = 0; i < num; i++) {
+            next = (pending[i].at > now) ? (pending[i].at - now + 999) / 1000 : 0;
+            if (timeout < 0 || (int)next < timeout) {
+                timeout = (int)next;
+            }
+        }
+        if (poll(&pfd, 1, timeout) > 0) {
+            n = recv(sock, buf, sizeof(buf) - 1, 0);
+            now = e2eNow();
+            if (n > 0 && oscDecode(buf, n, &msg) >= 0 && msg.addr != NULL) {
+                e2eReport(m->port, E2E_RECV, now, msg.addr);
+                for (i = 0; E2eReply[i].cmd != NULL; i++) {
+                    if (strcmp(msg.addr, E2eReply[i].cmd) == 0 && num < E2E_PENDING_MAX) {
+                        pending[num].at       = now + (uint64_t)m->delay * 1000 * E2eReply[i].step;
+                        pending[num].reply    = E2eReply[i].reply;
+                        pending[num].args     = E2eReply[i].args;
+                        num++;
+                    }
+                }
+            }
+        }
+
+        // 時刻になった応答をマネージャーへ送る
+        now = e2eNow();
+        for (i = 0; i < num; ) {
+            if (pending[i].at > now) {
+                i++;
+                continue;
+            }
+            e2eSend(sock, PWS_PORT_MANAGER, pending[i].reply,
+                    (pending[i].args == E2E_ARG_PATH) ? -1000 : 0,
+                    (pending[i].args == E2E_ARG_CODE) ? NULL : E2E_TAKE_PATH);
+            e2eReport(m->port, E2E_REPLY, e2eNow(), pending[i].reply);
+            pending[i] = pending[--num];
+        }
+    }
+
+    close(sock);
+    _exit(0);
+}
+
+///////////////////////////////////////////////////////////
+// ドライバー
+///////////////////////////////////////////////////////////
+
+// 代役モジュールからの報告を待つ（port と addr が一致するもの、他は捨てる）
+static int e2eWaitReport(int port, int kind, const char *addr, uint64_t *at)
+{
+    E2E_REPORT rep;
+    struct pollfd pfd;
+    uint64_t limit = e2eNow() + E2E_TIMEOUT_MS * 1000ULL, now;
+
+    pfd.fd     = E2eReportSock;
+    pfd.events = POLLIN;
+    while ((now = e2eNow()) < limit && !E2eFinish) {
+        if (poll(&pfd, 1, (int)((limit - now + 999) / 1000)) <= 0) {
+            continue;
+        }
+        if (recv(E2eReportSock, &rep, sizeof(rep), 0) != sizeof(rep)) {
+            continue;
+        }
+        if (rep.port == port && rep.kind == kind && strcmp(rep.addr, addr) == 0) {
+            *at = rep.at;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// LED が val になるまで待つ
+static int e2eWaitLed(int pin, int val, uint64_t *at)
+{
+    uint64_t limit = e2eNow() + E2E_TIMEOUT_MS * 1000ULL;
+
+    while (e2eNow() < limit && !E2eFinish) {
+        if (digitalRead(pin) == val) {
+            *at = e2eNow();
+            return 0;
+        }
+        usleep(E2E_LED_POLL_US);
+    }
+
+    return -1;
+}
+
+static void e2eAddSample(E2E_SAMPLES *s, uint64_t us, int max)
+{
+    if (s->val == NULL) {
+        s->val = calloc(max, sizeof(uint32_t));
+    }
+    if (s->val != NULL && s->num < max) {
+        s->val[s->num++] = (uint32_t)us;
+    }
+}
+
+static int e2eCompare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void e2ePrintSamples(const char *name, const char *what, E2E_SAMPLES *s)
+{
+    uint64_t sum = 0;
+    int i;
+
+    if (s->num == 0) {
+        return;
+    }
+    qsort(s->val, s->num, sizeof(uint32_t), e2eCompare);
+    for (i = 0; i < s->num; i++) {
+        sum += s->val[i];
+    }
+    printf("%-12s %-14s %6d %9u %9u %9u %9u %9u %9.0f\n", name, what, s->num,
+           s->val[0], s->val[s->num / 2], s->val[(s->num * 90) / 100],
+           s->val[(s->num * 99) / 100], s->val[s->num - 1], (double)sum / s->num);
+}
+
+// １手順分の計測
+static int e2eRunStep(int sock, int idx, int useLed, int max)
+{
+    const E2E_STEP *st = &E2eStep[idx];
+    uint64_t press, cmd, done, led;
+
+    press = e2eNow();
+    if (e2eSend(sock, PWS_PORT_MANAGER, st->press, -1000, NULL) < 0) {
+        return -1;
+    }
+    if (e2eWaitReport(st->port, E2E_RECV, st->cmd, &cmd) < 0) {
+        fprintf(stderr, "%s: no %s within %d ms (is the manager idle?)\n", st->name, st->cmd, E2E_TIMEOUT_MS);
+        return -1;
+    }
+    e2eAddSample(&E2eCmd[idx], cmd - press, max);
+
+    done = press;
+    if (st->done != NULL && e2eWaitReport(st->port, E2E_REPLY, st->done, &done) < 0) {
+        fprintf(stderr, "%s: stand-in did not send %s\n", st->name, st->done);
+        return -1;
+    }
+
+    if (useLed && st->ledPin >= 0) {
+        if (e2eWaitLed(st->ledPin, st->ledVal, &led) < 0) {
+            fprintf(stderr, "%s: LED (pin %d) did not change within %d ms\n", st->name, st->ledPin, E2E_TIMEOUT_MS);
+            return -1;
+        }
+        e2eAddSample(&E2eLed[idx], led - (st->ledFromDone ? done : press), max);
+    } else if (st->done != NULL) {
+        // 受信キューはボタン押下を先に処理するので、完了通知が処理されるまで次の押下を待たせる
+        usleep(E2E_SETTLE_US);
+    }
+
+    return 0;
+}
+
+static int e2eSetDelay(const char *spec, int delay)
+{
+    char work[256], *tok, *save = NULL, *eq;
+    int i, found;
+
+    for (i = 0; E2eModule[i].name != NULL; i++) {
+        if (E2eModule[i].delay < 0) {
+            E2eModule[i].delay = delay;
+        }
+    }
+    if (spec == NULL) {
+        return 0;
+    }
+    snprintf(work, sizeof(work), "%s", spec);
+    for (tok = strtok_r(work, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        eq = strchr(tok, '=');
+        if (eq == NULL) {
+            return -1;
+        }
+        *eq = '\0';
+        for (i = 0, found = 0; E2eModule[i].name != NULL; i++) {
+            if (strcmp(E2eModule[i].name, tok) == 0) {
+                E2eModule[i].delay = atoi(eq + 1);
+                found = 1;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, s, iterations = E2E_ITERATIONS, delay = E2E_DELAY_MS, useLed = 1, ret = 0, done = 0;
+    const char *spec = NULL;
+    socklen_t alen;
+    int sock, status;
+    struct sigaction sa;
+
+    while ((c = getopt(argc, argv, "n:d:D:L")) != -1) {
+        switch (c) {
+        case 'n': iterations = atoi(optarg); break;
+        case 'd': delay      = atoi(optarg); break;
+        case 'D': spec       = optarg;       break;
+        case 'L': useLed     = 0;            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-d delay_ms] [-D module=ms,...] [-L]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1 || e2eSetDelay(spec, delay) < 0) {
+        fprintf(stderr, "bad arguments\n");
+        return 1;
+    }
+    if (useLed && wiringPiSetup() == -1) {
+        fprintf(stderr, "wiringPiSetup failed (use -L to skip the LED)\n");
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = e2eSigHandler;
+    sigaction(SIGINT , &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // 報告の受信用（子プロセスはこのソケットから送る）
+    E2eReportSock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&E2eReportAddr, 0, sizeof(E2eReportAddr));
+    E2eReportAddr.sin_family      = AF_INET;
+    E2eReportAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    alen = sizeof(E2eReportAddr);
+    if (E2eReportSock < 0 ||
+        bind(E2eReportSock, (struct sockaddr *)&E2eReportAddr, sizeof(E2eReportAddr)) < 0 ||
+        getsockname(E2eReportSock, (struct sockaddr *)&E2eReportAddr, &alen) < 0)
+    {
+        perror("report socket");
+        return 1;
+    }
+
+    for (i = 0; E2eModule[i].name != NULL; i++) {
+        E2eModule[i].pid = fork();
+        if (E2eModule[i].pid == 0) {
+            e2eModuleRun(&E2eModule[i]);
+        }
+    }
+    // 代役のポートが使えたか確認する
+    usleep(200 * 1000);
+    for (i = 0; E2eModule[i].name != NULL; i++) {
+        if (waitpid(E2eModule[i].pid, &status, WNOHANG) == E2eModule[i].pid) {
+            E2eModule[i].pid = -1;
+            ret = 1;
+        }
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ret == 0) {
+        // PD 初期化終了待ちならアイドルにする（Pd Initializer の代わり）
+        e2eSend(sock, PWS_PORT_MANAGER, MSG_PD_INIT_FINISHED, 0, NULL);
+        usleep(100 * 1000);
+
+        for (i = 0; i < iterations && ret == 0 && !E2eFinish; i++) {
+            for (s = 0; E2eStep[s].name != NULL && ret == 0; s++) {
+                if (e2eRunStep(sock, s, useLed, iterations) < 0) {
+                    ret = 1;
+                }
+            }
+            if (ret == 0) {
+                done++;
+            }
+        }
+    }
+
+    for (i = 0; E2eModule[i].name != NULL; i++) {
+        if (E2eModule[i].pid > 0) {
+            kill(E2eModule[i].pid, SIGTERM);
+            waitpid(E2eModule[i].pid, NULL, 0);
+        }
+    }
+    close(sock);
+    close(E2eReportSock);
+
+    printf("%d iterations, stand-in delay %d ms%s\n", done, delay, useLed ? "" : ", LED not checked");
+    printf("%-12s %-14s %6s %9s %9s %9s %9s %9s %9s\n", "step", "latency(us)", "n", "min", "p50", "p90", "p99", "max", "mean");
+    for (s = 0; E2eStep[s].name != NULL; s++) {
+        e2ePrintSamples(E2eStep[s].name, "press->cmd", &E2eCmd[s]);
+        e2ePrintSamples(E2eStep[s].name, E2eStep[s].ledFromDone ? "done->led" : "press->led", &E2eLed[s]);
+        free(E2eCmd[s].val);
+        free(E2eLed[s].val);
+    }
+
+    return ret;
+}
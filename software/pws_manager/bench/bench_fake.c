@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////
+// bench_fake.c
+//   ベンチマーク用の代用関数（GPIO・録音ライブラリ・録音領域・レイテンシ・ピーク・書出し）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_util.h"
+#include "pws_gpio.h"
+#include "pws_lib.h"
+#include "pws_storage.h"
+#include "pws_latency.h"
+#include "pws_peak.h"
+#include "pws_render.h"
+#include "bench_fake.h"
+
+int FakeStorageFull;
+
+// 追従中の録音ファイル（録音終了で確定を通知する、トレースでは 8001 への出力になる）
+static char FakePeakPath[256];
+static int  FakePeakRunning;
+
+int gpioInitialize(void)                        { return 0; }
+void gpioCheckApMode(void)                      { }
+int gpioRead(int pin)                           { return 0; }
+void gpioWrite(int pin, int val)                { }
+void gpioFinish(void)                           { }
+
+int libInitialize(void)                         { return 0; }
+void libFinish(void)                            { }
+int libAddTake(const char *path)                { return 0; }
+int libSetUploadState(const char *path, int state) { return 0; }
+int libGetCount(void)                           { return 0; }
+int libGetTake(int idx, LIB_TAKE *take)         { return -1; }
+
+int storageInitialize(void)                     { return 0; }
+void storageFinish(void)                        { }
+void storageKick(void)                          { }
+int storageReserve(void)                        { return FakeStorageFull ? -1 : 0; }
+
+int latInitialize(void)                         { return 0; }
+int latMeasure(const char *path, LAT_INFO *info) { return -1; }
+
+// 解析は行わず、ファイルがあれば成功を通知する（トレースでは 8001 への出力になる）
+int latMeasureStart(const char *path)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeI(&OSC_WIRE_I(MSG_CALIB_MEASURED), (path != NULL) ? 0 : -1, buf, &len) < 0) {
+        return -1;
+    }
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
+int latGet(LAT_INFO *info)                      { memset(info, 0, sizeof(LAT_INFO)); return 0; }
+int latSet(const LAT_INFO *info)                { return 0; }
+int latSetAlign(int align)                      { return 0; }
+uint32_t latGetShift(void)                      { return 0; }
+int latAlignTake(const char *path, uint32_t frames) { return 0; }
+
+int peakStart(const char *path, uint32_t skip)
+{
+    snprintf(FakePeakPath, sizeof(FakePeakPath), "%s", path);
+    FakePeakRunning = 1;
+    return 0;
+}
+
+int peakStop(int code)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (!FakePeakRunning) {
+        return -1;
+    }
+    FakePeakRunning = 0;
+    if (code == 0 && oscEncodeIS(&OSC_WIRE_IS(MSG_TAKE_FINISHED), 0, FakePeakPath, buf, &len) == 0) {
+        utilSendLocal(PWS_PORT_MANAGER, buf, len);
+    }
+    return 0;
+}
+
+void peakFinish(void)                           { FakePeakRunning = 0; }
+
+int renderStart(const char *path, int preset, const struct sockaddr_in *replyTo) { return 0; }
+
+// 再生ではファイルが無いので、パス名をそのまま実体とみなす
+int renderResolveTake(const char *path, char *real, int len)
+{
+    if (path == NULL || (int)strlen(path) >= len || strlen(path) >= LIB_PATH_LEN) {
+        return -1;
+    }
+    strcpy(real, path);
+    return 0;
+}
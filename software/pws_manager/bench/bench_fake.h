@@ -0,0 +1,12 @@
+///////////////////////////////////////////////////////////
+// bench_fake.h
+//   ベンチマーク用の代用関数（GPIO・録音ライブラリ・録音領域・レイテンシ・ピーク・書出し）
+//   pws_manager.c を実機なしでリンクするために使う
+///////////////////////////////////////////////////////////
+#ifndef __BENCH_FAKE_H__
+#define __BENCH_FAKE_H__
+
+// 1: storageReserve が失敗する（録音領域不足）
+extern int FakeStorageFull;
+
+#endif // __BENCH_FAKE_H__
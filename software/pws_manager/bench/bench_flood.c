@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////
+// bench_flood.c
+//   マネージャーの受信処理の負荷試験
+//
+//   bench_flood [-d 秒] [-r 送信数/秒] [-p pid]
+//     起動中の pws_manager のポート 8001 へ実際のメッセージを混ぜて送り続け、
+//     処理できた数／秒、取りこぼし、１メッセージあたりの CPU 時間を表示する
+//     -r 省略時は全力で送信する
+//     -p 省略時は /proc から pws_manager を探す
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+
+#define BENCH_SECONDS       (5)
+
+// 送信するメッセージ（入力レベルとチューニング状態が大半、ボタン操作と問合せが少し）
+typedef struct {
+    const char *addr;
+    int         weight;
+} FLOOD_MIX;
+
+static const FLOOD_MIX FloodMix[] = {
+    { MSG_METER             , 60 },     // 入力レベル通知
+    { MSG_TUNING_COND       , 30 },     // チューニング状態通知
+    { MSG_LATENCY_QUERY     ,  5 },     // レイテンシ問合せ（返信あり）
+    { "/btnmonitor/push/volup", 5 },    // ボリュームアップボタン押下
+    { NULL                  ,  0 },
+};
+
+#define FLOOD_MSG_MAX       (8)
+
+static uint8_t  FloodBuf[FLOOD_MSG_MAX][SEND_BUF_SIZE];
+static int      FloodLen[FLOOD_MSG_MAX];
+static int      FloodOrder[100];
+
+static double benchNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// /proc から pws_manager のプロセスを探す
+static int benchFindPid(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    char path[300], comm[64];
+    FILE *fp;
+    int pid = -1;
+
+    dir = opendir("/proc");
+    if (dir == NULL) {
+        return -1;
+    }
+    while (pid < 0 && (ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] < '0' || ent->d_name[0] > '9') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%s/comm", ent->d_name);
+        fp = fopen(path, "r");
+        if (fp == NULL) {
+            continue;
+        }
+        if (fgets(comm, sizeof(comm), fp) != NULL && strcmp(comm, "pws_manager\n") == 0) {
+            pid = atoi(ent->d_name);
+        }
+        fclose(fp);
+    }
+    closedir(dir);
+
+    return pid;
+}
+
+// プロセスの CPU 時間（秒、ユーザー＋システム、ログ出力で起動した子プロセスの分も含む）
+static double benchCpuTime(int pid)
+{
+    char path[64], line[1024], *p;
+    unsigned long utime, stime;
+    long cutime, cstime;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1.0;
+    }
+    if (fgets(line, sizeof(line), fp) == NULL) {
+        fclose(fp);
+        return -1.0;
+    }
+    fclose(fp);
+
+    // comm に空白が入っても読めるように ')' の後から数える（14～17 番目）
+    p = strrchr(line, ')');
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %ld %ld",
+                            &utime, &stime, &cutime, &cstime) != 4)
+    {
+        return -1.0;
+    }
+
+    return (double)(utime + stime + cutime + cstime) / sysconf(_SC_CLK_TCK);
+}
+
+// 受信ソケットで溢れて捨てられた数（/proc/net/udp の drops）
+static long benchSocketDrops(int port)
+{
+    char line[512];
+    unsigned int localPort;
+    unsigned long drops;
+    long ret = -1;
+    FILE *fp;
+
+    fp = fopen("/proc/net/udp", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, " %*d: %*x:%x %*x:%*x %*x %*x:%*x %*x:%*x %*x %*u %*u %*u %*u %*s %lu",
+                   &localPort, &drops) == 2 && (int)localPort == port)
+        {
+            ret = (long)drops;
+            break;
+        }
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+// 送信するメッセージを作っておく
+static int benchBuildMessages(void)
+{
+    int i, j, k = 0;
+    OSC_MESSAGE msg;
+
+    for (i = 0; FloodMix[i].addr != NULL; i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.addr = (char *)FloodMix[i].addr;
+        if (strcmp(FloodMix[i].addr, MSG_METER) == 0) {
+            msg.num = 3;
+            msg.data[0].type = 'i'; msg.data[0].dlen = 4; msg.data[0].u.i = 0;
+            msg.data[1].type = 'f'; msg.data[1].dlen = 4; msg.data[1].u.f = -12.5f;
+            msg.data[2].type = 'f'; msg.data[2].dlen = 4; msg.data[2].u.f = -24.0f;
+        }
+        else if (strcmp(FloodMix[i].addr, MSG_TUNING_COND) == 0) {
+            msg.num = 1;
+            msg.data[0].type = 'i'; msg.data[0].dlen = 4; msg.data[0].u.i = 2;
+        }
+        if (oscEncode(&msg, FloodBuf[i], &FloodLen[i]) < 0) {
+            return -1;
+        }
+        for (j = 0; j < FloodMix[i].weight && k < 100; j++) {
+            FloodOrder[k++] = i;
+        }
+    }
+    // 種類が偏らないように混ぜる
+    srand(1);
+    for (i = k - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        k = FloodOrder[i];
+        FloodOrder[i] = FloodOrder[j];
+        FloodOrder[j] = k;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, pid = -1, sock, m;
+    double seconds = BENCH_SECONDS, rate = 0.0;
+    double t0, t, next, cpu0, cpu1;
+    long drop0, drop1, sent = 0, lost, handled;
+    struct sockaddr_in addr;
+    char rx[RECV_BUF_SIZE];
+
+    while ((c = getopt(argc, argv, "d:r:p:")) != -1) {
+        switch (c) {
+        case 'd': seconds = atof(optarg); break;
+        case 'r': rate    = atof(optarg); break;
+        case 'p': pid     = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-d sec] [-r msgs/sec] [-p pid]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (pid < 0) {
+        pid = benchFindPid();
+    }
+    if (pid < 0 || benchCpuTime(pid) < 0) {
+        fprintf(stderr, "pws_manager is not running\n");
+        return 1;
+    }
+    if (benchBuildMessages() < 0) {
+        fprintf(stderr, "oscEncode error\n");
+        return 1;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(PWS_PORT_MANAGER);
+
+    drop0 = benchSocketDrops(PWS_PORT_MANAGER);
+    cpu0  = benchCpuTime(pid);
+    t0 = next = benchNow();
+    while ((t = benchNow()) - t0 < seconds) {
+        if (rate > 0.0) {
+            if (t < next) {
+                continue;
+            }
+            next += 1.0 / rate;
+        }
+        m = FloodOrder[sent % 100];
+        if (sendto(sock, FloodBuf[m], FloodLen[m], 0, (struct sockaddr *)&addr, sizeof(addr)) > 0) {
+            sent++;
+        }
+        // 問合せの返信は読み捨てる
+        while (recv(sock, rx, sizeof(rx), MSG_DONTWAIT) > 0) {
+        }
+    }
+    t = benchNow() - t0;
+
+    // 受信済みの分を処理し終わるのを待つ
+    usleep(500 * 1000);
+    cpu1  = benchCpuTime(pid);
+    drop1 = benchSocketDrops(PWS_PORT_MANAGER);
+
+    lost    = (drop0 >= 0 && drop1 >= 0) ? drop1 - drop0 : 0;
+    handled = sent - lost;
+    printf("sent     %ld msgs in %.2f sec (%.0f msgs/sec)\n", sent, t, sent / t);
+    printf("handled  %ld msgs (%.0f msgs/sec)\n", handled, handled / t);
+    printf("lost     %ld msgs (%.2f %%)\n", lost, sent ? 100.0 * lost / sent : 0.0);
+    printf("cpu      %.2f sec, %.2f us/msg\n", cpu1 - cpu0, handled ? (cpu1 - cpu0) * 1e6 / handled : 0.0);
+
+    close(sock);
+
+    return 0;
+}
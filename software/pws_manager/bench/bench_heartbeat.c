@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////
+// bench_heartbeat.c
+//   心拍の途絶えから停止の検出までの時間の計測（起動中の pws_manager が相手）
+//
+//   bench_heartbeat [-n 回数] [-i 心拍の間隔] [-b 心拍の数]
+//     -n  計測の回数（既定 10）
+//     -i  心拍の間隔（ミリ秒、既定 200）
+//     -b  途絶える前に送る心拍の数（既定 5）
+//
+//   代役のモジュールを登録して心拍を送り、心拍を止めてから
+//   MSG_MODULE_LOST が購読者へ届くまでの時間を計る。
+//   検出までの時間は 間隔 x REG_MISS_MAX ～ それ + REG_CHECK_MS になるはず。
+//   代役の機能名は他のモジュールと重ならないもの（指示の宛先は変わらない）。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_registry.h"
+
+#define HB_ROUNDS           (10)
+#define HB_INTERVAL_MS      (200)
+#define HB_BEATS            (5)
+#define HB_NAME             "bench_heartbeat"
+#define HB_REPLY_MS         (500)           // 登録・購読の返信を待つ時間
+
+static uint64_t hbNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// マネージャーへ送る（引数は "i" / "is" / "iss" の並び）
+static int hbSend(int sock, const char *addr, int code, const char *s1, const char *s2)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+    struct sockaddr_in to;
+    OSC_MESSAGE msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.addr = (char *)addr;
+    msg.data[msg.num].type = 'i'; msg.data[msg.num].dlen = 4; msg.data[msg.num].u.i = code; msg.num++;
+    if (s1 != NULL) {
+        msg.data[msg.num].type = 's'; msg.data[msg.num].dlen = strlen(s1); msg.data[msg.num].u.s = (char *)s1; msg.num++;
+    }
+    if (s2 != NULL) {
+        msg.data[msg.num].type = 's'; msg.data[msg.num].dlen = strlen(s2); msg.data[msg.num].u.s = (char *)s2; msg.num++;
+    }
+    if (oscEncode(&msg, buf, &len) < 0) {
+        return -1;
+    }
+
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port        = htons(PWS_PORT_MANAGER);
+
+    return (sendto(sock, buf, len, 0, (struct sockaddr *)&to, sizeof(to)) < 0) ? -1 : 0;
+}
+
+// addr のメッセージが届くまで待つ（name が NULL でなければ文字列の引数も照合）
+//   戻り値: 先頭の整数、-1: 時間切れ
+static int hbWait(int sock, const char *addr, const char *name, int timeout, uint64_t *at)
+{
+    int i, n;
+    uint8_t buf[RECV_BUF_SIZE];
+    uint64_t limit;
+    struct pollfd pfd;
+    OSC_MESSAGE msg;
+
+    limit = hbNow() + (uint64_t)timeout * 1000;
+    pfd.fd     = sock;
+    pfd.events = POLLIN;
+    while (hbNow() < limit) {
+        if (poll(&pfd, 1, (int)((limit - hbNow()) / 1000) + 1) <= 0) {
+            continue;
+        }
+        n = recv(sock, buf, sizeof(buf), 0);
+        if (at != NULL) {
+            *at = hbNow();
+        }
+        if (n <= 0 || oscDecode(buf, n, &msg) < 0 || msg.addr == NULL || strcmp(msg.addr, addr) != 0) {
+            continue;
+        }
+        if (name != NULL) {
+            for (i = 0; i < msg.num; i++) {
+                if (msg.data[i].type == 's' && strcmp(msg.data[i].u.s, name) == 0) {
+                    break;
+                }
+            }
+            if (i >= msg.num) {
+                continue;
+            }
+        }
+        return (msg.num > 0 && msg.data[0].type == 'i') ? msg.data[0].u.i : 0;
+    }
+
+    return -1;
+}
+
+static int hbCompare(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int hbSocket(void)
+{
+    int sock;
+    struct sockaddr_in addr;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, r, b, n = 0, rounds = HB_ROUNDS, interval = HB_INTERVAL_MS, beats = HB_BEATS;
+    int mod, sub, reported;
+    int32_t *wall, *mgr;
+    uint64_t last, at;
+    struct timespec ts;
+
+    while ((c = getopt(argc, argv, "n:i:b:")) != -1) {
+        switch (c) {
+        case 'n': rounds   = atoi(optarg); break;
+        case 'i': interval = atoi(optarg); break;
+        case 'b': beats    = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n rounds] [-i interval_ms] [-b beats]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rounds <= 0 || interval < REG_INTERVAL_MIN_MS || interval > REG_INTERVAL_MAX_MS || beats <= 0) {
+        fprintf(stderr, "bad option\n");
+        return 1;
+    }
+
+    mod = hbSocket();
+    sub = hbSocket();
+    wall = calloc(rounds, sizeof(*wall));
+    mgr  = calloc(rounds, sizeof(*mgr));
+    if (mod < 0 || sub < 0 || wall == NULL || mgr == NULL) {
+        fprintf(stderr, "socket error\n");
+        return 1;
+    }
+
+    // 停止の検出を購読
+    hbSend(sub, MSG_SUBSCRIBE, 0, MSG_MODULE_LOST, NULL);
+    if (hbWait(sub, MSG_SUBSCRIBED, NULL, HB_REPLY_MS, NULL) <= 0) {
+        fprintf(stderr, "no reply from pws_manager (subscribe)\n");
+        return 1;
+    }
+
+    ts.tv_sec  = interval / 1000;
+    ts.tv_nsec = (interval % 1000) * 1000000L;
+    for (r = 0; r < rounds; r++) {
+        hbSend(mod, MSG_MODULE_ANNOUNCE, 0, HB_NAME, HB_NAME);
+        if (hbWait(mod, MSG_MODULE_REGISTERED, NULL, HB_REPLY_MS, NULL) != 0) {
+            fprintf(stderr, "announce failed\n");
+            break;
+        }
+        last = hbNow();
+        for (b = 0; b < beats; b++) {
+            nanosleep(&ts, NULL);
+            last = hbNow();
+            hbSend(mod, MSG_MODULE_HEARTBEAT, interval, HB_NAME, NULL);
+        }
+
+        // 心拍を止めて検出を待つ
+        reported = hbWait(sub, MSG_MODULE_LOST, HB_NAME, interval * REG_MISS_MAX * 2 + 1000, &at);
+        if (reported < 0) {
+            fprintf(stderr, "round %d: not detected\n", r);
+            continue;
+        }
+        wall[n] = (int32_t)((at - last) / 1000);
+        mgr[n]  = reported;
+        n++;
+    }
+
+    hbSend(sub, MSG_UNSUBSCRIBE, 0, NULL, NULL);
+    close(mod);
+    close(sub);
+
+    if (n == 0) {
+        free(wall);
+        free(mgr);
+        return 1;
+    }
+    qsort(wall, n, sizeof(*wall), hbCompare);
+    qsort(mgr , n, sizeof(*mgr) , hbCompare);
+    printf("heartbeat interval %d ms, miss %d, check %d ms (expected %d..%d ms)\n",
+           interval, REG_MISS_MAX, REG_CHECK_MS, interval * REG_MISS_MAX, interval * REG_MISS_MAX + REG_CHECK_MS);
+    printf("  last beat -> lost received  %d rounds  p50 %d ms  max %d ms\n", n, wall[n / 2], wall[n - 1]);
+    printf("  last beat -> lost detected  %d rounds  p50 %d ms  max %d ms (pws_manager)\n", n, mgr[n / 2], mgr[n - 1]);
+    free(wall);
+    free(mgr);
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+///////////////////////////////////////////////////////////
+// bench_log.c
+//   デバッグログ出力の計測用（Makefile の CFLAGS のログ設定でコンパイルする）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pws_debug.h"
+
+// コンパイル時のログ設定
+#if defined(DEBUG_LOGOUT_STDIO) && defined(DEBUG_LOGOUT_FILE)
+const char *BenchLogMode = "stdio+file";
+#elif defined(DEBUG_LOGOUT_STDIO)
+const char *BenchLogMode = "stdio";
+#elif defined(DEBUG_LOGOUT_FILE)
+const char *BenchLogMode = "file";
+#else
+const char *BenchLogMode = "none";
+#endif
+
+// マネージャーが受信ごとに出すログと同じ程度のもの
+void benchLog(const char *addr, int evt)
+{
+    PWS_DEBUG("addr=[%s] evt=%d\n", addr, evt);
+}
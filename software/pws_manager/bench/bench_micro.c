@@ -0,0 +1,593 @@
+///////////////////////////////////////////////////////////
+// bench_micro.c
+//   マネージャーの主要な処理のマイクロベンチマーク
+//
+//   bench_micro [-r 回数] [-w ミリ秒] [-t ミリ秒] [-c CPU] [-f 名前] [-o ファイル]
+//     -r  計測の繰返し数（既定 20、統計はこの回数分の値から求める）
+//     -w  計測前の空回し時間（既定 100 ms）
+//     -t  １回の計測時間の目安（既定 10 ms、これを超えるまで処理回数を倍にして決める）
+//     -c  固定する CPU（既定: 最後の CPU、-1: 固定しない）
+//     -f  名前にこの文字列を含むものだけ計測
+//     -o  結果（JSON）の出力先（既定: 標準出力）
+//
+//   結果は JSON で出力し、１件ごとの概要は標準エラーに出す。
+//   リリースごとの比較は ns_per_op.median で行う（Pi と x86 で同じ形式）。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_led.h"
+#include "pws_manager.h"
+#include "bench_fake.h"
+
+#define MICRO_REPEATS           (20)
+#define MICRO_WARMUP_MS         (100)
+#define MICRO_TARGET_MS         (10)
+#define MICRO_REPEAT_MAX        (200)
+#define MICRO_FAKE_SOCK         (1000)
+
+// bench_log.c（Makefile の CFLAGS のログ設定でコンパイル）
+extern const char *BenchLogMode;
+extern void benchLog(const char *addr, int evt);
+
+// 最適化で処理が消えないように結果を書込む先
+static volatile int     MicroSink;
+static long             MicroSendCount;
+static int              MicroNullFd = -1;
+
+///////////////////////////////////////////////////////////
+// リンク時の差し替え（送信は数えるだけ、system はログ出力先だけ変えて実行）
+///////////////////////////////////////////////////////////
+int __real_close(int fd);
+int __real_system(const char *cmd);
+
+int __wrap_socket(int domain, int type, int protocol)
+{
+    return MICRO_FAKE_SOCK;
+}
+
+int __wrap_bind(int sock, const struct sockaddr *addr, socklen_t len)
+{
+    return 0;
+}
+
+int __wrap_close(int fd)
+{
+    if (fd == MICRO_FAKE_SOCK) {
+        return 0;
+    }
+    return __real_close(fd);
+}
+
+ssize_t __wrap_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+    MicroSendCount++;
+    return len;
+}
+
+int __wrap_sendmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+    MicroSendCount += vlen;
+    return vlen;
+}
+
+int __wrap_system(const char *cmd)
+{
+    char work[1024], *p;
+
+    // ログ出力（echo ... >> ログファイル）だけ実行する、書込み先は /dev/null
+    if (strncmp(cmd, "echo ", 5) != 0) {
+        return 0;
+    }
+    snprintf(work, sizeof(work), "%s", cmd);
+    p = strstr(work, ">>");
+    if (p != NULL) {
+        snprintf(p, sizeof(work) - (p - work), ">> /dev/null");
+    }
+    return __real_system(work);
+}
+
+///////////////////////////////////////////////////////////
+// 計測対象
+///////////////////////////////////////////////////////////
+
+//
+// メッセージの組合せ（マネージャーが受信するものの割合に近づける）
+//
+typedef struct {
+    const char  *addr;
+    const char  *types;                     // 引数の型（i, f, s）
+    int          weight;                    // 100 件あたりの件数
+} MICRO_MSG;
+
+static const MICRO_MSG MicroMix[] = {
+    { MSG_METER             , "iff"     , 55 },     // 入力レベル通知
+    { MSG_TUNING_COND       , "i"       , 25 },     // チューニング状態通知
+    { MSG_PUSH_VOL_UP_BTN   , ""        ,  5 },     // ボタン押下
+    { MSG_REC_STOPPED       , "is"      ,  5 },     // 録音終了通知（パス付き）
+    { MSG_UPLOAD_STOPPED    , "is"      ,  5 },     // アップロード終了通知
+    { MSG_LATENCY_QUERY     , ""        ,  5 },     // 問合せ
+    { NULL                  , NULL      ,  0 },
+};
+#define MICRO_MIX_NUM       (6)
+#define MICRO_ORDER_NUM     (100)
+
+static OSC_MESSAGE  MicroMsg[MICRO_MIX_NUM];
+static uint8_t      MicroBuf[MICRO_MIX_NUM][SEND_BUF_SIZE];
+static int          MicroLen[MICRO_MIX_NUM];
+static int          MicroOrder[MICRO_ORDER_NUM];
+
+// LED Controller が受信するもの
+static char *MicroLedMsg[] = {
+    MSG_LED_RED_OFF, MSG_LED_GREEN_OFF, MSG_LED_YELLOW_ON, MSG_LED_RED_ON,
+    MSG_LED_YELLOW_BLINK, MSG_LED_BLINK_RED_GREEN, MSG_LED_RED_FLASH, MSG_LED_GREEN_ON,
+};
+#define MICRO_LED_NUM       ((int)(sizeof(MicroLedMsg) / sizeof(MicroLedMsg[0])))
+
+static INGRESS_PACKET MicroPkt[4];
+#define MICRO_PKT_METER     (0)
+#define MICRO_PKT_VOLUP     (1)
+#define MICRO_PKT_REC       (2)
+#define MICRO_PKT_RECSTOP   (3)
+
+static void microBuildMessage(OSC_MESSAGE *msg, const char *addr, const char *types)
+{
+    int i;
+
+    memset(msg, 0, sizeof(OSC_MESSAGE));
+    msg->addr = (char *)addr;
+    for (i = 0; types[i] != '\0' && i < OSC_DATA_NUM; i++) {
+        msg->data[i].type = types[i];
+        switch (types[i]) {
+        case 'i': msg->data[i].dlen = 4; msg->data[i].u.i = i;       break;
+        case 'f': msg->data[i].dlen = 4; msg->data[i].u.f = -12.5f;  break;
+        case 's': msg->data[i].u.s  = "/pws/rec/20240101_120000.wav";
+                  msg->data[i].dlen = strlen(msg->data[i].u.s);      break;
+        }
+    }
+    msg->num = i;
+}
+
+static int microBuildPacket(INGRESS_PACKET *pkt, const char *addr, const char *types, int cls)
+{
+    OSC_MESSAGE msg;
+
+    microBuildMessage(&msg, addr, types);
+    if (oscEncode(&msg, (uint8_t *)pkt->buf, &pkt->len) < 0) {
+        return -1;
+    }
+    pkt->buf[pkt->len] = '\0';
+    pkt->cls = cls;
+    pkt->at  = 1;
+    pkt->from.sin_family      = AF_INET;
+    pkt->from.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    pkt->from.sin_port        = htons(PWS_PORT_RECORDER);
+
+    return 0;
+}
+
+static int microSetup(void)
+{
+    int i, j, k = 0;
+    INGRESS_PACKET pkt;
+
+    for (i = 0; MicroMix[i].addr != NULL; i++) {
+        microBuildMessage(&MicroMsg[i], MicroMix[i].addr, MicroMix[i].types);
+        if (oscEncode(&MicroMsg[i], MicroBuf[i], &MicroLen[i]) < 0) {
+            return -1;
+        }
+        for (j = 0; j < MicroMix[i].weight && k < MICRO_ORDER_NUM; j++) {
+            MicroOrder[k++] = i;
+        }
+    }
+    // 種類が偏らないように混ぜる（毎回同じ並び）
+    srand(1);
+    for (i = k - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        k = MicroOrder[i];
+        MicroOrder[i] = MicroOrder[j];
+        MicroOrder[j] = k;
+    }
+
+    if (microBuildPacket(&MicroPkt[MICRO_PKT_METER]  , MSG_METER          , "iff", INGRESS_CLASS_TELEMETRY) < 0 ||
+        microBuildPacket(&MicroPkt[MICRO_PKT_VOLUP]  , MSG_PUSH_VOL_UP_BTN, ""   , INGRESS_CLASS_USER)      < 0 ||
+        microBuildPacket(&MicroPkt[MICRO_PKT_REC]    , MSG_PUSH_REC_BTN   , ""   , INGRESS_CLASS_USER)      < 0 ||
+        microBuildPacket(&MicroPkt[MICRO_PKT_RECSTOP], MSG_REC_STOPPED    , "is" , INGRESS_CLASS_MODULE)    < 0)
+    {
+        return -1;
+    }
+    // 状態遷移はアイドルから始める
+    mgrReplayReset();
+    if (microBuildPacket(&pkt, MSG_INITIALIZE, "", INGRESS_CLASS_USER) < 0) {
+        return -1;
+    }
+    mgrReplayDispatch(&pkt);
+    if (microBuildPacket(&pkt, MSG_PD_INIT_FINISHED, "i", INGRESS_CLASS_MODULE) < 0) {
+        return -1;
+    }
+    mgrReplayDispatch(&pkt);
+    if (mgrReplayGetState() != mgrReplayFindState("IDLE")) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void microOscEncode(long n)
+{
+    long i;
+    int len = 0;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    for (i = 0; i < n; i++) {
+        oscEncode(&MicroMsg[MicroOrder[i % MICRO_ORDER_NUM]], buf, &len);
+    }
+    MicroSink = len;
+}
+
+static void microOscDecode(long n)
+{
+    long i;
+    int m, num = 0;
+    OSC_MESSAGE msg;
+
+    for (i = 0; i < n; i++) {
+        m = MicroOrder[i % MICRO_ORDER_NUM];
+        num += oscDecode(MicroBuf[m], MicroLen[m], &msg);
+    }
+    MicroSink = num;
+}
+
+static void microMgrGetEvent(long n)
+{
+    long i;
+    int m, evt = 0;
+
+    for (i = 0; i < n; i++) {
+        m = MicroOrder[i % MICRO_ORDER_NUM];
+        evt += mgrReplayGetEvent((char *)MicroBuf[m], MicroLen[m]);
+    }
+    MicroSink = evt;
+}
+
+static void microLedGetEvent(long n)
+{
+    long i;
+    int evt = 0;
+
+    for (i = 0; i < n; i++) {
+        evt += ledReplayGetEvent(MicroLedMsg[i % MICRO_LED_NUM]);
+    }
+    MicroSink = evt;
+}
+
+static void microDispatchMeter(long n)
+{
+    long i;
+
+    for (i = 0; i < n; i++) {
+        mgrReplayDispatch(&MicroPkt[MICRO_PKT_METER]);
+    }
+}
+
+static void microDispatchVolume(long n)
+{
+    long i;
+
+    for (i = 0; i < n; i++) {
+        mgrReplayDispatch(&MicroPkt[MICRO_PKT_VOLUP]);
+    }
+}
+
+// 録音ボタン押下 → 録音終了通知（アイドル → 録音中 → アイドル）
+static void microDispatchRecCycle(long n)
+{
+    long i;
+
+    for (i = 0; i < n; i++) {
+        mgrReplayDispatch(&MicroPkt[MICRO_PKT_REC]);
+        mgrReplayDispatch(&MicroPkt[MICRO_PKT_RECSTOP]);
+    }
+}
+
+static void microLedTickSteady(long n)
+{
+    long i;
+
+    ledReplayReset(0);
+    for (i = 0; i < n; i++) {
+        ledReplayTick(i);
+    }
+}
+
+static void microLedTickBlink(long n)
+{
+    long i;
+
+    ledReplayReset(1);
+    for (i = 0; i < n; i++) {
+        ledReplayTick(i);
+    }
+}
+
+// ログは標準出力にも出るので、計測中は /dev/null へ向ける
+static void microDebugLog(long n)
+{
+    long i;
+    int saved;
+
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    dup2(MicroNullFd, STDOUT_FILENO);
+    for (i = 0; i < n; i++) {
+        benchLog(MSG_PUSH_VOL_UP_BTN, (int)i);
+    }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+typedef struct {
+    const char  *name;
+    const char  *desc;
+    void       (*run)(long n);
+} MICRO_CASE;
+
+static const MICRO_CASE MicroCase[] = {
+    { "osc_encode_mix"      , "oscEncode, received-message mix"                  , microOscEncode         },
+    { "osc_decode_mix"      , "oscDecode, received-message mix"                  , microOscDecode         },
+    { "mgr_get_event_mix"   , "mgrGetEvent (decode + address lookup), mix"       , microMgrGetEvent       },
+    { "led_get_event"       , "ledGetEvent, LED controller messages"             , microLedGetEvent       },
+    { "dispatch_meter"      , "STATE_TABLE dispatch, meter in IDLE (no output)"  , microDispatchMeter     },
+    { "dispatch_volume"     , "STATE_TABLE dispatch, volume up in IDLE (1 send)" , microDispatchVolume    },
+    { "dispatch_rec_cycle"  , "rec button + rec stopped (IDLE->REC->IDLE)"       , microDispatchRecCycle  },
+    { "led_tick_steady"     , "LED controller tick, no change"                   , microLedTickSteady     },
+    { "led_tick_blink"      , "LED controller tick, all LEDs blinking"           , microLedTickBlink      },
+    { "debug_log"           , "PWS_DEBUG with Makefile CFLAGS log settings"      , microDebugLog          },
+    { NULL                  , NULL                                               , NULL                   },
+};
+
+///////////////////////////////////////////////////////////
+// 計測
+///////////////////////////////////////////////////////////
+static double microNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int microCompare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+typedef struct {
+    long    iterations;                     // １回の計測での処理回数
+    int     repeats;
+    double  min, median, p90, mean, stddev; // ns/op
+    double  sendsPerOp;                     // 送信数（差し替えた sendto の呼出し数）/ op
+} MICRO_RESULT;
+
+static void microMeasure(const MICRO_CASE *c, int repeats, double warmupMs, double targetMs, MICRO_RESULT *res)
+{
+    double t0, t, ns[MICRO_REPEAT_MAX], sum = 0.0, var = 0.0;
+    long n = 1, sends;
+    int r;
+
+    // 空回し（キャッシュ・分岐予測・CPU クロックを安定させる）
+    t0 = microNow();
+    while (microNow() - t0 < warmupMs * 1e6) {
+        c->run(n);
+        if (n < (1 << 20)) {
+            n *= 2;
+        }
+    }
+
+    // １回の計測が targetMs を超える処理回数を決める
+    for (n = 1; ; n *= 2) {
+        t0 = microNow();
+        c->run(n);
+        t = microNow() - t0;
+        if (t >= targetMs * 1e6 || n >= (1L << 30)) {
+            break;
+        }
+    }
+
+    sends = MicroSendCount;
+    for (r = 0; r < repeats; r++) {
+        t0 = microNow();
+        c->run(n);
+        ns[r] = (microNow() - t0) / n;
+        sum += ns[r];
+    }
+    res->sendsPerOp = (double)(MicroSendCount - sends) / ((double)n * repeats);
+
+    qsort(ns, repeats, sizeof(double), microCompare);
+    res->iterations = n;
+    res->repeats    = repeats;
+    res->mean       = sum / repeats;
+    for (r = 0; r < repeats; r++) {
+        var += (ns[r] - res->mean) * (ns[r] - res->mean);
+    }
+    res->stddev = (repeats > 1) ? sqrt(var / (repeats - 1)) : 0.0;
+    res->min    = ns[0];
+    res->median = (repeats % 2) ? ns[repeats / 2] : (ns[repeats / 2 - 1] + ns[repeats / 2]) / 2;
+    res->p90    = ns[(int)ceil(repeats * 0.9) - 1];
+}
+
+// CPU の固定（戻り値: 固定した CPU、-1: 固定しない・失敗）
+static int microPinCpu(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0) {
+        return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_setaffinity");
+        return -1;
+    }
+
+    return cpu;
+}
+
+// /proc, /sys から１行読む（改行は除く、JSON に入れるので " と \ も除く）
+static void microReadLine(const char *path, const char *key, char *out, int len)
+{
+    FILE *fp;
+    char line[256], *p;
+    int i, j;
+
+    snprintf(out, len, "unknown");
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        p = line;
+        if (key != NULL) {
+            if (strncmp(line, key, strlen(key)) != 0 || (p = strchr(line, ':')) == NULL) {
+                continue;
+            }
+            p += 1 + strspn(p + 1, " \t");
+        }
+        for (i = j = 0; p[i] != '\0' && p[i] != '\n' && j < len - 1; i++) {
+            if (p[i] != '"' && p[i] != '\\') {
+                out[j++] = p[i];
+            }
+        }
+        out[j] = '\0';
+        break;
+    }
+    fclose(fp);
+}
+
+static void microPrintHost(FILE *fp, int cpu, int repeats, double warmupMs, double targetMs)
+{
+    struct utsname un;
+    char model[128], governor[64], path[128];
+
+    uname(&un);
+    // x86 は "model name"、Raspberry Pi は "Model"
+    microReadLine("/proc/cpuinfo", "model name", model, sizeof(model));
+    if (strcmp(model, "unknown") == 0) {
+        microReadLine("/proc/cpuinfo", "Model", model, sizeof(model));
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", (cpu < 0) ? 0 : cpu);
+    microReadLine(path, NULL, governor, sizeof(governor));
+
+    fprintf(fp, "  \"suite\": \"pws_manager\",\n");
+    fprintf(fp, "  \"version\": 1,\n");
+    fprintf(fp, "  \"time\": %ld,\n", (long)time(NULL));
+    fprintf(fp, "  \"host\": {\n");
+    fprintf(fp, "    \"machine\": \"%s\",\n", un.machine);
+    fprintf(fp, "    \"kernel\": \"%s\",\n", un.release);
+    fprintf(fp, "    \"cpu_model\": \"%s\",\n", model);
+    fprintf(fp, "    \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(fp, "    \"governor\": \"%s\",\n", governor);
+    fprintf(fp, "    \"compiler\": \"%s\"\n", __VERSION__);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"config\": {\n");
+    fprintf(fp, "    \"pinned_cpu\": %d,\n", cpu);
+    fprintf(fp, "    \"repeats\": %d,\n", repeats);
+    fprintf(fp, "    \"warmup_ms\": %.0f,\n", warmupMs);
+    fprintf(fp, "    \"target_ms\": %.0f,\n", targetMs);
+    fprintf(fp, "    \"log_mode\": \"%s\"\n", BenchLogMode);
+    fprintf(fp, "  },\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, cpu, repeats = MICRO_REPEATS, first = 1;
+    double warmupMs = MICRO_WARMUP_MS, targetMs = MICRO_TARGET_MS;
+    const char *filter = NULL, *outPath = NULL;
+    FILE *out = stdout;
+    MICRO_RESULT res;
+
+    cpu = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    while ((c = getopt(argc, argv, "r:w:t:c:f:o:")) != -1) {
+        switch (c) {
+        case 'r': repeats  = atoi(optarg); break;
+        case 'w': warmupMs = atof(optarg); break;
+        case 't': targetMs = atof(optarg); break;
+        case 'c': cpu      = atoi(optarg); break;
+        case 'f': filter   = optarg;       break;
+        case 'o': outPath  = optarg;       break;
+        default:
+            fprintf(stderr, "usage: %s [-r repeats] [-w warmup_ms] [-t target_ms] [-c cpu] [-f name] [-o file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repeats < 1 || repeats > MICRO_REPEAT_MAX) {
+        fprintf(stderr, "repeats must be 1..%d\n", MICRO_REPEAT_MAX);
+        return 1;
+    }
+
+    MicroNullFd = open("/dev/null", O_WRONLY);
+    if (MicroNullFd < 0 || microSetup() < 0) {
+        fprintf(stderr, "setup error\n");
+        return 1;
+    }
+    cpu = microPinCpu(cpu);
+
+    if (outPath != NULL) {
+        out = fopen(outPath, "w");
+        if (out == NULL) {
+            perror(outPath);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\n");
+    microPrintHost(out, cpu, repeats, warmupMs, targetMs);
+    fprintf(out, "  \"results\": [");
+    for (i = 0; MicroCase[i].name != NULL; i++) {
+        if (filter != NULL && strstr(MicroCase[i].name, filter) == NULL) {
+            continue;
+        }
+        microMeasure(&MicroCase[i], repeats, warmupMs, targetMs, &res);
+
+        fprintf(stderr, "%-20s %12.1f ns/op (min %.1f, p90 %.1f, sd %.1f) x %ld\n",
+                MicroCase[i].name, res.median, res.min, res.p90, res.stddev, res.iterations);
+        fprintf(out, "%s\n    {\n", first ? "" : ",");
+        fprintf(out, "      \"name\": \"%s\",\n", MicroCase[i].name);
+        fprintf(out, "      \"desc\": \"%s\",\n", MicroCase[i].desc);
+        fprintf(out, "      \"iterations\": %ld,\n", res.iterations);
+        fprintf(out, "      \"repeats\": %d,\n", res.repeats);
+        fprintf(out, "      \"sends_per_op\": %.2f,\n", res.sendsPerOp);
+        fprintf(out, "      \"ns_per_op\": { \"min\": %.2f, \"median\": %.2f, \"p90\": %.2f, \"mean\": %.2f, \"stddev\": %.2f },\n",
+                res.min, res.median, res.p90, res.mean, res.stddev);
+        fprintf(out, "      \"ops_per_sec\": %.0f\n", 1e9 / res.median);
+        fprintf(out, "    }");
+        first = 0;
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    close(MicroNullFd);
+
+    return 0;
+}
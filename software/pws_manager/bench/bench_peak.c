@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////
+// bench_peak.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "pws_peak.h"
+
+// 録音と同じ条件（44.1kHz / モノラル / 16bit）
+#define BENCH_RATE          (44100)
+#define BENCH_CHANNELS      (1)
+#define BENCH_SECONDS       (60)
+
+// 録音中の読込みサイズ相当で入力する
+#define BENCH_CHUNK_FRAMES  (16 * 1024)
+
+#define BENCH_WARMUP        (2)
+#define BENCH_REPEAT        (10)
+
+static double benchNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double benchRun(const int16_t *data, int frames)
+{
+    int i, n;
+    double t0, t1;
+    PEAK_BUILDER pb;
+
+    peakBuilderInit(&pb, BENCH_RATE, BENCH_CHANNELS);
+    t0 = benchNow();
+    for (i = 0; i < frames; i += n) {
+        n = frames - i;
+        if (n > BENCH_CHUNK_FRAMES) {
+            n = BENCH_CHUNK_FRAMES;
+        }
+        peakBuilderPush(&pb, data + i * BENCH_CHANNELS, n);
+    }
+    t1 = benchNow();
+    peakBuilderFree(&pb);
+
+    return t1 - t0;
+}
+
+int main(void)
+{
+    int i, frames = BENCH_RATE * BENCH_SECONDS;
+    double t, best = 1e9, sum = 0.0;
+    int16_t *data;
+    uint32_t seed = 1;
+
+    data = malloc(frames * BENCH_CHANNELS * sizeof(int16_t));
+    if (data == NULL) {
+        return 1;
+    }
+    for (i = 0; i < frames * BENCH_CHANNELS; i++) {
+        seed = seed * 1664525 + 1013904223;
+        data[i] = (int16_t)(seed >> 16);
+    }
+
+    for (i = 0; i < BENCH_WARMUP; i++) {
+        benchRun(data, frames);
+    }
+    for (i = 0; i < BENCH_REPEAT; i++) {
+        t = benchRun(data, frames);
+        sum += t;
+        if (t < best) {
+            best = t;
+        }
+    }
+
+    printf("peak: %.1f us per audio second (best %.1f us), %.0fx realtime\n",
+           sum / BENCH_REPEAT / BENCH_SECONDS * 1e6,
+           best / BENCH_SECONDS * 1e6,
+           BENCH_SECONDS / (sum / BENCH_REPEAT));
+
+    free(data);
+
+    return 0;
+}
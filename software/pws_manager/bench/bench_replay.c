@@ -0,0 +1,829 @@
+///////////////////////////////////////////////////////////
+// bench_replay.c
+//   マネージャーの状態遷移のトレース再生
+//
+//   bench_replay [トレース ...]          トレースを再生して出力を照合（省略時は bench/traces/*.trace）
+//   bench_replay -n 回数 [トレース]      トレースを繰返し再生して１秒あたりの処理数を表示
+//   bench_replay -f 件数 [-s 種] [-l 長さ]
+//                                        ランダムなイベント列で状態遷移を確認
+//
+//   pws_manager.c を PWS_REPLAY 付きでコンパイルしてリンクする。
+//   ソケット・system・時計はリンク時に差し替え（-Wl,--wrap=...）、
+//   GPIO・録音ライブラリなどは代用関数（bench_fake.c）を使うので、実機もネットワークも不要。
+//   時計は仮想時計なので、何度再生しても同じ結果になる。
+//
+//   トレースの書式（１行１命令、# 以降はコメント）
+//     send [from [IP:]ポート] アドレス [i:整数 f:実数 s:文字列 ...]
+//                                                                 マネージャーへ送信（IP の省略時は 127.0.0.1）
+//     expect ポート|led|system アドレス [引数 ...]               出力を先頭から順に照合
+//                                                                 （引数を省略したときはアドレスのみ）
+//     drain                                                       未照合の出力を捨てる
+//     state 状態                                                  状態の確認（IDLE など）
+//     advance ミリ秒                                              仮想時計を進めて心拍を確認する
+//     storage full|ok                                             録音領域の空きの有無
+//   send の前とトレースの最後に照合していない出力が残っていたらエラー
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_led.h"
+#include "pws_flight.h"
+#include "pws_peak.h"
+#include "pws_manager.h"
+#include "bench_fake.h"
+
+#define REPLAY_TRACE_DIR        "bench/traces"
+#define REPLAY_OUT_MAX          (256)           // 照合前に溜めておける出力の数
+#define REPLAY_OUT_LEN          (256)
+#define REPLAY_LINE_LEN         (512)
+#define REPLAY_FROM_DEFAULT     (9999)          // 送信元ポート（省略時）
+#define REPLAY_FAKE_SOCK        (1000)          // 差し替えたソケットの番号
+#define REPLAY_LOOPS            (20000)         // -n 省略時の繰返し数（make bench）
+#define REPLAY_FUZZ_CASES       (2000)          // -f 省略時の件数（make bench）
+#define REPLAY_FUZZ_LEN         (40)            // １件あたりのイベント数
+#define REPLAY_FUZZ_FAIL        "bench/traces/fuzz_fail.trace"
+#define REPLAY_FUZZ_FLIGHT      "bench/traces/fuzz_fail.flight"    // pws_flight で読める
+
+//
+// 出力の記録
+//
+static char     ReplayOut[REPLAY_OUT_MAX][REPLAY_OUT_LEN];
+static int      ReplayOutHead;
+static int      ReplayOutNum;
+static int      ReplayOutLost;
+static int      ReplayQuiet;                    // 出力を記録しない（-n の計測中）
+static long     ReplayOutTotal;
+
+// 出力を確認する関数（ファズ用、NULL: 確認しない）
+static void   (*ReplayWatch)(const char *out);
+
+// 仮想時計（ナノ秒）
+static uint64_t ReplayClock;
+
+///////////////////////////////////////////////////////////
+// リンク時の差し替え
+///////////////////////////////////////////////////////////
+int __real_close(int fd);
+
+int __wrap_socket(int domain, int type, int protocol)
+{
+    return REPLAY_FAKE_SOCK;
+}
+
+int __wrap_bind(int sock, const struct sockaddr *addr, socklen_t len)
+{
+    return 0;
+}
+
+int __wrap_close(int fd)
+{
+    if (fd == REPLAY_FAKE_SOCK) {
+        return 0;
+    }
+    return __real_close(fd);
+}
+
+static void replayOutput(const char *out)
+{
+    if (ReplayWatch != NULL) {
+        ReplayWatch(out);
+    }
+    ReplayOutTotal++;
+    if (ReplayQuiet) {
+        return;
+    }
+    if (ReplayOutNum >= REPLAY_OUT_MAX) {
+        ReplayOutLost++;
+        return;
+    }
+    snprintf(ReplayOut[(ReplayOutHead + ReplayOutNum) % REPLAY_OUT_MAX], REPLAY_OUT_LEN, "%s", out);
+    ReplayOutNum++;
+}
+
+// OSC の引数を "i:1 s:abc" の形にする
+static void replayFormatArgs(const OSC_MESSAGE *msg, char *out, int len)
+{
+    int i, n = 0;
+
+    out[0] = '\0';
+    for (i = 0; i < msg->num && n < len; i++) {
+        switch (msg->data[i].type) {
+        case 'i':
+            n += snprintf(out + n, len - n, " i:%d", msg->data[i].u.i);
+            break;
+        case 'f':
+            n += snprintf(out + n, len - n, " f:%g", msg->data[i].u.f);
+            break;
+        case 's':
+            n += snprintf(out + n, len - n, " s:%s", msg->data[i].u.s);
+            break;
+        default:
+            n += snprintf(out + n, len - n, " %c:?", msg->data[i].type);
+            break;
+        }
+    }
+}
+
+ssize_t __wrap_sendto(int sock, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+    int port;
+    uint8_t work[SEND_BUF_SIZE + 1];
+    char out[REPLAY_OUT_LEN], args[REPLAY_OUT_LEN];
+    OSC_MESSAGE msg;
+
+    port = ntohs(((const struct sockaddr_in *)to)->sin_port);
+
+    if (ReplayQuiet && ReplayWatch == NULL) {
+        ReplayOutTotal++;
+        return len;
+    }
+
+    if (len > SEND_BUF_SIZE) {
+        len = SEND_BUF_SIZE;
+    }
+    memcpy(work, buf, len);
+    work[len] = '\0';
+
+    if (port == PWS_PORT_LED_CONTROLLER) {
+        // LED Controller へは OSC ではなく文字列
+        snprintf(out, sizeof(out), "led %.200s", (char *)work);
+    }
+    else if (oscDecode(work, len, &msg) < 0 || msg.addr == NULL) {
+        snprintf(out, sizeof(out), "%d ?", port);
+    }
+    else {
+        replayFormatArgs(&msg, args, sizeof(args));
+        snprintf(out, sizeof(out), "%d %s%s", port, msg.addr, args);
+    }
+    replayOutput(out);
+
+    return len;
+}
+
+// 購読者への配信は宛先ごとに sendto したものとして記録する
+int __wrap_sendmmsg(int sock, struct mmsghdr *vec, unsigned int vlen, int flags)
+{
+    unsigned int i;
+
+    for (i = 0; i < vlen; i++) {
+        vec[i].msg_len = __wrap_sendto(sock, vec[i].msg_hdr.msg_iov[0].iov_base, vec[i].msg_hdr.msg_iov[0].iov_len,
+                                       flags, vec[i].msg_hdr.msg_name, vec[i].msg_hdr.msg_namelen);
+    }
+
+    return vlen;
+}
+
+int __wrap_system(const char *cmd)
+{
+    char out[REPLAY_OUT_LEN];
+
+    // シャットダウンなどは実行せず記録だけ
+    snprintf(out, sizeof(out), "system %s", cmd);
+    replayOutput(out);
+
+    return 0;
+}
+
+int __wrap_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    ts->tv_sec  = ReplayClock / 1000000000ULL;
+    ts->tv_nsec = ReplayClock % 1000000000ULL;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////
+// 再生
+///////////////////////////////////////////////////////////
+static void replayReset(void)
+{
+    mgrReplayReset();
+    peakFinish();
+    ReplayOutHead     = 0;
+    ReplayOutNum      = 0;
+    ReplayOutLost     = 0;
+    FakeStorageFull = 0;
+    ReplayClock       = 1000000000ULL;
+}
+
+// 送信元の解釈（"ポート" か "IP:ポート"、戻り値: ポート、-1: 誤り）
+static int replayParseFrom(char *arg, uint32_t *ip)
+{
+    char *colon;
+
+    colon = strchr(arg, ':');
+    if (colon != NULL) {
+        *colon = '\0';
+        if (inet_pton(AF_INET, arg, ip) != 1) {
+            return -1;
+        }
+        arg = colon + 1;
+    }
+
+    return atoi(arg);
+}
+
+// OSC メッセージを組立ててディスパッチする
+//   args は "i:1 f:0.5 s:abc" の並び（NULL 可）
+static int replaySend(uint32_t ip, int from, const char *addr, char *args)
+{
+    static INGRESS_PACKET pkt;
+    OSC_MESSAGE msg;
+    char *tok, *save = NULL;
+    int len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.addr = (char *)addr;
+    for (tok = (args != NULL) ? strtok_r(args, " \t", &save) : NULL;
+         tok != NULL && msg.num < OSC_DATA_NUM;
+         tok = strtok_r(NULL, " \t", &save))
+    {
+        if (strlen(tok) < 2 || tok[1] != ':') {
+            return -1;
+        }
+        msg.data[msg.num].type = tok[0];
+        switch (tok[0]) {
+        case 'i': msg.data[msg.num].dlen = 4; msg.data[msg.num].u.i = atoi(tok + 2); break;
+        case 'f': msg.data[msg.num].dlen = 4; msg.data[msg.num].u.f = atof(tok + 2); break;
+        case 's': msg.data[msg.num].dlen = strlen(tok + 2); msg.data[msg.num].u.s = tok + 2; break;
+        default:
+            return -1;
+        }
+        msg.num++;
+    }
+    if (oscEncode(&msg, (uint8_t *)pkt.buf, &len) < 0) {
+        return -1;
+    }
+    pkt.buf[len] = '\0';
+    pkt.len = len;
+    pkt.cls = (strncmp(addr, "/btnmonitor/", 12) == 0 || strncmp(addr, "/system/", 8) == 0)
+              ? INGRESS_CLASS_USER : INGRESS_CLASS_MODULE;
+    pkt.at  = (uint32_t)(ReplayClock / 1000);
+    pkt.from.sin_family      = AF_INET;
+    pkt.from.sin_addr.s_addr = ip;
+    pkt.from.sin_port        = htons(from);
+
+    // 受信ごとに 1us 進める（時刻 0 は未設定扱いのため）
+    ReplayClock += 1000;
+
+    mgrReplayDispatch(&pkt);
+
+    return 0;
+}
+
+// 出力の照合（expect の引数を省略したときはアドレスまで）
+static int replayMatch(const char *expect, const char *out)
+{
+    int n;
+    const char *sp;
+
+    if (strcmp(expect, out) == 0) {
+        return 1;
+    }
+    // "ポート アドレス" だけ指定されたときは引数を見ない
+    sp = strchr(expect, ' ');
+    if (sp != NULL && strchr(sp + 1, ' ') == NULL && strncmp(expect, "system ", 7) != 0) {
+        n = strlen(expect);
+        return strncmp(expect, out, n) == 0 && (out[n] == ' ' || out[n] == '\0');
+    }
+
+    return 0;
+}
+
+static void replayReportPending(const char *path, int line)
+{
+    int i;
+
+    fprintf(stderr, "%s:%d: unexpected output\n", path, line);
+    for (i = 0; i < ReplayOutNum; i++) {
+        fprintf(stderr, "    %s\n", ReplayOut[(ReplayOutHead + i) % REPLAY_OUT_MAX]);
+    }
+}
+
+//
+// トレース１つの再生
+//   戻り値: 0: 一致、-1: 不一致・書式エラー
+//
+static int replayTrace(const char *path, int verbose)
+{
+    FILE *fp;
+    char line[REPLAY_LINE_LEN], expect[REPLAY_OUT_LEN];
+    char *p, *cmd, *arg, *rest, *save;
+    int lineNo = 0, ret = 0, from, st;
+    uint32_t ip;
+    const char *out;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+    replayReset();
+
+    while (ret == 0 && fgets(line, sizeof(line), fp) != NULL) {
+        lineNo++;
+        if ((p = strchr(line, '#')) != NULL) {
+            *p = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        cmd = strtok_r(line, " \t", &save);
+        if (cmd == NULL) {
+            continue;
+        }
+        rest = save + strspn(save, " \t");
+
+        if (strcmp(cmd, "send") == 0) {
+            if (ReplayOutNum > 0) {
+                replayReportPending(path, lineNo);
+                ret = -1;
+                break;
+            }
+            ip   = htonl(INADDR_LOOPBACK);
+            from = REPLAY_FROM_DEFAULT;
+            arg  = strtok_r(NULL, " \t", &save);
+            if (arg != NULL && strcmp(arg, "from") == 0) {
+                arg  = strtok_r(NULL, " \t", &save);
+                from = (arg != NULL) ? replayParseFrom(arg, &ip) : -1;
+                arg  = strtok_r(NULL, " \t", &save);
+            }
+            if (arg == NULL || from < 0 || replaySend(ip, from, arg, save) < 0) {
+                fprintf(stderr, "%s:%d: bad send\n", path, lineNo);
+                ret = -1;
+            }
+        }
+        else if (strcmp(cmd, "expect") == 0) {
+            // 連続する空白を１つにして比べる
+            expect[0] = '\0';
+            for (arg = strtok_r(NULL, " \t", &save); arg != NULL; arg = strtok_r(NULL, " \t", &save)) {
+                if (expect[0] != '\0') {
+                    strncat(expect, " ", sizeof(expect) - strlen(expect) - 1);
+                }
+                strncat(expect, arg, sizeof(expect) - strlen(expect) - 1);
+            }
+            if (ReplayOutNum == 0) {
+                fprintf(stderr, "%s:%d: missing output: %s\n", path, lineNo, expect);
+                ret = -1;
+                break;
+            }
+            out = ReplayOut[ReplayOutHead];
+            if (!replayMatch(expect, out)) {
+                fprintf(stderr, "%s:%d: expected: %s\n%*s  actual: %s\n", path, lineNo, expect,
+                        (int)strlen(path) + 4, "", out);
+                ret = -1;
+                break;
+            }
+            ReplayOutHead = (ReplayOutHead + 1) % REPLAY_OUT_MAX;
+            ReplayOutNum--;
+        }
+        else if (strcmp(cmd, "drain") == 0) {
+            ReplayOutNum = 0;
+        }
+        else if (strcmp(cmd, "state") == 0) {
+            st = mgrReplayFindState(rest);
+            if (st < 0 || st != mgrReplayGetState()) {
+                fprintf(stderr, "%s:%d: state %s, expected %s\n", path, lineNo,
+                        mgrReplayStateId(mgrReplayGetState()), rest);
+                ret = -1;
+            }
+        }
+        else if (strcmp(cmd, "advance") == 0) {
+            ReplayClock += (uint64_t)atol(rest) * 1000000ULL;
+            // 監視スレッドの代わり（停止を検出したら 8001 への送信が記録される）
+            mgrReplayCheck();
+        }
+        else if (strcmp(cmd, "storage") == 0) {
+            FakeStorageFull = (strcmp(rest, "full") == 0);
+        }
+        else {
+            fprintf(stderr, "%s:%d: unknown command: %s\n", path, lineNo, cmd);
+            ret = -1;
+        }
+    }
+    fclose(fp);
+
+    if (ret == 0 && ReplayOutNum > 0) {
+        replayReportPending(path, lineNo);
+        ret = -1;
+    }
+    if (ret == 0 && ReplayOutLost > 0) {
+        fprintf(stderr, "%s: %d outputs lost (drain more often)\n", path, ReplayOutLost);
+        ret = -1;
+    }
+    if (verbose) {
+        printf("%-40s %s\n", path, (ret == 0) ? "ok" : "FAIL");
+    }
+
+    return ret;
+}
+
+static int replayCompare(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// bench/traces/*.trace を名前順に再生
+static int replayAll(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    char *names[256], path[300];
+    int i, n = 0, len, fail = 0;
+
+    dir = opendir(REPLAY_TRACE_DIR);
+    if (dir == NULL) {
+        fprintf(stderr, "%s: cannot open\n", REPLAY_TRACE_DIR);
+        return -1;
+    }
+    while ((ent = readdir(dir)) != NULL && n < 256) {
+        len = strlen(ent->d_name);
+        if (len > 6 && strcmp(ent->d_name + len - 6, ".trace") == 0 &&
+            strcmp(ent->d_name, strrchr(REPLAY_FUZZ_FAIL, '/') + 1) != 0)
+        {
+            names[n++] = strdup(ent->d_name);
+        }
+    }
+    closedir(dir);
+    qsort(names, n, sizeof(char *), replayCompare);
+
+    for (i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", REPLAY_TRACE_DIR, names[i]);
+        if (replayTrace(path, 1) < 0) {
+            fail++;
+        }
+        free(names[i]);
+    }
+    printf("traces   %d passed, %d failed\n", n - fail, fail);
+
+    return fail ? -1 : 0;
+}
+
+static double replayWallNow(void)
+{
+    struct timespec ts;
+
+    // clock_gettime は仮想時計に差し替えているので timespec_get を使う
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// 処理速度（トレースを出力の照合なしで繰返す）
+//
+static int replayThroughput(const char *path, long loops)
+{
+    FILE *fp;
+    char line[REPLAY_LINE_LEN], *lines[1024], *p;
+    int i, n = 0, from;
+    uint32_t ip;
+    char work[REPLAY_LINE_LEN], *cmd, *arg, *save;
+    long loop, sends = 0;
+    double t0, t;
+
+    // 先に照合して正しいトレースであることを確認する
+    if (replayTrace(path, 0) < 0) {
+        return -1;
+    }
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (n < 1024 && fgets(line, sizeof(line), fp) != NULL) {
+        if ((p = strchr(line, '#')) != NULL) {
+            *p = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        p = line + strspn(line, " \t");
+        if (strncmp(p, "send", 4) == 0 || strncmp(p, "advance", 7) == 0 || strncmp(p, "storage", 7) == 0) {
+            lines[n++] = strdup(p);
+        }
+    }
+    fclose(fp);
+
+    ReplayQuiet    = 1;
+    ReplayOutTotal = 0;
+    t0 = replayWallNow();
+    for (loop = 0; loop < loops; loop++) {
+        replayReset();
+        for (i = 0; i < n; i++) {
+            strcpy(work, lines[i]);
+            cmd = strtok_r(work, " \t", &save);
+            if (strcmp(cmd, "advance") == 0) {
+                ReplayClock += (uint64_t)atol(save) * 1000000ULL;
+                mgrReplayCheck();
+                continue;
+            }
+            if (strcmp(cmd, "storage") == 0) {
+                FakeStorageFull = (strncmp(save, "full", 4) == 0);
+                continue;
+            }
+            ip   = htonl(INADDR_LOOPBACK);
+            from = REPLAY_FROM_DEFAULT;
+            arg  = strtok_r(NULL, " \t", &save);
+            if (strcmp(arg, "from") == 0) {
+                from = replayParseFrom(strtok_r(NULL, " \t", &save), &ip);
+                arg  = strtok_r(NULL, " \t", &save);
+            }
+            replaySend(ip, from, arg, save);
+            sends++;
+        }
+    }
+    t = replayWallNow() - t0;
+    ReplayQuiet = 0;
+
+    for (i = 0; i < n; i++) {
+        free(lines[i]);
+    }
+    printf("replay   %s x %ld\n", path, loops);
+    printf("         %ld dispatches, %ld outputs in %.3f sec\n", sends, ReplayOutTotal, t);
+    printf("         %.0f dispatches/sec, %.2f us/dispatch\n", sends / t, t * 1e6 / sends);
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////
+// ファズ（イベントの順序をランダムに変えて状態遷移を確認）
+///////////////////////////////////////////////////////////
+
+// 送るメッセージ（ボタン操作とモジュールの通知、書出しやシャットダウンのような副作用の大きいものは除く）
+static const struct {
+    const char  *addr;
+    int          from;
+    const char  *args;
+} FuzzMsg[] = {
+    { MSG_PUSH_REC_BTN          , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_PLAY_BTN         , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_TUNING_BTN       , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_VOL_UP_BTN       , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_VOL_DOWN_BTN     , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_EFFECT_BTN       , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_PUSH_AP_SET_BTN       , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_INITIALIZE            , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_AP_CONFIGURED         , PWS_PORT_AP_CONFIGURATOR, "i:0"                   },
+    { MSG_AP_CONFIGURED         , PWS_PORT_AP_CONFIGURATOR, "i:-2"                  },
+    { MSG_PD_INIT_FINISHED      , REPLAY_FROM_DEFAULT    , "i:0"                    },
+    { MSG_PD_INIT_FINISHED      , REPLAY_FROM_DEFAULT    , "i:-1"                   },
+    { MSG_REC_STARTED           , PWS_PORT_RECORDER      , "i:0"                    },
+    { MSG_REC_STOPPED           , PWS_PORT_RECORDER      , "i:0 s:/pws/rec/a.wav"   },
+    { MSG_REC_STOPPED           , PWS_PORT_RECORDER      , "i:-1"                   },
+    { MSG_PLAY_STARTED          , PWS_PORT_PLAYER        , "i:0"                    },
+    { MSG_PLAY_STOPPED          , PWS_PORT_PLAYER        , "i:0"                    },
+    { MSG_TUNING_STARTED        , PWS_PORT_TUNER         , "i:0"                    },
+    { MSG_TUNING_STOPPED        , PWS_PORT_TUNER         , "i:0"                    },
+    { MSG_TUNING_COND           , PWS_PORT_TUNER         , "i:1"                    },
+    { MSG_UPLOAD_STARTED        , PWS_PORT_FILE_UPLOADER , "s:/pws/rec/a.wav"       },
+    { MSG_UPLOAD_STOPPED        , PWS_PORT_FILE_UPLOADER , "i:0 s:/pws/rec/a.wav"   },
+    { MSG_DOWNLOAD_STOPPED      , PWS_PORT_FILE_DOWNLOADER, "i:0"                   },
+    { MSG_LATENCY_CALIBRATE     , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_CALIB_STOPPED         , PWS_PORT_CALIBRATOR    , "i:0 s:/pws/calib.wav"   },
+    { MSG_RENDER_START          , REPLAY_FROM_DEFAULT    , "i:1 s:/pws/rec/a.wav"   },
+    { MSG_RENDER_STOPPED        , REPLAY_FROM_DEFAULT    , "i:0 s:/pws/rec/a_fx.wav" },
+    { MSG_METER                 , REPLAY_FROM_DEFAULT    , "i:0 f:-1.5 f:-20"       },
+    { MSG_LIB_QUERY             , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_LATENCY_QUERY         , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_SUBSCRIBE             , REPLAY_FROM_DEFAULT    , "i:0"                    },
+    { MSG_SUBSCRIBE             , REPLAY_FROM_DEFAULT    , "i:9300 s:/pws_manager/*" },
+    { MSG_UNSUBSCRIBE           , REPLAY_FROM_DEFAULT    , "i:0"                    },
+    { MSG_MODULE_ANNOUNCE       , PWS_PORT_RECORDER      , "i:0 s:recorder"         },
+    { MSG_MODULE_HEARTBEAT      , PWS_PORT_RECORDER      , "i:500 s:recorder"       },
+    { MSG_MODULE_LOST           , PWS_PORT_MANAGER       , "i:1500 s:recorder"      },
+    { MSG_MODULE_LOST           , PWS_PORT_MANAGER       , "i:1500 s:tuner"         },
+    { MSG_COMMAND_TIMEOUT       , PWS_PORT_MANAGER       , "i:1 s:/player/playback/start" },
+    { MSG_PD_RESTARTED          , PWS_PORT_MANAGER       , "i:1234 s:exit"          },
+    { MSG_TAKE_FINISHED         , PWS_PORT_MANAGER       , "i:0 s:/pws/rec/a.wav"   },
+    { MSG_CALIB_MEASURED        , PWS_PORT_MANAGER       , "i:0"                    },
+    { MSG_BOOT_QUERY            , REPLAY_FROM_DEFAULT    , ""                       },
+    { MSG_POWER_QUERY           , REPLAY_FROM_DEFAULT    , ""                       },
+    { "/unknown/address"        , REPLAY_FROM_DEFAULT    , "i:1"                    },
+    { MSG_REC_STOPPED           , PWS_PORT_RECORDER      , "s:/pws/rec/a.wav"       },  // 引数の型違い
+    { MSG_UPLOAD_STOPPED        , PWS_PORT_FILE_UPLOADER , "i:0"                    },  // 引数の不足
+    { MSG_PUSH_PLAY_BTN         , REPLAY_FROM_DEFAULT    , "i:1"                    },  // 引数の過剰
+};
+#define FUZZ_MSG_NUM    ((int)(sizeof(FuzzMsg) / sizeof(FuzzMsg[0])))
+
+// 不変条件の確認用（モジュールへの開始要求を重ねて送っていないか）
+static struct {
+    int     recording;                          // 録音開始要求を送って終了要求をまだ送っていない
+    int     playing;                            // 再生開始要求を送って終了要求をまだ送っていない
+    char    error[REPLAY_OUT_LEN];
+} FuzzCheck;
+
+static void fuzzWatch(const char *out)
+{
+    char tag[16];
+    int *flag = NULL, start = 0;
+
+    if (FuzzCheck.error[0] != '\0') {
+        return;
+    }
+    snprintf(tag, sizeof(tag), "%d ", PWS_PORT_RECORDER);
+    if (strncmp(out, tag, strlen(tag)) == 0) {
+        flag  = &FuzzCheck.recording;
+        start = (strstr(out, MSG_REC_START) != NULL);
+    }
+    snprintf(tag, sizeof(tag), "%d ", PWS_PORT_PLAYER);
+    if (strncmp(out, tag, strlen(tag)) == 0) {
+        flag  = &FuzzCheck.playing;
+        start = (strstr(out, MSG_PLAY_START) != NULL);
+    }
+    if (flag == NULL) {
+        return;
+    }
+    if (start && *flag) {
+        snprintf(FuzzCheck.error, sizeof(FuzzCheck.error), "start sent twice: %s", out);
+    }
+    *flag = start;
+}
+
+static uint32_t fuzzRand(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// seed からイベント列を作る（失敗したときに同じ列をトレースへ書出せるように）
+static void fuzzSequence(uint32_t seed, int len, int *seq)
+{
+    int i;
+    uint32_t x = seed * 2654435761u + 1;
+
+    // 起動と PD 初期化は先頭に置いて IDLE から始まる列を多くする
+    seq[0] = 7;
+    seq[1] = 10;
+    for (i = 2; i < len; i++) {
+        seq[i] = fuzzRand(&x) % FUZZ_MSG_NUM;
+    }
+}
+
+static int fuzzRun(const int *seq, int len)
+{
+    char args[REPLAY_LINE_LEN];
+    int i, st;
+
+    replayReset();
+    memset(&FuzzCheck, 0, sizeof(FuzzCheck));
+    ReplayQuiet = 1;
+    ReplayWatch = fuzzWatch;
+    for (i = 0; i < len; i++) {
+        // 録音・再生の終了通知でモジュール側は止まっている
+        if (strcmp(FuzzMsg[seq[i]].addr, MSG_REC_STOPPED) == 0) {
+            FuzzCheck.recording = 0;
+        }
+        if (strcmp(FuzzMsg[seq[i]].addr, MSG_PLAY_STOPPED) == 0) {
+            FuzzCheck.playing = 0;
+        }
+        snprintf(args, sizeof(args), "%s", FuzzMsg[seq[i]].args);
+        replaySend(htonl(INADDR_LOOPBACK), FuzzMsg[seq[i]].from, FuzzMsg[seq[i]].addr, args);
+
+        st = mgrReplayGetState();
+        if (mgrReplayFindState(mgrReplayStateId(st)) < 0) {
+            snprintf(FuzzCheck.error, sizeof(FuzzCheck.error), "invalid state %d", st);
+        }
+        if (FuzzCheck.error[0] != '\0') {
+            break;
+        }
+    }
+    ReplayWatch = NULL;
+    ReplayQuiet = 0;
+
+    return (FuzzCheck.error[0] != '\0') ? i : -1;
+}
+
+// 失敗した列を再生できるトレースとして書出す
+static void fuzzWriteTrace(uint32_t seed, const int *seq, int len, const char *why)
+{
+    FILE *fp;
+    int i;
+
+    fp = fopen(REPLAY_FUZZ_FAIL, "w");
+    if (fp == NULL) {
+        return;
+    }
+    fprintf(fp, "# bench_replay -f: seed %u\n# %s\n", seed, why);
+    for (i = 0; i < len; i++) {
+        if (FuzzMsg[seq[i]].from != REPLAY_FROM_DEFAULT) {
+            fprintf(fp, "send from %d %s %s\n", FuzzMsg[seq[i]].from, FuzzMsg[seq[i]].addr, FuzzMsg[seq[i]].args);
+        }
+        else {
+            fprintf(fp, "send %s %s\n", FuzzMsg[seq[i]].addr, FuzzMsg[seq[i]].args);
+        }
+        fprintf(fp, "drain\n");
+    }
+    fclose(fp);
+}
+
+//
+// ファズ（１件ずつ子プロセスで実行して異常終了も検出する）
+//
+static int replayFuzz(uint32_t seed, int cases, int len)
+{
+    int seq[1024], c, status, at;
+    pid_t pid;
+    char why[REPLAY_OUT_LEN];
+
+    if (len > 1024) {
+        len = 1024;
+    }
+    for (c = 0; c < cases; c++) {
+        fuzzSequence(seed + c, len, seq);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return -1;
+        }
+        if (pid == 0) {
+            // 異常終了したら直前の状態遷移を書出す
+            mgrReplayFlight(REPLAY_FUZZ_FLIGHT);
+            at = fuzzRun(seq, len);
+            if (at >= 0) {
+                flightDump(FLIGHT_CAUSE_REQUEST, 0);
+                fprintf(stderr, "fuzz     seed %u, event %d: %s\n", seed + c, at, FuzzCheck.error);
+                _exit(1);
+            }
+            _exit(0);
+        }
+        if (waitpid(pid, &status, 0) < 0) {
+            perror("waitpid");
+            return -1;
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            snprintf(why, sizeof(why), "signal %d", WTERMSIG(status));
+            fprintf(stderr, "fuzz     seed %u: %s\n", seed + c, why);
+        }
+        else {
+            snprintf(why, sizeof(why), "invariant violated");
+        }
+        fuzzWriteTrace(seed + c, seq, len, why);
+        printf("fuzz     FAIL, sequence written to %s (%s)\n", REPLAY_FUZZ_FAIL, REPLAY_FUZZ_FLIGHT);
+        return -1;
+    }
+    printf("fuzz     %d sequences x %d events (seed %u) ok\n", cases, len, seed);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, ret = 0, cases = 0, len = REPLAY_FUZZ_LEN;
+    long loops = 0;
+    uint32_t seed = 1;
+
+    while ((c = getopt(argc, argv, "n:f:s:l:")) != -1) {
+        switch (c) {
+        case 'n': loops = atol(optarg);              break;
+        case 'f': cases = atoi(optarg);              break;
+        case 's': seed  = strtoul(optarg, NULL, 0);  break;
+        case 'l': len   = atoi(optarg);              break;
+        default:
+            fprintf(stderr, "usage: %s [-n loops] [-f cases [-s seed] [-l len]] [trace ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (loops > 0) {
+        return replayThroughput((optind < argc) ? argv[optind] : REPLAY_TRACE_DIR "/rec_play.trace", loops) < 0;
+    }
+    if (cases > 0) {
+        return replayFuzz(seed, cases, len) < 0;
+    }
+    if (optind < argc) {
+        for (i = optind; i < argc; i++) {
+            if (replayTrace(argv[i], 1) < 0) {
+                ret = 1;
+            }
+        }
+        return ret;
+    }
+
+    // 引数なし（make bench）: 全トレース → 処理速度 → ファズ
+    if (replayAll() < 0) {
+        ret = 1;
+    }
+    if (replayThroughput(REPLAY_TRACE_DIR "/rec_play.trace", REPLAY_LOOPS) < 0) {
+        ret = 1;
+    }
+    if (replayFuzz(seed, REPLAY_FUZZ_CASES, len) < 0) {
+        ret = 1;
+    }
+
+    return ret;
+}
@@ -13,6 +13,33 @@
 #define PWS_CMD_WEB_RESTART         "/bin/systemctl restart pws-webserver"
 #define PWS_CMD_SHUTDOWN            "/sbin/shutdown now -h"
 
+// 録音ファイル
+#define PWS_TAKE_DIR                "/home/pi/pws"                  // 録音ディレクトリ
+#define PWS_TAKE_INDEX_FILE         "/home/pi/pws/.take_index"      // 録音ライブラリ索引
+#define PWS_LAST_PLAY_FILE_NAME     "last_play.wav"                 // 再生用ファイル
+#define PWS_CALIB_FILE              "/home/pi/pws/.calib.wav"       // レイテンシ測定用ファイル
+#define PWS_LATENCY_FILE            "/home/pi/pws/.latency"         // レイテンシ測定結果
+
+// Pd（pws-pd.service で起動、監視と再起動の依頼は pws_supervisor で）
+#define PWS_PD_UNIT                 "pws-pd.service"
+#define PWS_PD_PATCH                "/pws/pd/main.pd"
+
+// スレッドのスケジューリングとメモリのロック（pws_rt.h、無ければ既定値）
+#define PWS_RT_FILE                 "/pws/pws_rt.conf"
+
+// ログ
+#define PWS_FLIGHT_FILE             "/pws/log/pws_manager.flight"   // 状態遷移の記録（pws_flight で表示）
+
+// 録音フォーマット（Recorder.pd の writesf~ と合わせること）
+#define PWS_REC_RATE                (44100)                         // サンプリング周波数
+#define PWS_REC_CHANNELS            (1)                             // チャンネル数
+#define PWS_REC_BYTES               (2)                             // 1サンプルのバイト数
+#define PWS_REC_MAX_MSEC            (1500000)                       // 最大録音時間（ミリ秒）
+
+// 録音領域
+#define PWS_STORAGE_QUOTA_MB        (8192)                          // 録音ファイルの上限（MB）
+#define PWS_STORAGE_RESERVE_MB      (256)                           // システム用に残す空き容量（MB）
+
 //
 // ポート番号定義
 //                                            (モジュール名)       (ポート番号)
@@ -22,6 +49,7 @@
 #define PWS_PORT_TUNER              (8004)  // Tuner                8004
 #define PWS_PORT_EFFECT_CONTROLLER  (8005)  // Effect Controller    8005
 #define PWS_PORT_AUDIO_OUT          (8006)  // Audio Out            8006
+#define PWS_PORT_CALIBRATOR         (8007)  // Calibrator           8007
 #define PWS_PORT_FILE_UPLOADER      (8100)  // File Uploader        8100
 #define PWS_PORT_FILE_DOWNLOADER    (8101)  // File Downloader      8101
 #define PWS_PORT_AP_CONFIGURATOR    (8200)  // AP Configurator      8200
@@ -38,6 +66,7 @@
 #define MSG_PLAY_STOP           "/player/playback/stop"                 // 再生終了要求         （PWS Controller    →  Player           ）
 #define MSG_PLAY_STARTED        "/player/playback/started"              // 再生開始通知         （Player            →  PWS Controller   ）
 #define MSG_PLAY_STOPPED        "/player/playback/stopped"              // 再生終了通知         （Player            →  PWS Controller   ）
+#define MSG_PLAY_RATE           "/player/playback/rate"                 // 再生速度設定         （anyone            →  Player           ）
 #define MSG_TUNING_START        "/tuner/tune/start"                     // チューニング開始要求 （PWS Controller    →  Tuner            ）
 #define MSG_TUNING_STOP         "/tuner/tune/stop"                      // チューニング終了要求 （PWS Controller    →  Tuner            ）
 #define MSG_TUNING_STARTED      "/tuner/tune/started"                   // チューニング開始通知 （Tuner             →  PWS Controller   ）
@@ -46,6 +75,7 @@
 #define MSG_EFFECT_CHANGE       "/effector/effect/toggle"               // エフェクト変更要求   （PWS Controller    →  Effect Controller）
 #define MSG_VOL_UP              "/audio_out/volume/up"                  // ボリュームアップ要求 （PWS Controller    →  Audio Out        ）
 #define MSG_VOL_DOWN            "/audio_out/volume/down"                // ボリュームダウン要求 （PWS Controller    →  Audio Out        ）
+#define MSG_DSP                 "/audio_out/dsp"                        // DSP の停止・再開要求 （PWS Controller    →  Audio Out        ）
 #define MSG_UPLOAD_START        "/uploader/upload/start"                // アップロード開始要求 （PWS Controller    →  File Uploader    ）
 #define MSG_UPLOAD_STARTED      "/uploader/upload/started"              // アップロード開始通知 （File Uploader     →  PWS Controller   ）
 #define MSG_UPLOAD_STOP         "/uploader/upload/stop"                 // アップロード終了要求 （PWS Controller    →  File Uploader    ）
@@ -55,5 +85,47 @@
 #define MSG_DOWNLOAD_STOPPED    "/downloader/download/stopped"          // ダウンロード終了通知 （File Downloader   →  PWS Controller   ）
 #define MSG_AP_CONFIGURED       "/ap_configurator/configure/configured" // AP設定終了通知       （AP Configurator   →  PWS Controller   ）
 #define MSG_SYSTEM_LED_SET      "/system/led/set"                       // システムLED操作      （anyone            →  PWS Controller   ）
+#define MSG_LIB_QUERY           "/pws_manager/library/query"            // 録音ライブラリ問合せ （anyone            →  PWS Controller   ）
+#define MSG_LIB_COUNT           "/pws_manager/library/count"            // 録音ライブラリ件数   （PWS Controller    →  anyone           ）
+#define MSG_LIB_TAKE            "/pws_manager/library/take"             // 録音ライブラリ情報   （PWS Controller    →  anyone           ）
+#define MSG_CALIB_START         "/calibrator/calibrate/start"           // レイテンシ測定開始要求（PWS Controller   →  Calibrator       ）
+#define MSG_CALIB_STOPPED       "/calibrator/calibrate/stopped"         // レイテンシ測定終了通知（Calibrator       →  PWS Controller   ）
+#define MSG_LATENCY_CALIBRATE   "/pws_manager/latency/calibrate"        // レイテンシ測定要求   （anyone            →  PWS Controller   ）
+#define MSG_LATENCY_QUERY       "/pws_manager/latency/query"            // レイテンシ問合せ     （anyone            →  PWS Controller   ）
+#define MSG_LATENCY_ALIGN       "/pws_manager/latency/align"            // 録音の自動補正設定   （anyone            →  PWS Controller   ）
+#define MSG_LATENCY             "/pws_manager/latency"                  // レイテンシ情報       （PWS Controller    →  anyone           ）
+#define MSG_RENDER_START        "/pws_manager/render/start"             // エフェクト書出し要求 （anyone            →  PWS Controller   ）
+#define MSG_RENDER_STOPPED      "/pws_manager/render/stopped"           // エフェクト書出し終了通知（pws_render     →  PWS Controller   ）
+#define MSG_RENDER              "/pws_manager/render"                   // エフェクト書出し結果 （PWS Controller    →  anyone           ）
+#define MSG_METER               "/pws_manager/meter"                    // 入力レベル通知       （Meter             →  PWS Controller   ）
+#define MSG_METER_QUERY         "/pws_manager/meter/query"              // 入力レベル問合せ     （anyone            →  PWS Controller   ）
+#define MSG_METER_LEVEL         "/pws_manager/meter/level"              // 入力レベル情報       （PWS Controller    →  anyone           ）
+#define MSG_INGRESS_QUERY       "/pws_manager/ingress/query"            // 受信キュー統計問合せ （anyone            →  PWS Controller   ）
+#define MSG_INGRESS             "/pws_manager/ingress"                  // 受信キュー統計       （PWS Controller    →  anyone           ）
+#define MSG_INGRESS_REJECTED    "/pws_manager/ingress/rejected"         // 不正メッセージの破棄数（PWS Controller   →  anyone           ）
+#define MSG_STATS_QUERY         "/pws_manager/stats/query"              // 処理時間統計問合せ   （anyone            →  PWS Controller   ）
+#define MSG_STATS               "/pws_manager/stats"                    // 処理時間統計         （PWS Controller    →  anyone           ）
+#define MSG_FLIGHT_DUMP         "/pws_manager/flight/dump"              // 状態遷移の記録の書出し要求（anyone        →  PWS Controller   ）
+#define MSG_FLIGHT              "/pws_manager/flight"                   // 状態遷移の記録の書出し結果（PWS Controller →  anyone          ）
+#define MSG_SUBSCRIBE           "/pws_manager/subscribe"                // 状態通知の購読要求   （anyone            →  PWS Controller   ）
+#define MSG_UNSUBSCRIBE         "/pws_manager/unsubscribe"              // 状態通知の購読解除   （anyone            →  PWS Controller   ）
+#define MSG_SUBSCRIBED          "/pws_manager/subscribed"               // 状態通知の購読結果   （PWS Controller    →  anyone           ）
+#define MSG_STATE               "/pws_manager/state"                    // 状態遷移通知         （PWS Controller    →  購読者           ）
+#define MSG_MODULE_ANNOUNCE     "/pws_manager/module/announce"          // モジュールの登録     （各モジュール      →  PWS Controller   ）
+#define MSG_MODULE_REGISTERED   "/pws_manager/module/registered"        // モジュールの登録結果 （PWS Controller    →  各モジュール     ）
+#define MSG_MODULE_HEARTBEAT    "/pws_manager/module/heartbeat"         // モジュールの心拍     （各モジュール      →  PWS Controller   ）
+#define MSG_MODULE_LOST         "/pws_manager/module/lost"              // モジュールの停止検出 （PWS Controller    →  PWS Controller, 購読者）
+#define MSG_MODULE_QUERY        "/pws_manager/module/query"             // モジュールの問合せ   （anyone            →  PWS Controller   ）
+#define MSG_MODULE              "/pws_manager/module"                   // モジュールの情報     （PWS Controller    →  anyone           ）
+#define MSG_MODULE_DETECT       "/pws_manager/module/detect"            // 停止の検出時間       （PWS Controller    →  anyone           ）
+#define MSG_COMMAND_TIMEOUT     "/pws_manager/command/timeout"          // 指示の応答無し       （PWS Controller    →  PWS Controller   ）
+#define MSG_PD_RESTARTED        "/pws_manager/pd/restarted"             // Pd の再起動通知      （PWS Controller    →  PWS Controller   ）
+#define MSG_CALIB_MEASURED      "/pws_manager/latency/measured"         // レイテンシ解析終了通知（PWS Controller   →  PWS Controller   ）
+#define MSG_TAKE_FINISHED       "/pws_manager/take/finished"            // 録音ファイル確定通知 （PWS Controller    →  PWS Controller   ）
+#define MSG_BOOT_QUERY          "/pws_manager/boot/query"               // 起動の記録の問合せ   （anyone            →  PWS Controller   ）
+#define MSG_BOOT                "/pws_manager/boot"                     // 起動の節目           （PWS Controller    →  anyone           ）
+#define MSG_BOOT_END            "/pws_manager/boot/end"                 // 起動の記録の終わり   （PWS Controller    →  anyone           ）
+#define MSG_POWER_QUERY         "/pws_manager/power/query"              // 省電力の問合せ       （anyone            →  PWS Controller   ）
+#define MSG_POWER               "/pws_manager/power"                    // 省電力の状態         （PWS Controller    →  anyone           ）
 
 #endif  // __DEF_H__
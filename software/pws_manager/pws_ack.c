@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////
+// pws_ack.c
+//   モジュールへの指示の応答待ち（期限までに応答が無ければ送り直し、それでも無ければ失敗）
+//
+//   UDP の指示は落ちても分からないので、開始・終了の指示は応答（開始・終了通知）を待つ。
+//   期限切れは同じバイト列を送り直し、期限を倍にして揺らぎを加える
+//   （複数の指示の送り直しが重ならないように）。
+//   送り直すのは何度届いても同じ結果になる終了の指示だけで、開始の指示は
+//   （届いていれば録音・再生をやり直させてしまうので）長めの期限を一度だけ待つ。
+//   送り直しきったら、マネージャー自身へ MSG_COMMAND_TIMEOUT を送って
+//   状態遷移テーブルで元の状態へ戻させる。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_ack.h"
+#include "pws_power.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+#define ACK_WAIT                (1)     // 応答待ち
+#define ACK_FAILED              (2)     // 失敗（マネージャーが確認するまで残す）
+
+//
+// 応答待ちの指示
+//
+typedef struct {
+    int                 state;          // 0 / ACK_WAIT / ACK_FAILED
+    int                 seq;            // 登録ごとの番号（失敗の通知に付ける）
+    int                 attempts;       // 送った回数
+    struct sockaddr_in  to;             // 宛先
+    uint8_t             data[SEND_BUF_SIZE];
+    int                 len;
+    uint64_t            sent;           // 最後に送った時刻（CLOCK_MONOTONIC、マイクロ秒）
+    uint64_t            deadline;       // 応答期限
+} ACK_ENTRY;
+
+static ACK_ENTRY        AckEntry[ACK_CMD_NUM];
+static int              AckSeq;
+static uint32_t         AckRand;        // 揺らぎの乱数（初期化ごとに同じ列、トレース再生で再現できるように）
+static pthread_mutex_t  AckMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 送り直してよい指示（冪等なもの）
+static const int        AckResend[ACK_CMD_NUM] = {
+    [ACK_REC_START]     = 0,
+    [ACK_REC_STOP]      = 1,
+    [ACK_PLAY_START]    = 0,
+    [ACK_PLAY_STOP]     = 1,
+    [ACK_TUNING_START]  = 0,
+    [ACK_TUNING_STOP]   = 1,
+};
+
+static pthread_t        threadAckID;
+static pthread_mutex_t  threadAckMutex  = PTHREAD_MUTEX_INITIALIZER;
+static int              threadAckFinish = 0;
+static int              threadAckStarted = 0;
+
+static void *threadAckWatch(void *arg);
+static uint32_t ackJitter(void);
+static int ackSendTimeout(int seq, const char *addr);
+
+//
+// 初期化
+//
+void ackInitialize(void)
+{
+    pthread_mutex_lock(&AckMutex);
+    memset(AckEntry, 0, sizeof(AckEntry));
+    AckSeq  = 0;
+    AckRand = 0x9e3779b9;
+    pthread_mutex_unlock(&AckMutex);
+}
+
+//
+// 監視スレッドの開始
+//
+int ackStart(void)
+{
+    threadAckFinish = 0;
+    if (pthread_create(&threadAckID, NULL, threadAckWatch, NULL) != 0) {
+        PWS_DEBUG("ERROR: ack thread\n");
+        return -1;
+    }
+    threadAckStarted = 1;
+
+    return 0;
+}
+
+//
+// 監視スレッドの終了
+//
+void ackFinish(void)
+{
+    if (!threadAckStarted) {
+        return;
+    }
+
+    pthread_mutex_lock(&threadAckMutex);
+    threadAckFinish = 1;
+    pthread_mutex_unlock(&threadAckMutex);
+
+    pthread_join(threadAckID, NULL);
+    threadAckStarted = 0;
+}
+
+//
+// 応答待ちの登録
+//
+void ackExpect(int cmd, const struct sockaddr_in *to, const uint8_t *data, int len)
+{
+    ACK_ENTRY *e;
+
+    if (cmd < 0 || cmd >= ACK_CMD_NUM || len > SEND_BUF_SIZE) {
+        return;
+    }
+
+    pthread_mutex_lock(&AckMutex);
+    e = &AckEntry[cmd];
+    e->state    = ACK_WAIT;
+    e->seq      = ++AckSeq;
+    e->attempts = 1;
+    e->to       = *to;
+    memcpy(e->data, data, len);
+    e->len      = len;
+    e->sent     = utilNow();
+    e->deadline = e->sent + (AckResend[cmd] ? ACK_TIMEOUT_MS : ACK_ONCE_TIMEOUT_MS) * 1000;
+    pthread_mutex_unlock(&AckMutex);
+}
+
+//
+// 応答の受信
+//
+int32_t ackReceived(int cmd)
+{
+    int32_t rtt = -1;
+
+    if (cmd < 0 || cmd >= ACK_CMD_NUM) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&AckMutex);
+    if (AckEntry[cmd].state == ACK_WAIT) {
+        rtt = (int32_t)(utilNow() - AckEntry[cmd].sent);
+        if (AckEntry[cmd].attempts > 1) {
+            PWS_DEBUG("ack: [%s] after %d attempts\n", (char *)AckEntry[cmd].data, AckEntry[cmd].attempts);
+        }
+    }
+    AckEntry[cmd].state = 0;
+    pthread_mutex_unlock(&AckMutex);
+
+    return rtt;
+}
+
+//
+// 応答待ちの取消し
+//
+void ackCancel(int cmd)
+{
+    if (cmd < 0 || cmd >= ACK_CMD_NUM) {
+        return;
+    }
+
+    pthread_mutex_lock(&AckMutex);
+    AckEntry[cmd].state = 0;
+    pthread_mutex_unlock(&AckMutex);
+}
+
+void ackCancelAll(void)
+{
+    int i;
+
+    pthread_mutex_lock(&AckMutex);
+    for (i = 0; i < ACK_CMD_NUM; i++) {
+        AckEntry[i].state = 0;
+    }
+    pthread_mutex_unlock(&AckMutex);
+}
+
+//
+// 失敗の確認
+//
+int ackFailed(int seq)
+{
+    int i, cmd = -1;
+
+    pthread_mutex_lock(&AckMutex);
+    for (i = 0; i < ACK_CMD_NUM; i++) {
+        if (AckEntry[i].state == ACK_FAILED && AckEntry[i].seq == seq) {
+            AckEntry[i].state = 0;
+            cmd = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&AckMutex);
+
+    return cmd;
+}
+
+//
+// 期限の確認
+//
+int ackCheck(void)
+{
+    int i, n = 0, nFail = 0;
+    uint64_t now;
+    struct {
+        struct sockaddr_in  to;
+        uint8_t             data[SEND_BUF_SIZE];
+        int                 len;
+        int                 seq;
+    } out[ACK_CMD_NUM];
+
+    pthread_mutex_lock(&AckMutex);
+    now = utilNow();
+    for (i = 0; i < ACK_CMD_NUM; i++) {
+        ACK_ENTRY *e = &AckEntry[i];
+
+        if (e->state != ACK_WAIT || now < e->deadline) {
+            continue;
+        }
+        if (e->attempts > ACK_RETRY_MAX || !AckResend[i]) {
+            // 送り直しきった・送り直さない指示
+            e->state = ACK_FAILED;
+            out[n].seq = e->seq;
+            out[n].len = -1;
+            memcpy(out[n].data, e->data, e->len);
+            n++;
+            nFail++;
+            continue;
+        }
+        // 期限を倍にして揺らぎを加える
+        e->sent     = now;
+        e->deadline = now + ((uint64_t)ACK_TIMEOUT_MS << e->attempts) * 1000 + ackJitter();
+        e->attempts++;
+        out[n].to  = e->to;
+        out[n].len = e->len;
+        memcpy(out[n].data, e->data, e->len);
+        n++;
+    }
+    pthread_mutex_unlock(&AckMutex);
+
+    // 送信はロックの外で（指示のアドレスは先頭の文字列）
+    for (i = 0; i < n; i++) {
+        if (out[i].len >= 0) {
+            PWS_DEBUG("ack: retry [%s]\n", (char *)out[i].data);
+            utilSend(&out[i].to, out[i].data, out[i].len);
+        }
+        else {
+            PWS_DEBUG("ack: no response [%s]\n", (char *)out[i].data);
+            ackSendTimeout(out[i].seq, (char *)out[i].data);
+        }
+    }
+
+    return nFail;
+}
+
+// 監視スレッド
+static void *threadAckWatch(void *arg)
+{
+    int loop;
+    struct timespec ts;
+
+    rtApply(RT_ROLE_WATCH);
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = ACK_CHECK_MS * 1000000L;
+
+    loop = 1;
+    while (loop) {
+        pwrSleep(&ts);
+
+        ackCheck();
+
+        pthread_mutex_lock(&threadAckMutex);
+        if (threadAckFinish == 1) {
+            loop = 0;
+        }
+        pthread_mutex_unlock(&threadAckMutex);
+    }
+
+    return (void *)NULL;
+}
+
+// 揺らぎ（0 ～ ACK_JITTER_MS のマイクロ秒、xorshift）
+static uint32_t ackJitter(void)
+{
+    AckRand ^= AckRand << 13;
+    AckRand ^= AckRand >> 17;
+    AckRand ^= AckRand << 5;
+
+    return AckRand % (ACK_JITTER_MS * 1000 + 1);
+}
+
+// 失敗の通知（マネージャー自身の受信ポートへ）
+static int ackSendTimeout(int seq, const char *addr)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeIS(&OSC_WIRE_IS(MSG_COMMAND_TIMEOUT), seq, addr, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
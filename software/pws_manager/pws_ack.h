@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////
+// pws_ack.h
+//   モジュールへの指示の応答待ち（期限までに応答が無ければ送り直し、それでも無ければ失敗）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_ACK_H__
+#define __PWS_ACK_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// 最初の応答期限（ミリ秒、送り直すたびに倍にする）
+#define ACK_TIMEOUT_MS          (250)
+
+// 送り直しの期限に加える揺らぎの最大（ミリ秒）
+#define ACK_JITTER_MS           (50)
+
+// 送り直す回数（これを超えて応答が無ければ失敗）
+#define ACK_RETRY_MAX           (2)
+
+// 送り直さない指示（開始）の応答期限（ミリ秒、送り直す指示の期限の合計と同程度）
+#define ACK_ONCE_TIMEOUT_MS     (1500)
+
+// 期限の確認の周期（ミリ秒）
+#define ACK_CHECK_MS            (20)
+
+//
+// 応答を待つ指示（指示 → 応答）
+//
+#define ACK_NONE                (-1)
+#define ACK_REC_START           (0)     // MSG_REC_START    → MSG_REC_STARTED
+#define ACK_REC_STOP            (1)     // MSG_REC_STOP     → MSG_REC_STOPPED
+#define ACK_PLAY_START          (2)     // MSG_PLAY_START   → MSG_PLAY_STARTED
+#define ACK_PLAY_STOP           (3)     // MSG_PLAY_STOP    → MSG_PLAY_STOPPED
+#define ACK_TUNING_START        (4)     // MSG_TUNING_START → MSG_TUNING_STARTED
+#define ACK_TUNING_STOP         (5)     // MSG_TUNING_STOP  → MSG_TUNING_STOPPED
+#define ACK_CMD_NUM             (6)
+
+//
+// 初期化（応答待ちは全て取消し）
+//
+extern void ackInitialize(void);
+
+//
+// 監視スレッドの開始・終了
+//
+extern int ackStart(void);
+extern void ackFinish(void);
+
+//
+// 応答待ちの登録（送った指示をそのまま渡す、同じ指示の応答待ちは置き換える）
+//
+extern void ackExpect(int cmd, const struct sockaddr_in *to, const uint8_t *data, int len);
+
+//
+// 応答の受信（戻り値: 最後に送ってからの往復時間（マイクロ秒）、-1: 待っていない）
+//
+extern int32_t ackReceived(int cmd);
+
+//
+// 応答待ちの取消し
+//
+extern void ackCancel(int cmd);
+extern void ackCancelAll(void);
+
+//
+// 失敗の確認（seq: MSG_COMMAND_TIMEOUT の番号）
+//   戻り値: 失敗した指示、-1: 既に応答が届いた・取消された
+//
+extern int ackFailed(int seq);
+
+//
+// 期限の確認（期限切れは送り直し、送り直しきったらマネージャーへ MSG_COMMAND_TIMEOUT を送る）
+//   開始の指示は送り直さずに失敗とする
+//   監視スレッドから周期的に呼ぶ、戻り値: 失敗した数
+//
+extern int ackCheck(void);
+
+#endif  // __PWS_ACK_H__
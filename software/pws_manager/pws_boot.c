@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////
+// pws_boot.c
+//   起動の記録（電源投入からの時刻で節目を記録）と systemd への通知
+//
+//   時刻は CLOCK_BOOTTIME（カーネルの起動から）なので、systemd の
+//   ユニットの起動を待った時間も含めて、どこで時間がかかったかが分かる。
+//   sd_notify とソケットアクティベーションは libsystemd を使わずに
+//   プロトコルを直接扱う（環境変数と UNIX ドメインソケットだけ）。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pws_boot.h"
+#include "pws_util.h"
+#include "pws_debug.h"
+
+// systemd から渡されるソケットの最初の番号（SD_LISTEN_FDS_START）
+#define BOOT_LISTEN_FDS_START   (3)
+
+//
+// 節目
+//
+typedef struct {
+    char        name[BOOT_NAME_LEN];
+    uint64_t    at;                     // CLOCK_BOOTTIME（マイクロ秒）
+} BOOT_MARK;
+
+static BOOT_MARK        BootMark[BOOT_MARK_MAX];
+static int              BootMarkNum = 0;
+static pthread_mutex_t  BootMutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// 初期化
+//
+void bootInitialize(void)
+{
+    pthread_mutex_lock(&BootMutex);
+    memset(BootMark, 0, sizeof(BootMark));
+    BootMarkNum = 0;
+    pthread_mutex_unlock(&BootMutex);
+}
+
+//
+// 節目の記録
+//
+int bootMark(const char *name)
+{
+    int i;
+
+    pthread_mutex_lock(&BootMutex);
+    for (i = 0; i < BootMarkNum; i++) {
+        if (strcmp(BootMark[i].name, name) == 0) {
+            pthread_mutex_unlock(&BootMutex);
+            return -1;
+        }
+    }
+    if (BootMarkNum >= BOOT_MARK_MAX) {
+        pthread_mutex_unlock(&BootMutex);
+        return -1;
+    }
+    snprintf(BootMark[BootMarkNum].name, BOOT_NAME_LEN, "%s", name);
+    BootMark[BootMarkNum].at = utilBootNow();
+    BootMarkNum++;
+    pthread_mutex_unlock(&BootMutex);
+
+    return 0;
+}
+
+//
+// 問合せ
+//
+int bootGet(int idx, const char **name, int32_t *ms, int32_t *step)
+{
+    pthread_mutex_lock(&BootMutex);
+    if (idx < 0 || idx >= BootMarkNum) {
+        pthread_mutex_unlock(&BootMutex);
+        return -1;
+    }
+    *name = BootMark[idx].name;
+    *ms   = (int32_t)(BootMark[idx].at / 1000);
+    *step = (idx == 0) ? 0 : (int32_t)(BootMark[idx].at - BootMark[idx - 1].at);
+    pthread_mutex_unlock(&BootMutex);
+
+    return 0;
+}
+
+//
+// 記録のログ出力
+//
+void bootReport(void)
+{
+    int i;
+    const char *name;
+    int32_t ms, step;
+
+    for (i = 0; bootGet(i, &name, &ms, &step) == 0; i++) {
+        PWS_DEBUG("boot: %-10s %7d ms  +%d us\n", name, ms, step);
+    }
+}
+
+//
+// ソケットアクティベーション
+//
+int bootListenSocket(void)
+{
+    const char *pid, *fds;
+
+    pid = getenv("LISTEN_PID");
+    fds = getenv("LISTEN_FDS");
+    if (pid == NULL || fds == NULL || atoi(pid) != (int)getpid() || atoi(fds) < 1) {
+        return -1;
+    }
+
+    // 子プロセス（Pd の再起動など）へ引継がない
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+
+    return BOOT_LISTEN_FDS_START;
+}
+
+//
+// systemd への通知
+//
+int bootNotify(const char *state)
+{
+    int sock, len, ret = 0;
+    const char *path;
+    struct sockaddr_un addr;
+
+    path = getenv("NOTIFY_SOCKET");
+    if (path == NULL || (path[0] != '/' && path[0] != '@') || strlen(path) >= sizeof(addr.sun_path)) {
+        return 0;
+    }
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        PWS_DEBUG("ERROR: notify socket\n");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    len = strlen(path);
+    memcpy(addr.sun_path, path, len);
+    // '@' は抽象名前空間
+    if (addr.sun_path[0] == '@') {
+        addr.sun_path[0] = '\0';
+    }
+    if (sendto(sock, state, strlen(state), 0, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + len) == -1) {
+        PWS_DEBUG("ERROR: notify sendto\n");
+        ret = -1;
+    }
+    close(sock);
+
+    return ret;
+}
@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////
+// pws_boot.h
+//   起動の記録（電源投入からの時刻で節目を記録）と systemd への通知
+///////////////////////////////////////////////////////////
+#ifndef __PWS_BOOT_H__
+#define __PWS_BOOT_H__
+
+#include <stdint.h>
+
+// 記録できる節目の最大数（モジュールの登録も含む）
+#define BOOT_MARK_MAX           (24)
+#define BOOT_NAME_LEN           (32)
+
+//
+// 節目（起動順）
+//
+#define BOOT_MAIN               "main"          // pws_manager の開始
+#define BOOT_BOUND              "bound"         // 受信ソケットの準備（ここからのボタン操作は受付ける）
+#define BOOT_GPIO               "gpio"          // GPIO の設定
+#define BOOT_BUTTON             "button"        // ボタン監視スレッドの開始
+#define BOOT_LED                "led"           // LED 制御スレッドの受信準備
+#define BOOT_READY              "ready"         // systemd へ READY=1
+#define BOOT_STORAGE            "storage"       // 録音ライブラリ・録音領域・レイテンシの読込み
+#define BOOT_AP_CHECK           "ap_check"      // 起動モードの判定
+#define BOOT_PD_WAIT            "pd_wait"       // PD初期化終了待ち
+#define BOOT_IDLE               "idle"          // アイドル（最初の PD初期化終了通知）
+
+//
+// 初期化（記録を消す）
+//
+extern void bootInitialize(void);
+
+//
+// 節目の記録（同じ名前は最初の１回だけ、戻り値: -1: 記録済み・一杯）
+//
+extern int bootMark(const char *name);
+
+//
+// 問合せ（idx 番目の節目、ms: 電源投入から（CLOCK_BOOTTIME、ミリ秒）、
+//         step: 前の節目から（マイクロ秒、最初は 0）、戻り値: -1: 無し）
+//
+extern int bootGet(int idx, const char **name, int32_t *ms, int32_t *step);
+
+//
+// 記録のログ出力
+//
+extern void bootReport(void);
+
+//
+// systemd のソケットアクティベーション（戻り値: 渡された受信ソケット、-1: 無し）
+//
+extern int bootListenSocket(void);
+
+//
+// systemd への通知（sd_notify、NOTIFY_SOCKET が無ければ何もしない）
+//
+extern int bootNotify(const char *state);
+
+#endif  // __PWS_BOOT_H__
@@ -17,6 +17,9 @@
 #include "pws_gpio.h"
 #include "pws_osc.h"
 #include "pws_btn.h"
+#include "pws_stats.h"
+#include "pws_rt.h"
+#include "pws_power.h"
 #include "pws_debug.h"
 
 #define BTN_1               (0)
@@ -45,16 +48,26 @@ static struct {
     int     state;
     int     push;
     double  time;
+    uint32_t edge;                      // ボタンの変化を検出した時刻（statsNow）
 } BtnCtx[MAX_BTN] = {
-    { PIN_BTN_1, STATE_RELEASE, PIN_VAL_OFF, -1.0 },
-    { PIN_BTN_2, STATE_RELEASE, PIN_VAL_ON , -1.0 },
-    { PIN_BTN_3, STATE_RELEASE, PIN_VAL_ON , -1.0 },
-    { PIN_BTN_4, STATE_RELEASE, PIN_VAL_ON , -1.0 },
-    { PIN_BTN_5, STATE_RELEASE, PIN_VAL_ON , -1.0 },
-    { PIN_BTN_6, STATE_RELEASE, PIN_VAL_ON , -1.0 },
-    { PIN_BTN_7, STATE_RELEASE, PIN_VAL_ON , -1.0 },
+    { PIN_BTN_1, STATE_RELEASE, PIN_VAL_OFF, -1.0, 0 },
+    { PIN_BTN_2, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
+    { PIN_BTN_3, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
+    { PIN_BTN_4, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
+    { PIN_BTN_5, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
+    { PIN_BTN_6, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
+    { PIN_BTN_7, STATE_RELEASE, PIN_VAL_ON , -1.0, 0 },
 };
 
+// btnActionRelease からマネージャーへ送るまでの計測用（0: 計測しない）
+static uint32_t btnTraceEdge;
+static uint32_t btnTraceRelease;
+
+// 省電力中のボタンの割込みの時刻（statsNow、0: 無し）
+static uint32_t btnIsrAt;
+// 全てのボタンの割込みを登録できた（できなければ省電力中もポーリングを続ける）
+static int      btnIsrReady;
+
 static pthread_t       threadBtnID;
 static pthread_mutex_t threadBtnMutex  = PTHREAD_MUTEX_INITIALIZER;
 static int             threadBtnFinish = 0;
@@ -63,9 +76,10 @@ static void *threadBtnMonitor(void *arg);
 static int btnActionPush(int btn);
 static int btnActionRelease(int btn);
 static int btnActionLongPush(int btn);
-static int btnSendMessageToManager(char *msg);
+static int btnSendMessageToManager(const OSC_WIRE *wire);
 static double btnGetCurrentMsec();
 static int btnGetEvent(int idx);
+static void btnIsr(void);
 
 // 状態遷移テーブル
 static struct {
@@ -103,8 +117,19 @@ static struct {
 //
 int btnInitialize(void)
 {
+    int i;
+
     PWS_DEBUG("btnInitialize\n");
 
+    // 省電力中はボタンの変化（割込み）で起こす
+    for (i = 0; i < MAX_BTN; i++) {
+        if (wiringPiISR(BtnCtx[i].pin, INT_EDGE_BOTH, btnIsr) < 0) {
+            PWS_DEBUG("ERROR: wiringPiISR %d\n", BtnCtx[i].pin);
+            break;
+        }
+    }
+    btnIsrReady = (i == MAX_BTN);
+
     // スレッドの作成
     pthread_create(&threadBtnID , NULL, threadBtnMonitor , NULL);
 
@@ -130,11 +155,13 @@ void btnFinish(void)
 // ボタン監視スレッド
 static void *threadBtnMonitor(void *arg)
 {
-    int i, ret, loop, next;
+    int i, ret, loop, next, changed;
     int evt[MAX_BTN];
     int (*func)(int btn);
     struct timespec ts;
 
+    rtApply(RT_ROLE_BUTTON);
+
     // スリープ時間設定
     ts.tv_sec  = 0;
     ts.tv_nsec = 1000 * 1000 * 100; // 100 msec
@@ -142,8 +169,17 @@ static void *threadBtnMonitor(void *arg)
     loop = 1;
     while (loop) {
         // ボタンイベントの取得
+        changed = 0;
         for (i = 0; i < MAX_BTN; i++) {
             evt[i] = btnGetEvent(i);
+            if (evt[i] >= 0) {
+                changed = 1;
+            }
+        }
+
+        // 省電力中ならボタンの処理より先に戻す（割込みからの時間を記録）
+        if (changed) {
+            pwrResume(PWR_REASON_BUTTON, __atomic_exchange_n(&btnIsrAt, 0, __ATOMIC_ACQ_REL));
         }
 
         // 状態遷移
@@ -161,8 +197,13 @@ static void *threadBtnMonitor(void *arg)
                 BtnCtx[i].state = next;
             }
         }
-        // スリープ（100 msec）
-        nanosleep(&ts, NULL);
+        // スリープ（100 msec、省電力中は割込みまで）
+        if (btnIsrReady) {
+            pwrSleep(&ts);
+        }
+        else {
+            nanosleep(&ts, NULL);
+        }
 
         pthread_mutex_lock(&threadBtnMutex);
         if (threadBtnFinish == 1) {
@@ -188,6 +229,8 @@ static int btnGetEvent(int idx)
         else
             evt = (push == PIN_VAL_OFF) ? EVT_PUSH : EVT_RELEASE;
         BtnCtx[idx].push = push;
+        // ポーリング周期（100 msec）で検出するので、実際の変化からは最大でその分遅れる
+        BtnCtx[idx].edge = statsNow();
     }
     if (BtnCtx[idx].state == STATE_PUSH && evt == EVT_NONE) {
         if (BtnCtx[idx].time >= 0.0) {
@@ -201,6 +244,17 @@ static int btnGetEvent(int idx)
     return evt;
 }
 
+// ボタンの割込み（wiringPi の割込みスレッドから）
+static void btnIsr(void)
+{
+    uint32_t zero = 0;
+
+    if (pwrIsSaving()) {
+        __atomic_compare_exchange_n(&btnIsrAt, &zero, statsNow(), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        pwrKick();
+    }
+}
+
 static int btnActionPush(int btn)
 {
     BtnCtx[btn].time = btnGetCurrentMsec();
@@ -210,47 +264,53 @@ static int btnActionPush(int btn)
 
 static int btnActionRelease(int btn)
 {
+    // 処理時間の計測（送信したときにマネージャーへ渡す）
+    btnTraceEdge    = BtnCtx[btn].edge;
+    btnTraceRelease = statsNow();
+    statsRecord(STATS_EDGE_TO_RELEASE, btnTraceRelease - btnTraceEdge);
+
     // ボタン押下イベント発行
     switch (btn) {
     case BTN_1:
         if (BtnCtx[BTN_3].state == STATE_PUSH || BtnCtx[BTN_3].state == STATE_PUSH_OVER) {
             PWS_DEBUG("ボタン押下 [1] [3]\n");
-            btnSendMessageToManager(MSG_PUSH_AP_SET_BTN);
+            btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_AP_SET_BTN));
         }
         break;
     case BTN_2:
         PWS_DEBUG("ボタン押下 [2]\n");
-        btnSendMessageToManager(MSG_PUSH_TUNING_BTN);
+        btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_TUNING_BTN));
         break;
     case BTN_3:
         if (BtnCtx[BTN_1].state == STATE_PUSH || BtnCtx[BTN_1].state == STATE_PUSH_OVER) {
             PWS_DEBUG("ボタン押下 [1] [3]\n");
-            btnSendMessageToManager(MSG_PUSH_AP_SET_BTN);
+            btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_AP_SET_BTN));
         }
         else {
             PWS_DEBUG("ボタン押下 [3]\n");
-            btnSendMessageToManager(MSG_PUSH_EFFECT_BTN);
+            btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_EFFECT_BTN));
         }
         break;
     case BTN_4:
         PWS_DEBUG("ボタン押下 [4]\n");
-        btnSendMessageToManager(MSG_PUSH_REC_BTN);
+        btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_REC_BTN));
         break;
     case BTN_5:
         PWS_DEBUG("ボタン押下 [5]\n");
-        btnSendMessageToManager(MSG_PUSH_PLAY_BTN);
+        btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_PLAY_BTN));
         break;
     case BTN_6:
         PWS_DEBUG("ボタン押下 [6]\n");
-        btnSendMessageToManager(MSG_PUSH_VOL_UP_BTN);
+        btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_VOL_UP_BTN));
         break;
     case BTN_7:
         PWS_DEBUG("ボタン押下 [7]\n");
-        btnSendMessageToManager(MSG_PUSH_VOL_DOWN_BTN);
+        btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_VOL_DOWN_BTN));
         break;
     default:
         break;
     }
+    btnTraceRelease = 0;
 
     return 0;
 }
@@ -268,7 +328,7 @@ static int btnActionLongPush(int btn)
             BtnCtx[BTN_7].state != STATE_PUSH && BtnCtx[BTN_7].state != STATE_PUSH_OVER)
         {
             PWS_DEBUG("ボタン長押し [1]\n");
-            btnSendMessageToManager(MSG_PUSH_SHUTDOWN_BTN);
+            btnSendMessageToManager(&OSC_WIRE(MSG_PUSH_SHUTDOWN_BTN));
         }
         break;
     case BTN_2:
@@ -291,21 +351,10 @@ static int btnActionLongPush(int btn)
 }
 
 // マネージャーにメッセージを送信
-static int btnSendMessageToManager(char *msg)
+static int btnSendMessageToManager(const OSC_WIRE *wire)
 {
-    int n, ret, sock, len;
-    uint8_t sendBuf[SEND_BUF_SIZE];
+    int n, sock;
     struct sockaddr_in addr;
-    OSC_MESSAGE oscMsg;
-
-    memset(&oscMsg, 0, sizeof(oscMsg));
-    
-    oscMsg.addr = msg;
-    oscMsg.num  = 0;
-    ret = oscEncode(&oscMsg, (uint8_t *)sendBuf, &len);
-    if (ret < 0) {
-        return -1;
-    }
 
     sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock == -1) {
@@ -317,7 +366,10 @@ static int btnSendMessageToManager(char *msg)
     addr.sin_family      = AF_INET;
     addr.sin_addr.s_addr = inet_addr("127.0.0.1");
     addr.sin_port        = htons(PWS_PORT_MANAGER);
-    n = sendto(sock, sendBuf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    if (btnTraceRelease != 0) {
+        statsButtonSent(btnTraceEdge, btnTraceRelease);
+    }
+    n = sendto(sock, wire->data, wire->size, 0, (struct sockaddr *)&addr, sizeof(addr));
     if (n == -1) {
         PWS_DEBUG("ERROR: Sendto\n");
         close(sock);
@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////
+// pws_bus.c
+//   状態通知の購読（状態遷移、チューナー、アップロード、入力レベル、モジュールの停止を購読者へ配る）
+//
+//   購読時にアドレスパターンを通知のアドレスの木（pws_trie）と照合して
+//   ビットにしておくので、配信時はビットを見るだけで宛先が決まる。
+//   宛先は sendmmsg でまとめて送る。
+//   UDP では相手がいなくても分からない（接続していないソケットには ICMP の
+//   到達不能も返らない）ので、購読には期限を付けて購読者に送り直してもらい、
+//   期限切れの購読者だけを削除する。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "def.h"
+#include "pws_bus.h"
+#include "pws_trie.h"
+#include "pws_util.h"
+#include "pws_debug.h"
+
+// 通知のアドレス（BUS_TOPIC_* の順）
+static const char *BUS_TOPIC_ADDR[BUS_TOPIC_NUM] = {
+    MSG_STATE,                          // 状態遷移
+    MSG_TUNING_COND,                    // チューニング状態通知
+    MSG_METER,                          // 入力レベル通知
+    MSG_UPLOAD_STARTED,                 // アップロード開始通知
+    MSG_UPLOAD_STOPPED,                 // アップロード終了通知
+    MSG_MODULE_LOST,                    // モジュールの停止検出
+};
+
+//
+// 購読者
+//
+typedef struct {
+    int                 used;
+    struct sockaddr_in  to;             // 宛先
+    uint32_t            topics;         // 配信する通知（1 << BUS_TOPIC_*）
+    uint64_t            expire;         // 期限（CLOCK_MONOTONIC、ミリ秒）
+} BUS_SUB;
+
+static BUS_SUB      BusSub[BUS_SUB_MAX];
+static uint32_t     BusTopics;          // 購読されている通知（全購読者の OR）
+static int          BusSock = -1;
+static TRIE_NODE   *BusTrie = NULL;     // 通知のアドレスの木
+
+static void busRemove(int idx);
+
+//
+// 初期化
+//
+void busInitialize(int sock)
+{
+    int i;
+    TRIE_ENTRY entry[BUS_TOPIC_NUM];
+
+    memset(BusSub, 0, sizeof(BusSub));
+    BusTopics = 0;
+    BusSock   = sock;
+
+    if (BusTrie == NULL) {
+        for (i = 0; i < BUS_TOPIC_NUM; i++) {
+            entry[i].addr  = BUS_TOPIC_ADDR[i];
+            entry[i].val   = i;
+            entry[i].exact = 0;
+        }
+        BusTrie = trieBuild(entry, BUS_TOPIC_NUM);
+    }
+}
+
+//
+// 購読
+//
+int busSubscribe(const struct sockaddr_in *to, const char *pattern)
+{
+    int i, n, idx, empty;
+    int val[BUS_TOPIC_NUM];
+    uint32_t topics;
+    uint64_t now;
+
+    if (pattern == NULL) {
+        topics = (1u << BUS_TOPIC_NUM) - 1;
+        n = BUS_TOPIC_NUM;
+    }
+    else {
+        n = trieMatch(BusTrie, pattern, val, BUS_TOPIC_NUM);
+        for (i = 0, topics = 0; i < n; i++) {
+            topics |= 1u << val[i];
+        }
+    }
+
+    // 同じ宛先の購読は置き換える、期限切れは削除
+    now  = utilNow() / 1000;
+    idx  = -1;
+    empty = -1;
+    for (i = 0; i < BUS_SUB_MAX; i++) {
+        if (BusSub[i].used && BusSub[i].expire <= now) {
+            busRemove(i);
+        }
+        if (!BusSub[i].used) {
+            if (empty < 0) {
+                empty = i;
+            }
+        }
+        else if (BusSub[i].to.sin_addr.s_addr == to->sin_addr.s_addr &&
+                 BusSub[i].to.sin_port        == to->sin_port) {
+            idx = i;
+        }
+    }
+
+    if (n == 0) {
+        if (idx >= 0) {
+            busRemove(idx);
+        }
+        return 0;
+    }
+    if (idx < 0) {
+        if (empty < 0) {
+            PWS_DEBUG("ERROR: bus subscribers full\n");
+            return -1;
+        }
+        idx = empty;
+    }
+
+    BusSub[idx].used   = 1;
+    BusSub[idx].to     = *to;
+    BusSub[idx].topics = topics;
+    BusSub[idx].expire = now + BUS_LEASE_SEC * 1000;
+    BusTopics |= topics;
+
+    return n;
+}
+
+//
+// 購読の解除
+//
+int busUnsubscribe(const struct sockaddr_in *to)
+{
+    int i, n = 0;
+
+    for (i = 0; i < BUS_SUB_MAX; i++) {
+        if (BusSub[i].used &&
+            BusSub[i].to.sin_addr.s_addr == to->sin_addr.s_addr &&
+            BusSub[i].to.sin_port        == to->sin_port) {
+            busRemove(i);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+//
+// 購読者がいるか
+//
+int busWanted(int topic)
+{
+    return (BusTopics & (1u << topic)) != 0;
+}
+
+//
+// 配信
+//
+int busPublish(int topic, const uint8_t *data, int len)
+{
+    int i, n, rc, sent, start;
+    int idx[BUS_SUB_MAX];
+    uint64_t now;
+    struct iovec iov;
+    struct mmsghdr vec[BUS_SUB_MAX];
+
+    if (!busWanted(topic)) {
+        return 0;
+    }
+
+    // 宛先を集める（期限切れは削除）
+    now = utilNow() / 1000;
+    for (i = 0, n = 0; i < BUS_SUB_MAX; i++) {
+        if (!BusSub[i].used || (BusSub[i].topics & (1u << topic)) == 0) {
+            continue;
+        }
+        if (BusSub[i].expire <= now) {
+            PWS_DEBUG("bus: lease expired port=%d\n", ntohs(BusSub[i].to.sin_port));
+            busRemove(i);
+            continue;
+        }
+        memset(&vec[n], 0, sizeof(vec[n]));
+        vec[n].msg_hdr.msg_name    = &BusSub[i].to;
+        vec[n].msg_hdr.msg_namelen = sizeof(BusSub[i].to);
+        vec[n].msg_hdr.msg_iov     = &iov;
+        vec[n].msg_hdr.msg_iovlen  = 1;
+        idx[n++] = i;
+    }
+    iov.iov_base = (void *)data;
+    iov.iov_len  = len;
+
+    // 送れなかった宛先は飛ばして残りを送る（削除は期限切れだけ）
+    for (start = 0, sent = 0; start < n; ) {
+        rc = sendmmsg(BusSock, &vec[start], n - start, MSG_DONTWAIT);
+        if (rc < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 送信バッファが一杯（購読者のせいではないので今回は諦める）
+                break;
+            }
+            rc = 0;
+        }
+        sent  += rc;
+        start += rc;
+        if (start < n) {
+            i = idx[start];
+            PWS_DEBUG("bus: sendmmsg error port=%d errno=%d\n", ntohs(BusSub[i].to.sin_port), errno);
+            start++;
+        }
+    }
+
+    return sent;
+}
+
+// 購読者の削除
+static void busRemove(int idx)
+{
+    int i;
+
+    BusSub[idx].used = 0;
+    for (i = 0, BusTopics = 0; i < BUS_SUB_MAX; i++) {
+        if (BusSub[i].used) {
+            BusTopics |= BusSub[i].topics;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////
+// pws_bus.h
+//   状態通知の購読（状態遷移、チューナー、アップロード、入力レベル、モジュールの停止を購読者へ配る）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_BUS_H__
+#define __PWS_BUS_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// 購読者の最大数
+#define BUS_SUB_MAX             (8)
+
+// 購読の期限（秒、期限までに購読要求を送り直さなければ削除する）
+#define BUS_LEASE_SEC           (60)
+
+//
+// 配信する通知
+//
+#define BUS_TOPIC_STATE             (0)     // 状態遷移（MSG_STATE）
+#define BUS_TOPIC_TUNING_COND       (1)     // チューニング状態通知（受信したまま）
+#define BUS_TOPIC_METER             (2)     // 入力レベル通知（受信したまま）
+#define BUS_TOPIC_UPLOAD_STARTED    (3)     // アップロード開始通知（受信したまま）
+#define BUS_TOPIC_UPLOAD_STOPPED    (4)     // アップロード終了通知（受信したまま）
+#define BUS_TOPIC_MODULE_LOST       (5)     // モジュールの停止検出（受信したまま）
+#define BUS_TOPIC_NUM               (6)
+
+//
+// 初期化（送信に使うソケットを渡す、購読は全て削除）
+//
+extern void busInitialize(int sock);
+
+//
+// 購読（pattern: 通知のアドレスパターン、NULL なら全て）
+//   同じ宛先からの購読は置き換えて期限を延ばす
+//   戻り値: 一致した通知の数（0 なら登録しない）、-1: 購読者が一杯
+//
+extern int busSubscribe(const struct sockaddr_in *to, const char *pattern);
+
+//
+// 購読の解除（戻り値: 解除した数）
+//
+extern int busUnsubscribe(const struct sockaddr_in *to);
+
+//
+// 購読者がいるか（1: いる、配信するメッセージを作る前に確認する）
+//
+extern int busWanted(int topic);
+
+//
+// 配信（OSC メッセージ data を購読者全員へまとめて送る、戻り値: 送った数）
+//
+extern int busPublish(int topic, const uint8_t *data, int len);
+
+#endif  // __PWS_BUS_H__
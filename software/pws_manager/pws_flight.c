@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////
+// pws_flight.c
+//   状態遷移の記録（直近 FLIGHT_REC_NUM 件、異常時にファイルへ書出す）
+//
+//   ディスパッチループだけが書込むリングバッファ。
+//   書込み中の記録は通し番号で見分けて書出しから外すので、ロックは使わない。
+//   書出しはシグナルハンドラからも呼ぶので、async-signal-safe な関数だけを使う。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pws_flight.h"
+#include "pws_power.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+// 状態の監視周期（秒）
+#define FLIGHT_WATCH_SEC        (1)
+
+// シグナルハンドラ用のスタック（スタックあふれでも書出せるように）
+#define FLIGHT_ALTSTACK_SIZE    (64 * 1024)
+
+static FLIGHT_REC       FlightRing[FLIGHT_REC_NUM];
+static uint32_t         FlightSeq;                      // 最後に書込んだ通し番号
+
+// 書出し用
+static FLIGHT_REC       FlightOut[FLIGHT_REC_NUM];
+static FLIGHT_HEADER    FlightHdr;
+static char             FlightPath[256];
+static char             FlightTmpPath[260];
+static char **          FlightStateNames;
+static char **          FlightEventNames;
+static int              FlightStateNum;
+static int              FlightEventNum;
+static int              FlightDumping;                  // 書出し中（二重に書出さない）
+static uint8_t          FlightAltStack[FLIGHT_ALTSTACK_SIZE];
+
+// 状態の監視
+static int              FlightState;                    // 現在の状態
+static uint32_t         FlightEnterSeq;                 // 現在の状態に入った記録の通し番号
+static int              FlightStuckSec[FLIGHT_NAME_MAX];    // 0: 監視しない
+
+static pthread_t        threadFlightID;
+static pthread_mutex_t  threadFlightMutex  = PTHREAD_MUTEX_INITIALIZER;
+static int              threadFlightFinish = 0;
+static int              threadFlightStarted = 0;
+
+static void *threadFlightWatch(void *arg);
+static void flightSigHandler(int sig);
+static int flightWriteAll(int fd, const void *buf, size_t len);
+
+//
+// 初期化
+//
+int flightInitialize(const char *path, char **stateNames, int stateNum, char **eventNames, int eventNum)
+{
+    struct sigaction sa;
+    stack_t ss;
+    int sigs[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+    int i;
+
+    snprintf(FlightPath   , sizeof(FlightPath)   , "%s", path);
+    snprintf(FlightTmpPath, sizeof(FlightTmpPath), "%s.tmp", path);
+    FlightStateNames = stateNames;
+    FlightEventNames = eventNames;
+    FlightStateNum   = (stateNum < FLIGHT_NAME_MAX) ? stateNum : FLIGHT_NAME_MAX;
+    FlightEventNum   = (eventNum < FLIGHT_NAME_MAX) ? eventNum : FLIGHT_NAME_MAX;
+
+    // 異常終了時に書出す（１回だけ、その後は既定の動作でコアを残す）
+    ss.ss_sp    = FlightAltStack;
+    ss.ss_size  = sizeof(FlightAltStack);
+    ss.ss_flags = 0;
+    sigaltstack(&ss, NULL);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = flightSigHandler;
+    sa.sa_flags   = SA_RESETHAND | SA_ONSTACK;
+    sigemptyset(&sa.sa_mask);
+    for (i = 0; i < (int)(sizeof(sigs) / sizeof(sigs[0])); i++) {
+        sigaction(sigs[i], &sa, NULL);
+    }
+
+    // 状態の監視スレッド
+    if (pthread_create(&threadFlightID, NULL, threadFlightWatch, NULL) == 0) {
+        threadFlightStarted = 1;
+    }
+
+    PWS_DEBUG("flightInitialize %s\n", FlightPath);
+
+    return 0;
+}
+
+//
+// 終了処理
+//
+void flightFinish(void)
+{
+    if (!threadFlightStarted) {
+        return;
+    }
+
+    pthread_mutex_lock(&threadFlightMutex);
+    threadFlightFinish = 1;
+    pthread_mutex_unlock(&threadFlightMutex);
+
+    pthread_join(threadFlightID, NULL);
+    threadFlightStarted = 0;
+}
+
+//
+// 状態遷移の記録
+//
+void flightRecord(uint64_t time, int state, int next, int event, const char *addr, int ret, uint32_t elapsed)
+{
+    uint32_t seq = FlightSeq + 1;
+    FLIGHT_REC *rec = &FlightRing[seq & (FLIGHT_REC_NUM - 1)];
+
+    // 書込み中は通し番号を 0 にしておく（書出し側で読み飛ばす）
+    //   0 の書込みを内容の書換えより先に見せる
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    rec->time     = time;
+    rec->ret      = ret;
+    rec->elapsed  = elapsed;
+    rec->state    = (int16_t)state;
+    rec->next     = (int16_t)next;
+    rec->event    = (int16_t)event;
+    rec->reserved = 0;
+    strncpy(rec->addr, (addr != NULL) ? addr : "", FLIGHT_ADDR_LEN - 1);
+    rec->addr[FLIGHT_ADDR_LEN - 1] = '\0';
+    __atomic_store_n(&rec->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&FlightSeq, seq, __ATOMIC_RELEASE);
+
+    // 状態が変わったら監視をやり直す
+    if (next != state || seq == 1) {
+        __atomic_store_n(&FlightState, next, __ATOMIC_RELAXED);
+        __atomic_store_n(&FlightEnterSeq, seq, __ATOMIC_RELEASE);
+    }
+}
+
+//
+// 長時間留まったら異常とみなす状態の登録
+//
+int flightSetStuck(int state, int sec)
+{
+    if (state < 0 || state >= FLIGHT_NAME_MAX) {
+        return -1;
+    }
+    FlightStuckSec[state] = sec;
+
+    return 0;
+}
+
+//
+// ファイルへ書出す
+//   戻り値: 書出した記録数、-1: 失敗
+//
+int flightDump(int cause, int sig)
+{
+    struct timespec mono, real;
+    uint32_t last, seq, s, n = 0;
+    size_t len;
+    int fd, i, ret = -1;
+    FLIGHT_REC *rec;
+
+    if (__atomic_exchange_n(&FlightDumping, 1, __ATOMIC_ACQUIRE) != 0) {
+        return -1;
+    }
+
+    // 古い順に並べる（書込み中・上書き済みの記録は外す）
+    last = __atomic_load_n(&FlightSeq, __ATOMIC_ACQUIRE);
+    s = (last > FLIGHT_REC_NUM) ? last - FLIGHT_REC_NUM + 1 : 1;
+    for (seq = s; seq != last + 1 && last != 0; seq++) {
+        rec = &FlightRing[seq & (FLIGHT_REC_NUM - 1)];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+        }
+        memcpy(&FlightOut[n], rec, sizeof(FLIGHT_REC));
+        // 写している間に書換えが始まっていたら（通し番号が変わっていたら）外す
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) == seq) {
+            FlightOut[n].seq = seq;
+            n++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME , &real);
+
+    memset(&FlightHdr, 0, sizeof(FlightHdr));
+    FlightHdr.magic    = FLIGHT_MAGIC;
+    FlightHdr.version  = FLIGHT_VERSION;
+    FlightHdr.recSize  = sizeof(FLIGHT_REC);
+    FlightHdr.count    = n;
+    FlightHdr.cause    = cause;
+    FlightHdr.signal   = sig;
+    FlightHdr.state    = __atomic_load_n(&FlightState, __ATOMIC_RELAXED);
+    FlightHdr.monoNow  = (uint64_t)mono.tv_sec * 1000000 + mono.tv_nsec / 1000;
+    FlightHdr.realNow  = (uint64_t)real.tv_sec * 1000000 + real.tv_nsec / 1000;
+    FlightHdr.stateNum = FlightStateNum;
+    FlightHdr.eventNum = FlightEventNum;
+    for (i = 0; i < FlightStateNum; i++) {
+        FlightHdr.namesLen += strlen(FlightStateNames[i]) + 1;
+    }
+    for (i = 0; i < FlightEventNum; i++) {
+        FlightHdr.namesLen += strlen(FlightEventNames[i]) + 1;
+    }
+
+    // 途中で落ちても前回の書出し結果を壊さないように一時ファイルから置き換える
+    fd = open(FlightTmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        ret = 0;
+        if (flightWriteAll(fd, &FlightHdr, sizeof(FlightHdr)) < 0 ||
+            flightWriteAll(fd, FlightOut, n * sizeof(FLIGHT_REC)) < 0)
+        {
+            ret = -1;
+        }
+        for (i = 0; ret == 0 && i < FlightStateNum; i++) {
+            len = strlen(FlightStateNames[i]) + 1;
+            ret = flightWriteAll(fd, FlightStateNames[i], len);
+        }
+        for (i = 0; ret == 0 && i < FlightEventNum; i++) {
+            len = strlen(FlightEventNames[i]) + 1;
+            ret = flightWriteAll(fd, FlightEventNames[i], len);
+        }
+        close(fd);
+        if (ret == 0 && rename(FlightTmpPath, FlightPath) == 0) {
+            ret = (int)n;
+        }
+        else {
+            unlink(FlightTmpPath);
+            ret = -1;
+        }
+    }
+
+    __atomic_store_n(&FlightDumping, 0, __ATOMIC_RELEASE);
+
+    return ret;
+}
+
+// 状態の監視スレッド（登録した状態に長時間留まったら１回書出す）
+static void *threadFlightWatch(void *arg)
+{
+    int loop, state, stuck, dumped = 0;
+    uint32_t enter, watchSeq = 0, waited = 0;
+    struct timespec ts;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    ts.tv_sec  = FLIGHT_WATCH_SEC;
+    ts.tv_nsec = 0;
+
+    loop = 1;
+    while (loop) {
+        pwrSleep(&ts);
+
+        enter = __atomic_load_n(&FlightEnterSeq, __ATOMIC_ACQUIRE);
+        state = __atomic_load_n(&FlightState, __ATOMIC_RELAXED);
+        if (enter != watchSeq) {
+            watchSeq = enter;
+            waited   = 0;
+            dumped   = 0;
+        }
+        waited += FLIGHT_WATCH_SEC;
+
+        stuck = (state >= 0 && state < FLIGHT_NAME_MAX) ? FlightStuckSec[state] : 0;
+        if (stuck > 0 && !dumped && waited >= (uint32_t)stuck) {
+            PWS_DEBUG("flight: stuck in state %d for %u sec\n", state, waited);
+            flightDump(FLIGHT_CAUSE_STUCK, 0);
+            dumped = 1;
+        }
+
+        pthread_mutex_lock(&threadFlightMutex);
+        if (threadFlightFinish == 1) {
+            loop = 0;
+        }
+        pthread_mutex_unlock(&threadFlightMutex);
+    }
+
+    return (void *)NULL;
+}
+
+// 異常終了時の書出し
+static void flightSigHandler(int sig)
+{
+    flightDump(FLIGHT_CAUSE_SIGNAL, sig);
+
+    // SA_RESETHAND で既定の動作に戻っているので、もう一度発生させて終了する
+    raise(sig);
+}
+
+// 全て書込む（シグナルで中断されても続ける）
+static int flightWriteAll(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p   += n;
+        len -= n;
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////
+// pws_flight.h
+//   状態遷移の記録（直近 FLIGHT_REC_NUM 件、異常時にファイルへ書出す）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_FLIGHT_H__
+#define __PWS_FLIGHT_H__
+
+#include <stdint.h>
+
+// 記録する件数（2 のべき乗）
+#define FLIGHT_REC_NUM          (256)
+
+// 記録する OSC アドレスの長さ（終端文字を含む、長いものは切詰める）
+#define FLIGHT_ADDR_LEN         (36)
+
+// 書出しファイルの識別子とバージョン
+#define FLIGHT_MAGIC            (0x46535750)    // "PWSF"
+#define FLIGHT_VERSION          (1)
+
+// 状態・イベント名の最大数
+#define FLIGHT_NAME_MAX         (64)
+
+// 書出しの要因
+#define FLIGHT_CAUSE_REQUEST    (0)             // OSC での要求
+#define FLIGHT_CAUSE_STUCK      (1)             // 状態が長時間変わらない
+#define FLIGHT_CAUSE_SIGNAL     (2)             // SIGSEGV / SIGABRT など
+
+//
+// １件分の記録（64 バイト）
+//
+typedef struct {
+    uint64_t    time;                       // 受信時刻（CLOCK_MONOTONIC、マイクロ秒）
+    uint32_t    seq;                        // 通し番号（1 から）
+    int32_t     ret;                        // アクション関数の戻り値
+    uint32_t    elapsed;                    // アクション関数の処理時間（マイクロ秒）
+    int16_t     state;                      // 遷移前の状態
+    int16_t     next;                       // 遷移後の状態
+    int16_t     event;                      // イベント（-1: 該当なし）
+    int16_t     reserved;
+    char        addr[FLIGHT_ADDR_LEN];      // OSC アドレス
+} FLIGHT_REC;
+
+//
+// 書出しファイルのヘッダ
+//   ヘッダ → 記録（古い順、count 件） → 状態名 → イベント名（各 '\0' 区切り）
+//
+typedef struct {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    recSize;                    // sizeof(FLIGHT_REC)
+    uint32_t    count;                      // 記録数
+    int32_t     cause;                      // 書出しの要因（シグナルのときはシグナル番号を signal に）
+    int32_t     signal;
+    int32_t     state;                      // 書出し時の状態
+    uint64_t    monoNow;                    // 書出し時刻（CLOCK_MONOTONIC、マイクロ秒）
+    uint64_t    realNow;                    // 書出し時刻（CLOCK_REALTIME、マイクロ秒）
+    uint16_t    stateNum;                   // 状態名の数
+    uint16_t    eventNum;                   // イベント名の数
+    uint32_t    namesLen;                   // 状態名・イベント名の合計バイト数
+} FLIGHT_HEADER;
+
+//
+// 初期化（状態名・イベント名を登録、異常終了時の書出しを設定）
+//
+extern int flightInitialize(const char *path, char **stateNames, int stateNum, char **eventNames, int eventNum);
+
+//
+// 終了処理
+//
+extern void flightFinish(void);
+
+//
+// 状態遷移の記録（ディスパッチループからのみ呼ぶ）
+//
+extern void flightRecord(uint64_t time, int state, int next, int event, const char *addr, int ret, uint32_t elapsed);
+
+//
+// 長時間留まったら異常とみなす状態の登録（sec 秒）
+//
+extern int flightSetStuck(int state, int sec);
+
+//
+// ファイルへ書出す（シグナルハンドラからも呼べる）
+//
+extern int flightDump(int cause, int sig);
+
+#endif // __PWS_FLIGHT_H__
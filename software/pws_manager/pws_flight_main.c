@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////
+// pws_flight_main.c
+//   状態遷移の記録の表示
+//
+//   pws_flight [file]   （省略時は PWS_FLIGHT_FILE）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "def.h"
+#include "pws_flight.h"
+
+static const char *CAUSE_NAME[] = {
+    "OSC request",
+    "stuck state",
+    "signal",
+};
+
+// 番号から名前（無ければ番号のまま）
+static const char *flightName(char **names, int num, int idx, char *buf, int len)
+{
+    if (idx >= 0 && idx < num) {
+        return names[idx];
+    }
+    snprintf(buf, len, "(%d)", idx);
+    return buf;
+}
+
+// 単調増加時刻 → 日時文字列
+static void flightTime(const FLIGHT_HEADER *hdr, uint64_t mono, char *buf, int len)
+{
+    uint64_t real = hdr->realNow - (hdr->monoNow - mono);
+    time_t sec = (time_t)(real / 1000000);
+    struct tm tm;
+
+    localtime_r(&sec, &tm);
+    snprintf(buf, len, "%02d-%02d %02d:%02d:%02d.%03u", tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned)(real % 1000000) / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = (argc > 1) ? argv[1] : PWS_FLIGHT_FILE;
+    FLIGHT_HEADER hdr;
+    FLIGHT_REC *rec = NULL;
+    char *names = NULL, *p;
+    char *stateNames[FLIGHT_NAME_MAX], *eventNames[FLIGHT_NAME_MAX];
+    char when[32], b1[16], b2[16], b3[16];
+    uint32_t i;
+    uint64_t prev = 0;
+    FILE *fp;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != FLIGHT_MAGIC) {
+        fprintf(stderr, "%s: not a flight record\n", path);
+        fclose(fp);
+        return 1;
+    }
+    if (hdr.version != FLIGHT_VERSION || hdr.recSize != sizeof(FLIGHT_REC) ||
+        hdr.count > FLIGHT_REC_NUM || hdr.stateNum > FLIGHT_NAME_MAX || hdr.eventNum > FLIGHT_NAME_MAX)
+    {
+        fprintf(stderr, "%s: unsupported version %u (record %u bytes)\n", path, hdr.version, hdr.recSize);
+        fclose(fp);
+        return 1;
+    }
+
+    rec   = calloc(hdr.count + 1, sizeof(FLIGHT_REC));
+    names = calloc(hdr.namesLen + 1, 1);
+    if (rec == NULL || names == NULL ||
+        fread(rec, sizeof(FLIGHT_REC), hdr.count, fp) != hdr.count ||
+        fread(names, 1, hdr.namesLen, fp) != hdr.namesLen)
+    {
+        fprintf(stderr, "%s: truncated\n", path);
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+
+    // 名前の表（'\0' 区切り）
+    p = names;
+    for (i = 0; i < hdr.stateNum; i++) {
+        stateNames[i] = p;
+        p += strlen(p) + 1;
+    }
+    for (i = 0; i < hdr.eventNum; i++) {
+        eventNames[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    flightTime(&hdr, hdr.monoNow, when, sizeof(when));
+    printf("%s: %u records, dumped %s by %s", path, hdr.count, when,
+           (hdr.cause >= 0 && hdr.cause <= FLIGHT_CAUSE_SIGNAL) ? CAUSE_NAME[hdr.cause] : "?");
+    if (hdr.cause == FLIGHT_CAUSE_SIGNAL) {
+        printf(" %d (%s)", hdr.signal, strsignal(hdr.signal));
+    }
+    printf(", state %s\n\n", flightName(stateNames, hdr.stateNum, hdr.state, b1, sizeof(b1)));
+
+    printf("%-18s %9s %6s  %-24s %-24s %5s %8s  %s\n",
+           "time", "+ms", "seq", "state", "event", "ret", "us", "address");
+    for (i = 0; i < hdr.count; i++) {
+        flightTime(&hdr, rec[i].time, when, sizeof(when));
+        printf("%-18s %9.1f %6u  %-24s %-24s %5d %8u  %s\n",
+               when, (i > 0) ? (rec[i].time - prev) / 1000.0 : 0.0, rec[i].seq,
+               flightName(stateNames, hdr.stateNum, rec[i].state, b1, sizeof(b1)),
+               (rec[i].event >= 0) ? flightName(eventNames, hdr.eventNum, rec[i].event, b2, sizeof(b2)) : "-",
+               rec[i].ret, rec[i].elapsed, rec[i].addr);
+        if (rec[i].next != rec[i].state) {
+            printf("%-18s %9s %6s  -> %s\n", "", "", "",
+                   flightName(stateNames, hdr.stateNum, rec[i].next, b3, sizeof(b3)));
+        }
+        prev = rec[i].time;
+    }
+    if (hdr.count > 0) {
+        printf("\n%.1f sec since the last record\n", (hdr.monoNow - rec[hdr.count - 1].time) / 1e6);
+    }
+
+    free(names);
+    free(rec);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////
+// pws_fx.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pws_fx.h"
+#include "pws_debug.h"
+
+// プリセットごとの経路（Normal／Distortion／Reverb の spigot~）
+#define FX_PATH_NORMAL          (0x01)
+#define FX_PATH_DISTORTION      (0x02)
+#define FX_PATH_REVERB          (0x04)
+
+static const int FX_PATH[FX_PRESET_NUM] = {
+    FX_PATH_NORMAL,                             // FX_PRESET_DRY
+    FX_PATH_NORMAL | FX_PATH_REVERB,            // FX_PRESET_REVERB
+    FX_PATH_NORMAL | FX_PATH_DISTORTION,        // FX_PRESET_DISTORTION
+    FX_PATH_DISTORTION | FX_PATH_REVERB,        // FX_PRESET_DIST_REVERB
+};
+
+//
+// エフェクトの初期化
+//
+int fxInit(FX_STATE *fx, int preset, uint32_t rate, int channels)
+{
+    memset(fx, 0, sizeof(FX_STATE));
+
+    if (preset < 0 || preset >= FX_PRESET_NUM || channels <= 0 || rate == 0) {
+        return -1;
+    }
+    fx->preset   = preset;
+    fx->channels = channels;
+
+    if (FX_PATH[preset] & FX_PATH_REVERB) {
+        fx->delayFrames = (uint32_t)((uint64_t)rate * FX_REVERB_MSEC / 1000);
+        fx->delay = (float *)calloc((size_t)fx->delayFrames * channels, sizeof(float));
+        if (fx->delay == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// エフェクトの解放
+//
+void fxFree(FX_STATE *fx)
+{
+    free(fx->delay);
+    fx->delay = NULL;
+}
+
+//
+// 状態のクリア
+//
+void fxReset(FX_STATE *fx)
+{
+    if (fx->delay != NULL) {
+        memset(fx->delay, 0, (size_t)fx->delayFrames * fx->channels * sizeof(float));
+    }
+    fx->pos = 0;
+}
+
+//
+// 先行して流す長さ
+//
+uint32_t fxWarmupFrames(const FX_STATE *fx)
+{
+    return (fx->delay != NULL) ? fx->delayFrames * FX_REVERB_TAIL_LOOPS : 0;
+}
+
+//
+// インターリーブのフレームを処理
+//   out = Normal(x) + Distortion(clip(x)) + Reverb(x + d)
+//   遅延線には x + 0.5 * d を書く（delwrite~ の前の +~）
+//
+void fxProcess(FX_STATE *fx, float *buf, int frames)
+{
+    int i, c, ch = fx->channels, path = FX_PATH[fx->preset];
+    float x, y, d, *dl;
+
+    for (i = 0; i < frames; i++, buf += ch) {
+        dl = (fx->delay != NULL) ? fx->delay + (size_t)fx->pos * ch : NULL;
+        for (c = 0; c < ch; c++) {
+            x = buf[c];
+            y = 0.0f;
+            if (path & FX_PATH_NORMAL) {
+                y += x;
+            }
+            if (path & FX_PATH_DISTORTION) {
+                y += (x > FX_CLIP_LEVEL) ? FX_CLIP_LEVEL : (x < -FX_CLIP_LEVEL) ? -FX_CLIP_LEVEL : x;
+            }
+            if (dl != NULL) {
+                d = dl[c];
+                y += x + d;
+                dl[c] = x + FX_REVERB_FEEDBACK * d;
+            }
+            buf[c] = y;
+        }
+        if (dl != NULL && ++fx->pos >= fx->delayFrames) {
+            fx->pos = 0;
+        }
+    }
+}
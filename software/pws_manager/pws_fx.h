@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////
+// pws_fx.h
+//   Effect_Controller.pd と同じエフェクト（オフライン処理用）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_FX_H__
+#define __PWS_FX_H__
+
+#include <stdint.h>
+
+//
+// プリセット（Effect_Controller.pd のカウンター値と合わせること）
+//
+#define FX_PRESET_DRY           (0)     // エフェクトなし
+#define FX_PRESET_REVERB        (1)     // Normal + Reverb
+#define FX_PRESET_DISTORTION    (2)     // Normal + Distortion
+#define FX_PRESET_DIST_REVERB   (3)     // Distortion + Reverb
+#define FX_PRESET_NUM           (4)
+
+// Distortion（clip~ -0.7 0.7）
+#define FX_CLIP_LEVEL           (0.7f)
+
+// Reverb（delread~ delay1 120、帰還 *~ 0.5）
+#define FX_REVERB_MSEC          (120)
+#define FX_REVERB_FEEDBACK      (0.5f)
+
+// 帰還が 16bit の分解能以下に減衰するまでの周回数
+#define FX_REVERB_TAIL_LOOPS    (16)
+
+//
+// エフェクトの状態
+//
+typedef struct {
+    int         preset;                 // プリセット
+    int         channels;               // チャンネル数
+    uint32_t    delayFrames;            // 遅延線の長さ（フレーム数）
+    uint32_t    pos;                    // 遅延線の書込み位置
+    float *     delay;                  // 遅延線（インターリーブ）
+} FX_STATE;
+
+//
+// エフェクトの初期化／解放
+//
+extern int fxInit(FX_STATE *fx, int preset, uint32_t rate, int channels);
+extern void fxFree(FX_STATE *fx);
+
+//
+// 状態のクリア（遅延線を無音にする）
+//
+extern void fxReset(FX_STATE *fx);
+
+//
+// 途中から処理するときに先行して流す長さ（フレーム数、状態を持たなければ 0）
+//
+extern uint32_t fxWarmupFrames(const FX_STATE *fx);
+
+//
+// インターリーブのフレームを処理（その場で書換え）
+//
+extern void fxProcess(FX_STATE *fx, float *buf, int frames);
+
+#endif // __PWS_FX_H__
@@ -19,16 +19,18 @@
 #include "pws_btn.h"
 #include "pws_led.h"
 #include "pws_manager.h"
+#include "pws_boot.h"
 #include "pws_debug.h"
 
-static int gpioSendMessageToManager(char *msg);
+static int gpioSendMessageToManager(const OSC_WIRE *wire);
 
 //
 // GPIO初期化
 //
 int gpioInitialize(void)
 {
-    // wiringPi 初期化
+    // wiringPi 初期化（割込みの登録に失敗しても終了させずに -1 を返させる）
+    setenv("WIRINGPI_CODES", "1", 1);
     if (wiringPiSetup() == -1){
         PWS_DEBUG("ERROR: wiringPiSetup\n");
         return -1;
@@ -54,12 +56,17 @@ int gpioInitialize(void)
     pullUpDnControl(PIN_BTN_5, PUD_UP);
     pullUpDnControl(PIN_BTN_6, PUD_UP);
     pullUpDnControl(PIN_BTN_7, PUD_UP);
+    bootMark(BOOT_GPIO);
 
     // ボタン初期化（スレッド作成）
     btnInitialize();
+    bootMark(BOOT_BUTTON);
 
-    // LED 初期化（スレッド作成）
-    ledInitialize();
+    // LED 初期化（スレッド作成、受信できなくてもボタンは使えるので続ける）
+    if (ledInitialize() < 0) {
+        PWS_DEBUG("ERROR: ledInitialize\n");
+    }
+    bootMark(BOOT_LED);
 
     return 0;
 }
@@ -71,9 +78,9 @@ void gpioCheckApMode(void)
     int bootBtn3 = digitalRead(PIN_BTN_3);
 
     if (bootBtn1 == PIN_VAL_ON && bootBtn3 == PIN_VAL_OFF)
-        gpioSendMessageToManager(MSG_PUSH_AP_SET_BTN);
+        gpioSendMessageToManager(&OSC_WIRE(MSG_PUSH_AP_SET_BTN));
     else
-        gpioSendMessageToManager(MSG_INITIALIZE);
+        gpioSendMessageToManager(&OSC_WIRE(MSG_INITIALIZE));
 }
 
 // GPIO読込み
@@ -96,21 +103,10 @@ void gpioFinish(void)
 }
 
 // マネージャーにメッセージを送信
-static int gpioSendMessageToManager(char *msg)
+static int gpioSendMessageToManager(const OSC_WIRE *wire)
 {
-    int n, ret, sock, len;
-    uint8_t sendBuf[SEND_BUF_SIZE];
+    int n, sock;
     struct sockaddr_in addr;
-    OSC_MESSAGE oscMsg;
-
-    memset(&oscMsg, 0, sizeof(oscMsg));
-    
-    oscMsg.addr = msg;
-    oscMsg.num  = 0;
-    ret = oscEncode(&oscMsg, (uint8_t *)sendBuf, &len);
-    if (ret < 0) {
-        return -1;
-    }
 
     sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock == -1) {
@@ -122,7 +118,7 @@ static int gpioSendMessageToManager(char *msg)
     addr.sin_family      = AF_INET;
     addr.sin_addr.s_addr = inet_addr("127.0.0.1");
     addr.sin_port        = htons(PWS_PORT_MANAGER);
-    n = sendto(sock, sendBuf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    n = sendto(sock, wire->data, wire->size, 0, (struct sockaddr *)&addr, sizeof(addr));
     if (n == -1) {
         PWS_DEBUG("ERROR: sendto\n");
         return -1;
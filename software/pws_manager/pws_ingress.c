@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////
+// pws_ingress.c
+//   マネージャーの受信キュー（優先度クラス別）
+//
+//   ソケットに溜まったメッセージを recvmmsg でまとめて読み出し、
+//   クラスごとのキューへ振り分けてから優先度の高いものを返す。
+//   チューナーや入力レベルの状態通知が大量に届いてもボタン操作を先に処理する。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "def.h"
+#include "pws_ingress.h"
+#include "pws_stats.h"
+#include "pws_debug.h"
+
+// ユーザー操作として扱うアドレスの接頭辞
+static const char *INGRESS_USER_PREFIX[] = {
+    "/btnmonitor/",                     // ボタン押下
+    "/system/",                         // システム要求
+    NULL,
+};
+
+// 状態通知として扱うアドレス
+static const char *INGRESS_TELEMETRY_ADDR[] = {
+    MSG_TUNING_COND,                    // チューニング状態通知
+    MSG_METER,                          // 入力レベル通知
+    NULL,
+};
+
+// 受信バッファの数（キューと状態通知が満杯でも１回分の recvmmsg を受けられる数）
+#define INGRESS_SLAB_NUM    ((INGRESS_CLASS_NUM - 1) * INGRESS_QUEUE_LEN + INGRESS_TELEMETRY_SLOTS + INGRESS_BATCH + 1)
+
+//
+// キュー（受信バッファ番号のリングバッファ）
+//
+typedef struct {
+    int             idx[INGRESS_QUEUE_LEN];
+    int             head;
+    int             num;
+} INGRESS_QUEUE;
+
+//
+// 状態通知の保持（送信元ごとに最新値のみ）
+//
+typedef struct {
+    int             idx;                // 受信バッファ番号（-1: 未使用）
+    uint32_t        seq;                // 到着順（最初に届いた時点）
+} INGRESS_SLOT;
+
+static int              IngressSock = -1;
+static INGRESS_QUEUE    IngressQueue[INGRESS_CLASS_NUM - 1];    // ユーザー操作、モジュール
+static INGRESS_SLOT     IngressSlot[INGRESS_TELEMETRY_SLOTS];   // 状態通知
+static uint32_t         IngressSeq;
+static INGRESS_STATS    IngressStats[INGRESS_CLASS_NUM];
+
+// 受信バッファ（起動時に確保したものを使い回す、受信したままの位置でデコードする）
+static INGRESS_PACKET   IngressSlab[INGRESS_SLAB_NUM];
+static int              IngressFree[INGRESS_SLAB_NUM];
+static int              IngressFreeNum;
+static int              IngressCur = -1;                        // 取出し中の受信バッファ
+static int              IngressQueued;                          // キューと状態通知に残っている数
+static int              IngressSincePoll;                       // ソケットを確認してからの取出し数
+
+// recvmmsg の受信領域
+static struct mmsghdr   IngressMsg[INGRESS_BATCH];
+static struct iovec     IngressIov[INGRESS_BATCH];
+static int              IngressRxIdx[INGRESS_BATCH];
+
+static int ingressRecvBatch(int flags);
+static int ingressClassify(const INGRESS_PACKET *pkt);
+static void ingressPush(int cls, int idx);
+static void ingressPushTelemetry(int idx);
+static int ingressPop(void);
+
+//
+// 受信キューの初期化
+//
+int ingressInitialize(int sock)
+{
+    int i;
+
+    IngressSock = sock;
+    IngressSeq  = 0;
+    IngressCur  = -1;
+    IngressQueued    = 0;
+    IngressSincePoll = 0;
+    memset(IngressQueue, 0, sizeof(IngressQueue));
+    memset(IngressStats, 0, sizeof(IngressStats));
+    for (i = 0; i < INGRESS_TELEMETRY_SLOTS; i++) {
+        IngressSlot[i].idx = -1;
+    }
+    for (i = 0; i < INGRESS_SLAB_NUM; i++) {
+        IngressFree[i] = i;
+    }
+    IngressFreeNum = INGRESS_SLAB_NUM;
+
+    return 0;
+}
+
+//
+// 優先度の高いものから１件取出す
+//
+int ingressReceive(INGRESS_PACKET **pkt)
+{
+    int n, flags, total = 0;
+
+    // 前回取出した受信バッファを戻す
+    if (IngressCur >= 0) {
+        IngressFree[IngressFreeNum++] = IngressCur;
+        IngressCur = -1;
+    }
+
+    // キューに残っている間は INGRESS_POLL_INTERVAL 件ごとにソケットを確認する
+    //   （１件ごとに確認すると受信が無くてもシステムコールが増える）
+    if (IngressQueued > 0 && ++IngressSincePoll < INGRESS_POLL_INTERVAL) {
+        IngressCur = ingressPop();
+        *pkt = &IngressSlab[IngressCur];
+        return (*pkt)->cls;
+    }
+    IngressSincePoll = 0;
+
+    // ソケットに溜まっている分を読み出してから優先度順に選ぶ
+    //   キューが空なら最初の１件が届くまで待つ（届いた時点で溜まっている分も一緒に読む）
+    //   読み出す数に上限を設けて、ボタン操作の処理が遅れる時間を抑える
+    //   受信したものが全て捨てられたら（通常は起きない）待ち直す
+    while (IngressCur < 0) {
+        total = 0;
+        while (total < INGRESS_DRAIN_MAX) {
+            flags = (IngressQueued == 0) ? MSG_WAITFORONE : MSG_DONTWAIT;
+            n = ingressRecvBatch(flags);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (IngressQueued == 0) {
+                    return -1;
+                }
+                break;
+            }
+            total += n;
+            if (n < INGRESS_BATCH) {
+                break;
+            }
+        }
+
+        IngressCur = ingressPop();
+    }
+
+    *pkt = &IngressSlab[IngressCur];
+    return (*pkt)->cls;
+}
+
+//
+// クラスごとの統計の取得
+//
+int ingressGetStats(int cls, INGRESS_STATS *stats)
+{
+    if (cls < 0 || cls >= INGRESS_CLASS_NUM) {
+        return -1;
+    }
+    memcpy(stats, &IngressStats[cls], sizeof(INGRESS_STATS));
+
+    return 0;
+}
+
+//
+// ユーザー操作のアドレスか
+//
+int ingressIsUser(const char *addr)
+{
+    int i;
+
+    for (i = 0; INGRESS_USER_PREFIX[i] != NULL; i++) {
+        if (strncmp(addr, INGRESS_USER_PREFIX[i], strlen(INGRESS_USER_PREFIX[i])) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//
+// まとめて受信してキューへ振り分ける
+//   戻り値: 受信数、-1: エラー（EAGAIN は 0）
+//
+static int ingressRecvBatch(int flags)
+{
+    int i, n, idx;
+    uint32_t at;
+
+    // 空いている受信バッファへ直接受信する
+    for (i = 0; i < INGRESS_BATCH; i++) {
+        idx = IngressFree[--IngressFreeNum];
+        IngressRxIdx[i] = idx;
+        IngressIov[i].iov_base = IngressSlab[idx].buf;
+        IngressIov[i].iov_len  = sizeof(IngressSlab[idx].buf) - 1;
+        IngressMsg[i].msg_hdr.msg_iov     = &IngressIov[i];
+        IngressMsg[i].msg_hdr.msg_iovlen  = 1;
+        IngressMsg[i].msg_hdr.msg_name    = &IngressSlab[idx].from;
+        IngressMsg[i].msg_hdr.msg_namelen = sizeof(IngressSlab[idx].from);
+    }
+
+    n = recvmmsg(IngressSock, IngressMsg, INGRESS_BATCH, flags, NULL);
+
+    for (i = (n < 0) ? 0 : n; i < INGRESS_BATCH; i++) {
+        IngressFree[IngressFreeNum++] = IngressRxIdx[i];
+    }
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        PWS_DEBUG("ERROR: recvmmsg %d\n", errno);
+        return -1;
+    }
+
+    at = statsNow();
+    for (i = 0; i < n; i++) {
+        idx = IngressRxIdx[i];
+        IngressSlab[idx].at  = at;
+        IngressSlab[idx].len = IngressMsg[i].msg_len;
+        IngressSlab[idx].buf[IngressSlab[idx].len] = '\0';
+        IngressSlab[idx].cls = ingressClassify(&IngressSlab[idx]);
+        ingressPush(IngressSlab[idx].cls, idx);
+    }
+
+    return n;
+}
+
+//
+// アドレスからクラスを判定
+//
+static int ingressClassify(const INGRESS_PACKET *pkt)
+{
+    int i;
+
+    if (ingressIsUser(pkt->buf)) {
+        return INGRESS_CLASS_USER;
+    }
+    for (i = 0; INGRESS_TELEMETRY_ADDR[i] != NULL; i++) {
+        if (strcmp(pkt->buf, INGRESS_TELEMETRY_ADDR[i]) == 0) {
+            return INGRESS_CLASS_TELEMETRY;
+        }
+    }
+
+    return INGRESS_CLASS_MODULE;
+}
+
+//
+// キューへ追加（あふれたら新しい方を捨てる）
+//
+static void ingressPush(int cls, int idx)
+{
+    INGRESS_QUEUE *q;
+    INGRESS_STATS *st = &IngressStats[cls];
+
+    st->received++;
+    if (cls == INGRESS_CLASS_TELEMETRY) {
+        ingressPushTelemetry(idx);
+        return;
+    }
+
+    q = &IngressQueue[cls];
+    if (q->num >= INGRESS_QUEUE_LEN) {
+        st->dropped++;
+        IngressFree[IngressFreeNum++] = idx;
+        return;
+    }
+    q->idx[(q->head + q->num) % INGRESS_QUEUE_LEN] = idx;
+    q->num++;
+    IngressQueued++;
+
+    st->depth = q->num;
+    if (st->depth > st->maxDepth) {
+        st->maxDepth = st->depth;
+    }
+}
+
+//
+// 状態通知の保持（同じアドレス・送信元の古い値は置き換える）
+//
+static void ingressPushTelemetry(int idx)
+{
+    int i, empty = -1;
+    INGRESS_SLOT *slot;
+    INGRESS_PACKET *old, *pkt = &IngressSlab[idx];
+    INGRESS_STATS *st = &IngressStats[INGRESS_CLASS_TELEMETRY];
+
+    for (i = 0; i < INGRESS_TELEMETRY_SLOTS; i++) {
+        slot = &IngressSlot[i];
+        if (slot->idx < 0) {
+            if (empty < 0) {
+                empty = i;
+            }
+            continue;
+        }
+        old = &IngressSlab[slot->idx];
+        if (old->from.sin_addr.s_addr == pkt->from.sin_addr.s_addr &&
+            old->from.sin_port == pkt->from.sin_port &&
+            strcmp(old->buf, pkt->buf) == 0)
+        {
+            // 到着順は最初の値のまま（置き換え続けても後回しにならない）
+            IngressFree[IngressFreeNum++] = slot->idx;
+            slot->idx = idx;
+            st->coalesced++;
+            return;
+        }
+    }
+    if (empty < 0) {
+        st->dropped++;
+        IngressFree[IngressFreeNum++] = idx;
+        return;
+    }
+
+    slot = &IngressSlot[empty];
+    slot->idx = idx;
+    slot->seq = IngressSeq++;
+    IngressQueued++;
+
+    st->depth++;
+    if (st->depth > st->maxDepth) {
+        st->maxDepth = st->depth;
+    }
+}
+
+//
+// 優先度の高いクラスから１件取出す
+//   戻り値: 受信バッファ番号、-1: 空
+//
+static int ingressPop(void)
+{
+    int cls, i, idx, oldest = -1;
+    INGRESS_QUEUE *q;
+    INGRESS_STATS *st;
+
+    for (cls = 0; cls < INGRESS_CLASS_TELEMETRY; cls++) {
+        q  = &IngressQueue[cls];
+        st = &IngressStats[cls];
+        if (q->num > 0) {
+            idx = q->idx[q->head];
+            q->head = (q->head + 1) % INGRESS_QUEUE_LEN;
+            q->num--;
+            IngressQueued--;
+            st->depth = q->num;
+            st->dispatched++;
+            return idx;
+        }
+    }
+
+    for (i = 0; i < INGRESS_TELEMETRY_SLOTS; i++) {
+        if (IngressSlot[i].idx >= 0 &&
+            (oldest < 0 || (int32_t)(IngressSlot[i].seq - IngressSlot[oldest].seq) < 0))
+        {
+            oldest = i;
+        }
+    }
+    if (oldest < 0) {
+        return -1;
+    }
+
+    st  = &IngressStats[INGRESS_CLASS_TELEMETRY];
+    idx = IngressSlot[oldest].idx;
+    IngressSlot[oldest].idx = -1;
+    IngressQueued--;
+    st->depth--;
+    st->dispatched++;
+
+    return idx;
+}
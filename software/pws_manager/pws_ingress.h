@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////
+// pws_ingress.h
+//   マネージャーの受信キュー（優先度クラス別）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_INGRESS_H__
+#define __PWS_INGRESS_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "def.h"
+
+//
+// 優先度クラス（小さいほど先に処理する）
+//
+#define INGRESS_CLASS_USER          (0)     // ユーザー操作（ボタン、システム要求）
+#define INGRESS_CLASS_MODULE        (1)     // モジュールの完了通知、問合せ
+#define INGRESS_CLASS_TELEMETRY     (2)     // 周期的な状態通知（送信元ごとに最新値だけ残す）
+#define INGRESS_CLASS_NUM           (3)
+
+// recvmmsg で一度に受信する数
+#define INGRESS_BATCH               (16)
+
+// １回の取出しで読み切る最大数（INGRESS_BATCH の倍数）
+#define INGRESS_DRAIN_MAX           (INGRESS_BATCH * 4)
+
+// キューに残りがあってもソケットを確認する間隔（取出し数）
+//   後から届いたボタン操作は最大でこの件数の処理の後に取出される
+#define INGRESS_POLL_INTERVAL       (8)
+
+// クラスごとのキューの長さ
+#define INGRESS_QUEUE_LEN           (32)
+
+// 状態通知を保持する数（アドレスと送信元の組ごとに１つ）
+#define INGRESS_TELEMETRY_SLOTS     (8)
+
+//
+// 受信したメッセージ
+//
+typedef struct {
+    char                buf[RECV_BUF_SIZE];     // OSCメッセージ（終端文字付き）
+    int                 len;                    // 長さ
+    int                 cls;                    // クラス
+    uint32_t            at;                     // 受信時刻（statsNow）
+    struct sockaddr_in  from;                   // 送信元
+} INGRESS_PACKET;
+
+//
+// クラスごとの統計
+//
+typedef struct {
+    uint32_t    received;               // 受信数
+    uint32_t    dispatched;             // 取出し数
+    uint32_t    dropped;                // キューがあふれて捨てた数
+    uint32_t    coalesced;              // 新しい値で置き換えた数（状態通知のみ）
+    uint32_t    depth;                  // キューに残っている数
+    uint32_t    maxDepth;               // キューの最大長
+} INGRESS_STATS;
+
+//
+// 受信キューの初期化（受信用ソケットを渡す）
+//
+extern int ingressInitialize(int sock);
+
+//
+// 優先度の高いものから１件取出す（無ければ受信まで待つ）
+//   *pkt は受信バッファそのもの（次に呼び出すまで有効）
+//   戻り値: クラス、-1: 受信エラー（ソケットが閉じられた）
+//
+extern int ingressReceive(INGRESS_PACKET **pkt);
+
+//
+// クラスごとの統計の取得
+//
+extern int ingressGetStats(int cls, INGRESS_STATS *stats);
+
+//
+// ユーザー操作（ボタン、システム要求）のアドレスか（1: ユーザー操作）
+//
+extern int ingressIsUser(const char *addr);
+
+#endif // __PWS_INGRESS_H__
@@ -0,0 +1,407 @@
+///////////////////////////////////////////////////////////
+// pws_latency.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "def.h"
+#include "pws_wav.h"
+#include "pws_osc.h"
+#include "pws_latency.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+// 測定用ファイルが閉じられるのを待つ周期／最大時間（ミリ秒）
+#define LAT_POLL_MSEC       (50)
+#define LAT_CLOSE_TIMEOUT   (3000)
+
+// バーストの検出しきい値
+#define LAT_BURST_LEVEL     (0.001f)
+
+// 測定結果（解析スレッドからも書換える）
+static LAT_INFO LatInfo = { -1, 0, 0.0f, 0, 1 };
+static pthread_mutex_t LatMutex     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t LatFileMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *threadLatMeasure(void *arg);
+static int latNotify(int code);
+static int latOpenFinalized(const char *path, int flags, WAV_INFO *info);
+static void latPutLE32(uint8_t *p, uint32_t v);
+
+//
+// レイテンシ管理の初期化
+//
+int latInitialize(void)
+{
+    FILE *fp;
+    LAT_INFO info;
+    unsigned int rate, measured;
+
+    fp = fopen(PWS_LATENCY_FILE, "r");
+    if (fp == NULL) {
+        PWS_DEBUG("latInitialize not calibrated\n");
+        return -1;
+    }
+
+    memset(&info, 0, sizeof(info));
+    if (fscanf(fp, "%d %u %f %u %d", &info.frames, &rate, &info.score, &measured, &info.align) != 5) {
+        PWS_DEBUG("ERROR: bad latency file\n");
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    info.rate     = rate;
+    info.measured = measured;
+    pthread_mutex_lock(&LatMutex);
+    memcpy(&LatInfo, &info, sizeof(LAT_INFO));
+    pthread_mutex_unlock(&LatMutex);
+
+    PWS_DEBUG("latInitialize %d frames @ %u Hz\n", info.frames, info.rate);
+
+    return 0;
+}
+
+//
+// 測定用ファイルからレイテンシを求める
+//
+int latMeasure(const char *path, LAT_INFO *info)
+{
+    int fd, i, k, start, len, maxLag, lag, best;
+    uint32_t bytes, frames;
+    uint8_t *buf;
+    float *val, *ref, *cap;
+    double c, er, ec, score, bestScore;
+    WAV_INFO wav;
+
+    fd = latOpenFinalized(path, O_RDONLY, &wav);
+    if (fd < 0) {
+        return -1;
+    }
+    if (wav.channels != 2) {
+        PWS_DEBUG("ERROR: calibration file must be stereo\n");
+        close(fd);
+        return -1;
+    }
+
+    bytes  = wavDataBytes(&wav);
+    frames = bytes / wav.align;
+    buf = malloc(bytes);
+    val = malloc(frames * 2 * sizeof(float));
+    if (buf == NULL || val == NULL || pread(fd, buf, bytes, wav.dataOfs) != (ssize_t)bytes ||
+        wavToFloat(&wav, buf, val, frames * 2) < 0)
+    {
+        free(buf);
+        free(val);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    free(buf);
+
+    // チャンネルごとに並べ直す
+    ref = malloc(frames * 2 * sizeof(float));
+    if (ref == NULL) {
+        free(val);
+        return -1;
+    }
+    cap = ref + frames;
+    for (i = 0; i < (int)frames; i++) {
+        ref[i] = val[i * 2];
+        cap[i] = val[i * 2 + 1];
+    }
+    free(val);
+
+    // 出力したバーストの位置
+    for (start = 0; start < (int)frames; start++) {
+        if (fabsf(ref[start]) > LAT_BURST_LEVEL) {
+            break;
+        }
+    }
+    len    = wav.rate * LAT_BURST_MSEC / 1000;
+    maxLag = wav.rate * LAT_MAX_MSEC / 1000;
+    if (start + len + maxLag > (int)frames) {
+        PWS_DEBUG("ERROR: calibration burst not found\n");
+        free(ref);
+        return -1;
+    }
+
+    // バーストと録った音の相互相関（録った側のエネルギーで正規化）
+    er = 0.0;
+    ec = 0.0;
+    for (k = 0; k < len; k++) {
+        er += (double)ref[start + k] * ref[start + k];
+        ec += (double)cap[start + k] * cap[start + k];
+    }
+    best      = -1;
+    bestScore = 0.0;
+    for (lag = 0; lag < maxLag; lag++) {
+        c = 0.0;
+        for (k = 0; k < len; k++) {
+            c += (double)ref[start + k] * cap[start + lag + k];
+        }
+        score = (er > 0.0 && ec > 0.0) ? fabs(c) / sqrt(er * ec) : 0.0;
+        if (score > bestScore) {
+            bestScore = score;
+            best      = lag;
+        }
+        // 窓をずらす
+        ec += (double)cap[start + lag + len] * cap[start + lag + len] - (double)cap[start + lag] * cap[start + lag];
+        if (ec < 0.0) {
+            ec = 0.0;
+        }
+    }
+    free(ref);
+
+    PWS_DEBUG("latMeasure lag=%d score=%.3f\n", best, bestScore);
+
+    if (best < 0 || bestScore < LAT_MIN_SCORE) {
+        return -1;
+    }
+
+    info->frames   = best;
+    info->rate     = wav.rate;
+    info->score    = (float)bestScore;
+    info->measured = (uint32_t)time(NULL);
+    pthread_mutex_lock(&LatMutex);
+    info->align    = LatInfo.align;
+    pthread_mutex_unlock(&LatMutex);
+
+    return 0;
+}
+
+//
+// 測定用ファイルの解析開始
+//
+int latMeasureStart(const char *path)
+{
+    char *copy;
+    pthread_t th;
+    pthread_attr_t attr;
+
+    if (path == NULL || (copy = strdup(path)) == NULL) {
+        return latNotify(-1);
+    }
+
+    // 終了は待たない（終わったらスレッドからマネージャーへ通知する）
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&th, &attr, threadLatMeasure, copy) != 0) {
+        PWS_DEBUG("ERROR: latency thread\n");
+        free(copy);
+        pthread_attr_destroy(&attr);
+        return latNotify(-1);
+    }
+    pthread_attr_destroy(&attr);
+
+    return 0;
+}
+
+//
+// 測定結果の取得
+//
+int latGet(LAT_INFO *info)
+{
+    pthread_mutex_lock(&LatMutex);
+    memcpy(info, &LatInfo, sizeof(LAT_INFO));
+    pthread_mutex_unlock(&LatMutex);
+
+    return (info->frames < 0) ? -1 : 0;
+}
+
+//
+// 測定結果の保存
+//
+int latSet(const LAT_INFO *info)
+{
+    int ret = 0;
+    FILE *fp;
+    char tmp[128];
+
+    pthread_mutex_lock(&LatMutex);
+    memcpy(&LatInfo, info, sizeof(LAT_INFO));
+    pthread_mutex_unlock(&LatMutex);
+
+    // 解析スレッドと補正設定が同じ一時ファイルに書かないように
+    pthread_mutex_lock(&LatFileMutex);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", PWS_LATENCY_FILE);
+    fp = fopen(tmp, "w");
+    if (fp == NULL) {
+        PWS_DEBUG("ERROR: fopen %s\n", tmp);
+        ret = -1;
+    }
+    else {
+        fprintf(fp, "%d %u %.3f %u %d\n", info->frames, info->rate, info->score, info->measured, info->align);
+        fclose(fp);
+        if (rename(tmp, PWS_LATENCY_FILE) < 0) {
+            PWS_DEBUG("ERROR: rename %s\n", tmp);
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&LatFileMutex);
+
+    return ret;
+}
+
+//
+// 自動補正の有効／無効
+//
+int latSetAlign(int align)
+{
+    LAT_INFO info;
+
+    latGet(&info);
+    info.align = (align != 0);
+
+    return latSet(&info);
+}
+
+//
+// 次の録音で補正するフレーム数
+//
+uint32_t latGetShift(void)
+{
+    LAT_INFO info;
+
+    latGet(&info);
+    if (info.frames <= 0 || info.align == 0) {
+        return 0;
+    }
+
+    return (uint32_t)info.frames;
+}
+
+//
+// 録音ファイルの先頭を切り詰める
+//
+int latAlignTake(const char *path, uint32_t frames)
+{
+    int fd;
+    uint32_t bytes;
+    uint8_t junk[8], data[8];
+    WAV_INFO wav;
+
+    fd = latOpenFinalized(path, O_RDWR, &wav);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // JUNK チャンクの中身が偶数長になるようにする（RIFF のパディング）
+    bytes = frames * wav.align;
+    if (bytes < 8) {
+        close(fd);
+        return 0;
+    }
+    if ((bytes - 8) & 1) {
+        bytes += wav.align;
+    }
+    if (bytes >= wav.dataSize) {
+        PWS_DEBUG("ERROR: take too short to align [%s]\n", path);
+        close(fd);
+        return -1;
+    }
+
+    // 新しい data チャンクのヘッダー（切り捨てる範囲に上書き）を先に書く
+    memcpy(data, "data", 4);
+    latPutLE32(data + 4, wav.dataSize - bytes);
+    memcpy(junk, "JUNK", 4);
+    latPutLE32(junk + 4, bytes - 8);
+    if (pwrite(fd, data, sizeof(data), wav.dataOfs + bytes - 8) != sizeof(data) ||
+        pwrite(fd, junk, sizeof(junk), wav.dataOfs - 8) != sizeof(junk))
+    {
+        PWS_DEBUG("ERROR: pwrite [%s]\n", path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    PWS_DEBUG("latAlignTake [%s] %u frames\n", path, bytes / wav.align);
+
+    return 0;
+}
+
+// 解析スレッド（arg: 測定用ファイルのパス名、終わったら解放する）
+static void *threadLatMeasure(void *arg)
+{
+    char *path = (char *)arg;
+    int ret = -1;
+    LAT_INFO info;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    if (latMeasure(path, &info) == 0) {
+        ret = latSet(&info);
+    }
+    free(path);
+
+    latNotify(ret);
+
+    return (void *)NULL;
+}
+
+// マネージャーへ解析終了を通知（マネージャー自身の受信ポートへ）
+static int latNotify(int code)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeI(&OSC_WIRE_I(MSG_CALIB_MEASURED), code, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
+
+// Pd がファイルを閉じる（ヘッダーが確定する）のを待って開く
+static int latOpenFinalized(const char *path, int flags, WAV_INFO *info)
+{
+    int fd, waited = 0;
+    struct timespec ts;
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = LAT_POLL_MSEC * 1000 * 1000;
+
+    if (path == NULL) {
+        return -1;
+    }
+    fd = open(path, flags);
+    if (fd < 0) {
+        PWS_DEBUG("ERROR: open %s\n", path);
+        return -1;
+    }
+
+    for (;;) {
+        if (wavReadHeader(fd, info) == 0 && wavIsFinalized(info)) {
+            return fd;
+        }
+        if (waited > LAT_CLOSE_TIMEOUT) {
+            break;
+        }
+        nanosleep(&ts, NULL);
+        waited += LAT_POLL_MSEC;
+    }
+
+    PWS_DEBUG("ERROR: not finalized [%s]\n", path);
+    close(fd);
+
+    return -1;
+}
+
+// 32bit リトルエンディアンで書込み
+static void latPutLE32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
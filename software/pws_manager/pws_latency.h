@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////
+// pws_latency.h
+///////////////////////////////////////////////////////////
+#ifndef __PWS_LATENCY_H__
+#define __PWS_LATENCY_H__
+
+#include <stdint.h>
+
+// 探索するレイテンシの最大値（ミリ秒）
+#define LAT_MAX_MSEC        (250)
+
+// 測定用バーストの長さ（ミリ秒、Calibrator.pd と合わせること）
+#define LAT_BURST_MSEC      (20)
+
+// 測定成功とみなす相関の強さ
+#define LAT_MIN_SCORE       (0.3f)
+
+//
+// レイテンシ測定結果
+//
+typedef struct {
+    int32_t     frames;                 // 往復レイテンシ（フレーム数、未測定は -1）
+    uint32_t    rate;                   // サンプリング周波数
+    float       score;                  // 相関の強さ（0.0 ～ 1.0）
+    uint32_t    measured;               // 測定日時（UNIX時間）
+    int32_t     align;                  // 録音ファイルを自動補正するか
+} LAT_INFO;
+
+//
+// レイテンシ管理の初期化（前回の測定結果を読込み）
+//
+extern int latInitialize(void);
+
+//
+// 測定用ファイルからレイテンシを求める
+//   1ch: Audio_Out へ出したバースト、2ch: Audio_In で録った音
+//
+extern int latMeasure(const char *path, LAT_INFO *info);
+
+//
+// 測定用ファイルの解析開始（解析スレッドで latMeasure と latSet を行う）
+//   終わったらマネージャーへ MSG_CALIB_MEASURED（0: 成功、-1: 失敗）を送る
+//   path が NULL なら解析せずに失敗を送る
+//
+extern int latMeasureStart(const char *path);
+
+//
+// 測定結果の取得／保存
+//
+extern int latGet(LAT_INFO *info);
+extern int latSet(const LAT_INFO *info);
+
+//
+// 自動補正の有効／無効
+//
+extern int latSetAlign(int align);
+
+//
+// 次の録音で補正するフレーム数（補正しない場合は 0）
+//
+extern uint32_t latGetShift(void);
+
+//
+// 録音ファイルの先頭を指定フレーム数だけ切り詰める
+//   data チャンクの前を JUNK チャンクにするだけなので、ファイルは書き直さない
+//   Pd がファイルを閉じるまで待つので、状態遷移のスレッドからは呼ばないこと
+//
+extern int latAlignTake(const char *path, uint32_t frames);
+
+#endif // __PWS_LATENCY_H__
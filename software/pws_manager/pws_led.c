@@ -2,7 +2,6 @@
 // pws_led.c
 ///////////////////////////////////////////////////////////
 
-#include <wiringPi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -17,6 +16,9 @@
 #include "pws_gpio.h"
 #include "pws_osc.h"
 #include "pws_led.h"
+#include "pws_trie.h"
+#include "pws_rt.h"
+#include "pws_power.h"
 #include "pws_debug.h"
 
 // LEDイベント
@@ -37,6 +39,7 @@ typedef enum {
     EVT_LED_BLINK_RED_GREEN    ,    // 赤緑 LED 交互点滅
     EVT_LED_BLINK_GREEN_YELLOW ,    // 緑黄 LED 交互点滅
     EVT_LED_BLINK_YELLOW_RED   ,    // 黄赤 LED 交互点滅
+    EVT_LED_RED_FLASH          ,    // 赤色 LED 一時点灯
     EVT_LED_FINISH             ,    // スレッド終了イベント
     EVT_LED_MAX                     // LEDイベント最大個数
 } LED_EVENT;
@@ -53,6 +56,9 @@ typedef enum {
 #define SEQ_LED_BLINK_ON    (1)
 #define SEQ_MAX             (20)
 
+// 一時点灯の長さ（制御周期 100 msec の回数）
+#define LED_FLASH_TICKS     (5)
+
 // LED オフ
 static const int SEQ_ALWAYS_OFF[SEQ_MAX] = {
     SEQ_LED_BLINK_OFF,
@@ -179,10 +185,11 @@ static struct {
     const int   pin;
     int         curLightUp;
     int *       seqLightUp;
+    int         flash;                  // 一時点灯の残り回数
 } LedCtx[MAX_LED] = {
-    { PIN_LED_RED   , SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF },
-    { PIN_LED_GREEN , SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF },
-    { PIN_LED_YELLOW, SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF },
+    { PIN_LED_RED   , SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF, 0 },
+    { PIN_LED_GREEN , SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF, 0 },
+    { PIN_LED_YELLOW, SEQ_LED_BLINK_NONE, (int *)SEQ_ALWAYS_OFF, 0 },
 };
 
 
@@ -194,11 +201,19 @@ static pthread_mutex_t threadRcvMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t threadCtxMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  threadRcvCond  = PTHREAD_COND_INITIALIZER;
 static int             threadLedFinish = 0;
+static int             threadRcvReady  = 0;    // 1: 受信可能、-1: 受信できない
+
+// 受信するアドレスの木（パターンの照合用、初回の受信で作成）
+static TRIE_NODE      *LedTrie = NULL;
 
 static void *threadLedControl(void *arg);
 static void *threadRcvManager(void *arg);
-static int ledGetEvent(char *msg);
+static void ledTick(int seq);
+static int ledGetEvent(char *msg, int *evt, int max);
+static void ledSetEvent(int evt);
+static int ledSteady(void);
 static void ledCloseSocket(void);
+static void ledSetReady(int ready);
 static int ledSendMessageToMyself(char *msg);
 
 #if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
@@ -221,6 +236,7 @@ static char *strEvt[] = {
     "赤緑 LED 交互点滅",
     "緑黄 LED 交互点滅",
     "黄赤 LED 交互点滅",
+    "赤色 LED 一時点灯",
     "スレッド終了イベント",
 };
 #endif
@@ -243,12 +259,14 @@ int ledInitialize(void)
     pthread_create(&threadRcvID, NULL, threadRcvManager, NULL);
     pthread_create(&threadLedID, NULL, threadLedControl, NULL);
 
-    // 受信可能な状態まで待つ！
+    // 受信可能な状態まで待つ！（先に通知されていても待ち続けない）
     pthread_mutex_lock(&threadRcvMutex);
-    pthread_cond_wait(&threadRcvCond, &threadRcvMutex);
+    while (threadRcvReady == 0) {
+        pthread_cond_wait(&threadRcvCond, &threadRcvMutex);
+    }
     pthread_mutex_unlock(&threadRcvMutex);
 
-    return 0;
+    return (threadRcvReady > 0) ? 0 : -1;
 }
 
 //
@@ -273,14 +291,29 @@ void ledFinish(void)
     PWS_DEBUG("ledFinish\n");
 }
 
+//
+// 表示が変わらないか
+//
+int ledIsSteady(void)
+{
+    int steady;
+
+    pthread_mutex_lock(&threadCtxMutex);
+    steady = ledSteady();
+    pthread_mutex_unlock(&threadCtxMutex);
+
+    return steady;
+}
+
 // LED制御スレッド
 static void *threadLedControl(void *arg)
 {
     
-    int i, loop, seq;
-    int flgLightUp;
+    int loop, seq;
     struct timespec sleep_ts;
 
+    rtApply(RT_ROLE_LED);
+
     // スリープ時間設定
     sleep_ts.tv_sec  = 0;
     sleep_ts.tv_nsec = 1000 * 1000 * 100;
@@ -288,25 +321,10 @@ static void *threadLedControl(void *arg)
     seq = 0;
     loop = 1;
     while (loop) {
-        pthread_mutex_lock(&threadCtxMutex);
+        ledTick(seq);
 
-        for (i = 0; i < MAX_LED; i++) {
-            flgLightUp = LedCtx[i].seqLightUp[seq];
-            if (LedCtx[i].curLightUp != flgLightUp) {
-                if (flgLightUp == SEQ_LED_BLINK_ON) {
-                    gpioWrite(LedCtx[i].pin, PIN_VAL_ON);
-                }
-                else if (flgLightUp == SEQ_LED_BLINK_OFF) {
-                    gpioWrite(LedCtx[i].pin, PIN_VAL_OFF);
-                }
-                LedCtx[i].curLightUp = flgLightUp;
-            }
-        }
-
-        pthread_mutex_unlock(&threadCtxMutex);
-
-        // スリープ（500 msec）
-        nanosleep(&sleep_ts, NULL);
+        // スリープ（100 msec、省電力中は表示が変わるまで）
+        pwrSleep(&sleep_ts);
 
         // SEQ更新
         seq++;
@@ -323,17 +341,49 @@ static void *threadLedControl(void *arg)
     return (void *)NULL;
 }
 
+// LED の表示を１ステップ進める
+static void ledTick(int seq)
+{
+    int i, flgLightUp;
+
+    pthread_mutex_lock(&threadCtxMutex);
+
+    for (i = 0; i < MAX_LED; i++) {
+        flgLightUp = LedCtx[i].seqLightUp[seq];
+        // 一時点灯中は状態表示より優先（終われば元の表示に戻る）
+        if (LedCtx[i].flash > 0) {
+            flgLightUp = SEQ_LED_BLINK_ON;
+            LedCtx[i].flash--;
+        }
+        if (LedCtx[i].curLightUp != flgLightUp) {
+            if (flgLightUp == SEQ_LED_BLINK_ON) {
+                gpioWrite(LedCtx[i].pin, PIN_VAL_ON);
+            }
+            else if (flgLightUp == SEQ_LED_BLINK_OFF) {
+                gpioWrite(LedCtx[i].pin, PIN_VAL_OFF);
+            }
+            LedCtx[i].curLightUp = flgLightUp;
+        }
+    }
+
+    pthread_mutex_unlock(&threadCtxMutex);
+}
+
 // メッセージ受信スレッド
 static void *threadRcvManager(void *arg)
 {
-    int n, rc, evt, loop;
+    int n, rc, i, num, loop, steady;
+    int evt[EVT_LED_MAX];
     char buf[RECV_BUF_SIZE];
     struct sockaddr_in addr;
 
+    rtApply(RT_ROLE_LED);
+
     // ソケット作成
     sockRcv = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockRcv == -1) {
         PWS_DEBUG("ERROR: socket\n");
+        ledSetReady(-1);
         return (void *)NULL;
     }
     PWS_DEBUG("sock    %d\n", sockRcv);
@@ -347,13 +397,12 @@ static void *threadRcvManager(void *arg)
     if (rc == -1) {
         PWS_DEBUG("ERROR: bind\n");
         close(sockRcv);
+        ledSetReady(-1);
         return (void *)NULL;
     }
 
     // 受信可能な状態であることを設定
-    pthread_mutex_lock(&threadRcvMutex);
-    pthread_cond_signal(&threadRcvCond);
-    pthread_mutex_unlock(&threadRcvMutex);
+    ledSetReady(1);
 
     loop = 1;
     while (loop) {
@@ -363,123 +412,171 @@ static void *threadRcvManager(void *arg)
             PWS_DEBUG("ERROR: recv\n");
             break;
         }
-        evt = ledGetEvent(buf);
+        num = ledGetEvent(buf, evt, EVT_LED_MAX);
         pthread_mutex_lock(&threadCtxMutex);
-        switch(evt) {
-
-        // 赤色LED
-        case EVT_LED_RED_OFF:
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_ALWAYS_OFF;
-            break;
-        case EVT_LED_RED_ON:
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_ALWAYS_ON;
-            break;
-        case EVT_LED_RED_BLINK:
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            break;
-        case EVT_LED_RED_BLINK_FAST:
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_FAST_BLINK;
-            break;
-
-        // 緑色LED
-        case EVT_LED_GREEN_OFF:
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_ALWAYS_OFF;
-            break;
-        case EVT_LED_GREEN_ON:
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_ALWAYS_ON;
-            break;
-        case EVT_LED_GREEN_BLINK:
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            break;
-        case EVT_LED_GREEN_BLINK_FAST:
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_FAST_BLINK;
-            break;
-
-        // 黄色LED
-        case EVT_LED_YELLOW_OFF:
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_ALWAYS_OFF;
-            break;
-        case EVT_LED_YELLOW_ON:
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_ALWAYS_ON;
-            break;
-        case EVT_LED_YELLOW_BLINK:
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            break;
-        case EVT_LED_YELLOW_BLINK_FAST:
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_FAST_BLINK;
-            break;
-
-        // ２色交互
-        case EVT_LED_BLINK_RED_GREEN:
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_REVERSE_BLINK;
-            break;
-        case EVT_LED_BLINK_GREEN_YELLOW:
-            LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_REVERSE_BLINK;
-            break;
-        case EVT_LED_BLINK_YELLOW_RED:
-            LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_NORMAL_BLINK;
-            LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_REVERSE_BLINK;
-            break;
-        case EVT_LED_FINISH:
-            loop = 0;
-            break;
-        default:
-            break;
+        for (i = 0; i < num; i++) {
+            if (evt[i] == EVT_LED_FINISH) {
+                loop = 0;
+            }
+            else {
+                ledSetEvent(evt[i]);
+            }
         }
+        steady = ledSteady();
         pthread_mutex_unlock(&threadCtxMutex);
+
+        // 省電力中は制御スレッドを起こして表示を変える（点滅なら省電力から戻る）
+        if (num > 0) {
+            pwrKick();
+            if (!steady) {
+                pwrResume(PWR_REASON_LED, 0);
+            }
+        }
     }
 
     ledCloseSocket();
 
+    trieFree(LedTrie);
+    LedTrie = NULL;
+
     return (void *)NULL;
 }
 
+// イベントに従って LED の表示を設定（threadCtxMutex を取ってから呼ぶ）
+static void ledSetEvent(int evt)
+{
+    switch(evt) {
+
+    // 赤色LED
+    case EVT_LED_RED_OFF:
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_ALWAYS_OFF;
+        break;
+    case EVT_LED_RED_ON:
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_ALWAYS_ON;
+        break;
+    case EVT_LED_RED_BLINK:
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        break;
+    case EVT_LED_RED_BLINK_FAST:
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_FAST_BLINK;
+        break;
+
+    // 緑色LED
+    case EVT_LED_GREEN_OFF:
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_ALWAYS_OFF;
+        break;
+    case EVT_LED_GREEN_ON:
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_ALWAYS_ON;
+        break;
+    case EVT_LED_GREEN_BLINK:
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        break;
+    case EVT_LED_GREEN_BLINK_FAST:
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_FAST_BLINK;
+        break;
+
+    // 黄色LED
+    case EVT_LED_YELLOW_OFF:
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_ALWAYS_OFF;
+        break;
+    case EVT_LED_YELLOW_ON:
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_ALWAYS_ON;
+        break;
+    case EVT_LED_YELLOW_BLINK:
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        break;
+    case EVT_LED_YELLOW_BLINK_FAST:
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_FAST_BLINK;
+        break;
+
+    // ２色交互
+    case EVT_LED_BLINK_RED_GREEN:
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_REVERSE_BLINK;
+        break;
+    case EVT_LED_BLINK_GREEN_YELLOW:
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_REVERSE_BLINK;
+        break;
+    case EVT_LED_BLINK_YELLOW_RED:
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_REVERSE_BLINK;
+        break;
+    case EVT_LED_RED_FLASH:
+        LedCtx[LED_RED   ].flash = LED_FLASH_TICKS;
+        break;
+    default:
+        break;
+    }
+}
 
-// イベントの取得
-static int ledGetEvent(char *msg)
+// 点滅・一時点灯が無いか（threadCtxMutex を取ってから呼ぶ）
+static int ledSteady(void)
 {
-    int i, evt = EVT_LED_NONE;
-    static struct {
-        int   evt;
-        char* msg;
-    } EVT_TABLE[] = {
-        { EVT_LED_RED_OFF            , MSG_LED_RED_OFF            },
-        { EVT_LED_RED_ON             , MSG_LED_RED_ON             },
-        { EVT_LED_RED_BLINK          , MSG_LED_RED_BLINK          },
-        { EVT_LED_RED_BLINK_FAST     , MSG_LED_RED_BLINK_FAST     },
-        { EVT_LED_GREEN_OFF          , MSG_LED_GREEN_OFF          },
-        { EVT_LED_GREEN_ON           , MSG_LED_GREEN_ON           },
-        { EVT_LED_GREEN_BLINK        , MSG_LED_GREEN_BLINK        },
-        { EVT_LED_GREEN_BLINK_FAST   , MSG_LED_GREEN_BLINK_FAST   },
-        { EVT_LED_YELLOW_OFF         , MSG_LED_YELLOW_OFF         },
-        { EVT_LED_YELLOW_ON          , MSG_LED_YELLOW_ON          },
-        { EVT_LED_YELLOW_BLINK       , MSG_LED_YELLOW_BLINK       },
-        { EVT_LED_YELLOW_BLINK_FAST  , MSG_LED_YELLOW_BLINK_FAST  },
-        { EVT_LED_BLINK_RED_GREEN    , MSG_LED_BLINK_RED_GREEN    },
-        { EVT_LED_BLINK_GREEN_YELLOW , MSG_LED_BLINK_GREEN_YELLOW },
-        { EVT_LED_BLINK_YELLOW_RED   , MSG_LED_BLINK_YELLOW_RED   },
-        { EVT_LED_FINISH             , MSG_LED_FINISH             },
-        { EVT_LED_NONE               , NULL                       },
-    };
+    int i;
 
-    for (i = 0; EVT_TABLE[i].msg != NULL; i++) {
-        if (strcmp(msg, EVT_TABLE[i].msg) == 0) {
-            evt = EVT_TABLE[i].evt;
+    for (i = 0; i < MAX_LED; i++) {
+        if (LedCtx[i].flash > 0 ||
+            (LedCtx[i].seqLightUp != (int *)SEQ_ALWAYS_ON && LedCtx[i].seqLightUp != (int *)SEQ_ALWAYS_OFF)) {
+            return 0;
         }
     }
 
+    return 1;
+}
+
+// イベントの取得（アドレスがパターンなら一致したものを全て、戻り値: 件数）
+//   スレッド終了はパターンでは一致させない
+static int ledGetEvent(char *msg, int *evt, int max)
+{
+    int num;
+#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
+    int i;
+#endif
+    static const TRIE_ENTRY EVT_TABLE[] = {
+        { MSG_LED_RED_OFF            , EVT_LED_RED_OFF            , 0 },
+        { MSG_LED_RED_ON             , EVT_LED_RED_ON             , 0 },
+        { MSG_LED_RED_BLINK          , EVT_LED_RED_BLINK          , 0 },
+        { MSG_LED_RED_BLINK_FAST     , EVT_LED_RED_BLINK_FAST     , 0 },
+        { MSG_LED_GREEN_OFF          , EVT_LED_GREEN_OFF          , 0 },
+        { MSG_LED_GREEN_ON           , EVT_LED_GREEN_ON           , 0 },
+        { MSG_LED_GREEN_BLINK        , EVT_LED_GREEN_BLINK        , 0 },
+        { MSG_LED_GREEN_BLINK_FAST   , EVT_LED_GREEN_BLINK_FAST   , 0 },
+        { MSG_LED_YELLOW_OFF         , EVT_LED_YELLOW_OFF         , 0 },
+        { MSG_LED_YELLOW_ON          , EVT_LED_YELLOW_ON          , 0 },
+        { MSG_LED_YELLOW_BLINK       , EVT_LED_YELLOW_BLINK       , 0 },
+        { MSG_LED_YELLOW_BLINK_FAST  , EVT_LED_YELLOW_BLINK_FAST  , 0 },
+        { MSG_LED_BLINK_RED_GREEN    , EVT_LED_BLINK_RED_GREEN    , 0 },
+        { MSG_LED_BLINK_GREEN_YELLOW , EVT_LED_BLINK_GREEN_YELLOW , 0 },
+        { MSG_LED_BLINK_YELLOW_RED   , EVT_LED_BLINK_YELLOW_RED   , 0 },
+        { MSG_LED_RED_FLASH          , EVT_LED_RED_FLASH          , 0 },
+        { MSG_LED_FINISH             , EVT_LED_FINISH             , 1 },
+    };
+
+    if (LedTrie == NULL) {
+        LedTrie = trieBuild(EVT_TABLE, sizeof(EVT_TABLE) / sizeof(EVT_TABLE[0]));
+    }
+    num = trieMatch(LedTrie, msg, evt, max);
+
 #if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
-    if (evt >= 0) {
-        PWS_DEBUG("ledGetEvent %d [%s]\n", evt, strEvt[evt]);
+    for (i = 0; i < num; i++) {
+        PWS_DEBUG("ledGetEvent %d [%s]\n", evt[i], strEvt[evt[i]]);
     }
-    else {
-        PWS_DEBUG("ledGetEvent %d [（イベント無し）]\n", evt);
+    if (num == 0) {
+        PWS_DEBUG("ledGetEvent %d [（イベント無し）]\n", EVT_LED_NONE);
     }
 #endif
     
-    return evt;
+    return num;
+}
+
+// 受信の準備の結果を通知
+static void ledSetReady(int ready)
+{
+    pthread_mutex_lock(&threadRcvMutex);
+    threadRcvReady = ready;
+    pthread_cond_signal(&threadRcvCond);
+    pthread_mutex_unlock(&threadRcvMutex);
 }
 
 // ソケットをクローズ
@@ -519,3 +616,40 @@ static int ledSendMessageToMyself(char *msg)
     return 0;
 }
 
+#ifdef PWS_REPLAY
+//
+// ベンチマーク（bench/bench_micro）からの呼出し
+//
+// 最初に一致したイベント
+int ledReplayGetEvent(char *msg)
+{
+    int evt[EVT_LED_MAX];
+
+    if (ledGetEvent(msg, evt, EVT_LED_MAX) <= 0) {
+        return EVT_LED_NONE;
+    }
+    return evt[0];
+}
+
+// 表示の初期化（blink: 1 なら３色とも点滅させて毎回 GPIO を書く状態にする）
+void ledReplayReset(int blink)
+{
+    int i;
+
+    for (i = 0; i < MAX_LED; i++) {
+        LedCtx[i].curLightUp = SEQ_LED_BLINK_NONE;
+        LedCtx[i].seqLightUp = (int *)SEQ_ALWAYS_OFF;
+        LedCtx[i].flash      = 0;
+    }
+    if (blink) {
+        LedCtx[LED_RED   ].seqLightUp = (int *)SEQ_NORMAL_BLINK;
+        LedCtx[LED_GREEN ].seqLightUp = (int *)SEQ_REVERSE_BLINK;
+        LedCtx[LED_YELLOW].seqLightUp = (int *)SEQ_FAST_BLINK;
+    }
+}
+
+void ledReplayTick(int seq)
+{
+    ledTick(seq % SEQ_MAX);
+}
+#endif  // PWS_REPLAY
@@ -24,8 +24,12 @@
 #define MSG_LED_BLINK_RED_GREEN     "/led/blink/red/green"
 #define MSG_LED_BLINK_GREEN_YELLOW  "/led/blink/green/orange"
 #define MSG_LED_BLINK_YELLOW_RED    "/led/blink/orange/red"
+#define MSG_LED_RED_FLASH           "/led/red/flash"
 #define MSG_LED_FINISH              "/led/finish"
 
+// p^[iv LED ܂Ƃ߂Đݒ肷j
+#define MSG_LED_RED_GREEN_OFF       "/led/{red,green}/off"
+
 //
 // LED䏉
 //
@@ -36,4 +40,18 @@ extern int ledInitialize(void);
 //
 extern void ledFinish(void);
 
+//
+// \ςȂi_ŁEꎞ_Aȓd͂ɓĂ悢j
+//
+extern int ledIsSteady(void);
+
+#ifdef PWS_REPLAY
+//
+// x`}[Npibench/bench_microj
+//
+extern int ledReplayGetEvent(char *msg);
+extern void ledReplayReset(int blink);
+extern void ledReplayTick(int seq);
+#endif
+
 #endif // __PWS_LED_H__
@@ -0,0 +1,591 @@
+///////////////////////////////////////////////////////////
+// pws_lib.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "def.h"
+#include "pws_lib.h"
+#include "pws_wav.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+// 解析時の読込みサイズ
+#define LIB_SCAN_BUF_SIZE   (64 * 1024)
+
+// テーブルの拡張単位
+#define LIB_ALLOC_UNIT      (256)
+
+// FNV-1a 64bit
+#define FNV_OFFSET_BASIS    (14695981039346656037ULL)
+#define FNV_PRIME           (1099511628211ULL)
+
+// 管理情報
+static struct {
+    int         fd;                     // 索引ファイル
+    int         count;                  // 登録件数
+    int         capacity;               // テーブルの確保件数
+    LIB_TAKE *  takes;                  // テーブル
+} LibCtx = { -1, 0, 0, NULL };
+
+static pthread_t       threadScanID;
+static pthread_mutex_t threadLibMutex  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  threadScanCond  = PTHREAD_COND_INITIALIZER;
+static int             threadScanFinish = 0;
+static int             threadScanStarted = 0;
+
+static void *threadLibScan(void *arg);
+static int libLoad(void);
+static int libRebuild(void);
+static int libAppend(const char *path, uint32_t mtime);
+static int libIndexOf(const char *path);
+static int libWriteRecord(int idx);
+static int libWriteRecords(int idx);
+static int libWriteHeader(void);
+static int libScanFile(const char *path, LIB_TAKE *take);
+static int libIsTakeName(const char *name);
+
+//
+// 録音ライブラリ初期化
+//
+int libInitialize(void)
+{
+    PWS_DEBUG("libInitialize\n");
+
+    LibCtx.fd = open(PWS_TAKE_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+    if (LibCtx.fd < 0) {
+        PWS_DEBUG("ERROR: open %s\n", PWS_TAKE_INDEX_FILE);
+        return -1;
+    }
+
+    // 索引が無い／壊れている場合はディレクトリから再構築
+    if (libLoad() < 0) {
+        libRebuild();
+    }
+
+    // スレッドの作成
+    threadScanFinish = 0;
+    if (pthread_create(&threadScanID, NULL, threadLibScan, NULL) != 0) {
+        PWS_DEBUG("ERROR: scan thread\n");
+        return -1;
+    }
+    threadScanStarted = 1;
+
+    return 0;
+}
+
+//
+// 録音ライブラリ終了処理
+//
+void libFinish(void)
+{
+    // 解析スレッド終了
+    pthread_mutex_lock(&threadLibMutex);
+    threadScanFinish = 1;
+    pthread_cond_signal(&threadScanCond);
+    pthread_mutex_unlock(&threadLibMutex);
+
+    // スレッド終了待ち（開始できなかった場合は待たない）
+    if (threadScanStarted) {
+        pthread_join(threadScanID, NULL);
+        threadScanStarted = 0;
+    }
+
+    if (LibCtx.fd >= 0) {
+        close(LibCtx.fd);
+        LibCtx.fd = -1;
+    }
+    free(LibCtx.takes);
+    LibCtx.takes    = NULL;
+    LibCtx.count    = 0;
+    LibCtx.capacity = 0;
+
+    PWS_DEBUG("libFinish\n");
+}
+
+//
+// 録音ファイルの登録
+//
+int libAddTake(const char *path)
+{
+    int idx;
+    struct stat st;
+
+    if (path == NULL || strlen(path) >= LIB_PATH_LEN) {
+        PWS_DEBUG("ERROR: bad path\n");
+        return -1;
+    }
+
+    memset(&st, 0, sizeof(st));
+    stat(path, &st);
+
+    pthread_mutex_lock(&threadLibMutex);
+    idx = libIndexOf(path);
+    if (idx < 0) {
+        idx = libAppend(path, (uint32_t)st.st_mtime);
+    }
+    else {
+        // 上書きされた場合は再解析
+        LibCtx.takes[idx].mtime  = (uint32_t)st.st_mtime;
+        LibCtx.takes[idx].flags |= LIB_FLAG_SCANNING;
+        libWriteRecord(idx);
+    }
+    pthread_cond_signal(&threadScanCond);
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return (idx < 0) ? -1 : 0;
+}
+
+//
+// アップロード状態の更新
+//
+int libSetUploadState(const char *path, int state)
+{
+    int idx;
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&threadLibMutex);
+    idx = libIndexOf(path);
+    if (idx >= 0 && LibCtx.takes[idx].upload != state) {
+        LibCtx.takes[idx].upload = state;
+        libWriteRecord(idx);
+    }
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return (idx < 0) ? -1 : 0;
+}
+
+//
+// 録音ファイルの登録解除（ファイル自体は削除しない）
+//
+int libRemoveTake(const char *path)
+{
+    int idx;
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&threadLibMutex);
+    idx = libIndexOf(path);
+    if (idx >= 0) {
+        // 後ろのレコードを詰めて書き直す
+        LibCtx.count--;
+        memmove(&LibCtx.takes[idx], &LibCtx.takes[idx + 1], (LibCtx.count - idx) * sizeof(LIB_TAKE));
+        libWriteRecords(idx);
+        libWriteHeader();
+        if (ftruncate(LibCtx.fd, sizeof(LIB_HEADER) + (off_t)LibCtx.count * sizeof(LIB_TAKE)) < 0) {
+            PWS_DEBUG("ERROR: ftruncate index\n");
+        }
+    }
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return (idx < 0) ? -1 : 0;
+}
+
+//
+// 登録件数の取得
+//
+int libGetCount(void)
+{
+    int count;
+
+    pthread_mutex_lock(&threadLibMutex);
+    count = LibCtx.count;
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return count;
+}
+
+//
+// 録音ファイル情報の取得（インデックス指定）
+//
+int libGetTake(int idx, LIB_TAKE *take)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&threadLibMutex);
+    if (idx >= 0 && idx < LibCtx.count) {
+        memcpy(take, &LibCtx.takes[idx], sizeof(LIB_TAKE));
+        ret = 0;
+    }
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return ret;
+}
+
+//
+// 録音ファイル情報の取得（パス名指定）
+//
+int libFindTake(const char *path, LIB_TAKE *take)
+{
+    int idx;
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&threadLibMutex);
+    idx = libIndexOf(path);
+    if (idx >= 0 && take != NULL) {
+        memcpy(take, &LibCtx.takes[idx], sizeof(LIB_TAKE));
+    }
+    pthread_mutex_unlock(&threadLibMutex);
+
+    return idx;
+}
+
+// 解析スレッド
+static void *threadLibScan(void *arg)
+{
+    int i, idx, loop;
+    char path[LIB_PATH_LEN];
+    LIB_TAKE take;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    loop = 1;
+    while (loop) {
+        // 解析待ちのレコードを探す
+        pthread_mutex_lock(&threadLibMutex);
+        idx = -1;
+        while (threadScanFinish == 0) {
+            for (i = 0; i < LibCtx.count; i++) {
+                if (LibCtx.takes[i].flags & LIB_FLAG_SCANNING) {
+                    idx = i;
+                    break;
+                }
+            }
+            if (idx >= 0) {
+                break;
+            }
+            pthread_cond_wait(&threadScanCond, &threadLibMutex);
+        }
+        if (threadScanFinish == 1) {
+            pthread_mutex_unlock(&threadLibMutex);
+            break;
+        }
+        memcpy(path, LibCtx.takes[idx].path, sizeof(path));
+        pthread_mutex_unlock(&threadLibMutex);
+
+        // ロックを外して解析（数百MBになることもある）
+        memset(&take, 0, sizeof(take));
+        if (libScanFile(path, &take) < 0) {
+            take.flags = LIB_FLAG_INVALID;
+        }
+
+        // 解析中に削除・移動されている可能性があるので引き直す
+        pthread_mutex_lock(&threadLibMutex);
+        idx = libIndexOf(path);
+        if (idx >= 0) {
+            memcpy(take.path, LibCtx.takes[idx].path, sizeof(take.path));
+            take.upload = LibCtx.takes[idx].upload;
+            if (take.mtime == 0) {
+                take.mtime = LibCtx.takes[idx].mtime;
+            }
+            memcpy(&LibCtx.takes[idx], &take, sizeof(LIB_TAKE));
+            libWriteRecord(idx);
+        }
+        pthread_mutex_unlock(&threadLibMutex);
+
+        PWS_DEBUG("libScan [%s] %u ms peak=%.3f rms=%.3f\n", path, take.duration, take.peak, take.rms);
+    }
+
+    return (void *)NULL;
+}
+
+// 索引ファイルの読込み（１回の read で全件取得）
+static int libLoad(void)
+{
+    int i, n, count;
+    uint8_t *buf;
+    LIB_HEADER *hdr;
+    struct stat st;
+
+    if (fstat(LibCtx.fd, &st) < 0 || st.st_size < (off_t)sizeof(LIB_HEADER)) {
+        return -1;
+    }
+
+    buf = malloc(st.st_size);
+    if (buf == NULL) {
+        return -1;
+    }
+    n = pread(LibCtx.fd, buf, st.st_size, 0);
+    if (n != st.st_size) {
+        free(buf);
+        return -1;
+    }
+
+    hdr = (LIB_HEADER *)buf;
+    if (memcmp(hdr->magic, LIB_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != LIB_VERSION ||
+        hdr->recSize != sizeof(LIB_TAKE) ||
+        sizeof(LIB_HEADER) + (size_t)hdr->count * sizeof(LIB_TAKE) > (size_t)n)
+    {
+        PWS_DEBUG("ERROR: bad index file\n");
+        free(buf);
+        return -1;
+    }
+
+    count = hdr->count;
+    LibCtx.capacity = count + LIB_ALLOC_UNIT;
+    LibCtx.takes    = calloc(LibCtx.capacity, sizeof(LIB_TAKE));
+    if (LibCtx.takes == NULL) {
+        free(buf);
+        return -1;
+    }
+    memcpy(LibCtx.takes, buf + sizeof(LIB_HEADER), count * sizeof(LIB_TAKE));
+    LibCtx.count = count;
+    free(buf);
+
+    for (i = 0; i < count; i++) {
+        LibCtx.takes[i].path[LIB_PATH_LEN - 1] = '\0';
+    }
+
+    PWS_DEBUG("libLoad %d takes\n", count);
+
+    return 0;
+}
+
+// 録音ディレクトリから索引を再構築
+static int libRebuild(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct stat st;
+    char path[LIB_PATH_LEN];
+    int n;
+
+    PWS_DEBUG("libRebuild\n");
+
+    LibCtx.count = 0;
+    if (ftruncate(LibCtx.fd, 0) < 0 || libWriteHeader() < 0) {
+        return -1;
+    }
+
+    dir = opendir(PWS_TAKE_DIR);
+    if (dir == NULL) {
+        PWS_DEBUG("ERROR: opendir %s\n", PWS_TAKE_DIR);
+        return -1;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        if (libIsTakeName(ent->d_name) == 0) {
+            continue;
+        }
+        n = snprintf(path, sizeof(path), "%s/%s", PWS_TAKE_DIR, ent->d_name);
+        if (n < 0 || n >= (int)sizeof(path) || stat(path, &st) < 0) {
+            continue;
+        }
+        libAppend(path, (uint32_t)st.st_mtime);
+    }
+    closedir(dir);
+
+    return 0;
+}
+
+// レコードの追加（ロック取得済みで呼ぶこと）
+static int libAppend(const char *path, uint32_t mtime)
+{
+    int idx;
+    LIB_TAKE *takes;
+
+    if (LibCtx.count >= LibCtx.capacity) {
+        takes = realloc(LibCtx.takes, (LibCtx.capacity + LIB_ALLOC_UNIT) * sizeof(LIB_TAKE));
+        if (takes == NULL) {
+            PWS_DEBUG("ERROR: realloc\n");
+            return -1;
+        }
+        LibCtx.takes     = takes;
+        LibCtx.capacity += LIB_ALLOC_UNIT;
+    }
+
+    idx = LibCtx.count;
+    memset(&LibCtx.takes[idx], 0, sizeof(LIB_TAKE));
+    strncpy(LibCtx.takes[idx].path, path, LIB_PATH_LEN - 1);
+    LibCtx.takes[idx].mtime  = mtime;
+    LibCtx.takes[idx].upload = LIB_UPLOAD_NONE;
+    LibCtx.takes[idx].flags  = LIB_FLAG_SCANNING;
+    LibCtx.count++;
+
+    libWriteRecord(idx);
+    libWriteHeader();
+
+    return idx;
+}
+
+// パス名からインデックスを求める（ロック取得済みで呼ぶこと）
+static int libIndexOf(const char *path)
+{
+    int i;
+
+    for (i = LibCtx.count - 1; i >= 0; i--) {
+        if (strcmp(LibCtx.takes[i].path, path) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// レコードの書込み（ロック取得済みで呼ぶこと）
+static int libWriteRecord(int idx)
+{
+    off_t ofs = sizeof(LIB_HEADER) + (off_t)idx * sizeof(LIB_TAKE);
+
+    if (pwrite(LibCtx.fd, &LibCtx.takes[idx], sizeof(LIB_TAKE), ofs) != sizeof(LIB_TAKE)) {
+        PWS_DEBUG("ERROR: pwrite record %d\n", idx);
+        return -1;
+    }
+
+    return 0;
+}
+
+// 指定位置以降のレコードをまとめて書込み（ロック取得済みで呼ぶこと）
+static int libWriteRecords(int idx)
+{
+    off_t ofs = sizeof(LIB_HEADER) + (off_t)idx * sizeof(LIB_TAKE);
+    ssize_t len = (ssize_t)(LibCtx.count - idx) * sizeof(LIB_TAKE);
+
+    if (len <= 0) {
+        return 0;
+    }
+    if (pwrite(LibCtx.fd, &LibCtx.takes[idx], len, ofs) != len) {
+        PWS_DEBUG("ERROR: pwrite records %d-\n", idx);
+        return -1;
+    }
+
+    return 0;
+}
+
+// ヘッダーの書込み（ロック取得済みで呼ぶこと）
+static int libWriteHeader(void)
+{
+    LIB_HEADER hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LIB_MAGIC, sizeof(hdr.magic));
+    hdr.version = LIB_VERSION;
+    hdr.recSize = sizeof(LIB_TAKE);
+    hdr.count   = LibCtx.count;
+
+    if (pwrite(LibCtx.fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        PWS_DEBUG("ERROR: pwrite header\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// WAVファイルの解析（フォーマット、長さ、ピーク、RMS、ハッシュ）
+static int libScanFile(const char *path, LIB_TAKE *take)
+{
+    int fd, n, i, samples;
+    uint8_t *buf;
+    float *val;
+    uint32_t remain, len;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint64_t total = 0;
+    double sum = 0.0;
+    float peak = 0.0f, v;
+    off_t ofs;
+    WAV_INFO info;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        PWS_DEBUG("ERROR: open %s\n", path);
+        return -1;
+    }
+    if (wavReadHeader(fd, &info) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    take->size     = (uint32_t)info.fileSize;
+    take->channels = info.channels;
+    take->rate     = info.rate;
+    take->bits     = info.bits;
+    take->frames   = wavDataBytes(&info) / info.align;
+    take->duration = (uint32_t)((uint64_t)take->frames * 1000 / info.rate);
+
+    buf = malloc(LIB_SCAN_BUF_SIZE);
+    val = malloc(LIB_SCAN_BUF_SIZE / 2 * sizeof(float));
+    if (buf == NULL || val == NULL) {
+        free(buf);
+        free(val);
+        close(fd);
+        return -1;
+    }
+
+    // 音声データを１回だけ読んでハッシュ／ピーク／RMS を求める
+    ofs    = info.dataOfs;
+    remain = take->frames * info.align;
+    len    = (LIB_SCAN_BUF_SIZE / info.align) * info.align;
+    while (remain > 0) {
+        n = pread(fd, buf, (remain < len) ? remain : len, ofs);
+        if (n <= 0) {
+            break;
+        }
+        n -= n % info.align;
+        ofs    += n;
+        remain -= n;
+
+        for (i = 0; i < n; i++) {
+            hash ^= buf[i];
+            hash *= FNV_PRIME;
+        }
+
+        samples = n / (info.bits / 8);
+        if (wavToFloat(&info, buf, val, samples) < 0) {
+            continue;
+        }
+        for (i = 0; i < samples; i++) {
+            v = (val[i] < 0.0f) ? -val[i] : val[i];
+            if (v > peak) {
+                peak = v;
+            }
+            sum += v * v;
+        }
+        total += samples;
+    }
+
+    free(val);
+    free(buf);
+    close(fd);
+
+    take->hash = hash;
+    take->peak = peak;
+    take->rms  = (total > 0) ? (float)sqrt(sum / total) : 0.0f;
+
+    return 0;
+}
+
+// 録音ファイル名かどうか（*.wav、last_play.wav は除く）
+static int libIsTakeName(const char *name)
+{
+    size_t len = strlen(name);
+
+    if (len < 5 || strcmp(name + len - 4, ".wav") != 0) {
+        return 0;
+    }
+    if (strcmp(name, PWS_LAST_PLAY_FILE_NAME) == 0) {
+        return 0;
+    }
+    // 隠しファイル（レイテンシ測定用など）は除く
+    if (name[0] == '.') {
+        return 0;
+    }
+
+    return 1;
+}
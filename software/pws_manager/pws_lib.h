@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////
+// pws_lib.h
+///////////////////////////////////////////////////////////
+#ifndef __PWS_LIB_H__
+#define __PWS_LIB_H__
+
+#include <stdint.h>
+
+// 索引ファイルの識別子／版数
+#define LIB_MAGIC           "PWSL"
+#define LIB_VERSION         (1)
+
+// パス名の最大長（終端文字を含む）
+#define LIB_PATH_LEN        (128)
+
+// 一度の問合せで返す最大件数
+#define LIB_QUERY_MAX       (16)
+
+// アップロード状態
+#define LIB_UPLOAD_ERROR    (-1)        // アップロード失敗
+#define LIB_UPLOAD_NONE     (0)         // 未アップロード
+#define LIB_UPLOAD_QUEUED   (1)         // アップロード要求済み
+#define LIB_UPLOAD_DONE     (2)         // アップロード完了
+
+// フラグ
+#define LIB_FLAG_SCANNING   (0x0001)    // 解析待ち
+#define LIB_FLAG_INVALID    (0x0002)    // WAVとして解析できなかった
+
+//
+// 索引ファイルのヘッダー（16 byte）
+//
+typedef struct {
+    char        magic[4];               // "PWSL"
+    uint16_t    version;                // 版数
+    uint16_t    recSize;                // レコード長
+    uint32_t    count;                  // レコード数
+    uint32_t    reserved;
+} LIB_HEADER;
+
+//
+// 録音ファイル 1 件分のレコード（192 byte）
+//
+typedef struct {
+    char        path[LIB_PATH_LEN];     // パス名
+    uint64_t    hash;                   // 音声データのハッシュ値（FNV-1a 64bit）
+    uint32_t    mtime;                  // 更新日時（UNIX時間）
+    uint32_t    size;                   // ファイルサイズ（byte）
+    uint32_t    frames;                 // サンプルフレーム数
+    uint32_t    duration;               // 長さ（ミリ秒）
+    uint32_t    rate;                   // サンプリング周波数
+    uint16_t    channels;               // チャンネル数
+    uint16_t    bits;                   // 量子化ビット数
+    float       peak;                   // ピーク値（0.0 ～ 1.0）
+    float       rms;                    // RMS値 （0.0 ～ 1.0）
+    int32_t     upload;                 // アップロード状態
+    uint32_t    flags;                  // フラグ
+    uint32_t    reserved[4];
+} LIB_TAKE;
+
+//
+// 録音ライブラリ初期化（索引の読込み、解析スレッド作成）
+//
+extern int libInitialize(void);
+
+//
+// 録音ライブラリ終了処理
+//
+extern void libFinish(void);
+
+//
+// 録音ファイルの登録（解析はバックグラウンドで行う）
+//
+extern int libAddTake(const char *path);
+
+//
+// アップロード状態の更新
+//
+extern int libSetUploadState(const char *path, int state);
+
+//
+// 録音ファイルの登録解除（ファイル自体は削除しない）
+//
+extern int libRemoveTake(const char *path);
+
+//
+// 登録件数の取得
+//
+extern int libGetCount(void);
+
+//
+// 録音ファイル情報の取得（インデックス指定）
+//
+extern int libGetTake(int idx, LIB_TAKE *take);
+
+//
+// 録音ファイル情報の取得（パス名指定）
+//
+extern int libFindTake(const char *path, LIB_TAKE *take);
+
+#endif // __PWS_LIB_H__
@@ -9,6 +9,8 @@
 #include <string.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <time.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -18,8 +20,35 @@
 #include "pws_osc.h"
 #include "pws_gpio.h"
 #include "pws_led.h"
+#include "pws_lib.h"
+#include "pws_peak.h"
+#include "pws_storage.h"
+#include "pws_latency.h"
+#include "pws_render.h"
+#include "pws_ingress.h"
+#include "pws_stats.h"
+#include "pws_flight.h"
+#include "pws_trie.h"
+#include "pws_bus.h"
+#include "pws_registry.h"
+#include "pws_ack.h"
+#include "pws_supervisor.h"
+#include "pws_boot.h"
+#include "pws_power.h"
+#include "pws_util.h"
+#include "pws_rt.h"
 #include "pws_debug.h"
 
+// 長時間留まったら状態遷移の記録を書出す状態と時間（秒）
+#define MGR_STUCK_PD_WAIT_SEC       (60)    // PD初期化終了待ち
+#define MGR_STUCK_APSET_WAIT_SEC    (180)   // AP設定終了待ち
+
+// Pd の再起動で戻す設定（Audio_Out.pd の音量は 0.1 刻み、Effect_Controller.pd は 1 ～ 3 の巡回）
+#define MGR_VOLUME_DEFAULT          (4)     // 起動時の音量（x 0.1）
+#define MGR_VOLUME_MIN              (2)
+#define MGR_VOLUME_MAX              (10)
+#define MGR_EFFECT_NUM              (3)
+
 //
 // ステートマシンの状態
 //
@@ -32,6 +61,7 @@ typedef enum {
     STATE_REC                   ,   // 録音中
     STATE_PLAY                  ,   // 再生中
     STATE_TUNE                  ,   // チューニング中
+    STATE_CALIB                 ,   // レイテンシ測定中
     STATE_MAX                       // 最大個数
 } STATE;
 
@@ -60,6 +90,35 @@ typedef enum {
     EVT_RECV_UPLOAD_STOPPED     ,   // アップロード終了通知
     EVT_RECV_DOWNLOAD_STOPPED   ,   // ダウンロード終了通知
     EVT_PUSH_SHUTDOWN_BTN       ,   // シャットダウンボタン押下 
+    EVT_RECV_LIB_QUERY          ,   // 録音ライブラリ問合せ
+    EVT_RECV_REC_STARTED        ,   // 録音開始通知
+    EVT_PUSH_REC_BTN_NO_SPACE   ,   // 録音ボタン押下（録音領域不足）
+    EVT_RECV_CALIB_REQ          ,   // レイテンシ測定要求
+    EVT_RECV_CALIB_STOPPED      ,   // レイテンシ測定終了通知
+    EVT_RECV_LATENCY_QUERY      ,   // レイテンシ問合せ
+    EVT_RECV_LATENCY_ALIGN      ,   // レイテンシ補正設定
+    EVT_RECV_RENDER_REQ         ,   // エフェクト書出し要求
+    EVT_RECV_RENDER_STOPPED     ,   // エフェクト書出し終了通知
+    EVT_RECV_METER              ,   // 入力レベル通知
+    EVT_RECV_METER_QUERY        ,   // 入力レベル問合せ
+    EVT_RECV_INGRESS_QUERY      ,   // 受信キュー統計問合せ
+    EVT_RECV_STATS_QUERY        ,   // 処理時間統計問合せ
+    EVT_RECV_FLIGHT_DUMP        ,   // 状態遷移の記録の書出し要求
+    EVT_RECV_SUBSCRIBE          ,   // 状態通知の購読要求
+    EVT_RECV_UNSUBSCRIBE        ,   // 状態通知の購読解除
+    EVT_RECV_MODULE_QUERY       ,   // モジュールの問合せ
+    EVT_RECV_MODULE_ANNOUNCE    ,   // モジュールの登録
+    EVT_RECV_MODULE_HEARTBEAT   ,   // モジュールの心拍
+    EVT_RECV_MODULE_LOST        ,   // モジュールの停止検出
+    EVT_RECV_MODULE_LOST_ACTIVE ,   // モジュールの停止検出（現在の状態で使っているもの）
+    EVT_RECV_PLAY_STARTED       ,   // 再生開始通知
+    EVT_RECV_TUNING_STARTED     ,   // チューニング開始通知
+    EVT_RECV_COMMAND_TIMEOUT    ,   // 指示の応答無し
+    EVT_RECV_PD_RESTARTED       ,   // Pd の再起動通知
+    EVT_RECV_BOOT_QUERY         ,   // 起動の記録の問合せ
+    EVT_RECV_POWER_QUERY        ,   // 省電力の問合せ
+    EVT_RECV_TAKE_FINISHED      ,   // 録音ファイル確定通知
+    EVT_RECV_CALIB_MEASURED     ,   // レイテンシ解析終了通知
     EVT_MAX                         // イベント最大個数
 } EVENT;
 
@@ -69,8 +128,84 @@ typedef enum {
 static struct {
     int state;
     int event;
+    struct sockaddr_in from;            // 受信メッセージの送信元
+    struct sockaddr_in calibFrom;       // レイテンシ測定の要求元
+    struct {
+        float    peak;                  // ピーク（dBFS）
+        float    rms;                   // RMS（dBFS）
+        int      clips;                 // 直近の集計周期のクリップ数
+        uint32_t clipTotal;             // 起動からのクリップ数
+        struct timespec at;             // 受信時刻
+    } meter;                            // 入力レベル（Meter.pd から周期的に届く）
+    struct {
+        int      active;                // ボタン押下の処理中
+        uint32_t edge;                  // ボタンの変化検出時刻
+        uint32_t dispatch;              // 状態遷移テーブルの実行時刻
+    } trace;                            // 処理時間の計測（ボタン押下 → モジュールへの指示）
+    struct {
+        uint32_t decode;                // デコードできない
+        uint32_t unknown;               // 知らないアドレス
+        uint32_t signature;             // 引数が pws_schema.def の型と合わない
+        uint32_t forged;                // マネージャー自身への通知が他から届いた
+    } reject;                           // 破棄した受信メッセージの数
+    struct {
+        int      volume;                // 音量（x 0.1 - MGR_VOLUME_DEFAULT）
+        int      effect;                // エフェクト切替えの回数（0: 起動時のまま、1 ～ MGR_EFFECT_NUM）
+    } warm;                             // Pd の再起動で戻す設定
+    char caps[REG_CAPS_LEN];            // 並べて登録された機能をカンマ区切りにまとめたもの
 } MgrCtx;
 
+//
+// 受信メッセージの引数（pws_schema.def の型で照合済みのものを取出す）
+//
+typedef struct {
+    int32_t  code;                      // 先頭の整数（結果、番号など、無ければ 0）
+    char    *arg1;                      // １つ目の文字列（無ければ NULL）
+    char    *arg2;                      // ２つ目の文字列（無ければ NULL）
+} MGR_ARGS;
+
+//
+// 受信するアドレス（pws_schema.def）
+//
+static const struct {
+    char* msg;
+    int   evt;
+    char* types;
+} MGR_EVT_TABLE[] = {
+#define OSC_SCHEMA_IN(addr, evt, types)     { addr, evt, types },
+#define OSC_SCHEMA_OUT(addr, types)
+#include "pws_schema.def"
+#undef  OSC_SCHEMA_IN
+#undef  OSC_SCHEMA_OUT
+};
+#define MGR_EVT_NUM     ((int)(sizeof(MGR_EVT_TABLE) / sizeof(MGR_EVT_TABLE[0])))
+
+// 周期的に届くのでログに出さないイベント
+#define MGR_EVT_QUIET(evt)  ((evt) == EVT_RECV_METER || (evt) == EVT_RECV_MODULE_HEARTBEAT)
+
+// マネージャー自身（監視スレッド、ピーク生成、レイテンシ解析）からだけ受付けるイベント（送信元は utilSendLocal の 127.0.0.1:PWS_PORT_MANAGER）
+#define MGR_EVT_SELF(evt)   ((evt) == EVT_RECV_MODULE_LOST || (evt) == EVT_RECV_COMMAND_TIMEOUT || (evt) == EVT_RECV_PD_RESTARTED || \
+                             (evt) == EVT_RECV_TAKE_FINISHED || (evt) == EVT_RECV_CALIB_MEASURED)
+
+// 同じ機器の別プロセスからだけ受付けるイベント（送信元は 127.0.0.1、ポートは問わない）
+#define MGR_EVT_LOCAL(evt)  ((evt) == EVT_RECV_RENDER_STOPPED || (evt) == EVT_RECV_MODULE_ANNOUNCE || (evt) == EVT_RECV_MODULE_HEARTBEAT)
+
+// 受信するアドレスの木（パターンの照合用、初回の受信で作成）
+static TRIE_NODE *MgrTrie = NULL;
+
+// 状態ごとに使っているモジュールの機能（停止を検出したらその状態をやめる）
+static const char *MGR_STATE_CAP[STATE_MAX] = {
+    NULL                ,   // 初期化中
+    NULL                ,   // AP設定モード中
+    NULL                ,   // AP設定終了待ち
+    "pd_initializer"    ,   // PD初期化終了待ち
+    NULL                ,   // アイドル
+    "recorder"          ,   // 録音中
+    "player"            ,   // 再生中
+    "tuner"             ,   // チューニング中
+    "calibrator"        ,   // レイテンシ測定中
+};
+
 //
 // 関数のプロトタイプ宣言
 //
@@ -82,6 +217,8 @@ static int mgrPdInitFinished(int code, void *arg1, void *arg2);
 static int mgrPdInitError(int code, void *arg1, void *arg2);
 static int mgrRecStart(int code, void *arg1, void *arg2);
 static int mgrRecStop(int code, void *arg1, void *arg2);
+static int mgrRecStarted(int code, void *arg1, void *arg2);
+static int mgrRecNoSpace(int code, void *arg1, void *arg2);
 static int mgrRecStopped(int code, void *arg1, void *arg2);
 static int mgrPlayStart(int code, void *arg1, void *arg2);
 static int mgrPlayStop(int code, void *arg1, void *arg2);
@@ -97,17 +234,66 @@ static int mgrUploadStarted(int code, void *arg1, void *arg2);
 static int mgrUploadStopped(int code, void *arg1, void *arg2);
 static int mgrDownloadStopped(int code, void *arg1, void *arg2);
 static int mgrShutdown(int code, void *arg1, void *arg2);
-
-static int mgrGetEvent(char *buf, int len, OSC_MESSAGE *msg);
-static int mgrSendMessageToSndModule(int port, char *msg, char *param);
-static int mgrSendMessageToLedController(char *msg);
+static int mgrLibQuery(int code, void *arg1, void *arg2);
+static int mgrCalibStart(int code, void *arg1, void *arg2);
+static int mgrCalibStopped(int code, void *arg1, void *arg2);
+static int mgrLatencyQuery(int code, void *arg1, void *arg2);
+static int mgrLatencyAlign(int code, void *arg1, void *arg2);
+static int mgrRenderStart(int code, void *arg1, void *arg2);
+static int mgrRenderReject(int code, void *arg1, void *arg2);
+static int mgrRenderStopped(int code, void *arg1, void *arg2);
+static int mgrMeter(int code, void *arg1, void *arg2);
+static int mgrMeterQuery(int code, void *arg1, void *arg2);
+static int mgrIngressQuery(int code, void *arg1, void *arg2);
+static int mgrStatsQuery(int code, void *arg1, void *arg2);
+static int mgrFlightDump(int code, void *arg1, void *arg2);
+static int mgrSubscribe(int code, void *arg1, void *arg2);
+static int mgrUnsubscribe(int code, void *arg1, void *arg2);
+static int mgrModuleQuery(int code, void *arg1, void *arg2);
+static int mgrModuleAnnounce(int code, void *arg1, void *arg2);
+static int mgrModuleHeartbeat(int code, void *arg1, void *arg2);
+static int mgrModuleLost(int code, void *arg1, void *arg2);
+static int mgrModuleLostActive(int code, void *arg1, void *arg2);
+static int mgrPlayStarted(int code, void *arg1, void *arg2);
+static int mgrTuningStarted(int code, void *arg1, void *arg2);
+static int mgrCommandTimeout(int code, void *arg1, void *arg2);
+static int mgrAbortActive(void);
+static void mgrAck(int cmd);
+static int mgrPdRestarted(int code, void *arg1, void *arg2);
+static void mgrWarmStart(void);
+static int mgrBootQuery(int code, void *arg1, void *arg2);
+static int mgrPowerQuery(int code, void *arg1, void *arg2);
+static int mgrTakeFinished(int code, void *arg1, void *arg2);
+static int mgrCalibMeasured(int code, void *arg1, void *arg2);
+
+static int mgrDispatch(INGRESS_PACKET *pkt);
+static int mgrMatchEvent(char *buf, int len, OSC_MESSAGE *msg, int *idx, int max);
+static int mgrGetEvent(int idx, OSC_MESSAGE *msg, MGR_ARGS *args);
+static int mgrJoinCaps(OSC_MESSAGE *msg, int first);
+static int mgrStep(INGRESS_PACKET *pkt, OSC_MESSAGE *msg, int idx);
+static void mgrPublish(int evt, int prev, int next, INGRESS_PACKET *pkt, OSC_MESSAGE *msg, int idx);
+static int mgrSendWireToSndModule(int ack, int port, const OSC_WIRE *wire, const OSC_WIRE *prefix, char *param);
+static int mgrSendWireToLedController(const char *msg, int len);
+static int mgrSendMessageToSender(OSC_MESSAGE *msg);
+static int mgrSendMessageTo(struct sockaddr_in *to, OSC_MESSAGE *msg);
+static int mgrSendWireTo(struct sockaddr_in *to, const uint8_t *data, int len);
+static int mgrSendLatency(struct sockaddr_in *to);
+static int mgrSendRenderResult(int code, char *path);
+#ifndef PWS_REPLAY
 static void mgrCloseSocket(void);
 static void mgrSigHandler(int sig);
+#endif
 
 #if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
 static void mgrDebugOut(char *buf, int len);
 #endif
 
+// 指示と LED の文字列はリテラルなので、送るバイト列はコンパイル時に作っておく
+#define mgrSendMessageToSndModule(port, msg, param)     mgrSendWireToSndModule(ACK_NONE, (port), &OSC_WIRE(msg), &OSC_WIRE_S(msg), (param))
+// 応答（開始・終了通知）を待つ指示（pws_ack.h）
+#define mgrSendCommandToSndModule(ack, port, msg)       mgrSendWireToSndModule((ack), (port), &OSC_WIRE(msg), &OSC_WIRE_S(msg), NULL)
+#define mgrSendMessageToLedController(msg)              mgrSendWireToLedController(("" msg), sizeof("" msg) - 1)
+
 //
 // 状態遷移テーブル
 //
@@ -139,6 +325,35 @@ static struct {
         { STATE_INIT      , NULL                }, // アップロード終了通知
         { STATE_INIT      , NULL                }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_INIT      , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_INIT      , NULL                }, // 録音開始通知
+        { STATE_INIT      , NULL                }, // 録音領域不足
+        { STATE_INIT      , NULL                }, // レイテンシ測定要求
+        { STATE_INIT      , NULL                }, // レイテンシ測定終了通知
+        { STATE_INIT      , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_INIT      , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_INIT      , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_INIT      , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_INIT      , mgrMeter            }, // 入力レベル通知
+        { STATE_INIT      , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_INIT      , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_INIT      , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_INIT      , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_INIT      , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_INIT      , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_INIT      , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_INIT      , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_INIT      , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_INIT      , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_INIT      , mgrModuleLost       }, // モジュールの停止検出（使用中）
+        { STATE_INIT      , NULL                }, // 再生開始通知
+        { STATE_INIT      , NULL                }, // チューニング開始通知
+        { STATE_INIT      , NULL                }, // 指示の応答無し
+        { STATE_INIT      , NULL                }, // Pd の再起動通知
+        { STATE_INIT      , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_INIT      , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_INIT      , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_INIT      , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -165,6 +380,35 @@ static struct {
         { STATE_APSET     , NULL                }, // アップロード終了通知
         { STATE_APSET     , NULL                }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_APSET     , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_APSET     , NULL                }, // 録音開始通知
+        { STATE_APSET     , NULL                }, // 録音領域不足
+        { STATE_APSET     , NULL                }, // レイテンシ測定要求
+        { STATE_APSET     , NULL                }, // レイテンシ測定終了通知
+        { STATE_APSET     , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_APSET     , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_APSET     , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_APSET     , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_APSET     , mgrMeter            }, // 入力レベル通知
+        { STATE_APSET     , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_APSET     , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_APSET     , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_APSET     , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_APSET     , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_APSET     , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_APSET     , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_APSET     , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_APSET     , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_APSET     , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_APSET     , mgrModuleLost       }, // モジュールの停止検出（使用中）
+        { STATE_APSET     , NULL                }, // 再生開始通知
+        { STATE_APSET     , NULL                }, // チューニング開始通知
+        { STATE_APSET     , NULL                }, // 指示の応答無し
+        { STATE_APSET     , NULL                }, // Pd の再起動通知
+        { STATE_APSET     , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_APSET     , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_APSET     , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_APSET     , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -191,6 +435,35 @@ static struct {
         { STATE_APSET_WAIT, NULL                }, // アップロード終了通知
         { STATE_APSET_WAIT, NULL                }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_APSET_WAIT, mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_APSET_WAIT, NULL                }, // 録音開始通知
+        { STATE_APSET_WAIT, NULL                }, // 録音領域不足
+        { STATE_APSET_WAIT, NULL                }, // レイテンシ測定要求
+        { STATE_APSET_WAIT, NULL                }, // レイテンシ測定終了通知
+        { STATE_APSET_WAIT, mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_APSET_WAIT, mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_APSET_WAIT, mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_APSET_WAIT, mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_APSET_WAIT, mgrMeter            }, // 入力レベル通知
+        { STATE_APSET_WAIT, mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_APSET_WAIT, mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_APSET_WAIT, mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_APSET_WAIT, mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_APSET_WAIT, mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_APSET_WAIT, mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_APSET_WAIT, mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_APSET_WAIT, mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_APSET_WAIT, mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_APSET_WAIT, mgrModuleLost       }, // モジュールの停止検出
+        { STATE_APSET_WAIT, mgrModuleLost       }, // モジュールの停止検出（使用中）
+        { STATE_APSET_WAIT, NULL                }, // 再生開始通知
+        { STATE_APSET_WAIT, NULL                }, // チューニング開始通知
+        { STATE_APSET_WAIT, NULL                }, // 指示の応答無し
+        { STATE_APSET_WAIT, NULL                }, // Pd の再起動通知
+        { STATE_APSET_WAIT, mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_APSET_WAIT, mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_APSET_WAIT, mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_APSET_WAIT, NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -207,9 +480,9 @@ static struct {
         { STATE_PD_WAIT   , NULL                }, // 録音終了通知
         { STATE_PD_WAIT   , NULL                }, // 再生ボタン押下
         { STATE_PD_WAIT   , NULL                }, // 再生終了通知
-        { STATE_PD_WAIT   , NULL                }, // ボリュームアップボタン押下
-        { STATE_PD_WAIT   , NULL                }, // ボリュームダウンボタン押下
-        { STATE_PD_WAIT   , NULL                }, // エフェクトボタン押下
+        { STATE_PD_WAIT   , mgrVolumeUp         }, // ボリュームアップボタン押下
+        { STATE_PD_WAIT   , mgrVolumeDown       }, // ボリュームダウンボタン押下
+        { STATE_PD_WAIT   , mgrEffectChange     }, // エフェクトボタン押下
         { STATE_PD_WAIT   , NULL                }, // チューニングボタン押下
         { STATE_PD_WAIT   , NULL                }, // チューニング終了通知
         { STATE_PD_WAIT   , NULL                }, // チューニング状態通知
@@ -217,6 +490,35 @@ static struct {
         { STATE_PD_WAIT   , NULL                }, // アップロード終了通知
         { STATE_PD_WAIT   , NULL                }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_PD_WAIT   , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_PD_WAIT   , NULL                }, // 録音開始通知
+        { STATE_PD_WAIT   , NULL                }, // 録音領域不足
+        { STATE_PD_WAIT   , NULL                }, // レイテンシ測定要求
+        { STATE_PD_WAIT   , NULL                }, // レイテンシ測定終了通知
+        { STATE_PD_WAIT   , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_PD_WAIT   , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_PD_WAIT   , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_PD_WAIT   , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_PD_WAIT   , mgrMeter            }, // 入力レベル通知
+        { STATE_PD_WAIT   , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_PD_WAIT   , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_PD_WAIT   , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_PD_WAIT   , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_PD_WAIT   , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_PD_WAIT   , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_PD_WAIT   , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_PD_WAIT   , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_PD_WAIT   , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_PD_WAIT   , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_PD_WAIT   , mgrPdInitError      }, // モジュールの停止検出（使用中）
+        { STATE_PD_WAIT   , NULL                }, // 再生開始通知
+        { STATE_PD_WAIT   , NULL                }, // チューニング開始通知
+        { STATE_PD_WAIT   , NULL                }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_PD_WAIT   , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_PD_WAIT   , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_PD_WAIT   , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_PD_WAIT   , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -243,6 +545,35 @@ static struct {
         { STATE_IDLE      , mgrUploadStopped    }, // アップロード終了通知
         { STATE_IDLE      , mgrDownloadStopped  }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_IDLE      , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_IDLE      , NULL                }, // 録音開始通知
+        { STATE_IDLE      , mgrRecNoSpace       }, // 録音領域不足
+        { STATE_CALIB     , mgrCalibStart       }, // レイテンシ測定要求
+        { STATE_IDLE      , NULL                }, // レイテンシ測定終了通知
+        { STATE_IDLE      , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_IDLE      , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_IDLE      , mgrRenderStart      }, // エフェクト書出し要求
+        { STATE_IDLE      , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_IDLE      , mgrMeter            }, // 入力レベル通知
+        { STATE_IDLE      , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_IDLE      , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_IDLE      , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_IDLE      , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_IDLE      , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_IDLE      , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_IDLE      , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_IDLE      , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_IDLE      , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_IDLE      , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_IDLE      , mgrModuleLost       }, // モジュールの停止検出（使用中）
+        { STATE_IDLE      , NULL                }, // 再生開始通知
+        { STATE_IDLE      , NULL                }, // チューニング開始通知
+        { STATE_IDLE      , NULL                }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_IDLE      , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_IDLE      , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_IDLE      , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_IDLE      , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -269,6 +600,35 @@ static struct {
         { STATE_REC       , mgrUploadStopped    }, // アップロード終了通知
         { STATE_REC       , mgrDownloadStopped  }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_REC       , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_REC       , mgrRecStarted       }, // 録音開始通知
+        { STATE_REC       , NULL                }, // 録音領域不足
+        { STATE_REC       , NULL                }, // レイテンシ測定要求
+        { STATE_REC       , NULL                }, // レイテンシ測定終了通知
+        { STATE_REC       , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_REC       , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_REC       , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_REC       , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_REC       , mgrMeter            }, // 入力レベル通知
+        { STATE_REC       , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_REC       , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_REC       , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_REC       , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_REC       , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_REC       , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_REC       , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_REC       , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_REC       , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_REC       , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_IDLE      , mgrModuleLostActive }, // モジュールの停止検出（使用中）
+        { STATE_REC       , NULL                }, // 再生開始通知
+        { STATE_REC       , NULL                }, // チューニング開始通知
+        { STATE_IDLE      , mgrCommandTimeout   }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_REC       , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_REC       , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_REC       , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_REC       , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -295,6 +655,35 @@ static struct {
         { STATE_PLAY      , mgrUploadStopped    }, // アップロード終了通知
         { STATE_PLAY      , mgrDownloadStopped  }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_PLAY      , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_PLAY      , NULL                }, // 録音開始通知
+        { STATE_PLAY      , NULL                }, // 録音領域不足
+        { STATE_PLAY      , NULL                }, // レイテンシ測定要求
+        { STATE_PLAY      , NULL                }, // レイテンシ測定終了通知
+        { STATE_PLAY      , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_PLAY      , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_PLAY      , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_PLAY      , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_PLAY      , mgrMeter            }, // 入力レベル通知
+        { STATE_PLAY      , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_PLAY      , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_PLAY      , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_PLAY      , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_PLAY      , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_PLAY      , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_PLAY      , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_PLAY      , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_PLAY      , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_PLAY      , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_IDLE      , mgrModuleLostActive }, // モジュールの停止検出（使用中）
+        { STATE_PLAY      , mgrPlayStarted      }, // 再生開始通知
+        { STATE_PLAY      , NULL                }, // チューニング開始通知
+        { STATE_IDLE      , mgrCommandTimeout   }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_PLAY      , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_PLAY      , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_PLAY      , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_PLAY      , NULL                }, // レイテンシ解析終了通知
     },
 
     //
@@ -321,12 +710,95 @@ static struct {
         { STATE_TUNE      , mgrUploadStopped    }, // アップロード終了通知
         { STATE_TUNE      , mgrDownloadStopped  }, // ダウンロード終了通知
         { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_TUNE      , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_TUNE      , NULL                }, // 録音開始通知
+        { STATE_TUNE      , NULL                }, // 録音領域不足
+        { STATE_TUNE      , NULL                }, // レイテンシ測定要求
+        { STATE_TUNE      , NULL                }, // レイテンシ測定終了通知
+        { STATE_TUNE      , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_TUNE      , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_TUNE      , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_TUNE      , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_TUNE      , mgrMeter            }, // 入力レベル通知
+        { STATE_TUNE      , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_TUNE      , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_TUNE      , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_TUNE      , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_TUNE      , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_TUNE      , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_TUNE      , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_TUNE      , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_TUNE      , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_TUNE      , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_IDLE      , mgrModuleLostActive }, // モジュールの停止検出（使用中）
+        { STATE_TUNE      , NULL                }, // 再生開始通知
+        { STATE_TUNE      , mgrTuningStarted    }, // チューニング開始通知
+        { STATE_IDLE      , mgrCommandTimeout   }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_TUNE      , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_TUNE      , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_TUNE      , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_TUNE      , NULL                }, // レイテンシ解析終了通知
+    },
+
+    //
+    // STATE_CALIB：レイテンシ測定中
+    //
+    {
+        { STATE_CALIB     , NULL                }, // 起動
+        { STATE_CALIB     , NULL                }, // AP設定ボタン押下
+        { STATE_CALIB     , NULL                }, // AP設定終了通知
+        { STATE_CALIB     , NULL                }, // AP設定異常通知
+        { STATE_CALIB     , NULL                }, // PD初期化終了通知
+        { STATE_CALIB     , NULL                }, // PD初期化異常通知
+        { STATE_CALIB     , NULL                }, // 録音ボタン押下
+        { STATE_CALIB     , NULL                }, // 録音終了通知
+        { STATE_CALIB     , NULL                }, // 再生ボタン押下
+        { STATE_CALIB     , NULL                }, // 再生終了通知
+        { STATE_CALIB     , NULL                }, // ボリュームアップボタン押下
+        { STATE_CALIB     , NULL                }, // ボリュームダウンボタン押下
+        { STATE_CALIB     , NULL                }, // エフェクトボタン押下
+        { STATE_CALIB     , NULL                }, // チューニングボタン押下
+        { STATE_CALIB     , NULL                }, // チューニング終了通知
+        { STATE_CALIB     , NULL                }, // チューニング状態通知
+        { STATE_CALIB     , mgrUploadStarted    }, // アップロード開始通知
+        { STATE_CALIB     , mgrUploadStopped    }, // アップロード終了通知
+        { STATE_CALIB     , mgrDownloadStopped  }, // ダウンロード終了通知
+        { STATE_INIT      , mgrShutdown         }, // シャットダウンボタン押下
+        { STATE_CALIB     , mgrLibQuery         }, // 録音ライブラリ問合せ
+        { STATE_CALIB     , NULL                }, // 録音開始通知
+        { STATE_CALIB     , NULL                }, // 録音領域不足
+        { STATE_CALIB     , NULL                }, // レイテンシ測定要求
+        { STATE_CALIB     , mgrCalibStopped     }, // レイテンシ測定終了通知
+        { STATE_CALIB     , mgrLatencyQuery     }, // レイテンシ問合せ
+        { STATE_CALIB     , mgrLatencyAlign     }, // レイテンシ補正設定
+        { STATE_CALIB     , mgrRenderReject     }, // エフェクト書出し要求
+        { STATE_CALIB     , mgrRenderStopped    }, // エフェクト書出し終了通知
+        { STATE_CALIB     , mgrMeter            }, // 入力レベル通知
+        { STATE_CALIB     , mgrMeterQuery       }, // 入力レベル問合せ
+        { STATE_CALIB     , mgrIngressQuery     }, // 受信キュー統計問合せ
+        { STATE_CALIB     , mgrStatsQuery       }, // 処理時間統計問合せ
+        { STATE_CALIB     , mgrFlightDump       }, // 状態遷移の記録の書出し要求
+        { STATE_CALIB     , mgrSubscribe        }, // 状態通知の購読要求
+        { STATE_CALIB     , mgrUnsubscribe      }, // 状態通知の購読解除
+        { STATE_CALIB     , mgrModuleQuery      }, // モジュールの問合せ
+        { STATE_CALIB     , mgrModuleAnnounce   }, // モジュールの登録
+        { STATE_CALIB     , mgrModuleHeartbeat  }, // モジュールの心拍
+        { STATE_CALIB     , mgrModuleLost       }, // モジュールの停止検出
+        { STATE_IDLE      , mgrModuleLostActive }, // モジュールの停止検出（使用中）
+        { STATE_CALIB     , NULL                }, // 再生開始通知
+        { STATE_CALIB     , NULL                }, // チューニング開始通知
+        { STATE_CALIB     , NULL                }, // 指示の応答無し
+        { STATE_PD_WAIT   , mgrPdRestarted      }, // Pd の再起動通知
+        { STATE_CALIB     , mgrBootQuery        }, // 起動の記録の問合せ
+        { STATE_CALIB     , mgrPowerQuery       }, // 省電力の問合せ
+        { STATE_CALIB     , mgrTakeFinished     }, // 録音ファイル確定通知
+        { STATE_IDLE      , mgrCalibMeasured    }, // レイテンシ解析終了通知
     },
 };
 
-#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
 //
-// ステート文字列
+// ステート文字列（ログと状態遷移の記録に使う）
 //
 static char *strState[] = {
     "初期化中",
@@ -337,6 +809,7 @@ static char *strState[] = {
     "録音中",
     "再生中",
     "チューニング中",
+    "レイテンシ測定中",
 };
 
 //
@@ -363,94 +836,164 @@ static char *strEvt[] = {
     "アップロード終了通知",
     "ダウンロード終了通知",
     "シャットダウンボタン押下 ",
+    "録音ライブラリ問合せ",
+    "録音開始通知",
+    "録音領域不足",
+    "レイテンシ測定要求",
+    "レイテンシ測定終了通知",
+    "レイテンシ問合せ",
+    "レイテンシ補正設定",
+    "エフェクト書出し要求",
+    "エフェクト書出し終了通知",
+    "入力レベル通知",
+    "入力レベル問合せ",
+    "受信キュー統計問合せ",
+    "処理時間統計問合せ",
+    "状態遷移の記録の書出し要求",
+    "状態通知の購読要求",
+    "状態通知の購読解除",
+    "モジュールの問合せ",
+    "モジュールの登録",
+    "モジュールの心拍",
+    "モジュールの停止検出",
+    "モジュールの停止検出（使用中）",
+    "再生開始通知",
+    "チューニング開始通知",
+    "指示の応答無し",
+    "Pd の再起動通知",
+    "起動の記録の問合せ",
+    "省電力の問合せ",
+    "録音ファイル確定通知",
+    "レイテンシ解析終了通知",
+};
+
+//
+// 状態の識別子（トレースと状態遷移通知に使う）
+//
+static const char *strStateId[] = {
+    "INIT", "APSET", "APSET_WAIT", "PD_WAIT", "IDLE", "REC", "PLAY", "TUNE", "CALIB",
 };
-#endif
 
 static int sock        = -1;
+
+#ifndef PWS_REPLAY
 static int mainFinish  =  0;
 static pthread_mutex_t mainMutex = PTHREAD_MUTEX_INITIALIZER;
 
 int main(void)
 {
-    int rc, n, evt, next, ret, loop;
-    char buf[RECV_BUF_SIZE];
+    int rc, loop;
     struct sockaddr_in addr;
-    int (*func)(int code, void *arg1, void *arg2);
-    OSC_MESSAGE oscMsg;
+    INGRESS_PACKET *pkt;
 
+    // 起動の記録（電源投入からの時刻）
+    bootInitialize();
+    bootMark(BOOT_MAIN);
     PWS_DEBUG("START\n");
 
     // マネージャーのコンテキスト初期化
     memset(&MgrCtx, 0, sizeof(MgrCtx));
 
+    // スケジューリングとメモリのロック（スレッドを作る前に）
+    rtInitialize();
+
+    // ソケット作成（ボタンの監視より先に、systemd から渡されていればそれを使う）
+    //   ここから先のボタン操作・モジュールの通知は処理できるまで受信キューに溜まる
+    sock = bootListenSocket();
+    if (sock == -1) {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock == -1) {
+            PWS_DEBUG("Socket Error\n");
+            return 1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port        = htons(PWS_PORT_MANAGER);
+
+        rc = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+        if (rc == -1) {
+            close(sock);
+            sock = -1;
+            PWS_DEBUG("Bind Error\n");
+            return 2;
+        }
+    }
+    PWS_DEBUG("sock    %d\n", sock);
+    bootMark(BOOT_BOUND);
+
+    // 受信キューの初期化
+    ingressInitialize(sock);
+
+    // マネージャー自身・モジュールへの通知の送信元
+    utilSetSocket(sock);
+
+    // 状態通知の購読の初期化
+    busInitialize(sock);
+
     // GPIO初期化
-    gpioInitialize();
+    if (gpioInitialize() < 0) {
+        PWS_DEBUG("GPIO Error\n");
+        mgrCloseSocket();
+        return 3;
+    }
+
+    // 受信できるようになったので、後続のサービスの起動を待たせない
+    bootNotify("READY=1");
+    bootMark(BOOT_READY);
+
+    // 録音ライブラリ初期化
+    libInitialize();
+
+    // 録音領域管理の初期化
+    storageInitialize();
+
+    // 前回のレイテンシ測定結果の読込み
+    latInitialize();
+    bootMark(BOOT_STORAGE);
 
     // シグナルの設定
     signal(SIGTERM, mgrSigHandler);
     signal(SIGINT , mgrSigHandler);
     signal(SIGKILL, mgrSigHandler);
- 
-    // ソケット作成
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock == -1) {
-        PWS_DEBUG("Socket Error\n");
-        gpioFinish();
-        return 1;
-    }
-    PWS_DEBUG("sock    %d\n", sock);
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port        = htons(PWS_PORT_MANAGER);
+    // モジュールの登録と死活監視
+    regInitialize();
+    regStart();
 
-    rc = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
-    if (rc == -1) {
-        gpioFinish();
-        close(sock);
-        sock = -1;
-        PWS_DEBUG("Bind Error\n");
-        return 2;
-    }
+    // 指示の応答待ち
+    ackInitialize();
+    ackStart();
+
+    // Pd の監視と再起動
+    supInitialize();
+    supStart();
+
+    // 状態遷移の記録（異常終了時、長時間の待ち状態で書出す）
+    flightInitialize(PWS_FLIGHT_FILE, strState, STATE_MAX, strEvt, EVT_MAX);
+    flightSetStuck(STATE_PD_WAIT   , MGR_STUCK_PD_WAIT_SEC);
+    flightSetStuck(STATE_APSET_WAIT, MGR_STUCK_APSET_WAIT_SEC);
+
+    // 未使用時の省電力（LED が点滅していなければ入る）
+    pwrInitialize();
+    pwrStart(ledIsSteady);
 
     // 起動モードの判定
     gpioCheckApMode();
+    bootMark(BOOT_AP_CHECK);
+
+    // 受信と状態遷移はボタン監視の次に優先する
+    rtApply(RT_ROLE_MANAGER);
 
     loop = 1;
     while (loop) {
-        memset(&oscMsg, 0, sizeof(oscMsg));
-        memset(buf, 0, sizeof(buf));
-        n = recv(sock, buf, sizeof(buf) - 1, 0);
-        if (n < 0) {
+        // ボタン操作 → モジュールの通知 → 状態通知 の順に取出す
+        if (ingressReceive(&pkt) < 0) {
             PWS_DEBUG("ERROR: recv\n");
             break;
         }
-#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
-        mgrDebugOut(buf, n);
-#endif
-        evt = mgrGetEvent(buf, n, &oscMsg);
-#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
-        if (evt >= 0) {
-            PWS_DEBUG("evt=%2d [%s]\n", evt, strEvt[evt]);
-        }
-        else {
-            PWS_DEBUG("evt=%2d [（イベント無し）]\n", evt);
-        }
-#endif
-        if (evt >= 0) {
-            next = STATE_TABLE[MgrCtx.state][evt].next;
-            func = STATE_TABLE[MgrCtx.state][evt].func;
-            if (func != NULL) {
-                ret = func(oscMsg.data[0].u.i, oscMsg.data[1].u.s, oscMsg.data[2].u.s);
-                if (ret < 0) {
-                    // func error !!
-                    PWS_DEBUG("ERROR: func()[%s][%s]\n", strState[MgrCtx.state], strEvt[evt]);
-                }
-            }
-            PWS_DEBUG("state  [%s] --> [%s]\n", strState[MgrCtx.state], strState[next]);
-            MgrCtx.state = next;
-        }
+        mgrDispatch(pkt);
 
         pthread_mutex_lock(&mainMutex);
         if (mainFinish == 1) {
@@ -459,12 +1002,101 @@ int main(void)
         pthread_mutex_unlock(&mainMutex);
     }
 
+    bootNotify("STOPPING=1");
+
+    // 省電力中に待っているスレッドを先に起こす
+    pwrFinish();
+
+    supFinish();
+
+    ackFinish();
+
+    regFinish();
+
+    flightFinish();
+
+    peakFinish();
+
+    storageFinish();
+
+    libFinish();
+
     gpioFinish();
 
     mgrCloseSocket();
 
+    trieFree(MgrTrie);
+
     return 0;
 }
+#else
+//
+// トレース再生（bench/bench_replay）からの呼出し
+//   ソケット・GPIO・時計は再生側で差し替え、状態遷移の処理だけをそのまま使う
+//
+void mgrReplayReset(void)
+{
+    memset(&MgrCtx, 0, sizeof(MgrCtx));
+    busInitialize(sock);
+    regInitialize();
+    ackInitialize();
+    supInitialize();
+    bootInitialize();
+    pwrInitialize();
+    pwrReplayEnable();
+}
+
+int mgrReplayCheck(void)
+{
+    return regCheck() + ackCheck() + pwrReplayCheck();
+}
+
+// 異常終了時に状態遷移の記録を path へ書出す
+int mgrReplayFlight(const char *path)
+{
+    return flightInitialize(path, strState, STATE_MAX, strEvt, EVT_MAX);
+}
+
+int mgrReplayDispatch(INGRESS_PACKET *pkt)
+{
+    return mgrDispatch(pkt);
+}
+
+// 最初に一致したイベント
+int mgrReplayGetEvent(char *buf, int len)
+{
+    int idx;
+    OSC_MESSAGE oscMsg;
+    MGR_ARGS args;
+
+    if (mgrMatchEvent(buf, len, &oscMsg, &idx, 1) <= 0) {
+        return EVT_NONE;
+    }
+    return mgrGetEvent(idx, &oscMsg, &args);
+}
+
+int mgrReplayGetState(void)
+{
+    return MgrCtx.state;
+}
+
+const char *mgrReplayStateId(int state)
+{
+    return (state >= 0 && state < STATE_MAX) ? strStateId[state] : "?";
+}
+
+int mgrReplayFindState(const char *id)
+{
+    int i;
+
+    for (i = 0; i < STATE_MAX; i++) {
+        if (strcmp(strStateId[i], id) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+#endif  // PWS_REPLAY
 
 
 //
@@ -477,9 +1109,10 @@ static int  mgrInitialize(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
+    bootMark(BOOT_PD_WAIT);
+
     // LED 設定（黄色点灯）
-    mgrSendMessageToLedController(MSG_LED_RED_OFF);
-    mgrSendMessageToLedController(MSG_LED_GREEN_OFF);
+    mgrSendMessageToLedController(MSG_LED_RED_GREEN_OFF);
     mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK);
 
     return 0;
@@ -562,11 +1195,19 @@ static int mgrPdInitFinished(int code, void *arg1, void *arg2)
     case STATE_PD_WAIT:
         // LED 設定（黄色点灯）
         mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
+        // 再起動した Pd へ音量とエフェクトを戻す
+        mgrWarmStart();
         break;
     default:
         break;
     }
 
+    // 最初のアイドルまでの起動の記録を出力
+    if (MgrCtx.state != STATE_APSET && bootMark(BOOT_IDLE) == 0) {
+        bootReport();
+        bootNotify("STATUS=idle");
+    }
+
     return 0;
 }
 
@@ -603,7 +1244,7 @@ static int  mgrRecStart(int code, void *arg1, void *arg2)
     // LED 設定（黄色点灯）
     mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
 
-    mgrSendMessageToSndModule(PWS_PORT_RECORDER, MSG_REC_START, NULL);
+    mgrSendCommandToSndModule(ACK_REC_START, PWS_PORT_RECORDER, MSG_REC_START);
     
     return 0;
 }
@@ -613,7 +1254,35 @@ static int  mgrRecStop(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
-    mgrSendMessageToSndModule(PWS_PORT_RECORDER, MSG_REC_STOP, NULL);
+    // 開始通知より先に止める場合は終了通知だけを待つ
+    ackCancel(ACK_REC_START);
+    mgrSendCommandToSndModule(ACK_REC_STOP, PWS_PORT_RECORDER, MSG_REC_STOP);
+
+    return 0;
+}
+
+// 録音開始通知受信
+static int  mgrRecStarted(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    mgrAck(ACK_REC_START);
+
+    // 録音中のファイルからピークファイルを生成（補正で切り詰める分は除く）
+    if (code == 0 && arg1 != NULL) {
+        peakStart(arg1, latGetShift());
+    }
+
+    return 0;
+}
+
+// 録音領域不足（録音せずにアイドルのまま）
+static int  mgrRecNoSpace(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    // LED 設定（黄色早点滅）
+    mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK_FAST);
 
     return 0;
 }
@@ -623,12 +1292,20 @@ static int  mgrRecStopped(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
+    ackCancel(ACK_REC_START);
+    mgrAck(ACK_REC_STOP);
+
+    // ピークファイルの生成終了（ファイルが閉じられるまで追従し、終わったら MSG_TAKE_FINISHED が届く）
+    if (peakStop(code) < 0 && code == 0 && arg1 != NULL) {
+        // 追従していなければ（開始通知にファイルが無かった）閉じられるのを待って読む
+        if (peakStart(arg1, latGetShift()) < 0 || peakStop(code) < 0) {
+            mgrTakeFinished(-1, arg1, NULL);
+        }
+    }
+
     // LED 設定（赤色消灯）
     mgrSendMessageToLedController(MSG_LED_RED_OFF);
-    if (code == 0) {
-        mgrSendMessageToSndModule(PWS_PORT_FILE_UPLOADER, MSG_UPLOAD_START, arg1);
-    }
-    else {
+    if (code != 0 || arg1 == NULL) {
 		// LED 設定（黄色早点滅）
         mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK_FAST);
     }
@@ -636,6 +1313,27 @@ static int  mgrRecStopped(int code, void *arg1, void *arg2)
     return 0;
 }
 
+// 録音ファイル確定通知受信（code: ピークファイルの生成結果、arg1: 録音ファイル）
+//   Pd がファイルを閉じてピークファイルを書出した後に届くので、ここで登録してアップロードする
+static int  mgrTakeFinished(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    if (arg1 == NULL) {
+        return -1;
+    }
+
+    // 録音ライブラリへ登録（レイテンシ補正の切り詰めはピーク生成のスレッドで済んでいる）
+    libAddTake(arg1);
+    mgrSendMessageToSndModule(PWS_PORT_FILE_UPLOADER, MSG_UPLOAD_START, arg1);
+    libSetUploadState(arg1, LIB_UPLOAD_QUEUED);
+
+    // 次の録音に備えて空き容量を確認
+    storageKick();
+
+    return 0;
+}
+
 // 再生開始
 static int  mgrPlayStart(int code, void *arg1, void *arg2)
 {
@@ -648,7 +1346,7 @@ static int  mgrPlayStart(int code, void *arg1, void *arg2)
     // LED 設定（黄色点灯）
     mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
 
-    mgrSendMessageToSndModule(PWS_PORT_PLAYER, MSG_PLAY_START, NULL);
+    mgrSendCommandToSndModule(ACK_PLAY_START, PWS_PORT_PLAYER, MSG_PLAY_START);
 
     return 0;
 }
@@ -658,7 +1356,18 @@ static int  mgrPlayStop(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
-    mgrSendMessageToSndModule(PWS_PORT_PLAYER, MSG_PLAY_STOP, NULL);
+    ackCancel(ACK_PLAY_START);
+    mgrSendCommandToSndModule(ACK_PLAY_STOP, PWS_PORT_PLAYER, MSG_PLAY_STOP);
+
+    return 0;
+}
+
+// 再生開始通知受信
+static int  mgrPlayStarted(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    mgrAck(ACK_PLAY_START);
 
     return 0;
 }
@@ -668,6 +1377,9 @@ static int  mgrPlayStopped(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
+    ackCancel(ACK_PLAY_START);
+    mgrAck(ACK_PLAY_STOP);
+
     // LED 設定（緑色消灯）
     mgrSendMessageToLedController(MSG_LED_GREEN_OFF);
     if (code != 0) {
@@ -682,8 +1394,14 @@ static int  mgrPlayStopped(int code, void *arg1, void *arg2)
 static int  mgrVolumeUp(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
-    
-    mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_UP, NULL);
+
+    // PD初期化終了待ちの間は覚えておくだけ（初期化終了で送る）
+    if (MgrCtx.state != STATE_PD_WAIT) {
+        mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_UP, NULL);
+    }
+    if (MgrCtx.warm.volume < MGR_VOLUME_MAX - MGR_VOLUME_DEFAULT) {
+        MgrCtx.warm.volume++;
+    }
 
     return 0;
 }
@@ -693,7 +1411,13 @@ static int  mgrVolumeDown(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
-    mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_DOWN, NULL);
+    // PD初期化終了待ちの間は覚えておくだけ（初期化終了で送る）
+    if (MgrCtx.state != STATE_PD_WAIT) {
+        mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_DOWN, NULL);
+    }
+    if (MgrCtx.warm.volume > MGR_VOLUME_MIN - MGR_VOLUME_DEFAULT) {
+        MgrCtx.warm.volume--;
+    }
 
     return 0;
 }
@@ -703,7 +1427,11 @@ static int  mgrEffectChange(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
-    mgrSendMessageToSndModule(PWS_PORT_EFFECT_CONTROLLER, MSG_EFFECT_CHANGE, NULL);
+    // PD初期化終了待ちの間は覚えておくだけ（初期化終了で送る）
+    if (MgrCtx.state != STATE_PD_WAIT) {
+        mgrSendMessageToSndModule(PWS_PORT_EFFECT_CONTROLLER, MSG_EFFECT_CHANGE, NULL);
+    }
+    MgrCtx.warm.effect = MgrCtx.warm.effect % MGR_EFFECT_NUM + 1;
 
     return 0;
 }
@@ -718,7 +1446,7 @@ static int  mgrTuningStart(int code, void *arg1, void *arg2)
     // LED 設定（黄色点灯）
     mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
 
-    mgrSendMessageToSndModule(PWS_PORT_TUNER, MSG_TUNING_START, NULL);
+    mgrSendCommandToSndModule(ACK_TUNING_START, PWS_PORT_TUNER, MSG_TUNING_START);
 
     return 0;
 }
@@ -728,7 +1456,18 @@ static int  mgrTuningStop(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
-    mgrSendMessageToSndModule(PWS_PORT_TUNER, MSG_TUNING_STOP, NULL);
+    ackCancel(ACK_TUNING_START);
+    mgrSendCommandToSndModule(ACK_TUNING_STOP, PWS_PORT_TUNER, MSG_TUNING_STOP);
+
+    return 0;
+}
+
+// チューニング開始通知受信
+static int  mgrTuningStarted(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    mgrAck(ACK_TUNING_START);
 
     return 0;
 }
@@ -737,11 +1476,12 @@ static int  mgrTuningStop(int code, void *arg1, void *arg2)
 static int  mgrTuningStopped(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
+
+    ackCancel(ACK_TUNING_START);
+    mgrAck(ACK_TUNING_STOP);
     
-    // LED 設定（赤色消灯）
-    mgrSendMessageToLedController(MSG_LED_RED_OFF);
-    // LED 設定（緑色消灯）
-    mgrSendMessageToLedController(MSG_LED_GREEN_OFF);
+    // LED 設定（赤色・緑色消灯）
+    mgrSendMessageToLedController(MSG_LED_RED_GREEN_OFF);
     if (code != 0) {
 		// LED 設定（黄色早点滅）
         mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK_FAST);
@@ -773,6 +1513,14 @@ static int mgrUploadStopped(int code, void *arg1, void *arg2)
 {
     PWS_DEBUG("action: %s\n", __func__);
 
+    // 録音ライブラリのアップロード状態更新
+    libSetUploadState(arg1, (code == 0) ? LIB_UPLOAD_DONE : LIB_UPLOAD_ERROR);
+
+    // アップロード済みになったので削除候補が増えた
+    if (code == 0) {
+        storageKick();
+    }
+
     if (code == 0) {
         // LED 設定（黄色点灯）
         mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
@@ -814,137 +1562,991 @@ static int mgrShutdown(int code, void *arg1, void *arg2)
     return 0;
 }
 
-// イベント取得
-static int mgrGetEvent(char *buf, int len, OSC_MESSAGE *msg)
-{
-    int i, ret, evt = EVT_NONE;
-    static struct {
-        char* msg;
-        int   evt;
-    } EVT_TABLE[] = {
-        { MSG_INITIALIZE        , EVT_INITIALIZE            },  // 起動
-        { MSG_PUSH_AP_SET_BTN   , EVT_PUSH_AP_SET_BTN       },  // AP設定ボタン押下
-        { MSG_AP_CONFIGURED     , EVT_RECV_AP_CONFIGURED    },  // AP設定終了通知
-        { MSG_PD_INIT_FINISHED  , EVT_RECV_PD_INIT_FINISHED },  // PD初期化終了通知
-        { MSG_PUSH_REC_BTN      , EVT_PUSH_REC_BTN          },  // 録音ボタン押下
-        { MSG_REC_STOPPED       , EVT_RECV_REC_STOPPED      },  // 録音終了通知
-        { MSG_PUSH_PLAY_BTN     , EVT_PUSH_PLAY_BTN         },  // 再生ボタン押下
-        { MSG_PLAY_STOPPED      , EVT_RECV_PLAY_STOPPED     },  // 再生終了通知
-        { MSG_PUSH_VOL_UP_BTN   , EVT_PUSH_VOL_UP_BTN       },  // ボリュームアップボタン押下
-        { MSG_PUSH_VOL_DOWN_BTN , EVT_PUSH_VOL_DOWN_BTN     },  // ボリュームダウンボタン押下
-        { MSG_PUSH_EFFECT_BTN   , EVT_PUSH_EFFECT_BTN       },  // エフェクトボタン押下
-        { MSG_PUSH_TUNING_BTN   , EVT_PUSH_TUNING_BTN       },  // チューニングボタン押下
-        { MSG_TUNING_STOPPED    , EVT_RECV_TUNING_STOPPED   },  // チューニング終了通知
-        { MSG_TUNING_COND       , EVT_RECV_TUNING_COND      },  // チューニング状態通知
-        { MSG_UPLOAD_STARTED    , EVT_RECV_UPLOAD_STARTED   },  // アップロード開始通知
-        { MSG_UPLOAD_STOPPED    , EVT_RECV_UPLOAD_STOPPED   },  // アップロード終了通知
-        { MSG_DOWNLOAD_STOPPED  , EVT_RECV_DOWNLOAD_STOPPED },  // ダウンロード終了通知
-        { MSG_PUSH_SHUTDOWN_BTN , EVT_PUSH_SHUTDOWN_BTN     },  // シャットダウンボタン押下 
-        { NULL                  , -1                        },
-    };
+// 録音ライブラリ問合せ（code: 先頭インデックス）
+static int mgrLibQuery(int code, void *arg1, void *arg2)
+{
+    int i, idx, count, len;
+    char hash[17];
+    uint8_t sendBuf[SEND_BUF_SIZE];
+    LIB_TAKE take;
+    OSC_MESSAGE oscMsg;
 
-    ret = oscDecode((uint8_t *)buf, len, msg);
-    if (ret < 0) {
-        PWS_DEBUG("oscDecode Error\n");
-        return -1;
-    }
+    PWS_DEBUG("action: %s\n", __func__);
 
-	PWS_DEBUG("addr=[%s]\n\n", msg->addr);
-    
-    for (i = 0; EVT_TABLE[i].msg != NULL; i++) {
-        if (strcmp(msg->addr, EVT_TABLE[i].msg) == 0) {
-            evt = EVT_TABLE[i].evt;
-        }
+    // 件数
+    count = libGetCount();
+    if (oscEncodeI(&OSC_WIRE_I(MSG_LIB_COUNT), count, sendBuf, &len) == 0) {
+        mgrSendWireTo(&MgrCtx.from, sendBuf, len);
     }
 
-    switch(evt) {
-    case EVT_RECV_AP_CONFIGURED:
-        if (msg->num > 0 && msg->data[0].type == 'i' && msg->data[0].u.i < 0) {
-            evt = EVT_RECV_AP_CONFIG_ERROR;
-        }
-        break;
-    case EVT_RECV_PD_INIT_FINISHED:
-        if (msg->num > 0 && msg->data[0].type == 'i' && msg->data[0].u.i < 0) {
-            evt = EVT_RECV_PD_INIT_ERROR;
+    // 指定位置から LIB_QUERY_MAX 件分の情報
+    for (i = 0; i < LIB_QUERY_MAX; i++) {
+        idx = code + i;
+        if (idx < 0 || libGetTake(idx, &take) < 0) {
+            break;
         }
-        break;
-    default:
-        break;
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)take.hash);
+
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_LIB_TAKE;
+        oscMsg.num  = 10;
+        oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = idx;
+        oscMsg.data[1].type = 's'; oscMsg.data[1].dlen = strlen(take.path); oscMsg.data[1].u.s = take.path;
+        oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = take.duration;
+        oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = take.rate;
+        oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = take.channels;
+        oscMsg.data[5].type = 'i'; oscMsg.data[5].dlen = 4; oscMsg.data[5].u.i = take.bits;
+        oscMsg.data[6].type = 'f'; oscMsg.data[6].dlen = 4; oscMsg.data[6].u.f = take.peak;
+        oscMsg.data[7].type = 'f'; oscMsg.data[7].dlen = 4; oscMsg.data[7].u.f = take.rms;
+        oscMsg.data[8].type = 'i'; oscMsg.data[8].dlen = 4; oscMsg.data[8].u.i = take.upload;
+        oscMsg.data[9].type = 's'; oscMsg.data[9].dlen = strlen(hash); oscMsg.data[9].u.s = hash;
+        mgrSendMessageToSender(&oscMsg);
     }
 
-    return evt;
+    return 0;
 }
 
-// メッセージを SND モジュールへ送信
-static int mgrSendMessageToSndModule(int port, char *msg, char *param)
+// レイテンシ測定開始
+static int mgrCalibStart(int code, void *arg1, void *arg2)
 {
-    int n, ret, sock, len;
-    uint8_t sendBuf[SEND_BUF_SIZE];
-    struct sockaddr_in addr;
-    OSC_MESSAGE oscMsg;
-
-	PWS_DEBUG("mgrSendMessageToSndModule port=%d\n", port);
+    PWS_DEBUG("action: %s\n", __func__);
 
-    memset(&oscMsg, 0, sizeof(oscMsg));
+    // 結果は要求元へ返す
+    memcpy(&MgrCtx.calibFrom, &MgrCtx.from, sizeof(MgrCtx.calibFrom));
 
-    oscMsg.addr = msg;
-    if (param != NULL && strlen(param) > 0) {
-        oscMsg.num  = 1;
-        oscMsg.data[0].dlen = strlen(param);
-        oscMsg.data[0].type = 's';
-        oscMsg.data[0].u.s  = param;
-    }
-    else {
-        oscMsg.num  = 0;
-    }
-    ret = oscEncode(&oscMsg, (uint8_t *)sendBuf, &len);
-    if (ret < 0) {
-        return -1;
-    }
+    // LED 設定（赤色点滅）
+    mgrSendMessageToLedController(MSG_LED_RED_BLINK);
 
-#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
-    mgrDebugOut((char *)sendBuf, len);
-#endif
+    mgrSendMessageToSndModule(PWS_PORT_CALIBRATOR, MSG_CALIB_START, NULL);
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock == -1) {
-        PWS_DEBUG("ERROR: Socket\n");
-        return -1;
-    }
+    return 0;
+}
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    addr.sin_port        = htons(port);
-    n = sendto(sock, sendBuf, len, 0, (struct sockaddr *)&addr, sizeof(addr));
-    if (n == -1) {
-        PWS_DEBUG("ERROR: Sendto\n");
-        close(sock);
-        return -1;
-    }
+// レイテンシ測定終了通知受信（arg1: 測定用ファイル）
+//   解析は解析スレッドで行い、MSG_CALIB_MEASURED が届くまでレイテンシ測定中のまま
+static int mgrCalibStopped(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
 
-    close(sock);
+    // LED 設定（赤色消灯）
+    mgrSendMessageToLedController(MSG_LED_RED_OFF);
 
-    return 0;
+    // 失敗していれば解析せずに失敗が届く
+    return latMeasureStart((code == 0) ? arg1 : NULL);
 }
 
-// メッセージを LED Controller へ送信
-static int mgrSendMessageToLedController(char *msg)
+// レイテンシ解析終了通知受信（code: 0: 成功、-1: 失敗）
+static int mgrCalibMeasured(int code, void *arg1, void *arg2)
 {
-    int n, sock;
-    struct sockaddr_in addr;
+    int ret = (code == 0) ? 0 : -1;
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock == -1) {
-        PWS_DEBUG("ERROR: Socket\n");
-        return -1;
-    }
+    PWS_DEBUG("action: %s\n", __func__);
+
+    if (ret == 0) {
+        // LED 設定（黄色点灯）
+        mgrSendMessageToLedController(MSG_LED_YELLOW_ON);
+    }
+    else {
+        // LED 設定（黄色早点滅）
+        mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK_FAST);
+    }
+
+    mgrSendLatency(&MgrCtx.calibFrom);
+
+    return ret;
+}
+
+// レイテンシ問合せ
+static int mgrLatencyQuery(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    return mgrSendLatency(&MgrCtx.from);
+}
+
+// 録音の自動補正設定（code: 0=無効、1=有効）
+static int mgrLatencyAlign(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    latSetAlign(code);
+
+    return mgrSendLatency(&MgrCtx.from);
+}
+
+// エフェクト書出し開始（code: プリセット、arg1: 録音ファイル）
+static int mgrRenderStart(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    // 結果は書出しスレッドから要求元へ返す（録音ディレクトリの外のファイルは renderStart が断る）
+    if (arg1 == NULL || renderStart(arg1, code, &MgrCtx.from) < 0) {
+        return mgrSendRenderResult(-1, arg1);
+    }
+
+    return 0;
+}
+
+// エフェクト書出し拒否（録音中などは全コアを使わせない）
+static int mgrRenderReject(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s\n", __func__);
+
+    return mgrSendRenderResult(-1, arg1);
+}
+
+// エフェクト書出し終了通知受信（arg1: 書出したファイル）
+static int mgrRenderStopped(int code, void *arg1, void *arg2)
+{
+    char real[PATH_MAX];
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    if (code != 0 || arg1 == NULL) {
+        return 0;
+    }
+    // 録音ディレクトリの外のファイルは登録もアップロードもしない
+    if (renderResolveTake(arg1, real, sizeof(real)) < 0) {
+        PWS_DEBUG("ERROR: render output not in %s [%s]\n", PWS_TAKE_DIR, (char *)arg1);
+        return 0;
+    }
+
+    // 録音ファイルと同じく登録してアップロード
+    libAddTake(real);
+    mgrSendMessageToSndModule(PWS_PORT_FILE_UPLOADER, MSG_UPLOAD_START, real);
+    libSetUploadState(real, LIB_UPLOAD_QUEUED);
+
+    // 書出した分の空き容量を確認
+    storageKick();
+
+    return 0;
+}
+
+// 入力レベル通知受信（code: クリップ数、ピーク／RMS は mgrGetEvent で取得済み）
+static int mgrMeter(int code, void *arg1, void *arg2)
+{
+    MgrCtx.meter.clips = code;
+    clock_gettime(CLOCK_MONOTONIC, &MgrCtx.meter.at);
+
+    // 入力を鳴らしている間は省電力に入らない
+    if (MgrCtx.meter.peak > PWR_SIGNAL_DB) {
+        pwrSignal();
+    }
+
+    // クリップしたら状態によらず赤色を一時点灯（状態表示は LED Controller が戻す）
+    if (code > 0) {
+        MgrCtx.meter.clipTotal += code;
+        mgrSendMessageToLedController(MSG_LED_RED_FLASH);
+    }
+
+    return 0;
+}
+
+// 入力レベル問合せ（ピーク, RMS, 直近のクリップ数, 累計クリップ数, 経過ミリ秒）
+static int mgrMeterQuery(int code, void *arg1, void *arg2)
+{
+    struct timespec now;
+    int32_t age = -1;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    if (MgrCtx.meter.at.tv_sec != 0 || MgrCtx.meter.at.tv_nsec != 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        age = (int32_t)((now.tv_sec - MgrCtx.meter.at.tv_sec) * 1000 + (now.tv_nsec - MgrCtx.meter.at.tv_nsec) / 1000000);
+    }
+
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_METER_LEVEL;
+    oscMsg.num  = 5;
+    oscMsg.data[0].type = 'f'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.f = MgrCtx.meter.peak;
+    oscMsg.data[1].type = 'f'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.f = MgrCtx.meter.rms;
+    oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = MgrCtx.meter.clips;
+    oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = MgrCtx.meter.clipTotal;
+    oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = age;
+
+    return mgrSendMessageToSender(&oscMsg);
+}
+
+// 受信キュー統計問合せ（クラスごとに 受信, 処理, 破棄, 置換え, 滞留, 最大滞留 を返し、最後に不正メッセージの破棄数）
+static int mgrIngressQuery(int code, void *arg1, void *arg2)
+{
+    int cls, ret = 0;
+    INGRESS_STATS st;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    for (cls = 0; cls < INGRESS_CLASS_NUM; cls++) {
+        ingressGetStats(cls, &st);
+
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_INGRESS;
+        oscMsg.num  = 7;
+        oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = cls;
+        oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = (int32_t)st.received;
+        oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = (int32_t)st.dispatched;
+        oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = (int32_t)st.dropped;
+        oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = (int32_t)st.coalesced;
+        oscMsg.data[5].type = 'i'; oscMsg.data[5].dlen = 4; oscMsg.data[5].u.i = (int32_t)st.depth;
+        oscMsg.data[6].type = 'i'; oscMsg.data[6].dlen = 4; oscMsg.data[6].u.i = (int32_t)st.maxDepth;
+        if (mgrSendMessageToSender(&oscMsg) < 0) {
+            ret = -1;
+        }
+    }
+
+    // 破棄した数（デコード不可, 知らないアドレス, 引数の型違い, 送信元違い）
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_INGRESS_REJECTED;
+    oscMsg.num  = 4;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = (int32_t)MgrCtx.reject.decode;
+    oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = (int32_t)MgrCtx.reject.unknown;
+    oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = (int32_t)MgrCtx.reject.signature;
+    oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = (int32_t)MgrCtx.reject.forged;
+    if (mgrSendMessageToSender(&oscMsg) < 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+// 処理時間統計問合せ（区間ごとに 計測数, p50, p99, 最大 をマイクロ秒で返す、code: 1 なら返した後にクリア）
+static int mgrStatsQuery(int code, void *arg1, void *arg2)
+{
+    int stage, ret = 0;
+    STATS_SUMMARY sum;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    for (stage = 0; stage < STATS_STAGE_NUM; stage++) {
+        statsGetSummary(stage, &sum);
+
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_STATS;
+        oscMsg.num  = 5;
+        oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = stage;
+        oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = (int32_t)sum.count;
+        oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = (int32_t)sum.p50;
+        oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = (int32_t)sum.p99;
+        oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = (int32_t)sum.max;
+        if (mgrSendMessageToSender(&oscMsg) < 0) {
+            ret = -1;
+        }
+    }
+    if (code == 1) {
+        statsReset();
+    }
+
+    return ret;
+}
+
+// 状態遷移の記録の書出し要求（書出した記録数（-1: 失敗）, ファイル を返す）
+static int mgrFlightDump(int code, void *arg1, void *arg2)
+{
+    int n;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    // この要求自体はまだ記録されていない（書出し後に記録される）
+    n = flightDump(FLIGHT_CAUSE_REQUEST, 0);
+
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_FLIGHT;
+    oscMsg.num  = 2;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = n;
+    oscMsg.data[1].type = 's'; oscMsg.data[1].dlen = strlen(PWS_FLIGHT_FILE); oscMsg.data[1].u.s = PWS_FLIGHT_FILE;
+    mgrSendMessageToSender(&oscMsg);
+
+    return (n < 0) ? -1 : 0;
+}
+
+// 状態通知の購読要求（code: 宛先ポート、0 なら送信元、arg1: アドレスパターン、無ければ全て）
+static int mgrSubscribe(int code, void *arg1, void *arg2)
+{
+    int n;
+    struct sockaddr_in to;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    to = MgrCtx.from;
+    if (code > 0 && code <= 0xffff) {
+        to.sin_port = htons(code);
+    }
+    n = busSubscribe(&to, (char *)arg1);
+
+    // 返信は送信元へ（一致した通知の数、-1: 購読者が一杯）
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_SUBSCRIBED;
+    oscMsg.num  = 2;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = n;
+    oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = BUS_LEASE_SEC;
+    mgrSendMessageToSender(&oscMsg);
+
+    return (n < 0) ? -1 : 0;
+}
+
+// 状態通知の購読解除（code: 宛先ポート、0 なら送信元）
+static int mgrUnsubscribe(int code, void *arg1, void *arg2)
+{
+    struct sockaddr_in to;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    to = MgrCtx.from;
+    if (code > 0 && code <= 0xffff) {
+        to.sin_port = htons(code);
+    }
+    busUnsubscribe(&to);
+
+    return 0;
+}
+
+// モジュールの問合せ（モジュールごとの情報と停止の検出時間）
+static int mgrModuleQuery(int code, void *arg1, void *arg2)
+{
+    int i, n = 0;
+    REG_INFO info;
+    REG_DETECT detect;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    for (i = 0; i < REG_MODULE_MAX; i++) {
+        if (regGetInfo(i, &info) < 0) {
+            continue;
+        }
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_MODULE;
+        oscMsg.num  = 7;
+        oscMsg.data[0].type = 's'; oscMsg.data[0].dlen = strlen(info.name); oscMsg.data[0].u.s = info.name;
+        oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = info.port;
+        oscMsg.data[2].type = 's'; oscMsg.data[2].dlen = strlen(info.caps); oscMsg.data[2].u.s = info.caps;
+        oscMsg.data[3].type = 's';
+        oscMsg.data[3].u.s  = (info.alive == REG_ALIVE) ? "alive" : "lost";
+        oscMsg.data[3].dlen = strlen(oscMsg.data[3].u.s);
+        oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = info.interval;
+        oscMsg.data[5].type = 'i'; oscMsg.data[5].dlen = 4; oscMsg.data[5].u.i = info.age;
+        oscMsg.data[6].type = 'i'; oscMsg.data[6].dlen = 4; oscMsg.data[6].u.i = info.lost;
+        mgrSendMessageToSender(&oscMsg);
+        n++;
+    }
+
+    // 最後に件数と検出時間（ミリ秒、最後の心拍 → 検出）
+    regGetDetect(&detect);
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_MODULE_DETECT;
+    oscMsg.num  = 4;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = n;
+    oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = detect.count;
+    oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = detect.last;
+    oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = detect.max;
+
+    return mgrSendMessageToSender(&oscMsg);
+}
+
+// モジュールの登録（code: 宛先ポート、0 なら送信元、arg1: 名前、arg2: 機能の一覧）
+static int mgrModuleAnnounce(int code, void *arg1, void *arg2)
+{
+    int ret;
+    struct sockaddr_in to;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    // 宛先ポート 0: 送信元、負: 機能ごとに def.h のポートで受ける（Pd）
+    to = MgrCtx.from;
+    if (code > 0 && code <= 0xffff) {
+        to.sin_port = htons(code);
+    }
+    else if (code < 0) {
+        to.sin_port = 0;
+    }
+    ret = regAnnounce(&to, (char *)arg1, (char *)arg2);
+    // 各モジュールの準備ができた時刻も起動の記録に残す
+    bootMark((char *)arg1);
+
+    // 返信は送信元へ（結果, 心拍の間隔の既定値）
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_MODULE_REGISTERED;
+    oscMsg.num  = 2;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = ret;
+    oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = REG_INTERVAL_MS;
+    mgrSendMessageToSender(&oscMsg);
+
+    return ret;
+}
+
+// モジュールの心拍（code: 次の心拍までのミリ秒、arg1: 名前）
+static int mgrModuleHeartbeat(int code, void *arg1, void *arg2)
+{
+    OSC_MESSAGE oscMsg;
+
+    if (regHeartbeat((char *)arg1, code) == 0) {
+        return 0;
+    }
+
+    // 未登録（マネージャーが再起動した）なら登録し直してもらう
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_MODULE_REGISTERED;
+    oscMsg.num  = 2;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = -1;
+    oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = REG_INTERVAL_MS;
+    mgrSendMessageToSender(&oscMsg);
+
+    return -1;
+}
+
+// モジュールの停止検出（code: 検出時間、arg1: 名前、今の状態では使っていないもの）
+static int mgrModuleLost(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s [%s] %d ms\n", __func__, (char *)arg1, code);
+
+    // 固まった Pd は止めて起動し直す
+    if (strcmp(arg1, SUP_PD_NAME) == 0) {
+        supHung();
+    }
+
+    return 0;
+}
+
+// モジュールの停止検出（今の状態で使っているもの、異常終了として扱う）
+static int mgrModuleLostActive(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s [%s] %d ms\n", __func__, (char *)arg1, code);
+
+    if (strcmp(arg1, SUP_PD_NAME) == 0) {
+        supHung();
+    }
+
+    return mgrAbortActive();
+}
+
+// 指示の応答無し（code: 番号、arg1: 指示のアドレス、異常終了として扱う）
+static int mgrCommandTimeout(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s [%s] #%d\n", __func__, (char *)arg1, code);
+
+    return mgrAbortActive();
+}
+
+// 今の状態で使っているモジュールの異常終了（終了通知を受けた時と同じ後始末をしてアイドルへ）
+static int mgrAbortActive(void)
+{
+    // 止まっていなかった時のために終了要求も送る（応答は待たない）
+    ackCancelAll();
+    switch(MgrCtx.state) {
+    case STATE_REC:
+        mgrSendMessageToSndModule(PWS_PORT_RECORDER, MSG_REC_STOP, NULL);
+        return mgrRecStopped(-1, NULL, NULL);
+    case STATE_PLAY:
+        mgrSendMessageToSndModule(PWS_PORT_PLAYER, MSG_PLAY_STOP, NULL);
+        return mgrPlayStopped(-1, NULL, NULL);
+    case STATE_TUNE:
+        mgrSendMessageToSndModule(PWS_PORT_TUNER, MSG_TUNING_STOP, NULL);
+        return mgrTuningStopped(-1, NULL, NULL);
+    case STATE_CALIB:
+        // 解析中なら結果は捨てる（アイドルでは受付けない）
+        mgrSendMessageToLedController(MSG_LED_RED_OFF);
+        return mgrCalibMeasured(-1, NULL, NULL);
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+// Pd の再起動通知（code: 0: 起動を頼んだ、-1: 諦めた、arg1: 理由、初期化終了を待ち直す）
+static int mgrPdRestarted(int code, void *arg1, void *arg2)
+{
+    PWS_DEBUG("action: %s [%s] pid=%d\n", __func__, (char *)arg1, code);
+
+    // 使っていたモジュールは異常終了として後始末
+    mgrAbortActive();
+
+    // LED 設定（起動時と同じ黄色点滅、諦めたら黄色早点滅）
+    mgrSendMessageToLedController(MSG_LED_RED_GREEN_OFF);
+    if (code >= 0) {
+        mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK);
+    }
+    else {
+        mgrSendMessageToLedController(MSG_LED_YELLOW_BLINK_FAST);
+    }
+
+    return 0;
+}
+
+// Pd の初期化終了時に音量とエフェクトを戻す（起動時は初期化終了待ちの間の操作だけ）
+static void mgrWarmStart(void)
+{
+    int i;
+    int32_t elapsed;
+
+    elapsed = supReady();
+    if (elapsed >= 0) {
+        statsRecord(STATS_PD_RESTART, elapsed);
+    }
+
+    for (i = 0; i < MgrCtx.warm.volume; i++) {
+        mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_UP, NULL);
+    }
+    for (i = 0; i > MgrCtx.warm.volume; i--) {
+        mgrSendMessageToSndModule(PWS_PORT_AUDIO_OUT, MSG_VOL_DOWN, NULL);
+    }
+    for (i = 0; i < MgrCtx.warm.effect; i++) {
+        mgrSendMessageToSndModule(PWS_PORT_EFFECT_CONTROLLER, MSG_EFFECT_CHANGE, NULL);
+    }
+}
+
+// 起動の記録の問合せ（節目ごとに返信し、最後に節目の数）
+static int mgrBootQuery(int code, void *arg1, void *arg2)
+{
+    int n;
+    const char *name;
+    int32_t ms, step;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    for (n = 0; bootGet(n, &name, &ms, &step) == 0; n++) {
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_BOOT;
+        oscMsg.num  = 3;
+        oscMsg.data[0].type = 's'; oscMsg.data[0].dlen = strlen(name); oscMsg.data[0].u.s = (char *)name;
+        oscMsg.data[1].type = 'i'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.i = ms;
+        oscMsg.data[2].type = 'i'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.i = step;
+        mgrSendMessageToSender(&oscMsg);
+    }
+
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_BOOT_END;
+    oscMsg.num  = 1;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = n;
+
+    return mgrSendMessageToSender(&oscMsg);
+}
+
+// 省電力の問合せ
+static int mgrPowerQuery(int code, void *arg1, void *arg2)
+{
+    char *mode;
+    PWR_INFO info;
+    OSC_MESSAGE oscMsg;
+
+    PWS_DEBUG("action: %s\n", __func__);
+
+    pwrGetInfo(&info);
+    mode = info.saving ? "saving" : "active";
+
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_POWER;
+    oscMsg.num  = 7;
+    oscMsg.data[0].type = 's'; oscMsg.data[0].dlen = strlen(mode); oscMsg.data[0].u.s = mode;
+    oscMsg.data[1].type = 'f'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.f = info.wakeupsActive;
+    oscMsg.data[2].type = 'f'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.f = info.wakeupsIdle;
+    oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = info.mwActive;
+    oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = info.mwIdle;
+    oscMsg.data[5].type = 'i'; oscMsg.data[5].dlen = 4; oscMsg.data[5].u.i = (int32_t)info.entries;
+    oscMsg.data[6].type = 'i'; oscMsg.data[6].dlen = 4; oscMsg.data[6].u.i = info.resume;
+
+    return mgrSendMessageToSender(&oscMsg);
+}
+
+// 指示の応答の受信（往復時間を記録する）
+static void mgrAck(int cmd)
+{
+    int32_t rtt;
+
+    rtt = ackReceived(cmd);
+    if (rtt >= 0) {
+        statsRecord(STATS_COMMAND_RTT, rtt);
+    }
+}
+
+// 受信したメッセージ１件の処理（イベント判定 → 状態遷移テーブルの実行 → 記録）
+//   受信バッファのままデコードする（oscMsg の文字列は pkt->buf を指す）
+//   アドレスがパターンなら一致したイベントを pws_schema.def の順に全て処理する
+static int mgrDispatch(INGRESS_PACKET *pkt)
+{
+    int i, num, ret;
+    uint32_t release;
+    int idx[MGR_EVT_NUM];
+    OSC_MESSAGE oscMsg;
+
+    memcpy(&MgrCtx.from, &pkt->from, sizeof(MgrCtx.from));
+
+    // ボタン監視スレッドからのメッセージなら押下時刻を受取る
+    MgrCtx.trace.active = 0;
+    if (pkt->cls == INGRESS_CLASS_USER && statsButtonTake(&MgrCtx.trace.edge, &release) == 0) {
+        statsRecord(STATS_RELEASE_TO_RECV, pkt->at - release);
+        MgrCtx.trace.active = 1;
+    }
+
+    num = mgrMatchEvent(pkt->buf, pkt->len, &oscMsg, idx, MGR_EVT_NUM);
+    if (num <= 0) {
+        return mgrStep(pkt, &oscMsg, -1);
+    }
+
+    // 入力レベル通知と心拍は周期的に届くのでログに出さない（ログ出力の負荷の方が大きい）
+#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
+    if (!MGR_EVT_QUIET(MGR_EVT_TABLE[idx[0]].evt)) {
+        mgrDebugOut(pkt->buf, pkt->len);
+    }
+#endif
+    for (i = 0, ret = 0; i < num; i++) {
+        if (mgrStep(pkt, &oscMsg, idx[i]) < 0) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+// 一致したアドレス１つ分の処理（idx: MGR_EVT_TABLE の位置、-1: 該当なし）
+static int mgrStep(INGRESS_PACKET *pkt, OSC_MESSAGE *msg, int idx)
+{
+    int evt, prev, next, ret, quiet;
+    uint32_t elapsed;
+    uint64_t at;
+    int (*func)(int code, void *arg1, void *arg2);
+    MGR_ARGS args;
+
+    evt = (idx >= 0) ? mgrGetEvent(idx, msg, &args) : EVT_NONE;
+
+    quiet = MGR_EVT_QUIET(evt);
+#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
+    if (!quiet) {
+        if (idx < 0) {
+            mgrDebugOut(pkt->buf, pkt->len);
+        }
+        if (evt >= 0) {
+            PWS_DEBUG("evt=%2d [%s]\n", evt, strEvt[evt]);
+        }
+        else {
+            PWS_DEBUG("evt=%2d [（イベント無し）]\n", evt);
+        }
+    }
+#endif
+    prev    = MgrCtx.state;
+    next    = MgrCtx.state;
+    ret     = 0;
+    elapsed = 0;
+    at      = utilNow();
+    if (evt >= 0) {
+        next = STATE_TABLE[MgrCtx.state][evt].next;
+        func = STATE_TABLE[MgrCtx.state][evt].func;
+        MgrCtx.trace.dispatch = statsNow();
+        statsRecord(STATS_RECV_TO_DISPATCH, MgrCtx.trace.dispatch - pkt->at);
+        // 省電力中の操作は Pd の DSP を再開してから処理する
+        if (pkt->cls == INGRESS_CLASS_USER) {
+            pwrResume(PWR_REASON_EVENT, 0);
+        }
+        if (func != NULL) {
+            ret = func(args.code, args.arg1, args.arg2);
+            elapsed = (uint32_t)(utilNow() - at);
+            if (ret < 0) {
+                // func error !!
+                PWS_DEBUG("ERROR: func()[%s][%s]\n", strState[MgrCtx.state], strEvt[evt]);
+            }
+        }
+        if (!quiet) {
+            PWS_DEBUG("state  [%s] --> [%s]\n", strState[MgrCtx.state], strState[next]);
+        }
+        MgrCtx.state = next;
+        mgrPublish(evt, prev, next, pkt, msg, idx);
+
+        // 操作・状態遷移があれば省電力までの時間を計り直す（心拍・問合せは数えない）
+        if (pkt->cls == INGRESS_CLASS_USER || prev != next) {
+            pwrActivity(next == STATE_IDLE);
+        }
+    }
+
+    // 状態遷移の記録（入力レベル通知は記録を押し流すので残さない）
+    if (!quiet) {
+        flightRecord(at, prev, next, evt, msg->addr, ret, elapsed);
+    }
+
+    return ret;
+}
+
+// 購読者への配信（状態遷移、受信した状態通知）
+static void mgrPublish(int evt, int prev, int next, INGRESS_PACKET *pkt, OSC_MESSAGE *msg, int idx)
+{
+    int topic, len;
+    uint8_t buf[SEND_BUF_SIZE];
+    OSC_MESSAGE oscMsg;
+
+    // 状態遷移（遷移後, 遷移前）
+    if (next != prev && busWanted(BUS_TOPIC_STATE)) {
+        memset(&oscMsg, 0, sizeof(oscMsg));
+        oscMsg.addr = MSG_STATE;
+        oscMsg.num  = 2;
+        oscMsg.data[0].type = 's'; oscMsg.data[0].dlen = strlen(strStateId[next]); oscMsg.data[0].u.s = (char *)strStateId[next];
+        oscMsg.data[1].type = 's'; oscMsg.data[1].dlen = strlen(strStateId[prev]); oscMsg.data[1].u.s = (char *)strStateId[prev];
+        if (oscEncode(&oscMsg, buf, &len) == 0) {
+            busPublish(BUS_TOPIC_STATE, buf, len);
+        }
+    }
+
+    switch (evt) {
+    case EVT_RECV_TUNING_COND:      topic = BUS_TOPIC_TUNING_COND;      break;
+    case EVT_RECV_METER:            topic = BUS_TOPIC_METER;            break;
+    case EVT_RECV_UPLOAD_STARTED:   topic = BUS_TOPIC_UPLOAD_STARTED;   break;
+    case EVT_RECV_UPLOAD_STOPPED:   topic = BUS_TOPIC_UPLOAD_STOPPED;   break;
+    case EVT_RECV_MODULE_LOST:
+    case EVT_RECV_MODULE_LOST_ACTIVE:
+                                    topic = BUS_TOPIC_MODULE_LOST;      break;
+    default:
+        return;
+    }
+    if (!busWanted(topic)) {
+        return;
+    }
+
+    // 受信したまま送る（パターンで届いたものはアドレスを置き換える）
+    if (strcmp(msg->addr, MGR_EVT_TABLE[idx].msg) == 0) {
+        busPublish(topic, (uint8_t *)pkt->buf, pkt->len);
+    }
+    else {
+        oscMsg = *msg;
+        oscMsg.addr = MGR_EVT_TABLE[idx].msg;
+        if (oscEncode(&oscMsg, buf, &len) == 0) {
+            busPublish(topic, buf, len);
+        }
+    }
+}
+
+// アドレスの照合（戻り値: 一致した MGR_EVT_TABLE の位置の数、-1: デコードできない）
+//   ボタン監視・システム要求はパターンでは一致させない（全ボタンの同時押下などを防ぐ）
+static int mgrMatchEvent(char *buf, int len, OSC_MESSAGE *msg, int *idx, int max)
+{
+    int i, ret, num;
+    TRIE_ENTRY entry[MGR_EVT_NUM];
+
+    ret = oscDecode((uint8_t *)buf, len, msg);
+    if (ret < 0 || msg->addr == NULL) {
+        PWS_DEBUG("oscDecode Error\n");
+        MgrCtx.reject.decode++;
+        return -1;
+    }
+
+    if (MgrTrie == NULL) {
+        for (i = 0; i < MGR_EVT_NUM; i++) {
+            entry[i].addr  = MGR_EVT_TABLE[i].msg;
+            entry[i].val   = i;
+            entry[i].exact = ingressIsUser(MGR_EVT_TABLE[i].msg);
+        }
+        MgrTrie = trieBuild(entry, MGR_EVT_NUM);
+    }
+
+    num = trieMatch(MgrTrie, msg->addr, idx, max);
+    if (num == 0) {
+        PWS_DEBUG("unknown addr=[%s]\n", msg->addr);
+        MgrCtx.reject.unknown++;
+    }
+
+    return num;
+}
+
+// イベント取得（引数は pws_schema.def の型と照合し、合わなければ破棄する）
+static int mgrGetEvent(int idx, OSC_MESSAGE *msg, MGR_ARGS *args)
+{
+    int i, str, evt;
+
+    memset(args, 0, sizeof(*args));
+
+    evt = MGR_EVT_TABLE[idx].evt;
+    if (oscCheck(msg, MGR_EVT_TABLE[idx].types) < 0) {
+        PWS_DEBUG("ERROR: addr=[%s] args do not match \"%s\"\n", msg->addr, MGR_EVT_TABLE[idx].types);
+        MgrCtx.reject.signature++;
+        return EVT_NONE;
+    }
+
+    // LAN や他のプロセスからの偽の通知で状態を変えさせない
+    if (MGR_EVT_SELF(evt) &&
+        (MgrCtx.from.sin_addr.s_addr != htonl(INADDR_LOOPBACK) || MgrCtx.from.sin_port != htons(PWS_PORT_MANAGER))) {
+        PWS_DEBUG("ERROR: addr=[%s] not from self\n", msg->addr);
+        MgrCtx.reject.forged++;
+        return EVT_NONE;
+    }
+    if (MGR_EVT_LOCAL(evt) && MgrCtx.from.sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
+        PWS_DEBUG("ERROR: addr=[%s] not from local\n", msg->addr);
+        MgrCtx.reject.forged++;
+        return EVT_NONE;
+    }
+
+    if (!MGR_EVT_QUIET(evt)) {
+        PWS_DEBUG("addr=[%s]\n\n", msg->addr);
+    }
+
+    // 先頭の整数を code、文字列を順に arg1, arg2 へ
+    for (i = 0, str = 0; i < msg->num; i++) {
+        if (i == 0 && msg->data[i].type == 'i') {
+            args->code = msg->data[i].u.i;
+        }
+        else if (msg->data[i].type == 's') {
+            if (str == 0) {
+                args->arg1 = msg->data[i].u.s;
+            }
+            else if (str == 1) {
+                args->arg2 = msg->data[i].u.s;
+            }
+            str++;
+        }
+    }
+
+    switch(evt) {
+    case EVT_RECV_AP_CONFIGURED:
+        if (args->code < 0) {
+            evt = EVT_RECV_AP_CONFIG_ERROR;
+        }
+        break;
+    case EVT_RECV_PD_INIT_FINISHED:
+        if (args->code < 0) {
+            evt = EVT_RECV_PD_INIT_ERROR;
+        }
+        break;
+    case EVT_PUSH_REC_BTN:
+        // 録音開始前に最大長の録音１回分の空きを確保する（録音途中で失敗させない）
+        if (MgrCtx.state == STATE_IDLE && storageReserve() < 0) {
+            evt = EVT_PUSH_REC_BTN_NO_SPACE;
+        }
+        break;
+    case EVT_RECV_METER:
+        // クリップ数, ピーク, RMS（実数への変換は oscCheck で済んでいる）
+        MgrCtx.meter.peak = msg->data[1].u.f;
+        MgrCtx.meter.rms  = msg->data[2].u.f;
+        break;
+    case EVT_RECV_MODULE_ANNOUNCE:
+        // Pd のメッセージにはカンマを書けないので、機能は１つずつ並べて送られてくる
+        if (msg->num > 3) {
+            if (mgrJoinCaps(msg, 2) < 0) {
+                MgrCtx.reject.signature++;
+                return EVT_NONE;
+            }
+            args->arg2 = MgrCtx.caps;
+        }
+        break;
+    case EVT_RECV_MODULE_LOST:
+        if (MGR_STATE_CAP[MgrCtx.state] != NULL && regProvides(args->arg1, MGR_STATE_CAP[MgrCtx.state])) {
+            evt = EVT_RECV_MODULE_LOST_ACTIVE;
+        }
+        break;
+    case EVT_RECV_COMMAND_TIMEOUT:
+        // 失敗の通知が届くまでに応答が届いた・取消された
+        if (ackFailed(args->code) < 0) {
+            evt = EVT_NONE;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return evt;
+}
+
+// 機能名の引数（first 番目以降）をカンマ区切りで MgrCtx.caps へまとめる（戻り値: -1: 文字列以外・長すぎる）
+static int mgrJoinCaps(OSC_MESSAGE *msg, int first)
+{
+    int i, len, pos = 0;
+
+    for (i = first; i < msg->num; i++) {
+        if (msg->data[i].type != 's') {
+            return -1;
+        }
+        len = strlen(msg->data[i].u.s);
+        if (pos + len + 1 > (int)sizeof(MgrCtx.caps)) {
+            return -1;
+        }
+        if (pos > 0) {
+            MgrCtx.caps[pos - 1] = ',';
+        }
+        memcpy(&MgrCtx.caps[pos], msg->data[i].u.s, len + 1);
+        pos += len + 1;
+    }
+
+    return 0;
+}
+
+// メッセージを SND モジュールへ送信（引数なし: wire をそのまま、引数あり: prefix に param を付ける）
+//   ack: 応答を待つ指示（ACK_NONE: 待たない）
+static int mgrSendWireToSndModule(int ack, int port, const OSC_WIRE *wire, const OSC_WIRE *prefix, char *param)
+{
+    int n, sock, len;
+    uint32_t now;
+    const uint8_t *data;
+    uint8_t sendBuf[SEND_BUF_SIZE];
+    struct sockaddr_in addr;
+
+	PWS_DEBUG("mgrSendWireToSndModule port=%d\n", port);
+
+    if (param != NULL && param[0] != '\0') {
+        if (oscEncodeS(prefix, param, sendBuf, &len) < 0) {
+            return -1;
+        }
+        data = sendBuf;
+    }
+    else {
+        data = wire->data;
+        len  = wire->size;
+    }
+
+#if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
+    mgrDebugOut((char *)data, len);
+#endif
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        PWS_DEBUG("ERROR: Socket\n");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port        = htons(port);
+    // 登録されたモジュールが機能を持っていればそちらへ
+    regRoute((const char *)data, &addr);
+    n = sendto(sock, data, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    if (n == -1) {
+        PWS_DEBUG("ERROR: Sendto\n");
+        close(sock);
+        return -1;
+    }
+    ackExpect(ack, &addr, data, len);
+
+    // ボタン押下から最初の指示までの時間
+    if (MgrCtx.trace.active) {
+        now = statsNow();
+        statsRecord(STATS_DISPATCH_TO_SEND, now - MgrCtx.trace.dispatch);
+        statsRecord(STATS_EDGE_TO_SEND, now - MgrCtx.trace.edge);
+        MgrCtx.trace.active = 0;
+    }
+
+    close(sock);
+
+    return 0;
+}
+
+// メッセージを LED Controller へ送信
+static int mgrSendWireToLedController(const char *msg, int len)
+{
+    int n, sock;
+    struct sockaddr_in addr;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        PWS_DEBUG("ERROR: Socket\n");
+        return -1;
+    }
 
     memset(&addr, 0, sizeof(addr));
     addr.sin_family      = AF_INET;
     addr.sin_addr.s_addr = inet_addr("127.0.0.1");
     addr.sin_port        = htons(PWS_PORT_LED_CONTROLLER);
-    n = sendto(sock, msg, strlen(msg), 0, (struct sockaddr *)&addr, sizeof(addr));
+    n = sendto(sock, msg, len, 0, (struct sockaddr *)&addr, sizeof(addr));
     if (n == -1) {
         PWS_DEBUG("ERROR: Sendto\n");
         close(sock);
@@ -956,11 +2558,85 @@ static int mgrSendMessageToLedController(char *msg)
     return 0;
 }
 
+// メッセージを受信メッセージの送信元へ返信
+static int mgrSendMessageToSender(OSC_MESSAGE *msg)
+{
+    return mgrSendMessageTo(&MgrCtx.from, msg);
+}
+
+// メッセージを指定の宛先へ送信（受信用ソケットから送る）
+static int mgrSendMessageTo(struct sockaddr_in *to, OSC_MESSAGE *msg)
+{
+    int ret, len;
+    uint8_t sendBuf[SEND_BUF_SIZE];
+
+    ret = oscEncode(msg, (uint8_t *)sendBuf, &len);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return mgrSendWireTo(to, sendBuf, len);
+}
+
+// エンコード済みのメッセージを指定の宛先へ送信（受信用ソケットから送る）
+static int mgrSendWireTo(struct sockaddr_in *to, const uint8_t *data, int len)
+{
+    int n;
+
+    if (to->sin_port == 0) {
+        return -1;
+    }
+
+    n = sendto(sock, data, len, 0, (struct sockaddr *)to, sizeof(struct sockaddr_in));
+    if (n == -1) {
+        PWS_DEBUG("ERROR: Sendto\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// レイテンシ情報を送信（フレーム数, ミリ秒, 相関の強さ, サンプリング周波数, 自動補正, 測定日時）
+static int mgrSendLatency(struct sockaddr_in *to)
+{
+    LAT_INFO info;
+    OSC_MESSAGE oscMsg;
+
+    latGet(&info);
+
+    memset(&oscMsg, 0, sizeof(oscMsg));
+    oscMsg.addr = MSG_LATENCY;
+    oscMsg.num  = 6;
+    oscMsg.data[0].type = 'i'; oscMsg.data[0].dlen = 4; oscMsg.data[0].u.i = info.frames;
+    oscMsg.data[1].type = 'f'; oscMsg.data[1].dlen = 4; oscMsg.data[1].u.f = (info.rate > 0) ? info.frames * 1000.0f / info.rate : 0.0f;
+    oscMsg.data[2].type = 'f'; oscMsg.data[2].dlen = 4; oscMsg.data[2].u.f = info.score;
+    oscMsg.data[3].type = 'i'; oscMsg.data[3].dlen = 4; oscMsg.data[3].u.i = info.rate;
+    oscMsg.data[4].type = 'i'; oscMsg.data[4].dlen = 4; oscMsg.data[4].u.i = info.align;
+    oscMsg.data[5].type = 'i'; oscMsg.data[5].dlen = 4; oscMsg.data[5].u.i = info.measured;
+
+    return mgrSendMessageTo(to, &oscMsg);
+}
+
+// エフェクト書出し結果を要求元へ返信（結果, ファイル）
+static int mgrSendRenderResult(int code, char *path)
+{
+    int len;
+    uint8_t sendBuf[SEND_BUF_SIZE];
+
+    if (oscEncodeIS(&OSC_WIRE_IS(MSG_RENDER), code, (path != NULL) ? path : "", sendBuf, &len) < 0) {
+        return -1;
+    }
+
+    return mgrSendWireTo(&MgrCtx.from, sendBuf, len);
+}
+
+#ifndef PWS_REPLAY
 // ソケットのクローズ
 static void mgrCloseSocket(void)
 {
     PWS_DEBUG("mgrCloseSocket sock=%d\n", sock);
     if (sock >= 0) {
+        utilSetSocket(-1);
         close(sock);
         sock = -1;
     }
@@ -971,6 +2647,9 @@ static void mgrSigHandler(int sig)
 {
     PWS_DEBUG("mgrSigHandler\n");
 
+    // 省電力中はボタン監視・LED制御が待ったままなので先に起こす
+    pwrFinish();
+
     gpioFinish();
 
     // メイン終了
@@ -980,6 +2659,7 @@ static void mgrSigHandler(int sig)
 
     mgrCloseSocket();
 }
+#endif
 
 #if defined(DEBUG_LOGOUT_STDIO) || defined(DEBUG_LOGOUT_FILE)
 static void mgrDebugOut(char *buf, int len)
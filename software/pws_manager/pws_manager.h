@@ -20,4 +20,20 @@
 #define MSG_PUSH_TUNING_BTN     "/btnmonitor/push/tuningbtn"    // チューニングボタン押下
 #define MSG_PUSH_SHUTDOWN_BTN   "/btnmonitor/push/shutdownbtn"  // シャットダウンボタン押下
 
+#ifdef PWS_REPLAY
+//
+// トレース再生用（bench/bench_replay）
+//
+#include "pws_ingress.h"
+
+extern void mgrReplayReset(void);
+extern int mgrReplayCheck(void);
+extern int mgrReplayFlight(const char *path);
+extern int mgrReplayDispatch(INGRESS_PACKET *pkt);
+extern int mgrReplayGetEvent(char *buf, int len);
+extern int mgrReplayGetState(void);
+extern const char *mgrReplayStateId(int state);
+extern int mgrReplayFindState(const char *id);
+#endif
+
 #endif // __PWS_MANAGER_H__
@@ -11,7 +11,16 @@
 #include "pws_gpio.h"
 #include "pws_debug.h"
 
+// デコード内容の詳細ログ（メッセージごとにログを出すと受信処理より重くなるので通常は出さない）
+#ifdef DEBUG_OSC_TRACE
+#define OSC_TRACE(fmt, ...)     PWS_DEBUG(fmt, ##__VA_ARGS__)
+#else
+#define OSC_TRACE(fmt, ...)
+#endif
+
 static int oscPadSize(int len);
+static uint8_t *oscPutI(uint8_t *ptr, int32_t i);
+static uint8_t *oscPutS(uint8_t *ptr, const char *s);
 static int32_t oscEndian_i(const int32_t x);
 static float oscEndian_f(const float x);
 
@@ -51,6 +60,10 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
         return -1;
     }
 
+    // 呼出し側でクリアしなくてよいように、参照されるものだけ初期化する
+    msg->addr = NULL;
+    msg->num  = 0;
+
     while (ptr < end && num < OSC_DATA_NUM) {
         c = *ptr;
         switch (state) {
@@ -67,7 +80,7 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
             break;
         case ADDRESS:
             if (c != '\0') {
-                PWS_DEBUG("INFO: addr[%s]\n", adr);
+                OSC_TRACE("INFO: addr[%s]\n", adr);
                 msg->addr = adr;
                 ptr += strlen((char *)ptr);
             }
@@ -109,11 +122,11 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
             break;
         case DATA:
             len = strlen(typ);
-            for (i = 0; i < len; i++) {
+            for (i = 0; i < len && num < OSC_DATA_NUM; i++) {
                 switch (typ[i]) {
                 case 'i':
                     if (ptr + 4 <= end) {
-	                    PWS_DEBUG("INFO[%d]: int[%d]\n", i, *((const int *)ptr));
+	                    OSC_TRACE("INFO[%d]: int[%d]\n", i, *((const int *)ptr));
                         msg->data[num].type = typ[i];
                         msg->data[num].dlen = 4;
                         msg->data[num].u.i = oscEndian_i(*((const int32_t *)ptr));
@@ -124,7 +137,7 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
                     break;
                 case 'f':
                     if (ptr + 4 <= end) {
-	                    PWS_DEBUG("INFO[%d]: float[%f]\n", i, *((const float *)ptr));
+	                    OSC_TRACE("INFO[%d]: float[%f]\n", i, *((const float *)ptr));
                         msg->data[num].type = typ[i];
                         msg->data[num].dlen = 4;
                         msg->data[num].u.f = oscEndian_f(*((const float *)ptr));
@@ -136,11 +149,12 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
                 case 's':
                     dlen = strlen((const char *)ptr);
                     if (ptr + dlen <= end) {
-	                    PWS_DEBUG("INFO[%d]: str[%s]\n", i, ptr);
+	                    OSC_TRACE("INFO[%d]: str[%s]\n", i, ptr);
                         msg->data[num].type = typ[i];
                         msg->data[num].dlen = dlen;
                         msg->data[num].u.s  = (char *)ptr;
-                        ptr += dlen;
+                        // 終端文字と 4 バイト境界までの詰め物を飛ばす
+                        ptr += (dlen + 4) & ~3;
                         num++;
                         msg->num = num;
                     }
@@ -162,6 +176,62 @@ int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg)
     return num;
 }
 
+//-----------------------------------------------------------------------------
+//【関数名】 oscCheck
+// 
+//【内  容】 デコードしたメッセージの引数を型（pws_schema.def の書式）と照合する
+//           数値は型に合わせて変換する（Pd は整数値を 'i'、それ以外を 'f' で送る）
+// 
+//【引  数】 OSC_MESSAGE  *msg      デコード結果（構造体）
+//           const char   *types    引数の型（i, f, s、'|' 以降は省略可、'*' 以降は照合しない）
+//
+//【戻り値】  0 : 一致
+//           -1 : 不一致（引数の不足・過剰、型違い）
+// 
+//【履  歴】 [新規] 2026/10/19
+//-----------------------------------------------------------------------------
+int oscCheck(OSC_MESSAGE *msg, const char *types)
+{
+    int i = 0, opt = 0;
+    const char *t;
+    OSC_DATA *d;
+
+    for (t = types; *t != '\0'; t++) {
+        if (*t == '|') {
+            opt = 1;
+            continue;
+        }
+        if (*t == '*') {
+            return 0;
+        }
+        if (i >= msg->num) {
+            return opt ? 0 : -1;
+        }
+
+        d = &msg->data[i++];
+        switch (*t) {
+        case 'i':
+            if (d->type == 'f') {
+                d->type = 'i';
+                d->u.i  = (int32_t)d->u.f;
+            }
+            break;
+        case 'f':
+            if (d->type == 'i') {
+                d->type = 'f';
+                d->u.f  = (float)d->u.i;
+            }
+            break;
+        }
+        if (d->type != *t) {
+            OSC_TRACE("oscCheck: arg %d is '%c' (expected '%c')\n", i - 1, d->type, *t);
+            return -1;
+        }
+    }
+
+    return (i == msg->num) ? 0 : -1;
+}
+
 //-----------------------------------------------------------------------------
 //【関数名】 oscEncode
 // 
@@ -268,6 +338,95 @@ int oscEncode(OSC_MESSAGE *msg, uint8_t *data, int *size)
     return 0;
 }
 
+//-----------------------------------------------------------------------------
+//【関数名】 oscEncodeI / oscEncodeS / oscEncodeIS
+// 
+//【内  容】 型タグまでエンコード済みの prefix（OSC_WIRE_I 等）に引数を付けて
+//           OSCメッセージにエンコード（oscEncode と同じバイト列になる）
+// 
+//【引  数】 const OSC_WIRE *prefix   アドレスと型タグ（OSC_WIRE_I / OSC_WIRE_S / OSC_WIRE_IS）
+//           int32_t         i        整数の引数
+//           const char     *s        文字列の引数（OSC_STRING_LEN 未満）
+//           uint8_t        *data     OSCメッセージ
+//           int            *size     OSCメッセージの長さ
+//
+//【戻り値】  0 : 成功
+//           -1 : 失敗
+// 
+//【履  歴】 [新規] 2026/10/19
+//-----------------------------------------------------------------------------
+int oscEncodeI(const OSC_WIRE *prefix, int32_t i, uint8_t *data, int *size)
+{
+    uint8_t *ptr = data;
+
+    memcpy(ptr, prefix->data, prefix->size);
+    ptr = oscPutI(ptr + prefix->size, i);
+
+    *size = ptr - data;
+
+    return 0;
+}
+
+int oscEncodeS(const OSC_WIRE *prefix, const char *s, uint8_t *data, int *size)
+{
+    uint8_t *ptr = data;
+
+    if (s == NULL || strlen(s) >= OSC_STRING_LEN) {
+        PWS_DEBUG("ERROR: invalid string\n");
+        return -1;
+    }
+
+    memcpy(ptr, prefix->data, prefix->size);
+    ptr = oscPutS(ptr + prefix->size, s);
+
+    *size = ptr - data;
+
+    return 0;
+}
+
+int oscEncodeIS(const OSC_WIRE *prefix, int32_t i, const char *s, uint8_t *data, int *size)
+{
+    uint8_t *ptr = data;
+
+    if (s == NULL || strlen(s) >= OSC_STRING_LEN) {
+        PWS_DEBUG("ERROR: invalid string\n");
+        return -1;
+    }
+
+    memcpy(ptr, prefix->data, prefix->size);
+    ptr = oscPutI(ptr + prefix->size, i);
+    ptr = oscPutS(ptr, s);
+
+    *size = ptr - data;
+
+    return 0;
+}
+
+// 整数を書込み（ビッグエンディアン）
+static uint8_t *oscPutI(uint8_t *ptr, int32_t i)
+{
+    int32_t ui = oscEndian_i(i);
+
+    memcpy(ptr, &ui, sizeof(ui));
+
+    return ptr + sizeof(ui);
+}
+
+// 文字列を書込み（'\0' を含めて４バイト境界まで）
+static uint8_t *oscPutS(uint8_t *ptr, const char *s)
+{
+    int len = strlen(s) + 1;
+    int pad = oscPadSize(len);
+
+    memcpy(ptr, s, len);
+    ptr += len;
+    while (pad--) {
+        *ptr++ = '\0';
+    }
+
+    return ptr;
+}
+
 //-----------------------------------------------------------------------------
 //【関数名】 oscPadSize
 // 
@@ -5,7 +5,7 @@
 #define __PWS_OSC_H__
 
 #define DECODE_BUFF_SIZE    (512)
-#define OSC_DATA_NUM        (3)
+#define OSC_DATA_NUM        (10)
 #define OSC_STRING_LEN      (512)
 
 typedef enum {
@@ -38,7 +38,34 @@ typedef struct {
     OSC_DATA       data[OSC_DATA_NUM];
 } OSC_MESSAGE;
 
+//
+// エンコード済みのメッセージ（送信するバイト列そのもの）
+//
+typedef struct {
+    const uint8_t  *data;
+    int             size;
+} OSC_WIRE;
+
+//
+// 固定メッセージのワイヤー形式をコンパイル時に作る（a は文字列リテラルであること）
+//   OSC_WIRE(a)      : 引数なし（アドレス + ４バイト境界までの '\0'）
+//   OSC_WIRE_S(a) 等 : 型タグまで（引数は oscEncodeS 等で後ろに付ける）
+//
+#define OSC_WIRE_SIZE(a)        ((int)((sizeof(a) + 3) & ~3))
+#define OSC_WIRE_PAD(a, t)      ((sizeof(a) % 4 == 0) ? a "\0" t         \
+                                : (sizeof(a) % 4 == 1) ? a "\0\0\0\0" t \
+                                : (sizeof(a) % 4 == 2) ? a "\0\0\0" t   \
+                                :                        a "\0\0" t)
+#define OSC_WIRE(a)             ((const OSC_WIRE){ (const uint8_t *)(a "\0\0\0"), OSC_WIRE_SIZE(a) })
+#define OSC_WIRE_I(a)           ((const OSC_WIRE){ (const uint8_t *)OSC_WIRE_PAD(a, ",i\0\0"), OSC_WIRE_SIZE(a) + 4 })
+#define OSC_WIRE_S(a)           ((const OSC_WIRE){ (const uint8_t *)OSC_WIRE_PAD(a, ",s\0\0"), OSC_WIRE_SIZE(a) + 4 })
+#define OSC_WIRE_IS(a)          ((const OSC_WIRE){ (const uint8_t *)OSC_WIRE_PAD(a, ",is\0"), OSC_WIRE_SIZE(a) + 4 })
+
 extern int oscDecode(uint8_t *data, int size, OSC_MESSAGE *msg);
+extern int oscCheck(OSC_MESSAGE *msg, const char *types);
 extern int oscEncode(OSC_MESSAGE *msg, uint8_t *data, int *size);
+extern int oscEncodeI(const OSC_WIRE *prefix, int32_t i, uint8_t *data, int *size);
+extern int oscEncodeS(const OSC_WIRE *prefix, const char *s, uint8_t *data, int *size);
+extern int oscEncodeIS(const OSC_WIRE *prefix, int32_t i, const char *s, uint8_t *data, int *size);
 
 #endif // __PWS_OSC_H__
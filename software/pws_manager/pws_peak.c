@@ -0,0 +1,516 @@
+///////////////////////////////////////////////////////////
+// pws_peak.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "def.h"
+#include "pws_wav.h"
+#include "pws_osc.h"
+#include "pws_latency.h"
+#include "pws_peak.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+// パス名の最大長
+#define PEAK_PATH_LEN       (256)
+
+// 録音中ファイルの読込みサイズ
+#define PEAK_READ_SIZE      (32 * 1024)
+
+// 追従の周期（ミリ秒）
+#define PEAK_POLL_MSEC      (100)
+
+// 録音終了後、ファイルが閉じられるのを待つ最大時間（ミリ秒）
+#define PEAK_CLOSE_TIMEOUT  (3000)
+
+// 追従１つ分（録音ごとに確保し、追従スレッドが解放する）
+typedef struct {
+    char    path[PEAK_PATH_LEN];        // 録音中のファイル
+    uint32_t skip;                      // 先頭で読み飛ばすフレーム数
+    int     stop;                       // 録音終了
+    int     result;                     // 録音の結果（録音終了通知の結果）
+} PEAK_FOLLOW;
+
+// 管理情報
+static struct {
+    PEAK_FOLLOW *cur;                   // 録音中のファイルの追従（録音終了で切離す）
+    int     running;                    // 動いている追従スレッドの数
+} PeakCtx;
+
+static pthread_mutex_t threadPeakMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  threadPeakCond  = PTHREAD_COND_INITIALIZER;
+
+static void *threadPeakFollow(void *arg);
+static int peakFollow(PEAK_FOLLOW *pf);
+static int peakIsStopped(PEAK_FOLLOW *pf);
+static int peakNotify(int code, const char *path);
+static void peakEmit(PEAK_BUILDER *pb, int lvl, PEAK_BIN bin);
+static int peakLevelAppend(PEAK_LEVEL *lv, PEAK_BIN bin);
+
+//
+// ピーク生成器の初期化
+//
+int peakBuilderInit(PEAK_BUILDER *pb, uint32_t rate, int channels)
+{
+    int i;
+    uint32_t spp = PEAK_BASE_SPP;
+
+    if (channels <= 0) {
+        return -1;
+    }
+
+    memset(pb, 0, sizeof(PEAK_BUILDER));
+    pb->rate     = rate;
+    pb->channels = channels;
+    for (i = 0; i < PEAK_LEVEL_NUM; i++) {
+        pb->level[i].spp = spp;
+        spp *= PEAK_LEVEL_RATIO;
+    }
+
+    return 0;
+}
+
+//
+// ピーク生成器の解放
+//
+void peakBuilderFree(PEAK_BUILDER *pb)
+{
+    int i;
+
+    for (i = 0; i < PEAK_LEVEL_NUM; i++) {
+        free(pb->level[i].bins);
+        pb->level[i].bins     = NULL;
+        pb->level[i].count    = 0;
+        pb->level[i].capacity = 0;
+    }
+}
+
+//
+// フレームの入力
+//
+int peakBuilderPush(PEAK_BUILDER *pb, const int16_t *data, int frames)
+{
+    int i, n, k;
+    int16_t lo, hi;
+    PEAK_LEVEL *lv = &pb->level[0];
+
+    while (frames > 0) {
+        // 現在のビンが埋まるまでの分だけまとめて処理する
+        k = lv->spp - lv->accNum;
+        if (k > frames) {
+            k = frames;
+        }
+        n = k * pb->channels;
+
+        if (lv->accNum == 0) {
+            lo =  32767;
+            hi = -32768;
+        }
+        else {
+            lo = lv->acc.min;
+            hi = lv->acc.max;
+        }
+        for (i = 0; i < n; i++) {
+            if (data[i] < lo) lo = data[i];
+            if (data[i] > hi) hi = data[i];
+        }
+        lv->acc.min  = lo;
+        lv->acc.max  = hi;
+        lv->accNum  += k;
+        pb->frames  += k;
+        data        += n;
+        frames      -= k;
+
+        if (lv->accNum >= lv->spp) {
+            lv->accNum = 0;
+            peakEmit(pb, 0, lv->acc);
+        }
+    }
+
+    return 0;
+}
+
+//
+// ピークファイルの書出し
+//
+int peakBuilderWrite(PEAK_BUILDER *pb, const char *path)
+{
+    int i, fd, ok;
+    uint32_t ofs;
+    char tmp[PEAK_PATH_LEN + 8];
+    PEAK_BIN bin;
+    PEAK_FILE_HEADER hdr;
+    PEAK_FILE_LEVEL tbl[PEAK_LEVEL_NUM];
+
+    // 集計中のビンを下位レベルから確定
+    for (i = 0; i < PEAK_LEVEL_NUM; i++) {
+        if (pb->level[i].accNum > 0) {
+            bin = pb->level[i].acc;
+            pb->level[i].accNum = 0;
+            peakEmit(pb, i, bin);
+        }
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PEAK_MAGIC, sizeof(hdr.magic));
+    hdr.version  = PEAK_VERSION;
+    hdr.levels   = PEAK_LEVEL_NUM;
+    hdr.rate     = pb->rate;
+    hdr.frames   = pb->frames;
+    hdr.channels = pb->channels;
+
+    ofs = sizeof(hdr) + sizeof(tbl);
+    for (i = 0; i < PEAK_LEVEL_NUM; i++) {
+        tbl[i].spp    = pb->level[i].spp;
+        tbl[i].count  = pb->level[i].count;
+        tbl[i].offset = ofs;
+        ofs += pb->level[i].count * sizeof(PEAK_BIN);
+    }
+
+    // 途中の状態を見せないように一時ファイルに書いてから置き換える
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        PWS_DEBUG("ERROR: open %s\n", tmp);
+        return -1;
+    }
+    ok = (write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+          write(fd, tbl, sizeof(tbl)) == sizeof(tbl));
+    for (i = 0; ok && i < PEAK_LEVEL_NUM; i++) {
+        ssize_t len = pb->level[i].count * sizeof(PEAK_BIN);
+        ok = (write(fd, pb->level[i].bins, len) == len);
+    }
+    close(fd);
+
+    if (!ok || rename(tmp, path) < 0) {
+        PWS_DEBUG("ERROR: write %s\n", path);
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+//
+// ピークファイルのパス名作成（*.wav → *.pk）
+//
+int peakMakePath(const char *wavPath, char *peakPath, int len)
+{
+    int n = strlen(wavPath);
+
+    if (n > 4 && strcmp(wavPath + n - 4, ".wav") == 0) {
+        n -= 4;
+    }
+    if (n + (int)sizeof(PEAK_FILE_EXT) > len) {
+        return -1;
+    }
+    memcpy(peakPath, wavPath, n);
+    memcpy(peakPath + n, PEAK_FILE_EXT, sizeof(PEAK_FILE_EXT));
+
+    return 0;
+}
+
+//
+// 録音中ファイルの追従開始
+//
+int peakStart(const char *path, uint32_t skip)
+{
+    pthread_t th;
+    pthread_attr_t attr;
+    PEAK_FOLLOW *pf;
+
+    if (path == NULL || strlen(path) >= PEAK_PATH_LEN) {
+        PWS_DEBUG("ERROR: bad path\n");
+        return -1;
+    }
+    pf = (PEAK_FOLLOW *)calloc(1, sizeof(PEAK_FOLLOW));
+    if (pf == NULL) {
+        return -1;
+    }
+    strncpy(pf->path, path, PEAK_PATH_LEN - 1);
+    pf->skip   = skip;
+    pf->result = -1;
+
+    PWS_DEBUG("peakStart [%s]\n", path);
+
+    pthread_mutex_lock(&threadPeakMutex);
+    // 前回の追従が残っていれば（録音終了通知が届かなかった）失敗扱いで終わらせる
+    if (PeakCtx.cur != NULL) {
+        PeakCtx.cur->stop = 1;
+    }
+    PeakCtx.cur = pf;
+    PeakCtx.running++;
+    pthread_mutex_unlock(&threadPeakMutex);
+
+    // 終了は待たない（終わったらスレッドからマネージャーへ通知する）
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&th, &attr, threadPeakFollow, pf) != 0) {
+        PWS_DEBUG("ERROR: peak thread\n");
+        pthread_mutex_lock(&threadPeakMutex);
+        if (PeakCtx.cur == pf) {
+            PeakCtx.cur = NULL;
+        }
+        PeakCtx.running--;
+        pthread_cond_signal(&threadPeakCond);
+        pthread_mutex_unlock(&threadPeakMutex);
+        free(pf);
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    pthread_attr_destroy(&attr);
+
+    return 0;
+}
+
+//
+// 録音終了
+//
+int peakStop(int code)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&threadPeakMutex);
+    if (PeakCtx.cur != NULL) {
+        PeakCtx.cur->stop   = 1;
+        PeakCtx.cur->result = code;
+        PeakCtx.cur = NULL;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&threadPeakMutex);
+
+    return ret;
+}
+
+//
+// ピーク生成終了処理
+//
+void peakFinish(void)
+{
+    pthread_mutex_lock(&threadPeakMutex);
+    if (PeakCtx.cur != NULL) {
+        PeakCtx.cur->stop = 1;
+        PeakCtx.cur = NULL;
+    }
+    // 追従スレッドは止めてから PEAK_CLOSE_TIMEOUT 程度で終わる
+    while (PeakCtx.running > 0) {
+        pthread_cond_wait(&threadPeakCond, &threadPeakMutex);
+    }
+    pthread_mutex_unlock(&threadPeakMutex);
+}
+
+// 録音中ファイルの追従スレッド
+static void *threadPeakFollow(void *arg)
+{
+    PEAK_FOLLOW *pf = (PEAK_FOLLOW *)arg;
+    int ret, stop, result;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    ret = peakFollow(pf);
+
+    pthread_mutex_lock(&threadPeakMutex);
+    if (PeakCtx.cur == pf) {
+        PeakCtx.cur = NULL;
+    }
+    stop   = pf->stop;
+    result = pf->result;
+    pthread_mutex_unlock(&threadPeakMutex);
+
+    // 録音が成功していれば確定を通知（止められる前に失敗したときは録音終了で読み直す）
+    if (stop && result == 0) {
+        // 読み終わってから、読み飛ばした分だけ録音ファイルの先頭も切り詰める
+        if (pf->skip > 0) {
+            latAlignTake(pf->path, pf->skip);
+        }
+        peakNotify(ret, pf->path);
+    }
+    free(pf);
+
+    pthread_mutex_lock(&threadPeakMutex);
+    PeakCtx.running--;
+    pthread_cond_signal(&threadPeakCond);
+    pthread_mutex_unlock(&threadPeakMutex);
+
+    return (void *)NULL;
+}
+
+// 録音中ファイルを追従してピークファイルを書出す（戻り値: 0: 書出した、-1: 失敗）
+static int peakFollow(PEAK_FOLLOW *pf)
+{
+    int fd = -1, n, samples, waited = 0, ret = -1;
+    uint8_t *buf = NULL;
+    int16_t *val = NULL;
+    uint32_t pos = 0, avail, len, skip;
+    char path[PEAK_PATH_LEN];
+    char peakPath[PEAK_PATH_LEN];
+    PEAK_BUILDER pb;
+    WAV_INFO info;
+    struct timespec ts;
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = PEAK_POLL_MSEC * 1000 * 1000;
+
+    // 追従中は変わらない
+    memcpy(path, pf->path, sizeof(path));
+    skip = pf->skip;
+
+    // ヘッダーが書かれるまで待つ
+    for (;;) {
+        if (fd < 0) {
+            fd = open(path, O_RDONLY);
+        }
+        if (fd >= 0 && wavReadHeader(fd, &info) == 0) {
+            break;
+        }
+        if (peakIsStopped(pf)) {
+            waited += PEAK_POLL_MSEC;
+            if (waited > PEAK_CLOSE_TIMEOUT) {
+                PWS_DEBUG("ERROR: peak source not found [%s]\n", path);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return -1;
+            }
+        }
+        nanosleep(&ts, NULL);
+    }
+
+    buf = malloc(PEAK_READ_SIZE);
+    val = malloc(PEAK_READ_SIZE);
+    if (buf == NULL || val == NULL || peakBuilderInit(&pb, info.rate, info.channels) < 0) {
+        free(buf);
+        free(val);
+        close(fd);
+        return -1;
+    }
+
+    // 書かれた分だけ読み進める
+    len    = (PEAK_READ_SIZE / info.align) * info.align;
+    pos    = skip * info.align;
+    waited = 0;
+    for (;;) {
+        avail = (wavDataBytes(&info) > pos) ? wavDataBytes(&info) - pos : 0;
+        if (avail > 0) {
+            n = pread(fd, buf, (avail < len) ? avail : len, info.dataOfs + pos);
+            if (n > 0) {
+                n -= n % info.align;
+                pos += n;
+                samples = n / (info.bits / 8);
+                if (wavToInt16(&info, buf, val, samples) > 0) {
+                    peakBuilderPush(&pb, val, samples / info.channels);
+                }
+                continue;
+            }
+        }
+
+        // 録音終了後、ヘッダーが確定したら（閉じられたら）読み終わり
+        if (peakIsStopped(pf)) {
+            if (wavIsFinalized(&info) || waited > PEAK_CLOSE_TIMEOUT) {
+                break;
+            }
+            waited += PEAK_POLL_MSEC;
+        }
+        nanosleep(&ts, NULL);
+
+        if (wavReadHeader(fd, &info) < 0) {
+            break;
+        }
+    }
+    close(fd);
+
+    if (peakMakePath(path, peakPath, sizeof(peakPath)) == 0 && peakBuilderWrite(&pb, peakPath) == 0) {
+        PWS_DEBUG("peak [%s] %u frames, %u bins\n", peakPath, pb.frames, pb.level[0].count);
+        ret = 0;
+    }
+
+    peakBuilderFree(&pb);
+    free(val);
+    free(buf);
+
+    return ret;
+}
+
+// 録音終了済みか
+static int peakIsStopped(PEAK_FOLLOW *pf)
+{
+    int stop;
+
+    pthread_mutex_lock(&threadPeakMutex);
+    stop = pf->stop;
+    pthread_mutex_unlock(&threadPeakMutex);
+
+    return stop;
+}
+
+// マネージャーへ録音ファイルの確定を通知（マネージャー自身の受信ポートへ）
+static int peakNotify(int code, const char *path)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeIS(&OSC_WIRE_IS(MSG_TAKE_FINISHED), code, path, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
+
+// ビンを確定して上位レベルへ伝搬
+static void peakEmit(PEAK_BUILDER *pb, int lvl, PEAK_BIN bin)
+{
+    PEAK_LEVEL *up;
+
+    for (; lvl < PEAK_LEVEL_NUM; lvl++) {
+        peakLevelAppend(&pb->level[lvl], bin);
+        if (lvl + 1 >= PEAK_LEVEL_NUM) {
+            break;
+        }
+
+        up = &pb->level[lvl + 1];
+        if (up->accNum == 0) {
+            up->acc = bin;
+        }
+        else {
+            if (bin.min < up->acc.min) up->acc.min = bin.min;
+            if (bin.max > up->acc.max) up->acc.max = bin.max;
+        }
+        up->accNum++;
+        if (up->accNum < PEAK_LEVEL_RATIO) {
+            break;
+        }
+        up->accNum = 0;
+        bin = up->acc;
+    }
+}
+
+// ビンの追加
+static int peakLevelAppend(PEAK_LEVEL *lv, PEAK_BIN bin)
+{
+    uint32_t capacity;
+    PEAK_BIN *bins;
+
+    if (lv->count >= lv->capacity) {
+        capacity = (lv->capacity == 0) ? 1024 : lv->capacity * 2;
+        bins = realloc(lv->bins, capacity * sizeof(PEAK_BIN));
+        if (bins == NULL) {
+            PWS_DEBUG("ERROR: realloc\n");
+            return -1;
+        }
+        lv->bins     = bins;
+        lv->capacity = capacity;
+    }
+    lv->bins[lv->count++] = bin;
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////
+// pws_peak.h
+///////////////////////////////////////////////////////////
+#ifndef __PWS_PEAK_H__
+#define __PWS_PEAK_H__
+
+#include <stdint.h>
+
+// ピークファイルの識別子／版数／拡張子
+#define PEAK_MAGIC          "PWSP"
+#define PEAK_VERSION        (1)
+#define PEAK_FILE_EXT       ".pk"
+
+// ズームレベル（レベル0: 256 フレーム／ビン、以降 4 倍ずつ）
+#define PEAK_LEVEL_NUM      (4)
+#define PEAK_BASE_SPP       (256)
+#define PEAK_LEVEL_RATIO    (4)
+
+//
+// ピークファイルのヘッダー（20 byte）
+//   続いて PEAK_FILE_LEVEL × levels、各レベルのビン（PEAK_BIN）が並ぶ
+//
+typedef struct {
+    char        magic[4];               // "PWSP"
+    uint16_t    version;                // 版数
+    uint16_t    levels;                 // レベル数
+    uint32_t    rate;                   // サンプリング周波数
+    uint32_t    frames;                 // サンプルフレーム数
+    uint16_t    channels;               // チャンネル数
+    uint16_t    reserved;
+} PEAK_FILE_HEADER;
+
+typedef struct {
+    uint32_t    spp;                    // 1ビンあたりのフレーム数
+    uint32_t    count;                  // ビン数
+    uint32_t    offset;                 // ファイル先頭からの位置
+} PEAK_FILE_LEVEL;
+
+//
+// ビン（全チャンネルの最小値／最大値）
+//
+typedef struct {
+    int16_t     min;
+    int16_t     max;
+} PEAK_BIN;
+
+//
+// ピーク生成器
+//
+typedef struct {
+    uint32_t    spp;                    // 1ビンあたりのフレーム数
+    uint32_t    count;                  // 確定したビン数
+    uint32_t    capacity;               // 確保済みビン数
+    PEAK_BIN *  bins;                   // 確定したビン
+    PEAK_BIN    acc;                    // 集計中のビン
+    uint32_t    accNum;                 // 集計中のビンに入った数
+} PEAK_LEVEL;
+
+typedef struct {
+    uint32_t    rate;                   // サンプリング周波数
+    uint32_t    frames;                 // 入力済みフレーム数
+    int         channels;               // チャンネル数
+    PEAK_LEVEL  level[PEAK_LEVEL_NUM];
+} PEAK_BUILDER;
+
+//
+// ピーク生成器の初期化／解放
+//
+extern int peakBuilderInit(PEAK_BUILDER *pb, uint32_t rate, int channels);
+extern void peakBuilderFree(PEAK_BUILDER *pb);
+
+//
+// 16bit インターリーブのフレームを入力（全レベルを１パスで更新）
+//
+extern int peakBuilderPush(PEAK_BUILDER *pb, const int16_t *data, int frames);
+
+//
+// 集計中のビンを確定してピークファイルを書出し
+//
+extern int peakBuilderWrite(PEAK_BUILDER *pb, const char *path);
+
+//
+// 録音ファイルのパス名からピークファイルのパス名を作成
+//
+extern int peakMakePath(const char *wavPath, char *peakPath, int len);
+
+//
+// 録音中ファイルの追従開始（録音開始通知で呼ぶ）
+//   skip: 先頭で読み飛ばすフレーム数（レイテンシ補正で切り詰める分、読み終わったら録音ファイルも切り詰める）
+//
+extern int peakStart(const char *path, uint32_t skip);
+
+//
+// 録音終了（残りを読み切ってピークファイルを書出す）
+//   code: 録音終了通知の結果、成功なら書出した後にマネージャーへ MSG_TAKE_FINISHED を送る
+//   戻り値: 0: 追従していた、-1: 追従していない（通知は届かない）
+//
+extern int peakStop(int code);
+
+//
+// ピーク生成終了処理（追従スレッドが全て終わるのを待つ）
+//
+extern void peakFinish(void);
+
+#endif // __PWS_PEAK_H__
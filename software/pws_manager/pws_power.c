@@ -0,0 +1,480 @@
+///////////////////////////////////////////////////////////
+// pws_power.c
+//   未使用時の省電力（周期的な起床をやめて、ボタンの割込みで戻る）
+//
+//   アイドルのまま操作も入力信号も無く LED も点滅していない状態が PWR_IDLE_SEC 続いたら、
+//   Pd の DSP を止め、周期的に起きているスレッド（ボタン・LED・監視）を
+//   pwrSleep で待たせたままにする。ボタンの割込み（pwrKick）で起きた
+//   ボタン監視が変化を見つけたら pwrResume で DSP を再開して全スレッドを起こす。
+//   前後の起床回数と CPU 使用率から消費電力を見積ってログと問合せで返す。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_stats.h"
+#include "pws_power.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+//
+// 計測の区切り
+//
+typedef struct {
+    uint64_t    at;                     // CLOCK_MONOTONIC（マイクロ秒）
+    uint64_t    switches;               // 全スレッドのコンテキストスイッチの合計（≒ 起床回数）
+    uint64_t    busy;                   // /proc/stat の CPU 使用（jiffies、全コア）
+    uint64_t    total;
+} PWR_MARK;
+
+static int              PwrEnable;      // 1: 監視スレッドが動いている
+static int              PwrSaving;      // 1: 省電力中
+static uint32_t         PwrKickSeq;     // pwrKick の回数（待っているスレッドを１回だけ起こす）
+static uint64_t         PwrDeadline;    // 省電力に入る時刻（0: 計っていない）
+static uint32_t         PwrArmSeq;      // 計り直した回数（計測の区切りを取り直す）
+static PWR_MARK         PwrMark;        // 計測の区切り（計り直した時・省電力に入った時）
+static PWR_INFO         PwrInfo;
+static int            (*PwrSteady)(void);
+static pthread_mutex_t  PwrMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   PwrCond  = PTHREAD_COND_INITIALIZER;    // pwrSleep の待ち
+static pthread_cond_t   PwrArmCond;                             // 監視スレッドの待ち（CLOCK_MONOTONIC）
+
+static pthread_t        threadPwrID;
+static int              threadPwrFinish = 0;
+static int              threadPwrStarted = 0;
+
+static void *threadPwrWatch(void *arg);
+static int pwrEnter(void);
+static void pwrMeasure(PWR_MARK *mark);
+static void pwrEstimate(const PWR_MARK *from, const PWR_MARK *to, float *wakeups, int32_t *mw);
+static int pwrSendDsp(int on);
+
+//
+// 初期化
+//
+void pwrInitialize(void)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&PwrArmCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_mutex_lock(&PwrMutex);
+    PwrEnable   = 0;
+    PwrSaving   = 0;
+    PwrKickSeq  = 0;
+    PwrDeadline = 0;
+    PwrArmSeq   = 0;
+    memset(&PwrMark, 0, sizeof(PwrMark));
+    memset(&PwrInfo, 0, sizeof(PwrInfo));
+    PwrInfo.resume = -1;
+    pthread_mutex_unlock(&PwrMutex);
+}
+
+//
+// 監視スレッドの開始
+//
+int pwrStart(int (*steady)(void))
+{
+    if (PWR_IDLE_SEC <= 0) {
+        return 0;
+    }
+
+    PwrSteady = steady;
+    threadPwrFinish = 0;
+    pthread_mutex_lock(&PwrMutex);
+    PwrEnable = 1;
+    pthread_mutex_unlock(&PwrMutex);
+    if (pthread_create(&threadPwrID, NULL, threadPwrWatch, NULL) != 0) {
+        PWS_DEBUG("ERROR: power thread\n");
+        pthread_mutex_lock(&PwrMutex);
+        PwrEnable = 0;
+        pthread_mutex_unlock(&PwrMutex);
+        return -1;
+    }
+    threadPwrStarted = 1;
+
+    return 0;
+}
+
+//
+// 監視スレッドの終了
+//
+void pwrFinish(void)
+{
+    if (!threadPwrStarted) {
+        return;
+    }
+
+    // 終了処理で待たないよう DSP を戻して待っているスレッドを全て起こす
+    pwrResume(PWR_REASON_EVENT, 0);
+
+    pthread_mutex_lock(&PwrMutex);
+    PwrEnable = 0;
+    threadPwrFinish = 1;
+    pthread_cond_broadcast(&PwrCond);
+    pthread_cond_signal(&PwrArmCond);
+    pthread_mutex_unlock(&PwrMutex);
+
+    pthread_join(threadPwrID, NULL);
+    threadPwrStarted = 0;
+}
+
+//
+// 操作・状態遷移の通知
+//
+void pwrActivity(int idle)
+{
+    int saving;
+
+    pthread_mutex_lock(&PwrMutex);
+    if (!PwrEnable) {
+        pthread_mutex_unlock(&PwrMutex);
+        return;
+    }
+    PwrDeadline = idle ? utilNow() + (uint64_t)PWR_IDLE_SEC * 1000000 : 0;
+    PwrArmSeq++;
+    pthread_cond_signal(&PwrArmCond);
+    saving = PwrSaving;
+    pthread_mutex_unlock(&PwrMutex);
+
+    if (saving) {
+        pwrResume(PWR_REASON_EVENT, 0);
+    }
+}
+
+//
+// 入力信号あり
+//   パススルーで入力を鳴らしている間に DSP を止めないよう、省電力に入る時刻だけ延ばす
+//   （監視スレッドは元の時刻に起きて延びた時刻まで待ち直す）
+//
+void pwrSignal(void)
+{
+    pthread_mutex_lock(&PwrMutex);
+    if (PwrEnable && PwrDeadline != 0) {
+        PwrDeadline = utilNow() + (uint64_t)PWR_IDLE_SEC * 1000000;
+    }
+    pthread_mutex_unlock(&PwrMutex);
+}
+
+//
+// 省電力から戻る
+//
+int pwrResume(const char *reason, uint32_t at)
+{
+    int32_t resume = -1;
+    PWR_MARK from, to;
+    float wakeups;
+    int32_t mw;
+
+    pthread_mutex_lock(&PwrMutex);
+    if (!PwrSaving) {
+        pthread_mutex_unlock(&PwrMutex);
+        return 0;
+    }
+    PwrSaving = 0;
+    // 先に DSP を再開してから各スレッドを起こす（入る時の送信と順序を入れ替えない）
+    pwrSendDsp(1);
+    pthread_cond_broadcast(&PwrCond);
+    if (at != 0) {
+        resume = (int32_t)(statsNow() - at);
+    }
+    // アイドルのままならまた計り直す（操作があればマネージャーが計り直す）
+    if (PwrEnable) {
+        PwrDeadline = utilNow() + (uint64_t)PWR_IDLE_SEC * 1000000;
+        PwrArmSeq++;
+        pthread_cond_signal(&PwrArmCond);
+    }
+    from = PwrMark;
+    pthread_mutex_unlock(&PwrMutex);
+
+    if (resume >= 0) {
+        statsRecord(STATS_POWER_RESUME, resume);
+    }
+
+    // 省電力中の計測
+    pwrMeasure(&to);
+    pwrEstimate(&from, &to, &wakeups, &mw);
+
+    pthread_mutex_lock(&PwrMutex);
+    PwrInfo.wakeupsIdle = wakeups;
+    PwrInfo.mwIdle      = mw;
+    if (resume >= 0) {
+        PwrInfo.resume = resume;
+    }
+    pthread_mutex_unlock(&PwrMutex);
+
+    PWS_DEBUG("power: resume (%s) after %u sec, %.1f wakeups/s, %d mW, resume %d us\n",
+              reason, (unsigned int)((to.at - from.at) / 1000000), wakeups, mw, resume);
+
+    return 1;
+}
+
+//
+// 周期的な処理の待ち
+//
+void pwrSleep(const struct timespec *ts)
+{
+    uint32_t seq;
+
+    pthread_mutex_lock(&PwrMutex);
+    if (PwrSaving) {
+        seq = PwrKickSeq;
+        while (PwrSaving && seq == PwrKickSeq) {
+            pthread_cond_wait(&PwrCond, &PwrMutex);
+        }
+        pthread_mutex_unlock(&PwrMutex);
+        return;
+    }
+    pthread_mutex_unlock(&PwrMutex);
+
+    nanosleep(ts, NULL);
+}
+
+//
+// 省電力中に待っているスレッドを起こす
+//
+void pwrKick(void)
+{
+    pthread_mutex_lock(&PwrMutex);
+    if (PwrSaving) {
+        PwrKickSeq++;
+        pthread_cond_broadcast(&PwrCond);
+    }
+    pthread_mutex_unlock(&PwrMutex);
+}
+
+//
+// 省電力中か
+//
+int pwrIsSaving(void)
+{
+    int saving;
+
+    pthread_mutex_lock(&PwrMutex);
+    saving = PwrSaving;
+    pthread_mutex_unlock(&PwrMutex);
+
+    return saving;
+}
+
+//
+// 計測結果の取得
+//
+void pwrGetInfo(PWR_INFO *info)
+{
+    pthread_mutex_lock(&PwrMutex);
+    *info = PwrInfo;
+    info->saving = PwrSaving;
+    pthread_mutex_unlock(&PwrMutex);
+}
+
+// 監視スレッド（省電力に入る時刻まで起きない）
+static void *threadPwrWatch(void *arg)
+{
+    uint32_t marked = 0;
+    uint64_t deadline;
+    struct timespec ts;
+    PWR_MARK mark;
+
+    rtApply(RT_ROLE_WATCH);
+
+    pthread_mutex_lock(&PwrMutex);
+    while (!threadPwrFinish) {
+        if (PwrSaving || PwrDeadline == 0) {
+            pthread_cond_wait(&PwrArmCond, &PwrMutex);
+            continue;
+        }
+
+        // 計り直したら、そこから省電力に入るまでを「入る前」として計測する
+        if (marked != PwrArmSeq) {
+            marked = PwrArmSeq;
+            pthread_mutex_unlock(&PwrMutex);
+            pwrMeasure(&mark);
+            pthread_mutex_lock(&PwrMutex);
+            PwrMark = mark;
+            continue;
+        }
+
+        deadline = PwrDeadline;
+        if (utilNow() < deadline) {
+            ts.tv_sec  = deadline / 1000000;
+            ts.tv_nsec = (deadline % 1000000) * 1000;
+            pthread_cond_timedwait(&PwrArmCond, &PwrMutex, &ts);
+            continue;
+        }
+
+        pthread_mutex_unlock(&PwrMutex);
+        pwrEnter();
+        pthread_mutex_lock(&PwrMutex);
+    }
+    pthread_mutex_unlock(&PwrMutex);
+
+    return (void *)NULL;
+}
+
+// 省電力に入る（LED が点滅していたら点滅が終わるのを待って計り直す、戻り値: 1: 入った）
+static int pwrEnter(void)
+{
+    PWR_MARK from, to;
+    float wakeups;
+    int32_t mw;
+
+    if (PwrSteady != NULL && !PwrSteady()) {
+        pthread_mutex_lock(&PwrMutex);
+        if (PwrDeadline != 0) {
+            PwrDeadline = utilNow() + (uint64_t)PWR_IDLE_SEC * 1000000;
+        }
+        pthread_mutex_unlock(&PwrMutex);
+        return 0;
+    }
+
+    pwrMeasure(&to);
+
+    pthread_mutex_lock(&PwrMutex);
+    // 計っている間に操作があった
+    if (!PwrEnable || PwrDeadline == 0 || to.at < PwrDeadline) {
+        pthread_mutex_unlock(&PwrMutex);
+        return 0;
+    }
+    from = PwrMark;
+    pwrEstimate(&from, &to, &wakeups, &mw);
+    PwrMark     = to;
+    PwrDeadline = 0;
+    PwrSaving   = 1;
+    PwrInfo.entries++;
+    PwrInfo.wakeupsActive = wakeups;
+    PwrInfo.mwActive      = mw;
+    pwrSendDsp(0);
+    pthread_mutex_unlock(&PwrMutex);
+
+    PWS_DEBUG("power: saving after %u sec idle, %.1f wakeups/s, %d mW\n",
+              (unsigned int)((to.at - from.at) / 1000000), wakeups, mw);
+
+    return 1;
+}
+
+// 計測（起床回数は /proc/self/task/*/status、CPU 使用は /proc/stat）
+static void pwrMeasure(PWR_MARK *mark)
+{
+    DIR *dir;
+    FILE *fp;
+    struct dirent *ent;
+    char path[300], line[256];
+    unsigned long long v, n[8];
+    int i;
+
+    memset(mark, 0, sizeof(*mark));
+    mark->at = utilNow();
+
+    dir = opendir("/proc/self/task");
+    if (dir != NULL) {
+        while ((ent = readdir(dir)) != NULL) {
+            if (ent->d_name[0] == '.') {
+                continue;
+            }
+            snprintf(path, sizeof(path), "/proc/self/task/%s/status", ent->d_name);
+            fp = fopen(path, "r");
+            if (fp == NULL) {
+                continue;
+            }
+            while (fgets(line, sizeof(line), fp) != NULL) {
+                if (sscanf(line, "voluntary_ctxt_switches: %llu", &v) == 1 ||
+                    sscanf(line, "nonvoluntary_ctxt_switches: %llu", &v) == 1) {
+                    mark->switches += v;
+                }
+            }
+            fclose(fp);
+        }
+        closedir(dir);
+    }
+
+    // "cpu  user nice system idle iowait irq softirq steal"
+    fp = fopen("/proc/stat", "r");
+    if (fp != NULL) {
+        if (fgets(line, sizeof(line), fp) != NULL &&
+            sscanf(line, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &n[0], &n[1], &n[2], &n[3], &n[4], &n[5], &n[6], &n[7]) == 8) {
+            for (i = 0; i < 8; i++) {
+                mark->total += n[i];
+            }
+            mark->busy = mark->total - n[3] - n[4];
+        }
+        fclose(fp);
+    }
+}
+
+// 区間の起床回数（1 秒あたり）と推定消費電力（mW）
+static void pwrEstimate(const PWR_MARK *from, const PWR_MARK *to, float *wakeups, int32_t *mw)
+{
+    double sec, cores = 0.0;
+    long ncpu;
+
+    sec = (to->at > from->at) ? (to->at - from->at) / 1000000.0 : 0.0;
+    if (sec <= 0.0) {
+        *wakeups = 0.0f;
+        *mw      = PWR_BASE_MW;
+        return;
+    }
+    *wakeups = (float)((to->switches - from->switches) / sec);
+
+    // 使用中のコア数（全コアの jiffies の比率 × コア数）
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (to->total > from->total && ncpu > 0) {
+        cores = (double)(to->busy - from->busy) / (to->total - from->total) * ncpu;
+    }
+    *mw = (int32_t)(PWR_BASE_MW + PWR_CORE_MW * cores + *wakeups * PWR_WAKEUP_UJ / 1000.0);
+}
+
+// Pd の DSP の停止・再開（Audio_Out.pd へ）
+static int pwrSendDsp(int on)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeI(&OSC_WIRE_I(MSG_DSP), on, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_AUDIO_OUT, buf, len);
+}
+
+#ifdef PWS_REPLAY
+//
+// トレース再生（bench/bench_replay）からの呼出し
+//
+// 監視スレッド無しで有効にする（LED は見ない）
+void pwrReplayEnable(void)
+{
+    pthread_mutex_lock(&PwrMutex);
+    PwrSteady = NULL;
+    PwrEnable = 1;
+    pthread_mutex_unlock(&PwrMutex);
+}
+
+// 省電力に入る時刻を過ぎていたら入る（戻り値: 1: 入った）
+int pwrReplayCheck(void)
+{
+    int due;
+
+    pthread_mutex_lock(&PwrMutex);
+    due = PwrEnable && !PwrSaving && PwrDeadline != 0 && utilNow() >= PwrDeadline;
+    pthread_mutex_unlock(&PwrMutex);
+
+    return due ? pwrEnter() : 0;
+}
+#endif  // PWS_REPLAY
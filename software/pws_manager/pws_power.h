@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////
+// pws_power.h
+//   未使用時の省電力（周期的な起床をやめて、ボタンの割込みで戻る）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_POWER_H__
+#define __PWS_POWER_H__
+
+#include <stdint.h>
+#include <time.h>
+
+// アイドルのまま LED の表示が変わらずにこの時間（秒）が過ぎたら省電力に入る（0: 入らない）
+#define PWR_IDLE_SEC            (30)
+
+// 入力レベル（ピーク、dBFS）がこれより大きい間は入力を鳴らしているとみなして省電力に入らない
+#define PWR_SIGNAL_DB           (-50.0f)
+
+// 消費電力の見積り（Raspberry Pi 3 の目安、mW と uJ）
+#define PWR_BASE_MW             (1200)      // 何もしていないときの全体
+#define PWR_CORE_MW             (300)       // コア１つ分の CPU 使用
+#define PWR_WAKEUP_UJ           (50)        // 起床１回（コアの省電力状態からの復帰）
+
+//
+// 省電力から戻った理由
+//
+#define PWR_REASON_BUTTON       "button"    // ボタンの割込み
+#define PWR_REASON_LED          "led"       // LED の点滅
+#define PWR_REASON_EVENT        "event"     // 状態遷移
+
+//
+// 計測結果
+//
+typedef struct {
+    int         saving;                 // 1: 省電力中
+    uint32_t    entries;                // 省電力に入った回数
+    int32_t     resume;                 // 最後の復帰（ボタンの割込み → Pd の DSP 再開の送信、マイクロ秒、-1: 未計測）
+    float       wakeupsActive;          // 省電力に入る前の起床回数（1 秒あたり、pws_manager の全スレッド）
+    float       wakeupsIdle;            // 省電力中の起床回数
+    int32_t     mwActive;               // 省電力に入る前の推定消費電力（mW）
+    int32_t     mwIdle;                 // 省電力中の推定消費電力（mW）
+} PWR_INFO;
+
+//
+// 初期化
+//
+extern void pwrInitialize(void);
+
+//
+// 監視スレッドの開始・終了
+//   steady: 省電力に入ってよいか（LED が点滅していないか）
+//   終了すると省電力には入らず、待っているスレッドを全て起こす（他のスレッドの終了より先に呼ぶ）
+//
+extern int pwrStart(int (*steady)(void));
+extern void pwrFinish(void);
+
+//
+// 操作・状態遷移の通知（idle: 1 ならアイドルなので省電力までの時間を計り直す、0 なら計らない）
+//   省電力中なら戻る
+//
+extern void pwrActivity(int idle);
+
+//
+// 入力信号あり（入力レベルの通知ごと、省電力に入る時刻を延ばすだけで計り直さない）
+//
+extern void pwrSignal(void);
+
+//
+// 省電力から戻る（at: 戻る契機の時刻（statsNow）、0: 計測しない、戻り値: 1: 戻った、0: 省電力中でない）
+//
+extern int pwrResume(const char *reason, uint32_t at);
+
+//
+// 周期的な処理の待ち（nanosleep の代わり）
+//   省電力中は pwrKick・pwrResume まで待ち続ける
+//
+extern void pwrSleep(const struct timespec *ts);
+
+//
+// 省電力中に待っているスレッドを１回だけ起こす（割込みから呼ぶ）
+//
+extern void pwrKick(void);
+
+//
+// 省電力中か
+//
+extern int pwrIsSaving(void);
+
+//
+// 計測結果の取得
+//
+extern void pwrGetInfo(PWR_INFO *info);
+
+#ifdef PWS_REPLAY
+//
+// トレース再生用（bench/bench_replay、監視スレッドの代わりに仮想時計を進めるたびに確認する）
+//
+extern void pwrReplayEnable(void);
+extern int pwrReplayCheck(void);
+#endif
+
+#endif  // __PWS_POWER_H__
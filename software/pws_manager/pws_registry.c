@@ -0,0 +1,374 @@
+///////////////////////////////////////////////////////////
+// pws_registry.c
+//   モジュールの登録と死活監視（起動時の登録と周期的な心拍）
+//
+//   モジュールは起動時に名前・機能・宛先ポートを登録し、その後は周期的に心拍を送る。
+//   指示はアドレスの先頭の要素（"/recorder/record/start" なら recorder）を機能名として
+//   登録された宛先へ送る（未登録なら def.h のポートのまま）。
+//   監視スレッドが心拍の途絶えたモジュールを見つけたら、マネージャー自身へ
+//   MSG_MODULE_LOST を送って状態遷移テーブルで処理させる。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_registry.h"
+#include "pws_power.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+//
+// 登録されたモジュール
+//
+typedef struct {
+    int                 used;
+    char                name[REG_NAME_LEN];
+    char                caps[REG_CAPS_LEN];
+    struct sockaddr_in  to;             // 指示の宛先
+    int                 alive;          // REG_ALIVE / REG_LOST
+    int32_t             interval;       // 心拍の間隔（ミリ秒）
+    uint64_t            beat;           // 最後の心拍（CLOCK_MONOTONIC、ミリ秒）
+    uint32_t            lost;           // 停止を検出した回数
+} REG_MODULE;
+
+static REG_MODULE       RegModule[REG_MODULE_MAX];
+static REG_DETECT       RegDetect;
+static pthread_mutex_t  RegMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t        threadRegID;
+static pthread_mutex_t  threadRegMutex  = PTHREAD_MUTEX_INITIALIZER;
+static int              threadRegFinish = 0;
+static int              threadRegStarted = 0;
+
+static void *threadRegWatch(void *arg);
+static int regFind(const char *name);
+static int regHasCap(const char *caps, const char *cap, int len);
+static int regSendLost(const char *name, int32_t latency);
+
+//
+// 初期化
+//
+void regInitialize(void)
+{
+    pthread_mutex_lock(&RegMutex);
+    memset(RegModule, 0, sizeof(RegModule));
+    memset(&RegDetect, 0, sizeof(RegDetect));
+    pthread_mutex_unlock(&RegMutex);
+}
+
+//
+// 監視スレッドの開始
+//
+int regStart(void)
+{
+    threadRegFinish = 0;
+    if (pthread_create(&threadRegID, NULL, threadRegWatch, NULL) != 0) {
+        PWS_DEBUG("ERROR: registry thread\n");
+        return -1;
+    }
+    threadRegStarted = 1;
+
+    return 0;
+}
+
+//
+// 監視スレッドの終了
+//
+void regFinish(void)
+{
+    if (!threadRegStarted) {
+        return;
+    }
+
+    pthread_mutex_lock(&threadRegMutex);
+    threadRegFinish = 1;
+    pthread_mutex_unlock(&threadRegMutex);
+
+    pthread_join(threadRegID, NULL);
+    threadRegStarted = 0;
+}
+
+//
+// 登録
+//
+int regAnnounce(const struct sockaddr_in *to, const char *name, const char *caps)
+{
+    int i, idx;
+
+    if (name == NULL || name[0] == '\0' || strlen(name) >= REG_NAME_LEN) {
+        return -1;
+    }
+    if (caps == NULL || caps[0] == '\0') {
+        // 機能の指定が無ければモジュール名を機能名とする
+        caps = name;
+    }
+
+    pthread_mutex_lock(&RegMutex);
+    idx = regFind(name);
+    for (i = 0; idx < 0 && i < REG_MODULE_MAX; i++) {
+        if (!RegModule[i].used) {
+            idx = i;
+        }
+    }
+    if (idx < 0) {
+        pthread_mutex_unlock(&RegMutex);
+        PWS_DEBUG("ERROR: registry full [%s]\n", name);
+        return -1;
+    }
+
+    // 再起動したモジュールの登録し直しは停止の検出回数だけ引継ぐ
+    if (!RegModule[idx].used) {
+        memset(&RegModule[idx], 0, sizeof(RegModule[idx]));
+        snprintf(RegModule[idx].name, sizeof(RegModule[idx].name), "%s", name);
+        RegModule[idx].interval = REG_INTERVAL_MS;
+    }
+    RegModule[idx].used  = 1;
+    RegModule[idx].to    = *to;
+    RegModule[idx].alive = REG_ALIVE;
+    RegModule[idx].beat  = utilNow() / 1000;
+    snprintf(RegModule[idx].caps, sizeof(RegModule[idx].caps), "%s", caps);
+    pthread_mutex_unlock(&RegMutex);
+
+    PWS_DEBUG("registry: [%s] port=%d caps=[%s]\n", name, ntohs(to->sin_port), caps);
+
+    return 0;
+}
+
+//
+// 心拍
+//
+int regHeartbeat(const char *name, int interval)
+{
+    int idx;
+
+    pthread_mutex_lock(&RegMutex);
+    idx = (name != NULL) ? regFind(name) : -1;
+    if (idx < 0) {
+        pthread_mutex_unlock(&RegMutex);
+        return -1;
+    }
+    if (interval > 0) {
+        if (interval < REG_INTERVAL_MIN_MS) {
+            interval = REG_INTERVAL_MIN_MS;
+        }
+        if (interval > REG_INTERVAL_MAX_MS) {
+            interval = REG_INTERVAL_MAX_MS;
+        }
+        RegModule[idx].interval = interval;
+    }
+    if (RegModule[idx].alive == REG_LOST) {
+        PWS_DEBUG("registry: [%s] recovered\n", name);
+    }
+    RegModule[idx].alive = REG_ALIVE;
+    RegModule[idx].beat  = utilNow() / 1000;
+    pthread_mutex_unlock(&RegMutex);
+
+    return 0;
+}
+
+//
+// モジュールが機能を持つか
+//
+int regProvides(const char *name, const char *cap)
+{
+    int idx, ret = 0;
+
+    pthread_mutex_lock(&RegMutex);
+    idx = (name != NULL) ? regFind(name) : -1;
+    if (idx >= 0) {
+        ret = regHasCap(RegModule[idx].caps, cap, strlen(cap));
+    }
+    pthread_mutex_unlock(&RegMutex);
+
+    return ret;
+}
+
+//
+// 指示の宛先
+//
+int regRoute(const char *addr, struct sockaddr_in *to)
+{
+    int i, len, ret = 0;
+    const char *cap;
+
+    if (addr == NULL || addr[0] != '/') {
+        return 0;
+    }
+    cap = addr + 1;
+    for (len = 0; cap[len] != '\0' && cap[len] != '/'; len++) {
+    }
+
+    pthread_mutex_lock(&RegMutex);
+    for (i = 0; i < REG_MODULE_MAX; i++) {
+        // 宛先ポート 0 のモジュール（Pd）は機能ごとに def.h のポートで受ける
+        if (RegModule[i].used && RegModule[i].alive == REG_ALIVE && RegModule[i].to.sin_port != 0 &&
+            regHasCap(RegModule[i].caps, cap, len)) {
+            *to = RegModule[i].to;
+            ret = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&RegMutex);
+
+    return ret;
+}
+
+//
+// 心拍の確認
+//
+int regCheck(void)
+{
+    int i, n = 0;
+    uint64_t now;
+    char name[REG_MODULE_MAX][REG_NAME_LEN];
+    int32_t latency[REG_MODULE_MAX];
+
+    pthread_mutex_lock(&RegMutex);
+    now = utilNow() / 1000;
+    for (i = 0; i < REG_MODULE_MAX; i++) {
+        if (!RegModule[i].used || RegModule[i].alive != REG_ALIVE) {
+            continue;
+        }
+        if (now - RegModule[i].beat <= (uint64_t)RegModule[i].interval * REG_MISS_MAX) {
+            continue;
+        }
+        RegModule[i].alive = REG_LOST;
+        RegModule[i].lost++;
+
+        // 検出時間（最後の心拍から）
+        latency[n] = (int32_t)(now - RegModule[i].beat);
+        RegDetect.count++;
+        RegDetect.last = latency[n];
+        if (latency[n] > RegDetect.max) {
+            RegDetect.max = latency[n];
+        }
+        memcpy(name[n], RegModule[i].name, REG_NAME_LEN);
+        n++;
+    }
+    pthread_mutex_unlock(&RegMutex);
+
+    // 通知はロックの外で
+    for (i = 0; i < n; i++) {
+        PWS_DEBUG("registry: [%s] lost (%d ms since last heartbeat)\n", name[i], latency[i]);
+        regSendLost(name[i], latency[i]);
+    }
+
+    return n;
+}
+
+//
+// 問合せ
+//
+int regGetInfo(int idx, REG_INFO *info)
+{
+    if (idx < 0 || idx >= REG_MODULE_MAX) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&RegMutex);
+    if (!RegModule[idx].used) {
+        pthread_mutex_unlock(&RegMutex);
+        return -1;
+    }
+    memcpy(info->name, RegModule[idx].name, sizeof(info->name));
+    memcpy(info->caps, RegModule[idx].caps, sizeof(info->caps));
+    info->port     = ntohs(RegModule[idx].to.sin_port);
+    info->alive    = RegModule[idx].alive;
+    info->interval = RegModule[idx].interval;
+    info->age      = (int32_t)(utilNow() / 1000 - RegModule[idx].beat);
+    info->lost     = RegModule[idx].lost;
+    pthread_mutex_unlock(&RegMutex);
+
+    return 0;
+}
+
+void regGetDetect(REG_DETECT *detect)
+{
+    pthread_mutex_lock(&RegMutex);
+    *detect = RegDetect;
+    pthread_mutex_unlock(&RegMutex);
+}
+
+// 監視スレッド
+static void *threadRegWatch(void *arg)
+{
+    int loop;
+    struct timespec ts;
+
+    rtApply(RT_ROLE_WATCH);
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = REG_CHECK_MS * 1000000L;
+
+    loop = 1;
+    while (loop) {
+        pwrSleep(&ts);
+
+        regCheck();
+
+        pthread_mutex_lock(&threadRegMutex);
+        if (threadRegFinish == 1) {
+            loop = 0;
+        }
+        pthread_mutex_unlock(&threadRegMutex);
+    }
+
+    return (void *)NULL;
+}
+
+// 名前で探す（ロック済みで呼ぶこと）
+static int regFind(const char *name)
+{
+    int i;
+
+    for (i = 0; i < REG_MODULE_MAX; i++) {
+        if (RegModule[i].used && strcmp(RegModule[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// カンマ区切りの一覧に cap（長さ len）があるか
+static int regHasCap(const char *caps, const char *cap, int len)
+{
+    const char *p = caps;
+
+    while (*p != '\0') {
+        if (strncmp(p, cap, len) == 0 && (p[len] == ',' || p[len] == '\0')) {
+            return 1;
+        }
+        p = strchr(p, ',');
+        if (p == NULL) {
+            break;
+        }
+        p++;
+    }
+
+    return 0;
+}
+
+// 停止の通知（マネージャー自身の受信ポートへ）
+static int regSendLost(const char *name, int32_t latency)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeIS(&OSC_WIRE_IS(MSG_MODULE_LOST), latency, name, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////
+// pws_registry.h
+//   モジュールの登録と死活監視（起動時の登録と周期的な心拍）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_REGISTRY_H__
+#define __PWS_REGISTRY_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// 登録できるモジュールの最大数
+#define REG_MODULE_MAX          (16)
+
+// モジュール名と機能の一覧（"recorder,player" のようにカンマ区切り）の最大長
+#define REG_NAME_LEN            (32)
+#define REG_CAPS_LEN            (128)
+
+// 心拍の間隔（ミリ秒、心拍で指定されるまでは既定値を使う）
+#define REG_INTERVAL_MS         (1000)
+#define REG_INTERVAL_MIN_MS     (20)
+#define REG_INTERVAL_MAX_MS     (60000)
+
+// 心拍の間隔のこの倍数だけ届かなければ停止とみなす
+//   検出にかかる時間は 間隔 x REG_MISS_MAX ～ それ + REG_CHECK_MS
+#define REG_MISS_MAX            (3)
+
+// 監視の周期（ミリ秒）
+#define REG_CHECK_MS            (50)
+
+//
+// 死活
+//
+#define REG_ALIVE               (0)     // 動作中
+#define REG_LOST                (1)     // 心拍が途絶えた
+
+//
+// 問合せ結果
+//
+typedef struct {
+    char        name[REG_NAME_LEN];     // モジュール名
+    char        caps[REG_CAPS_LEN];     // 機能の一覧
+    int         port;                   // 指示の宛先ポート
+    int         alive;                  // REG_ALIVE / REG_LOST
+    int32_t     interval;               // 心拍の間隔（ミリ秒）
+    int32_t     age;                    // 最後の心拍からの時間（ミリ秒）
+    uint32_t    lost;                   // 停止を検出した回数
+} REG_INFO;
+
+//
+// 検出時間の集計（ミリ秒、最後の心拍 → 停止の検出）
+//
+typedef struct {
+    uint32_t    count;                  // 検出数
+    int32_t     last;                   // 直近
+    int32_t     max;                    // 最大
+} REG_DETECT;
+
+//
+// 初期化（登録は全て削除）
+//
+extern void regInitialize(void);
+
+//
+// 監視スレッドの開始・終了
+//
+extern int regStart(void);
+extern void regFinish(void);
+
+//
+// 登録（同じ名前の登録は置き換える、戻り値: 0: 成功、-1: 一杯・不正な名前）
+//
+extern int regAnnounce(const struct sockaddr_in *to, const char *name, const char *caps);
+
+//
+// 心拍（interval: 次の心拍までの間隔、0 なら変えない、戻り値: -1: 未登録）
+//
+extern int regHeartbeat(const char *name, int interval);
+
+//
+// モジュールが機能 cap を持つか（1: 持つ）
+//
+extern int regProvides(const char *name, const char *cap);
+
+//
+// 指示の宛先（アドレスの先頭の要素を機能名として、動作中のモジュールを探す）
+//   宛先ポート 0 で登録したモジュール（機能ごとに def.h のポートで受ける Pd）は除く
+//   戻り値: 1: 見つかった（to を書換える）、0: 未登録（def.h のポートを使う）
+//
+extern int regRoute(const char *addr, struct sockaddr_in *to);
+
+//
+// 心拍の確認（停止を検出したらマネージャーへ MSG_MODULE_LOST を送る）
+//   監視スレッドから周期的に呼ぶ、戻り値: 新たに検出した数
+//
+extern int regCheck(void);
+
+//
+// 問合せ（戻り値: -1: 未使用）
+//
+extern int regGetInfo(int idx, REG_INFO *info);
+extern void regGetDetect(REG_DETECT *detect);
+
+#endif  // __PWS_REGISTRY_H__
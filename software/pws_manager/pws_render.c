@@ -0,0 +1,541 @@
+///////////////////////////////////////////////////////////
+// pws_render.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_wav.h"
+#include "pws_fx.h"
+#include "pws_lib.h"
+#include "pws_render.h"
+#include "pws_rt.h"
+#include "pws_util.h"
+#include "pws_debug.h"
+
+// 1 回に読み書きするフレーム数
+#define RENDER_BLOCK            (4096)
+
+// 出力の量子化ビット数
+#define RENDER_BITS             (16)
+
+//
+// 書出し中のファイル
+//
+typedef struct {
+    const char *    out;                // 出力ファイル
+    char            tmp[LIB_PATH_LEN];  // 書出し中の一時ファイル
+    WAV_INFO        info;               // 入力ファイルの情報
+    int             inFd;
+    int             outFd;
+    uint64_t        frames;             // フレーム数
+    int             error;              // 異常あり
+} RENDER_FILE;
+
+//
+// 区間（ファイル内の連続したフレーム）
+//
+typedef struct {
+    int             file;               // RENDER_FILE のインデックス
+    uint64_t        start;              // 先頭フレーム
+    uint64_t        frames;             // フレーム数
+} RENDER_TASK;
+
+//
+// 書出し全体
+//
+typedef struct {
+    RENDER_FILE *   file;
+    RENDER_TASK *   task;
+    int             taskNum;
+    int             next;               // 次に処理する区間
+    int             preset;
+    pthread_mutex_t mutex;
+} RENDER_JOB;
+
+//
+// バックグラウンド書出しの要求
+//
+typedef struct {
+    char                path[LIB_PATH_LEN];
+    int                 preset;
+    struct sockaddr_in  replyTo;
+} RENDER_REQ;
+
+static pthread_mutex_t renderMutex = PTHREAD_MUTEX_INITIALIZER;
+static int             renderBusy  = 0;
+
+static void *threadRender(void *arg);
+static void *threadRenderWorker(void *arg);
+static int renderOpen(RENDER_FILE *f, const char *in, const char *out);
+static void renderClose(RENDER_FILE *f);
+static uint64_t renderChunkFrames(const RENDER_FILE *f, int preset, int jobs);
+static int renderTask(RENDER_JOB *job, const RENDER_TASK *task);
+static int renderSend(const struct sockaddr_in *to, OSC_MESSAGE *msg);
+static double renderNow(void);
+
+//
+// 出力ファイルのパス名を作成
+//
+int renderMakePath(const char *path, int preset, char *out, int len)
+{
+    const char *ext = strrchr(path, '.');
+    int n;
+
+    if (ext == NULL || strchr(ext, '/') != NULL) {
+        ext = path + strlen(path);
+    }
+    n = snprintf(out, len, "%.*s%s%d.wav", (int)(ext - path), path, RENDER_SUFFIX, preset);
+
+    return (n > 0 && n < len) ? 0 : -1;
+}
+
+//
+// 書出し
+//
+int renderFiles(const char **in, const char **out, int num, int preset, int jobs, RENDER_RESULT *res)
+{
+    int i, n, ret = 0, threads;
+    uint64_t pos, chunk;
+    double t0;
+    RENDER_JOB job;
+    pthread_t th[RENDER_MAX_JOBS];
+
+    memset(res, 0, sizeof(RENDER_RESULT));
+    if (num <= 0 || preset < 0 || preset >= FX_PRESET_NUM) {
+        return -1;
+    }
+    if (jobs <= 0) {
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    jobs = (jobs < 1) ? 1 : (jobs > RENDER_MAX_JOBS) ? RENDER_MAX_JOBS : jobs;
+
+    t0 = renderNow();
+
+    memset(&job, 0, sizeof(job));
+    job.preset = preset;
+    job.file   = (RENDER_FILE *)calloc(num, sizeof(RENDER_FILE));
+    if (job.file == NULL) {
+        return -1;
+    }
+    for (i = 0; i < num; i++) {
+        job.file[i].inFd  = -1;
+        job.file[i].outFd = -1;
+    }
+
+    // 入力を開いて区間に分ける
+    for (i = 0, n = 0; i < num; i++) {
+        if (renderOpen(&job.file[i], in[i], out[i]) < 0) {
+            PWS_DEBUG("render: open error %s\n", in[i]);
+            job.file[i].error = 1;
+            ret = -1;
+            continue;
+        }
+        chunk = renderChunkFrames(&job.file[i], preset, jobs);
+        if (chunk == 0) {
+            job.file[i].error = 1;
+            ret = -1;
+            continue;
+        }
+        n += (int)((job.file[i].frames + chunk - 1) / chunk);
+        res->frames   += job.file[i].frames;
+        res->audioSec += (double)job.file[i].frames / job.file[i].info.rate;
+    }
+
+    job.task = (RENDER_TASK *)calloc((n > 0) ? n : 1, sizeof(RENDER_TASK));
+    if (job.task == NULL) {
+        ret = -1;
+        n = 0;
+    }
+    for (i = 0; i < num && job.task != NULL; i++) {
+        if (job.file[i].inFd < 0 || job.file[i].error) {
+            continue;
+        }
+        chunk = renderChunkFrames(&job.file[i], preset, jobs);
+        for (pos = 0; pos < job.file[i].frames; pos += chunk) {
+            job.task[job.taskNum].file   = i;
+            job.task[job.taskNum].start  = pos;
+            job.task[job.taskNum].frames = (job.file[i].frames - pos < chunk) ? job.file[i].frames - pos : chunk;
+            job.taskNum++;
+        }
+    }
+
+    // 区間を処理スレッドへ振り分ける
+    pthread_mutex_init(&job.mutex, NULL);
+    threads = (job.taskNum < jobs) ? job.taskNum : jobs;
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&th[i], NULL, threadRenderWorker, &job) != 0) {
+            break;
+        }
+    }
+    threads = i;
+    if (threads == 0 && job.taskNum > 0) {
+        // スレッドが作れなければこのスレッドで処理
+        threadRenderWorker(&job);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(th[i], NULL);
+    }
+    pthread_mutex_destroy(&job.mutex);
+
+    // 全区間が書けたファイルだけ残す
+    for (i = 0; i < num; i++) {
+        if (job.file[i].outFd >= 0 && job.file[i].error == 0) {
+            renderClose(&job.file[i]);
+            if (rename(job.file[i].tmp, job.file[i].out) == 0) {
+                res->files++;
+                continue;
+            }
+            job.file[i].error = 1;
+        }
+        renderClose(&job.file[i]);
+        if (job.file[i].tmp[0] != '\0') {
+            unlink(job.file[i].tmp);
+        }
+        ret = -1;
+    }
+
+    res->wallSec = renderNow() - t0;
+    res->speed   = (res->wallSec > 0.0) ? (float)(res->audioSec / res->wallSec) : 0.0f;
+
+    PWS_DEBUG("render: %d/%d files, %.1f sec in %.2f sec (x%.1f, %d jobs)\n",
+              res->files, num, res->audioSec, res->wallSec, res->speed, threads);
+
+    free(job.task);
+    free(job.file);
+
+    return ret;
+}
+
+//
+// バックグラウンドで書出し開始
+//
+int renderStart(const char *path, int preset, const struct sockaddr_in *replyTo)
+{
+    pthread_t th;
+    RENDER_REQ *req;
+    char real[PATH_MAX];
+
+    if (path == NULL || strlen(path) >= LIB_PATH_LEN || preset < 0 || preset >= FX_PRESET_NUM) {
+        return -1;
+    }
+    // 録音ディレクトリの外（.. やシンボリックリンクで抜けるものを含む）は書出さない
+    if (renderResolveTake(path, real, sizeof(real)) < 0) {
+        PWS_DEBUG("ERROR: render path not in %s [%s]\n", PWS_TAKE_DIR, path);
+        return -1;
+    }
+
+    // 同時に１件だけ（全コアを使うため）
+    pthread_mutex_lock(&renderMutex);
+    if (renderBusy) {
+        pthread_mutex_unlock(&renderMutex);
+        return -1;
+    }
+    renderBusy = 1;
+    pthread_mutex_unlock(&renderMutex);
+
+    req = (RENDER_REQ *)calloc(1, sizeof(RENDER_REQ));
+    if (req != NULL) {
+        // 確かめた実体のパス名で書出す（確認の後に差替えられても外へは出ない）
+        strcpy(req->path, real);
+        req->preset = preset;
+        memcpy(&req->replyTo, replyTo, sizeof(req->replyTo));
+        if (pthread_create(&th, NULL, threadRender, req) == 0) {
+            pthread_detach(th);
+            return 0;
+        }
+        free(req);
+    }
+
+    pthread_mutex_lock(&renderMutex);
+    renderBusy = 0;
+    pthread_mutex_unlock(&renderMutex);
+
+    return -1;
+}
+
+//
+// 録音ディレクトリ内のファイルの実体のパス名
+//
+int renderResolveTake(const char *path, char *real, int len)
+{
+    int n;
+    char dir[PATH_MAX];
+
+    if (path == NULL || len < PATH_MAX || realpath(PWS_TAKE_DIR, dir) == NULL || realpath(path, real) == NULL) {
+        return -1;
+    }
+    n = strlen(dir);
+    if (strncmp(real, dir, n) != 0 || real[n] != '/' || strlen(real) >= LIB_PATH_LEN) {
+        return -1;
+    }
+
+    return 0;
+}
+
+//
+// マネージャーへ書出し終了を通知
+//
+int renderNotify(int code, const char *out)
+{
+    struct sockaddr_in addr;
+    OSC_MESSAGE msg;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port        = htons(PWS_PORT_MANAGER);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.addr = MSG_RENDER_STOPPED;
+    msg.num  = 2;
+    msg.data[0].type = 'i'; msg.data[0].dlen = 4;           msg.data[0].u.i = code;
+    msg.data[1].type = 's'; msg.data[1].dlen = strlen(out); msg.data[1].u.s = (char *)out;
+
+    return renderSend(&addr, &msg);
+}
+
+// バックグラウンド書出しスレッド
+static void *threadRender(void *arg)
+{
+    RENDER_REQ *req = (RENDER_REQ *)arg;
+    RENDER_RESULT res;
+    char out[LIB_PATH_LEN];
+    const char *in = req->path, *outp = out;
+    int code = -1;
+    OSC_MESSAGE msg;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    if (renderMakePath(req->path, req->preset, out, sizeof(out)) == 0) {
+        code = renderFiles(&in, &outp, 1, req->preset, 0, &res);
+    }
+    else {
+        memset(&res, 0, sizeof(res));
+        strcpy(out, req->path);
+    }
+
+    // 録音ライブラリへの登録とアップロードはマネージャーの状態遷移で行う
+    renderNotify(code, out);
+
+    // 要求元へ結果（結果, 出力ファイル, 実時間の何倍か, 音声の長さ）
+    memset(&msg, 0, sizeof(msg));
+    msg.addr = MSG_RENDER;
+    msg.num  = 4;
+    msg.data[0].type = 'i'; msg.data[0].dlen = 4;           msg.data[0].u.i = code;
+    msg.data[1].type = 's'; msg.data[1].dlen = strlen(out); msg.data[1].u.s = out;
+    msg.data[2].type = 'f'; msg.data[2].dlen = 4;           msg.data[2].u.f = res.speed;
+    msg.data[3].type = 'f'; msg.data[3].dlen = 4;           msg.data[3].u.f = (float)res.audioSec;
+    if (req->replyTo.sin_port != 0) {
+        renderSend(&req->replyTo, &msg);
+    }
+
+    free(req);
+
+    pthread_mutex_lock(&renderMutex);
+    renderBusy = 0;
+    pthread_mutex_unlock(&renderMutex);
+
+    return NULL;
+}
+
+// 処理スレッド（区間を順に取って処理する）
+static void *threadRenderWorker(void *arg)
+{
+    RENDER_JOB *job = (RENDER_JOB *)arg;
+    int idx;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    // 録音／再生中でも Pd を優先させる
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), RENDER_NICE);
+
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        idx = (job->next < job->taskNum) ? job->next++ : -1;
+        pthread_mutex_unlock(&job->mutex);
+        if (idx < 0) {
+            break;
+        }
+        if (renderTask(job, &job->task[idx]) < 0) {
+            pthread_mutex_lock(&job->mutex);
+            job->file[job->task[idx].file].error = 1;
+            pthread_mutex_unlock(&job->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+// 入力を開き、同じ長さの出力（一時ファイル）を用意する
+static int renderOpen(RENDER_FILE *f, const char *in, const char *out)
+{
+    uint8_t hdr[WAV_HEADER_SIZE];
+    const char *base;
+    uint64_t dataSize;
+
+    f->out = out;
+    f->inFd = open(in, O_RDONLY);
+    if (f->inFd < 0 || wavReadHeader(f->inFd, &f->info) < 0) {
+        return -1;
+    }
+    f->frames = wavDataBytes(&f->info) / f->info.align;
+    dataSize  = f->frames * f->info.channels * (RENDER_BITS / 8);
+    if (dataSize > UINT32_MAX - WAV_HEADER_SIZE) {
+        return -1;
+    }
+
+    // 書き終わるまでは録音ライブラリから見えない名前（ドットファイル）にしておく
+    base = strrchr(out, '/');
+    base = (base != NULL) ? base + 1 : out;
+    if (snprintf(f->tmp, sizeof(f->tmp), "%.*s.%s.tmp", (int)(base - out), out, base) >= (int)sizeof(f->tmp)) {
+        f->tmp[0] = '\0';
+        return -1;
+    }
+    f->outFd = open(f->tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f->outFd < 0) {
+        f->tmp[0] = '\0';
+        return -1;
+    }
+    wavMakeHeader(hdr, f->info.rate, f->info.channels, RENDER_BITS, (uint32_t)dataSize);
+    if (pwrite(f->outFd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        ftruncate(f->outFd, (off_t)(WAV_HEADER_SIZE + dataSize)) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void renderClose(RENDER_FILE *f)
+{
+    if (f->inFd >= 0) {
+        close(f->inFd);
+        f->inFd = -1;
+    }
+    if (f->outFd >= 0) {
+        close(f->outFd);
+        f->outFd = -1;
+    }
+}
+
+// 区間の長さ
+//   ファイルが少なければ区間に分けて全コアを使う（先行処理の割合は 1/RENDER_CHUNK_RATIO 以下）
+static uint64_t renderChunkFrames(const RENDER_FILE *f, int preset, int jobs)
+{
+    uint64_t chunk, min, warmup;
+    FX_STATE fx;
+
+    if (fxInit(&fx, preset, f->info.rate, f->info.channels) < 0) {
+        return 0;
+    }
+    warmup = fxWarmupFrames(&fx);
+    fxFree(&fx);
+
+    min   = (warmup > 0) ? warmup * RENDER_CHUNK_RATIO : f->info.rate;
+    chunk = (f->frames + jobs - 1) / jobs;
+
+    return (chunk < min) ? min : chunk;
+}
+
+// 区間の処理（状態を持つエフェクトは手前から先行して流し、その分は書かない）
+static int renderTask(RENDER_JOB *job, const RENDER_TASK *task)
+{
+    RENDER_FILE *f = &job->file[task->file];
+    int i, n, ch = f->info.channels, ret = 0;
+    uint64_t pos, end = task->start + task->frames, warmup;
+    uint8_t *raw;
+    float *buf, v;
+    int16_t *pcm;
+    FX_STATE fx;
+
+    if (fxInit(&fx, job->preset, f->info.rate, ch) < 0) {
+        return -1;
+    }
+    warmup = fxWarmupFrames(&fx);
+    pos = (task->start > warmup) ? task->start - warmup : 0;
+
+    raw = (uint8_t *)malloc((size_t)RENDER_BLOCK * f->info.align);
+    buf = (float *)malloc((size_t)RENDER_BLOCK * ch * sizeof(float));
+    pcm = (int16_t *)malloc((size_t)RENDER_BLOCK * ch * sizeof(int16_t));
+    if (raw == NULL || buf == NULL || pcm == NULL) {
+        ret = -1;
+    }
+
+    while (ret == 0 && pos < end) {
+        // 先行処理と書出しの境目をまたがない
+        n = RENDER_BLOCK;
+        if (pos < task->start && task->start - pos < (uint64_t)n) {
+            n = (int)(task->start - pos);
+        }
+        if (end - pos < (uint64_t)n) {
+            n = (int)(end - pos);
+        }
+
+        if (pread(f->inFd, raw, (size_t)n * f->info.align, f->info.dataOfs + (off_t)pos * f->info.align) != (ssize_t)n * f->info.align ||
+            wavToFloat(&f->info, raw, buf, n * ch) < 0)
+        {
+            ret = -1;
+            break;
+        }
+        fxProcess(&fx, buf, n);
+
+        if (pos >= task->start) {
+            for (i = 0; i < n * ch; i++) {
+                v = buf[i] * 32768.0f;
+                pcm[i] = (v >= 32767.0f) ? 32767 : (v <= -32768.0f) ? -32768 : (int16_t)v;
+            }
+            if (pwrite(f->outFd, pcm, (size_t)n * ch * sizeof(int16_t),
+                       WAV_HEADER_SIZE + (off_t)pos * ch * sizeof(int16_t)) != (ssize_t)(n * ch * sizeof(int16_t)))
+            {
+                ret = -1;
+            }
+        }
+        pos += n;
+    }
+
+    free(pcm);
+    free(buf);
+    free(raw);
+    fxFree(&fx);
+
+    return ret;
+}
+
+// メッセージ送信
+static int renderSend(const struct sockaddr_in *to, OSC_MESSAGE *msg)
+{
+    int len;
+    uint8_t sendBuf[SEND_BUF_SIZE];
+
+    if (oscEncode(msg, sendBuf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSend(to, sendBuf, len);
+}
+
+// 経過時間（秒）
+static double renderNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////
+// pws_render.h
+//   録音ファイルのエフェクト書出し（オフライン、全コア並列）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_RENDER_H__
+#define __PWS_RENDER_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// 出力ファイル名（<元の名前>_fx<プリセット>.wav）
+#define RENDER_SUFFIX           "_fx"
+
+// 同時に処理するスレッドの最大数
+#define RENDER_MAX_JOBS         (16)
+
+// 分割の最小単位（先行処理の長さの何倍か、状態を持たないエフェクトは 1 秒）
+#define RENDER_CHUNK_RATIO      (8)
+
+// 処理スレッドの nice 値（Pd の音声処理を妨げない）
+#define RENDER_NICE             (10)
+
+//
+// 書出し結果
+//
+typedef struct {
+    int         files;                  // 書出したファイル数
+    uint64_t    frames;                 // 書出したフレーム数（合計）
+    double      audioSec;               // 音声の長さ（秒、合計）
+    double      wallSec;                // 処理時間（秒）
+    float       speed;                  // 実時間の何倍で処理できたか
+} RENDER_RESULT;
+
+//
+// 出力ファイルのパス名を作成
+//
+extern int renderMakePath(const char *path, int preset, char *out, int len);
+
+//
+// 書出し（終わるまで戻らない）
+//   ファイル単位とファイル内の区間単位で jobs 個のスレッドへ振り分ける
+//   jobs: 0 ならコア数
+//
+extern int renderFiles(const char **in, const char **out, int num, int preset, int jobs, RENDER_RESULT *res);
+
+//
+// バックグラウンドで書出し開始
+//   終了すると replyTo へ結果を、マネージャーへ終了通知を送る
+//   path は PWS_TAKE_DIR の中のファイルに限る（renderResolveTake で確かめる）
+//
+extern int renderStart(const char *path, int preset, const struct sockaddr_in *replyTo);
+
+//
+// 録音ディレクトリ内のファイルの実体のパス名（len は PATH_MAX 以上）
+//   シンボリックリンクと .. を解決し、PWS_TAKE_DIR の中でなければ -1
+//
+extern int renderResolveTake(const char *path, char *real, int len);
+
+//
+// マネージャーへ書出し終了を通知（録音ライブラリへの登録とアップロード）
+//
+extern int renderNotify(int code, const char *out);
+
+#endif // __PWS_RENDER_H__
@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////
+// pws_render_main.c
+//   録音ファイルのエフェクト書出し（コマンドライン）
+//
+//   pws_render [-p preset] [-j jobs] [-n] file.wav ...
+//     -p  エフェクトのプリセット（0: なし、1～3: Effect_Controller と同じ）
+//     -j  処理スレッド数（省略時はコア数）
+//     -n  アップロードしない（マネージャーへ通知しない）
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include "pws_fx.h"
+#include "pws_lib.h"
+#include "pws_render.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-p preset(0-%d)] [-j jobs] [-n] file.wav ...\n", prog, FX_PRESET_NUM - 1);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, num, ret, preset = FX_PRESET_REVERB, jobs = 0, notify = 1;
+    const char **in, **out;
+    char (*outPath)[LIB_PATH_LEN];
+    char absPath[PATH_MAX];
+    RENDER_RESULT res;
+
+    while ((c = getopt(argc, argv, "p:j:n")) != -1) {
+        switch (c) {
+        case 'p':
+            preset = atoi(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'n':
+            notify = 0;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    num = argc - optind;
+    if (num <= 0 || preset < 0 || preset >= FX_PRESET_NUM) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    in      = (const char **)calloc(num, sizeof(char *));
+    out     = (const char **)calloc(num, sizeof(char *));
+    outPath = calloc(num, sizeof(*outPath));
+    if (in == NULL || out == NULL || outPath == NULL) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+    for (i = 0; i < num; i++) {
+        // 録音ライブラリは絶対パスで管理している
+        if (realpath(argv[optind + i], absPath) == NULL ||
+            renderMakePath(absPath, preset, outPath[i], LIB_PATH_LEN) < 0)
+        {
+            fprintf(stderr, "%s: bad path\n", argv[optind + i]);
+            return 1;
+        }
+        in[i]  = argv[optind + i];
+        out[i] = outPath[i];
+    }
+
+    // 前回の書出し結果は置き換える（失敗したときに古いファイルを通知しない）
+    for (i = 0; i < num; i++) {
+        unlink(out[i]);
+    }
+    ret = renderFiles(in, out, num, preset, jobs, &res);
+
+    for (i = 0; i < num; i++) {
+        if (access(out[i], F_OK) == 0) {
+            printf("%s -> %s\n", in[i], out[i]);
+            if (notify) {
+                renderNotify(0, out[i]);
+            }
+        }
+        else {
+            fprintf(stderr, "%s: render error\n", in[i]);
+        }
+    }
+    printf("%d/%d files, %.1f sec audio in %.2f sec (x%.1f real time)\n",
+           res.files, num, res.audioSec, res.wallSec, res.speed);
+
+    free(outPath);
+    free(out);
+    free(in);
+
+    return (ret == 0) ? 0 : 2;
+}
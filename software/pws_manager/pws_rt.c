@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////
+// pws_rt.c
+//   スレッドの役割ごとのスケジューリングとメモリのロック
+//
+//   ボタン監視・LED・監視スレッドは SCHED_FIFO で動かし、アップロード
+//   （Python）や WEB サーバー、録音ライブラリの走査などの SCHED_OTHER の
+//   処理が CPU を使っていても待たされないようにする。
+//   メインループはファイル I/O や system（ログ出力を含む）で待つことがあるので
+//   SCHED_FIFO にはせず、nice を下げた SCHED_OTHER で動かす。
+//   mlockall でページアウトによる待ちも無くす（スタックは小さくして先に確保）。
+//   SCHED_FIFO は SCHED_RESET_ON_FORK 付きで設定するので、system や Pd の
+//   再起動で作る子プロセスは通常のスケジューリングに戻る。
+///////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "def.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK     (0x40000000)
+#endif
+
+//
+// 役割ごとの設定（PWS_RT_FILE で上書き）
+//
+static RT_PROFILE RtProfile[RT_ROLE_NUM] = {
+    { "button"    , 60,  0, -1 },
+    { "manager"   ,  0,-10, -1 },
+    { "led"       , 50,  0, -1 },
+    { "watch"     , 45,  0, -1 },
+    { "background",  0, 10, -1 },
+};
+
+static int RtEnable  = 1;               // 0: 何も設定しない
+static int RtMlock   = 1;               // mlockall
+static int RtStackKB = RT_STACK_KB;     // スレッドのスタック
+
+static int rtLoad(const char *path);
+static void rtPrefault(void);
+static void rtAtForkChild(void);
+
+//
+// 初期化
+//
+int rtInitialize(void)
+{
+    int ret = 0;
+    pthread_attr_t attr;
+
+    rtLoad(PWS_RT_FILE);
+    if (!RtEnable) {
+        PWS_DEBUG("rtInitialize disabled\n");
+        return 0;
+    }
+
+    // 子プロセスは CPU の指定を引継がない
+    pthread_atfork(NULL, NULL, rtAtForkChild);
+
+    // 以降に作るスレッドのスタック（mlockall すると全て確保されるので小さくする）
+    if (pthread_attr_init(&attr) == 0) {
+        pthread_attr_setstacksize(&attr, (size_t)RtStackKB * 1024);
+        if (pthread_setattr_default_np(&attr) != 0) {
+            PWS_DEBUG("ERROR: rt stack size\n");
+            ret = -1;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    if (RtMlock) {
+        // 確保したヒープを返さない（返すと次の確保でページフォールトする）
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+            PWS_DEBUG("ERROR: mlockall (%d)\n", errno);
+            ret = -1;
+        }
+        rtPrefault();
+    }
+
+    PWS_DEBUG("rtInitialize mlock %d stack %d KB\n", RtMlock, RtStackKB);
+
+    return ret;
+}
+
+//
+// 呼出したスレッドへ役割の設定を適用
+//
+int rtApply(int role)
+{
+    int ret = 0;
+    pid_t tid;
+    cpu_set_t set;
+    struct sched_param param;
+    const RT_PROFILE *p;
+
+    if (!RtEnable || role < 0 || role >= RT_ROLE_NUM) {
+        return 0;
+    }
+    p = &RtProfile[role];
+    tid = (pid_t)syscall(SYS_gettid);
+
+    memset(&param, 0, sizeof(param));
+    if (p->prio > 0) {
+        param.sched_priority = p->prio;
+        if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) < 0) {
+            PWS_DEBUG("ERROR: rt %s SCHED_FIFO %d (%d)\n", p->name, p->prio, errno);
+            ret = -1;
+        }
+    }
+    else {
+        if (sched_setscheduler(0, SCHED_OTHER | SCHED_RESET_ON_FORK, &param) < 0) {
+            ret = -1;
+        }
+        // Linux の nice はスレッドごと
+        if (setpriority(PRIO_PROCESS, tid, p->nice) < 0) {
+            PWS_DEBUG("ERROR: rt %s nice %d (%d)\n", p->name, p->nice, errno);
+            ret = -1;
+        }
+    }
+
+    if (p->cpu >= 0 && p->cpu < sysconf(_SC_NPROCESSORS_ONLN)) {
+        CPU_ZERO(&set);
+        CPU_SET(p->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            PWS_DEBUG("ERROR: rt %s cpu %d\n", p->name, p->cpu);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+//
+// 役割の検索
+//
+int rtFindRole(const char *name)
+{
+    int i;
+
+    for (i = 0; i < RT_ROLE_NUM; i++) {
+        if (strcmp(RtProfile[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//
+// 設定の取得
+//
+int rtGetProfile(int role, RT_PROFILE *profile)
+{
+    if (role < 0 || role >= RT_ROLE_NUM) {
+        return -1;
+    }
+    memcpy(profile, &RtProfile[role], sizeof(RT_PROFILE));
+    return 0;
+}
+
+// 設定ファイルの読込み（"enable 0|1"、"mlock 0|1"、"stack KB"、"役割 優先度 nice CPU"）
+static int rtLoad(const char *path)
+{
+    FILE *fp;
+    char line[128], name[32];
+    int n, val, prio, nice, cpu, role;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        n = sscanf(line, "%31s %d %d %d", name, &prio, &nice, &cpu);
+        if (n == 2) {
+            val = prio;
+            if (strcmp(name, "enable") == 0) {
+                RtEnable = (val != 0);
+            }
+            else if (strcmp(name, "mlock") == 0) {
+                RtMlock = (val != 0);
+            }
+            else if (strcmp(name, "stack") == 0 && val >= 64) {
+                RtStackKB = val;
+            }
+            continue;
+        }
+        if (n != 4 || (role = rtFindRole(name)) < 0) {
+            continue;
+        }
+        if (prio < 0 || prio > sched_get_priority_max(SCHED_FIFO)) {
+            PWS_DEBUG("ERROR: rt %s bad priority %d\n", name, prio);
+            continue;
+        }
+        RtProfile[role].prio = prio;
+        RtProfile[role].nice = nice;
+        RtProfile[role].cpu  = cpu;
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+// メインスレッドのスタックとヒープを先に確保（ロックしたまま使う）
+static void rtPrefault(void)
+{
+    volatile char stack[RT_PREFAULT_KB * 1024];
+    volatile char *heap;
+    long page;
+    int i;
+
+    page = sysconf(_SC_PAGESIZE);
+    for (i = 0; i < (int)sizeof(stack); i += page) {
+        stack[i] = 0;
+    }
+
+    heap = malloc(RT_HEAP_KB * 1024);
+    if (heap != NULL) {
+        for (i = 0; i < RT_HEAP_KB * 1024; i += page) {
+            heap[i] = 0;
+        }
+        free((void *)heap);
+    }
+}
+
+// 子プロセス（fork 直後）は全ての CPU で動かす
+static void rtAtForkChild(void)
+{
+    int i, num;
+    cpu_set_t set;
+
+    num = sysconf(_SC_NPROCESSORS_CONF);
+    CPU_ZERO(&set);
+    for (i = 0; i < num && i < CPU_SETSIZE; i++) {
+        CPU_SET(i, &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////
+// pws_rt.h
+//   スレッドの役割ごとのスケジューリング（SCHED_FIFO の優先度、nice、CPU）と
+//   メモリのロック（アップロードや WEB サーバーの負荷でボタン・LED を遅らせない）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_RT_H__
+#define __PWS_RT_H__
+
+//
+// スレッドの役割
+//   優先度は Pd（-rt）の音声処理（90 台）より下にする
+//
+#define RT_ROLE_BUTTON          (0)     // ボタン監視
+#define RT_ROLE_MANAGER         (1)     // 受信と状態遷移（メインループ、SCHED_OTHER）
+#define RT_ROLE_LED             (2)     // LED 制御と LED への指示の受信
+#define RT_ROLE_WATCH           (3)     // 心拍・応答待ち・Pd の監視
+#define RT_ROLE_BACKGROUND      (4)     // 録音ライブラリ・録音領域・ピーク・書出し・記録
+#define RT_ROLE_NUM             (5)
+
+// 設定ファイルが無いときの既定値
+#define RT_STACK_KB             (256)   // スレッドのスタック（mlockall するので小さくする）
+#define RT_PREFAULT_KB          (256)   // メインスレッドのスタックを先に確保する大きさ
+#define RT_HEAP_KB              (1024)  // 先に確保しておくヒープ
+
+//
+// 役割ごとの設定
+//
+typedef struct {
+    const char *name;                   // 設定ファイルでの名前
+    int         prio;                   // SCHED_FIFO の優先度（0: SCHED_OTHER）
+    int         nice;                   // SCHED_OTHER のときの nice
+    int         cpu;                    // 実行する CPU（-1: 指定しない）
+} RT_PROFILE;
+
+//
+// 初期化（PWS_RT_FILE の読込み、メモリのロック、スタックの確保）
+//   設定ファイルが無ければ既定値を使う、戻り値: -1: 一部を設定できない（権限など）
+//
+extern int rtInitialize(void);
+
+//
+// 呼出したスレッドへ役割の設定を適用（スレッド関数の先頭で呼ぶ）
+//   子プロセス（system、Pd の再起動）へは引継がない、戻り値: -1: 設定できない
+//
+extern int rtApply(int role);
+
+//
+// 役割の検索（戻り値: 役割、-1: 無し）と設定の取得
+//
+extern int rtFindRole(const char *name);
+extern int rtGetProfile(int role, RT_PROFILE *profile);
+
+#endif  // __PWS_RT_H__
@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////
+// pws_stats.c
+//   ボタン操作からモジュールへの指示までの処理時間の統計
+//
+//   区間ごとに HDR ヒストグラムと同じ形（2 のべき乗ごとに線形に分割）で数える。
+//   ボタン監視スレッドとマネージャーの両方から書くのでアトミック操作だけで更新する。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "pws_stats.h"
+#include "pws_util.h"
+
+typedef struct {
+    uint32_t    bucket[STATS_BUCKET_NUM];
+    uint32_t    count;
+    uint32_t    max;
+} STATS_HIST;
+
+static STATS_HIST StatsHist[STATS_STAGE_NUM];
+
+// ボタン監視スレッドからの受渡し（release が 0 なら受取り済み）
+static uint32_t StatsBtnEdge;
+static uint32_t StatsBtnRelease;
+
+static int statsBucket(uint32_t v);
+static uint32_t statsBucketValue(int idx);
+
+//
+// 現在時刻（マイクロ秒）
+//
+uint32_t statsNow(void)
+{
+    uint32_t now = (uint32_t)utilNow();
+
+    // 0 は「受取り済み」に使うので避ける
+    return (now == 0) ? 1 : now;
+}
+
+//
+// 計測値の登録
+//
+void statsRecord(int stage, uint32_t usec)
+{
+    STATS_HIST *h;
+    uint32_t max;
+
+    if (stage < 0 || stage >= STATS_STAGE_NUM) {
+        return;
+    }
+    h = &StatsHist[stage];
+
+    __atomic_fetch_add(&h->bucket[statsBucket(usec)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+
+    max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (usec > max &&
+           !__atomic_compare_exchange_n(&h->max, &max, usec, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        // 他のスレッドが更新した値と比べ直す
+    }
+}
+
+//
+// 集計結果の取得
+//
+int statsGetSummary(int stage, STATS_SUMMARY *sum)
+{
+    STATS_HIST *h;
+    uint32_t n, acc = 0, rank50, rank99;
+    int i;
+
+    if (stage < 0 || stage >= STATS_STAGE_NUM) {
+        return -1;
+    }
+    h = &StatsHist[stage];
+    memset(sum, 0, sizeof(STATS_SUMMARY));
+
+    // 登録中の値が混ざっても大きくずれないように、件数はバケットの合計を使う
+    n = 0;
+    for (i = 0; i < STATS_BUCKET_NUM; i++) {
+        n += __atomic_load_n(&h->bucket[i], __ATOMIC_RELAXED);
+    }
+    if (n == 0) {
+        return 0;
+    }
+    rank50 = (n + 1) / 2;
+    rank99 = n - n / 100;
+
+    for (i = 0; i < STATS_BUCKET_NUM; i++) {
+        acc += __atomic_load_n(&h->bucket[i], __ATOMIC_RELAXED);
+        if (sum->p50 == 0 && acc >= rank50) {
+            sum->p50 = statsBucketValue(i);
+        }
+        if (acc >= rank99) {
+            sum->p99 = statsBucketValue(i);
+            break;
+        }
+    }
+    sum->count = n;
+    sum->max   = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+
+    // バケットの上限で丸めた値が最大値を超えないようにする
+    if (sum->p50 > sum->max) {
+        sum->p50 = sum->max;
+    }
+    if (sum->p99 > sum->max) {
+        sum->p99 = sum->max;
+    }
+
+    return 0;
+}
+
+//
+// 計測値のクリア
+//
+void statsReset(void)
+{
+    int s, i;
+
+    for (s = 0; s < STATS_STAGE_NUM; s++) {
+        for (i = 0; i < STATS_BUCKET_NUM; i++) {
+            __atomic_store_n(&StatsHist[s].bucket[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&StatsHist[s].count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&StatsHist[s].max  , 0, __ATOMIC_RELAXED);
+    }
+}
+
+//
+// ボタン監視スレッドからの送信時刻の受渡し
+//
+void statsButtonSent(uint32_t edge, uint32_t release)
+{
+    __atomic_store_n(&StatsBtnEdge, edge, __ATOMIC_RELAXED);
+    __atomic_store_n(&StatsBtnRelease, release, __ATOMIC_RELEASE);
+}
+
+int statsButtonTake(uint32_t *edge, uint32_t *release)
+{
+    *release = __atomic_exchange_n(&StatsBtnRelease, 0, __ATOMIC_ACQUIRE);
+    if (*release == 0) {
+        return -1;
+    }
+    *edge = __atomic_load_n(&StatsBtnEdge, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+// 値 → バケット番号
+static int statsBucket(uint32_t v)
+{
+    int e;
+
+    if (v < STATS_SUB_NUM) {
+        return (int)v;
+    }
+    e = 31 - __builtin_clz(v);
+    return STATS_SUB_NUM + (e - STATS_SUB_BITS) * STATS_SUB_NUM + (int)((v >> (e - STATS_SUB_BITS)) - STATS_SUB_NUM);
+}
+
+// バケット番号 → そのバケットの上限値
+static uint32_t statsBucketValue(int idx)
+{
+    int e, sub;
+
+    if (idx < STATS_SUB_NUM) {
+        return (uint32_t)idx;
+    }
+    e   = (idx - STATS_SUB_NUM) / STATS_SUB_NUM + STATS_SUB_BITS;
+    sub = (idx - STATS_SUB_NUM) % STATS_SUB_NUM;
+    return (uint32_t)((((uint64_t)(STATS_SUB_NUM + sub + 1)) << (e - STATS_SUB_BITS)) - 1);
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////
+// pws_stats.h
+//   ボタン操作からモジュールへの指示までの処理時間の統計
+///////////////////////////////////////////////////////////
+#ifndef __PWS_STATS_H__
+#define __PWS_STATS_H__
+
+#include <stdint.h>
+
+//
+// 計測区間
+//
+#define STATS_EDGE_TO_RELEASE       (0)     // ボタンの変化検出 → btnActionRelease
+#define STATS_RELEASE_TO_RECV       (1)     // btnActionRelease → マネージャーの受信
+#define STATS_RECV_TO_DISPATCH      (2)     // マネージャーの受信 → 状態遷移テーブルの実行（全メッセージ）
+#define STATS_DISPATCH_TO_SEND      (3)     // 状態遷移テーブルの実行 → mgrSendMessageToSndModule
+#define STATS_EDGE_TO_SEND          (4)     // ボタンの変化検出 → mgrSendMessageToSndModule
+#define STATS_COMMAND_RTT           (5)     // モジュールへの指示 → 開始・終了通知（最後に送った指示から）
+#define STATS_PD_RESTART            (6)     // Pd の停止検出 → PD初期化終了通知（再起動）
+#define STATS_POWER_RESUME          (7)     // 省電力中のボタンの割込み → Pd の DSP 再開の送信
+#define STATS_STAGE_NUM             (8)
+
+//
+// ヒストグラム（マイクロ秒、2 のべき乗ごとに 16 分割、誤差 1/16 以内）
+//
+#define STATS_SUB_BITS              (4)
+#define STATS_SUB_NUM               (1 << STATS_SUB_BITS)
+#define STATS_BUCKET_NUM            (STATS_SUB_NUM + (32 - STATS_SUB_BITS) * STATS_SUB_NUM)
+
+//
+// 集計結果（マイクロ秒）
+//
+typedef struct {
+    uint32_t    count;                  // 計測数
+    uint32_t    p50;                    // 中央値
+    uint32_t    p99;                    // 99 パーセンタイル
+    uint32_t    max;                    // 最大
+} STATS_SUMMARY;
+
+//
+// 現在時刻（マイクロ秒、CLOCK_MONOTONIC、約 71 分で一周するので差分だけに使う）
+//
+extern uint32_t statsNow(void);
+
+//
+// 計測値の登録（ロック不要、どのスレッドからでも呼べる）
+//
+extern void statsRecord(int stage, uint32_t usec);
+
+//
+// 集計結果の取得
+//
+extern int statsGetSummary(int stage, STATS_SUMMARY *sum);
+
+//
+// 計測値のクリア
+//
+extern void statsReset(void);
+
+//
+// ボタン監視スレッドからマネージャーへ送信時刻を渡す
+//   statsButtonTake は受取り済みなら -1
+//
+extern void statsButtonSent(uint32_t edge, uint32_t release);
+extern int statsButtonTake(uint32_t *edge, uint32_t *release);
+
+#endif // __PWS_STATS_H__
@@ -0,0 +1,309 @@
+///////////////////////////////////////////////////////////
+// pws_storage.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include "def.h"
+#include "pws_lib.h"
+#include "pws_peak.h"
+#include "pws_storage.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+// 最大長の録音１回分のサイズ（WAVヘッダー分を含む）
+#define STORAGE_TAKE_BYTES      ((uint64_t)PWS_REC_MAX_MSEC * PWS_REC_RATE / 1000 * PWS_REC_CHANNELS * PWS_REC_BYTES + 1024)
+
+// 削除スレッドが確保しておく空き（録音何回分か）
+#define STORAGE_TARGET_TAKES    (2)
+
+// 削除スレッドの確認周期（秒）
+#define STORAGE_CHECK_SEC       (60)
+
+// I/O 優先度（linux/ioprio.h）
+#define IOPRIO_CLASS_SHIFT      (13)
+#define IOPRIO_CLASS_IDLE       (3)
+#define IOPRIO_WHO_PROCESS      (1)
+#define IOPRIO_PRIO_VALUE(c, d) (((c) << IOPRIO_CLASS_SHIFT) | (d))
+
+#define MB                      ((uint64_t)1024 * 1024)
+
+// 管理情報（空き容量は削除スレッドが確認したときの値）
+static struct {
+    uint32_t    evicted;                // 削除した録音ファイル数
+    int         kick;                   // 確認要求あり
+    int         measured;               // 空き容量を確認済み
+    uint64_t    freeBytes;              // ファイルシステムの空き容量
+    uint64_t    usedBytes;              // 録音ファイルの合計サイズ
+} StorageCtx;
+
+static pthread_t       threadStorageID;
+static pthread_mutex_t threadStorageMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  threadStorageCond  = PTHREAD_COND_INITIALIZER;
+static int             threadStorageFinish = 0;
+static int             threadStorageStarted = 0;
+
+static void *threadStorage(void *arg);
+static int storageEnsure(uint64_t need);
+static int storageGetUsage(uint64_t *freeBytes, uint64_t *usedBytes);
+static int storageEvictOldest(void);
+
+//
+// 録音領域管理の初期化
+//
+int storageInitialize(void)
+{
+    PWS_DEBUG("storageInitialize\n");
+
+    memset(&StorageCtx, 0, sizeof(StorageCtx));
+    StorageCtx.kick = 1;
+
+    // スレッドの作成
+    threadStorageFinish = 0;
+    if (pthread_create(&threadStorageID, NULL, threadStorage, NULL) != 0) {
+        PWS_DEBUG("ERROR: storage thread\n");
+        return -1;
+    }
+    threadStorageStarted = 1;
+
+    return 0;
+}
+
+//
+// 録音領域管理の終了処理
+//
+void storageFinish(void)
+{
+    if (!threadStorageStarted) {
+        return;
+    }
+
+    // 削除スレッド終了
+    pthread_mutex_lock(&threadStorageMutex);
+    threadStorageFinish = 1;
+    pthread_cond_signal(&threadStorageCond);
+    pthread_mutex_unlock(&threadStorageMutex);
+
+    // スレッド終了待ち
+    pthread_join(threadStorageID, NULL);
+    threadStorageStarted = 0;
+
+    PWS_DEBUG("storageFinish\n");
+}
+
+//
+// 空き容量の確認を依頼
+//
+void storageKick(void)
+{
+    pthread_mutex_lock(&threadStorageMutex);
+    StorageCtx.kick = 1;
+    pthread_cond_signal(&threadStorageCond);
+    pthread_mutex_unlock(&threadStorageMutex);
+}
+
+//
+// 最大長の録音１回分の空きを確保
+//   状態遷移のスレッドから呼ばれるので I/O はせず、削除スレッドが確認した値だけを見る
+//   起動直後でまだ確認していなければ録音させる（確認は下の要求で削除スレッドが行う）
+//
+int storageReserve(void)
+{
+    int ret = -1;
+    uint64_t reserve = (uint64_t)PWS_STORAGE_RESERVE_MB * MB;
+    uint64_t quota   = (uint64_t)PWS_STORAGE_QUOTA_MB * MB;
+
+    pthread_mutex_lock(&threadStorageMutex);
+    if (!StorageCtx.measured) {
+        ret = 0;
+    }
+    else if (StorageCtx.freeBytes >= STORAGE_TAKE_BYTES + reserve && StorageCtx.usedBytes + STORAGE_TAKE_BYTES <= quota) {
+        // 次に確認するまでは録音した分を使ったものとする
+        StorageCtx.freeBytes -= STORAGE_TAKE_BYTES;
+        StorageCtx.usedBytes += STORAGE_TAKE_BYTES;
+        ret = 0;
+    }
+    // 次の録音分を先回りして空けておく
+    StorageCtx.kick = 1;
+    pthread_cond_signal(&threadStorageCond);
+    pthread_mutex_unlock(&threadStorageMutex);
+
+    if (ret < 0) {
+        PWS_DEBUG("ERROR: storageReserve no space\n");
+    }
+
+    return ret;
+}
+
+//
+// 録音領域の状態取得
+//
+int storageGetStatus(STORAGE_STATUS *status)
+{
+    int ret = -1;
+
+    memset(status, 0, sizeof(STORAGE_STATUS));
+    status->quotaBytes = (uint64_t)PWS_STORAGE_QUOTA_MB * MB;
+
+    pthread_mutex_lock(&threadStorageMutex);
+    if (StorageCtx.measured) {
+        status->freeBytes = StorageCtx.freeBytes;
+        status->usedBytes = StorageCtx.usedBytes;
+        ret = 0;
+    }
+    status->evicted = StorageCtx.evicted;
+    pthread_mutex_unlock(&threadStorageMutex);
+
+    return ret;
+}
+
+// 削除スレッド
+static void *threadStorage(void *arg)
+{
+    int loop;
+    struct timespec ts;
+
+    rtApply(RT_ROLE_BACKGROUND);
+
+    // 録音・再生の I/O を邪魔しないよう、アイドル時のみ I/O する
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)) < 0) {
+        PWS_DEBUG("ERROR: ioprio_set errno=%d\n", errno);
+    }
+
+    loop = 1;
+    while (loop) {
+        pthread_mutex_lock(&threadStorageMutex);
+        if (StorageCtx.kick == 0 && threadStorageFinish == 0) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += STORAGE_CHECK_SEC;
+            pthread_cond_timedwait(&threadStorageCond, &threadStorageMutex, &ts);
+        }
+        StorageCtx.kick = 0;
+        if (threadStorageFinish == 1) {
+            loop = 0;
+        }
+        pthread_mutex_unlock(&threadStorageMutex);
+
+        if (loop) {
+            storageEnsure(STORAGE_TARGET_TAKES * STORAGE_TAKE_BYTES);
+        }
+    }
+
+    return (void *)NULL;
+}
+
+// 指定サイズの空きを確保（古いアップロード済みの録音から削除）
+//   削除スレッドだけが呼ぶ、確認した空き容量は storageReserve 用に残す
+static int storageEnsure(uint64_t need)
+{
+    int ret = -1, measured = 0;
+    uint64_t freeBytes, usedBytes;
+    uint64_t reserve = (uint64_t)PWS_STORAGE_RESERVE_MB * MB;
+    uint64_t quota   = (uint64_t)PWS_STORAGE_QUOTA_MB * MB;
+
+    for (;;) {
+        if (storageGetUsage(&freeBytes, &usedBytes) < 0) {
+            break;
+        }
+        measured = 1;
+        if (freeBytes >= need + reserve && usedBytes + need <= quota) {
+            ret = 0;
+            break;
+        }
+        if (storageEvictOldest() < 0) {
+            // 削除できる録音が無い
+            break;
+        }
+    }
+
+    if (measured) {
+        pthread_mutex_lock(&threadStorageMutex);
+        StorageCtx.measured  = 1;
+        StorageCtx.freeBytes = freeBytes;
+        StorageCtx.usedBytes = usedBytes;
+        pthread_mutex_unlock(&threadStorageMutex);
+    }
+
+    return ret;
+}
+
+// 空き容量と録音ファイルの合計サイズ
+static int storageGetUsage(uint64_t *freeBytes, uint64_t *usedBytes)
+{
+    int i, count;
+    LIB_TAKE take;
+    struct stat st;
+    struct statvfs vfs;
+
+    if (statvfs(PWS_TAKE_DIR, &vfs) < 0) {
+        PWS_DEBUG("ERROR: statvfs %s\n", PWS_TAKE_DIR);
+        return -1;
+    }
+    *freeBytes = (uint64_t)vfs.f_bavail * vfs.f_frsize;
+
+    // 解析前のレコードはサイズが入っていないので実ファイルを見る
+    *usedBytes = 0;
+    count = libGetCount();
+    for (i = 0; i < count; i++) {
+        if (libGetTake(i, &take) < 0) {
+            break;
+        }
+        if (stat(take.path, &st) == 0) {
+            *usedBytes += st.st_size;
+        }
+    }
+
+    return 0;
+}
+
+// 一番古いアップロード済みの録音を削除
+static int storageEvictOldest(void)
+{
+    int i, count, found = -1;
+    char peakPath[LIB_PATH_LEN + 8];
+    LIB_TAKE take, oldest;
+
+    count = libGetCount();
+    for (i = 0; i < count; i++) {
+        if (libGetTake(i, &take) < 0) {
+            break;
+        }
+        if (take.upload != LIB_UPLOAD_DONE) {
+            continue;
+        }
+        if (found < 0 || take.mtime < oldest.mtime) {
+            memcpy(&oldest, &take, sizeof(LIB_TAKE));
+            found = i;
+        }
+    }
+    if (found < 0) {
+        return -1;
+    }
+
+    PWS_DEBUG("storageEvict [%s]\n", oldest.path);
+
+    // 索引から外してからファイルを削除（途中で落ちても索引は実ファイルの部分集合）
+    libRemoveTake(oldest.path);
+    if (unlink(oldest.path) < 0 && errno != ENOENT) {
+        PWS_DEBUG("ERROR: unlink %s errno=%d\n", oldest.path, errno);
+    }
+    if (peakMakePath(oldest.path, peakPath, sizeof(peakPath)) == 0) {
+        unlink(peakPath);
+    }
+
+    pthread_mutex_lock(&threadStorageMutex);
+    StorageCtx.evicted++;
+    pthread_mutex_unlock(&threadStorageMutex);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////
+// pws_storage.h
+///////////////////////////////////////////////////////////
+#ifndef __PWS_STORAGE_H__
+#define __PWS_STORAGE_H__
+
+#include <stdint.h>
+
+//
+// 録音領域の状態
+//
+typedef struct {
+    uint64_t    freeBytes;              // ファイルシステムの空き容量
+    uint64_t    usedBytes;              // 録音ファイルの合計サイズ
+    uint64_t    quotaBytes;             // 録音ファイルの上限
+    uint32_t    evicted;                // 起動後に削除した録音ファイル数
+} STORAGE_STATUS;
+
+//
+// 録音領域管理の初期化（削除スレッド作成）
+//
+extern int storageInitialize(void);
+
+//
+// 録音領域管理の終了処理
+//
+extern void storageFinish(void);
+
+//
+// 空き容量の確認を依頼（録音終了／アップロード完了時に呼ぶ）
+//
+extern void storageKick(void);
+
+//
+// 最大長の録音１回分の空きを確保
+//   削除スレッドが最後に確認した空き容量で判断する（削除は削除スレッドだけが行う）
+//   確保できなければ -1（削除スレッドに確認を依頼するので、空けば次は確保できる）
+//
+extern int storageReserve(void);
+
+//
+// 録音領域の状態取得（削除スレッドが最後に確認した値、未確認なら -1）
+//
+extern int storageGetStatus(STORAGE_STATUS *status);
+
+#endif // __PWS_STORAGE_H__
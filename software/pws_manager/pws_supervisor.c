@@ -0,0 +1,334 @@
+///////////////////////////////////////////////////////////
+// pws_supervisor.c
+//   Pd の監視と再起動（プロセスの終了と心拍の途絶えを検出したら起動し直す）
+//
+//   Pd は自分のユニット（PWS_PD_UNIT、User=pi、Restart=on-failure）で動くので、
+//   /proc から PWS_PD_PATCH を開いているプロセスを探して監視するだけにする。
+//   終了を検出したらユニットの起動を systemd へ頼み（正常終了では systemd は
+//   起動し直さない）、マネージャー自身へ MSG_PD_RESTARTED を送って
+//   PD初期化終了待ちへ戻させる。
+//   心拍の途絶え（固まった Pd）は止めて、同じ手順で起動し直す。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "def.h"
+#include "pws_osc.h"
+#include "pws_supervisor.h"
+#include "pws_power.h"
+#include "pws_util.h"
+#include "pws_rt.h"
+#include "pws_debug.h"
+
+static pid_t            SupPid;         // 監視中の Pd（0: 見つかっていない）
+static int              SupRestarting;  // 起動し直してから初期化終了まで
+static const char      *SupReason;      // 次の再起動の理由
+static uint64_t         SupDetected;    // 停止の検出時刻（CLOCK_MONOTONIC、マイクロ秒）
+static uint64_t         SupScan;        // 次に Pd を探す時刻
+static uint64_t         SupStartAt;     // 見つからなければユニットを起動する時刻（0: 諦めた）
+static uint64_t         SupHistory[SUP_RESTART_MAX];    // 再起動した時刻（古い順に上書き）
+static pthread_mutex_t  SupMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t        threadSupID;
+static pthread_mutex_t  threadSupMutex  = PTHREAD_MUTEX_INITIALIZER;
+static int              threadSupFinish = 0;
+static int              threadSupStarted = 0;
+
+static void *threadSupWatch(void *arg);
+static pid_t supFind(void);
+static int supAlive(pid_t pid);
+static int supUnitStart(void);
+static int supSendRestarted(int32_t pid, const char *reason);
+
+//
+// 初期化
+//
+void supInitialize(void)
+{
+    pthread_mutex_lock(&SupMutex);
+    SupPid        = 0;
+    SupRestarting = 0;
+    SupReason     = SUP_REASON_EXIT;
+    SupDetected   = 0;
+    SupScan       = 0;
+    SupStartAt    = utilNow() + (uint64_t)SUP_START_WAIT_MS * 1000;
+    memset(SupHistory, 0, sizeof(SupHistory));
+    pthread_mutex_unlock(&SupMutex);
+}
+
+//
+// 監視スレッドの開始
+//
+int supStart(void)
+{
+    threadSupFinish = 0;
+    if (pthread_create(&threadSupID, NULL, threadSupWatch, NULL) != 0) {
+        PWS_DEBUG("ERROR: supervisor thread\n");
+        return -1;
+    }
+    threadSupStarted = 1;
+
+    return 0;
+}
+
+//
+// 監視スレッドの終了
+//
+void supFinish(void)
+{
+    if (!threadSupStarted) {
+        return;
+    }
+
+    pthread_mutex_lock(&threadSupMutex);
+    threadSupFinish = 1;
+    pthread_mutex_unlock(&threadSupMutex);
+
+    pthread_join(threadSupID, NULL);
+    threadSupStarted = 0;
+}
+
+//
+// 心拍の途絶え
+//
+void supHung(void)
+{
+    pthread_mutex_lock(&SupMutex);
+    // 起動し直した直後は前の Pd の心拍が途絶えただけ
+    if (SupPid > 0 && !SupRestarting) {
+        PWS_DEBUG("supervisor: pd %d hung, kill\n", (int)SupPid);
+        SupReason = SUP_REASON_HUNG;
+        // マネージャーは root、systemd はシグナルでの終了を失敗として起動し直す
+        kill(SupPid, SIGKILL);
+    }
+    pthread_mutex_unlock(&SupMutex);
+}
+
+//
+// 初期化終了
+//
+int32_t supReady(void)
+{
+    int32_t elapsed = -1;
+
+    pthread_mutex_lock(&SupMutex);
+    if (SupRestarting) {
+        elapsed = (int32_t)(utilNow() - SupDetected);
+        SupRestarting = 0;
+        PWS_DEBUG("supervisor: pd ready in %d us\n", elapsed);
+    }
+    pthread_mutex_unlock(&SupMutex);
+
+    return elapsed;
+}
+
+//
+// プロセスの確認
+//
+int supCheck(void)
+{
+    int i, start = 0;
+    uint64_t now;
+    const char *reason;
+
+    pthread_mutex_lock(&SupMutex);
+    now = utilNow();
+
+    if (SupPid <= 0) {
+        // 起動時・起動し直している間・諦めた後は Pd が現れるまで探す
+        if (now >= SupScan) {
+            SupScan = now + SUP_SCAN_MS * 1000;
+            SupPid  = supFind();
+            if (SupPid > 0) {
+                PWS_DEBUG("supervisor: watch pd %d\n", (int)SupPid);
+                SupStartAt = 0;
+            }
+            // しばらく現れなければユニットの起動を頼み直す
+            else if (SupStartAt != 0 && now >= SupStartAt) {
+                SupStartAt = now + (uint64_t)SUP_START_WAIT_MS * 1000;
+                start = 1;
+            }
+        }
+        pthread_mutex_unlock(&SupMutex);
+        if (start) {
+            supUnitStart();
+        }
+        return 0;
+    }
+    if (supAlive(SupPid)) {
+        pthread_mutex_unlock(&SupMutex);
+        return 0;
+    }
+
+    // 停止の検出（起動し直している間にまた止まったら最初の検出から測る）
+    PWS_DEBUG("supervisor: pd %d stopped (%s)\n", (int)SupPid, SupReason);
+    if (!SupRestarting) {
+        SupDetected = now;
+    }
+    reason    = SupReason;
+    SupReason = SUP_REASON_EXIT;
+    SupPid    = 0;
+
+    // 制限時間内の再起動が多すぎる（起動してすぐ落ちる）なら諦める
+    for (i = 0; i < SUP_RESTART_MAX; i++) {
+        if (SupHistory[i] == 0 || now - SupHistory[i] >= (uint64_t)SUP_RESTART_WINDOW_MS * 1000) {
+            break;
+        }
+    }
+    if (i == SUP_RESTART_MAX) {
+        PWS_DEBUG("ERROR: supervisor: pd restarted %d times, give up\n", SUP_RESTART_MAX);
+        SupRestarting = 0;
+        SupScan       = now + SUP_SCAN_MS * 1000;
+        SupStartAt    = 0;
+        pthread_mutex_unlock(&SupMutex);
+        supSendRestarted(-1, reason);
+        return -1;
+    }
+    memmove(&SupHistory[1], &SupHistory[0], sizeof(SupHistory[0]) * (SUP_RESTART_MAX - 1));
+    SupHistory[0] = now;
+
+    SupRestarting = 1;
+    SupScan       = now;
+    SupStartAt    = now + (uint64_t)SUP_START_WAIT_MS * 1000;
+    pthread_mutex_unlock(&SupMutex);
+
+    if (supUnitStart() < 0) {
+        supSendRestarted(-1, reason);
+        return -1;
+    }
+    supSendRestarted(0, reason);
+
+    return 1;
+}
+
+// 監視スレッド
+static void *threadSupWatch(void *arg)
+{
+    int loop;
+    struct timespec ts;
+
+    rtApply(RT_ROLE_WATCH);
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = SUP_CHECK_MS * 1000000L;
+
+    loop = 1;
+    while (loop) {
+        pwrSleep(&ts);
+
+        supCheck();
+
+        pthread_mutex_lock(&threadSupMutex);
+        if (threadSupFinish == 1) {
+            loop = 0;
+        }
+        pthread_mutex_unlock(&threadSupMutex);
+    }
+
+    return (void *)NULL;
+}
+
+// PWS_PD_PATCH を開いているプロセスを探す（戻り値: 0: 見つからない）
+static pid_t supFind(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    char path[64], cmd[512];
+    int fd, len, i;
+    pid_t pid, found = 0;
+
+    dir = opendir("/proc");
+    if (dir == NULL) {
+        return 0;
+    }
+    while (found == 0 && (ent = readdir(dir)) != NULL) {
+        pid = (pid_t)atoi(ent->d_name);
+        if (pid <= 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        len = read(fd, cmd, sizeof(cmd) - 1);
+        close(fd);
+        if (len <= 0) {
+            continue;
+        }
+        cmd[len] = '\0';
+        // 引数は '\0' 区切り
+        for (i = 0; i < len; i += strlen(&cmd[i]) + 1) {
+            if (strcmp(&cmd[i], PWS_PD_PATCH) == 0) {
+                found = pid;
+                break;
+            }
+        }
+    }
+    closedir(dir);
+
+    return found;
+}
+
+// プロセスが動いているか（ゾンビは止まったとみなす）
+static int supAlive(pid_t pid)
+{
+    char path[64], stat[128], *p;
+    int fd, len;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    len = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    stat[len] = '\0';
+    // "pid (comm) state ..."
+    p = strrchr(stat, ')');
+    if (p == NULL || p[1] == '\0') {
+        return 1;
+    }
+    return p[2] != 'Z' && p[2] != 'X';
+}
+
+// Pd のユニットの起動（systemd が User=pi で起動する、起動の完了は待たない）
+static int supUnitStart(void)
+{
+    if (system(SUP_UNIT_START) != 0) {
+        PWS_DEBUG("ERROR: supervisor [%s]\n", SUP_UNIT_START);
+        return -1;
+    }
+
+    PWS_DEBUG("supervisor: %s requested\n", PWS_PD_UNIT);
+
+    return 0;
+}
+
+// 再起動の通知（マネージャー自身の受信ポートへ）
+static int supSendRestarted(int32_t pid, const char *reason)
+{
+    int len;
+    uint8_t buf[SEND_BUF_SIZE];
+
+    if (oscEncodeIS(&OSC_WIRE_IS(MSG_PD_RESTARTED), pid, reason, buf, &len) < 0) {
+        return -1;
+    }
+
+    return utilSendLocal(PWS_PORT_MANAGER, buf, len);
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////
+// pws_supervisor.h
+//   Pd の監視と再起動（プロセスの終了と心拍の途絶えを検出したら起動し直す）
+///////////////////////////////////////////////////////////
+#ifndef __PWS_SUPERVISOR_H__
+#define __PWS_SUPERVISOR_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Pd が心拍の登録に使う名前（Pd_Initializer.pd と合わせること）
+#define SUP_PD_NAME             "pd"
+
+// プロセスの確認の周期（ミリ秒、終了の検出にかかる時間の上限）
+#define SUP_CHECK_MS            (10)
+
+// 監視する Pd が見つかるまでの探し直しの周期（ミリ秒）
+#define SUP_SCAN_MS             (200)
+
+// Pd が現れないままこの時間が過ぎたらユニットの起動を頼み直す（ミリ秒）
+#define SUP_START_WAIT_MS       (10000)
+
+// Pd のユニットの起動（既に動いていれば何もしない）
+#define SUP_UNIT_START          "systemctl --no-block start " PWS_PD_UNIT
+
+// 再起動の回数の制限（この時間内にこの回数を超えたら諦める）
+#define SUP_RESTART_MAX         (5)
+#define SUP_RESTART_WINDOW_MS   (60000)
+
+//
+// 再起動の理由
+//
+#define SUP_REASON_EXIT         "exit"      // プロセスが終了した
+#define SUP_REASON_HUNG         "hung"      // 心拍が途絶えた（止めてから起動し直す）
+
+//
+// 初期化
+//
+extern void supInitialize(void);
+
+//
+// 監視スレッドの開始・終了（終了しても Pd は止めない）
+//
+extern int supStart(void);
+extern void supFinish(void);
+
+//
+// 心拍の途絶え（再起動中でなければ Pd を止める、終了は監視スレッドが検出する）
+//
+extern void supHung(void);
+
+//
+// 初期化終了（戻り値: 停止の検出から初期化終了までの時間（マイクロ秒）、-1: 再起動中でない）
+//
+extern int32_t supReady(void);
+
+//
+// プロセスの確認（終了していたらユニットの起動を頼み、マネージャーへ MSG_PD_RESTARTED を送る）
+//   監視スレッドから周期的に呼ぶ、戻り値: 1: 起動し直した、0: 変化なし、-1: 起動できない
+//
+extern int supCheck(void);
+
+#endif  // __PWS_SUPERVISOR_H__
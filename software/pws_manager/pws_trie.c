@@ -0,0 +1,366 @@
+///////////////////////////////////////////////////////////
+// pws_trie.c
+//   OSC アドレスパターン（*, ?, [], {}）の照合
+//
+//   OSC 1.0 のパターン照合に従う。
+//     ?       : 任意の１文字
+//     *       : 任意の０文字以上（'/' は越えない）
+//     [abc]   : いずれかの１文字（a-z で範囲、先頭の ! で否定）
+//     {ab,cd} : いずれかの文字列
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pws_trie.h"
+
+static TRIE_NODE *trieAddChild(TRIE_NODE *node, const char *name, int len);
+static void trieSort(TRIE_NODE *node);
+static int trieCompare(const void *a, const void *b);
+static int trieCompareName(const char *a, int alen, const char *b, int blen);
+static void trieFreeChild(TRIE_NODE *node);
+static void trieWalk(const TRIE_NODE *node, const char *p, int pattern, int *val, int max, int *num);
+static int trieMatchSeg(const char *p, const char *pe, const char *s, const char *se);
+static const char *trieMatchSet(const char *p, const char *pe, char c, int *hit);
+
+//
+// 木の作成
+//
+TRIE_NODE *trieBuild(const TRIE_ENTRY *entry, int num)
+{
+    int i;
+    const char *p, *pe;
+    TRIE_NODE *root, *node;
+
+    root = (TRIE_NODE *)calloc(1, sizeof(TRIE_NODE));
+    if (root == NULL) {
+        return NULL;
+    }
+    root->val = -1;
+
+    for (i = 0; i < num; i++) {
+        if (entry[i].addr[0] != '/') {
+            continue;
+        }
+        node = root;
+        for (p = entry[i].addr; *p == '/'; p = pe) {
+            p++;
+            pe = strchr(p, '/');
+            if (pe == NULL) {
+                pe = p + strlen(p);
+            }
+            node = trieAddChild(node, p, (int)(pe - p));
+            if (node == NULL) {
+                trieFree(root);
+                return NULL;
+            }
+        }
+        // 同じアドレスは先に登録したものを使う
+        if (node->val < 0) {
+            node->val   = entry[i].val;
+            node->exact = entry[i].exact;
+        }
+    }
+
+    // 子を名前順に並べる（リテラルの区切りは二分探索で引く）
+    trieSort(root);
+
+    return root;
+}
+
+//
+// 木の破棄
+//
+void trieFree(TRIE_NODE *root)
+{
+    if (root != NULL) {
+        trieFreeChild(root);
+        free(root);
+    }
+}
+
+//
+// アドレス（パターン）の照合
+//
+int trieMatch(const TRIE_NODE *root, const char *pattern, int *val, int max)
+{
+    int num = 0;
+
+    int wild = 0;
+    const char *p;
+
+    if (root == NULL || pattern == NULL || pattern[0] != '/') {
+        return 0;
+    }
+    // 長すぎるパターンやワイルドカードの多すぎるパターンは照合しない
+    for (p = pattern; *p != '\0'; p++) {
+        if (p - pattern >= TRIE_PATTERN_MAX) {
+            return 0;
+        }
+        if (*p == '*' || *p == '{' || *p == ',') {
+            if (++wild > TRIE_WILD_MAX) {
+                return 0;
+            }
+        }
+    }
+    trieWalk(root, pattern, 0, val, max, &num);
+
+    return num;
+}
+
+// 子の追加（同じ名前があればそれを返す）
+static TRIE_NODE *trieAddChild(TRIE_NODE *node, const char *name, int len)
+{
+    int i;
+    TRIE_NODE *child;
+
+    for (i = 0; i < node->num; i++) {
+        if (node->child[i].len == len && memcmp(node->child[i].name, name, len) == 0) {
+            return &node->child[i];
+        }
+    }
+
+    child = (TRIE_NODE *)realloc(node->child, (node->num + 1) * sizeof(TRIE_NODE));
+    if (child == NULL) {
+        return NULL;
+    }
+    node->child = child;
+    child = &node->child[node->num++];
+    memset(child, 0, sizeof(*child));
+    child->name = name;
+    child->len  = len;
+    child->val  = -1;
+
+    return child;
+}
+
+// 子を名前順に並べる
+static void trieSort(TRIE_NODE *node)
+{
+    int i;
+
+    if (node->num > 1) {
+        qsort(node->child, node->num, sizeof(TRIE_NODE), trieCompare);
+    }
+    for (i = 0; i < node->num; i++) {
+        trieSort(&node->child[i]);
+    }
+}
+
+// 区切りの名前の比較（長さの違う前方一致は短い方が先）
+static int trieCompare(const void *a, const void *b)
+{
+    const TRIE_NODE *na = (const TRIE_NODE *)a;
+    const TRIE_NODE *nb = (const TRIE_NODE *)b;
+
+    return trieCompareName(na->name, na->len, nb->name, nb->len);
+}
+
+static int trieCompareName(const char *a, int alen, const char *b, int blen)
+{
+    int ret;
+
+    ret = memcmp(a, b, (alen < blen) ? alen : blen);
+    if (ret == 0) {
+        ret = alen - blen;
+    }
+
+    return ret;
+}
+
+// 子の破棄
+static void trieFreeChild(TRIE_NODE *node)
+{
+    int i;
+
+    for (i = 0; i < node->num; i++) {
+        trieFreeChild(&node->child[i]);
+    }
+    free(node->child);
+    node->child = NULL;
+    node->num   = 0;
+}
+
+// 区切りごとに子を辿る（p は '/' か終端を指す、pattern: ここまでにパターン文字があった）
+static void trieWalk(const TRIE_NODE *node, const char *p, int pattern, int *val, int max, int *num)
+{
+    int i, lo, hi, ret, literal;
+    const char *pe;
+    const TRIE_NODE *child;
+
+    if (*num >= max) {
+        return;
+    }
+    if (*p == '\0') {
+        if (node->val >= 0 && !(pattern && node->exact)) {
+            val[(*num)++] = node->val;
+        }
+        return;
+    }
+
+    // 区切りの終わりを探しながらパターン文字の有無を調べる
+    p++;
+    literal = 1;
+    for (pe = p; *pe != '\0' && *pe != '/'; pe++) {
+        if (*pe == '*' || *pe == '?' || *pe == '[' || *pe == '{') {
+            literal = 0;
+        }
+    }
+
+    // パターン文字の無い区切りは二分探索
+    if (literal) {
+        lo = 0;
+        hi = node->num;
+        while (lo < hi) {
+            i = (lo + hi) / 2;
+            child = &node->child[i];
+            ret = trieCompareName(child->name, child->len, p, (int)(pe - p));
+            if (ret == 0) {
+                trieWalk(child, pe, pattern, val, max, num);
+                return;
+            }
+            if (ret < 0) {
+                lo = i + 1;
+            }
+            else {
+                hi = i;
+            }
+        }
+        return;
+    }
+
+    for (i = 0; i < node->num; i++) {
+        child = &node->child[i];
+        if (trieMatchSeg(p, pe, child->name, child->name + child->len)) {
+            trieWalk(child, pe, 1, val, max, num);
+        }
+    }
+}
+
+// パターンの区切り１つ（p 〜 pe）と名前（s 〜 se）の照合（1: 一致）
+//   バックトラックせず、パターンを先頭から１要素ずつ進めながら
+//   名前のどの位置まで一致し得るか（live）を更新する。
+//   手間はパターン長 × 名前の長さ程度に収まる。
+static int trieMatchSeg(const char *p, const char *pe, const char *s, const char *se)
+{
+    int i, n, hit, any;
+    const char *a, *ae, *end, *next;
+    unsigned char live[TRIE_NAME_MAX + 1], step[TRIE_NAME_MAX + 1];
+
+    n = (int)(se - s);
+    if (n > TRIE_NAME_MAX) {
+        return 0;
+    }
+    memset(live, 0, sizeof(live));
+    live[0] = 1;
+
+    while (p < pe) {
+        memset(step, 0, sizeof(step));
+        switch (*p) {
+        case '*':
+            while (p < pe && *p == '*') {
+                p++;
+            }
+            // 一致した位置以降は全て一致し得る
+            for (i = 0, any = 0; i <= n; i++) {
+                any |= live[i];
+                step[i] = any;
+            }
+            break;
+
+        case '?':
+            for (i = 0; i < n; i++) {
+                step[i + 1] = live[i];
+            }
+            p++;
+            break;
+
+        case '[':
+            next = NULL;
+            for (i = 0; i < n; i++) {
+                next = trieMatchSet(p, pe, s[i], &hit);
+                if (next == NULL) {
+                    return 0;
+                }
+                step[i + 1] = live[i] && hit;
+            }
+            if (next == NULL && (next = trieMatchSet(p, pe, '\0', &hit)) == NULL) {
+                return 0;
+            }
+            p = next;
+            break;
+
+        case '{':
+            end = memchr(p, '}', pe - p);
+            if (end == NULL) {
+                return 0;
+            }
+            // 候補ごとに一致した位置を進める
+            for (a = p + 1; a <= end; a = ae + 1) {
+                for (ae = a; ae < end && *ae != ','; ae++) {
+                    ;
+                }
+                for (i = 0; i + (ae - a) <= n; i++) {
+                    if (live[i] && memcmp(s + i, a, ae - a) == 0) {
+                        step[i + (ae - a)] = 1;
+                    }
+                }
+            }
+            p = end + 1;
+            break;
+
+        default:
+            for (i = 0; i < n; i++) {
+                step[i + 1] = live[i] && (s[i] == *p);
+            }
+            p++;
+            break;
+        }
+
+        // 一致し得る位置が無くなれば打切り
+        for (i = 0, any = 0; i <= n; i++) {
+            live[i] = step[i];
+            any |= step[i];
+        }
+        if (!any) {
+            return 0;
+        }
+    }
+
+    return live[n];
+}
+
+// 文字の集合 [...] の照合（戻り値: ']' の次、閉じていなければ NULL）
+static const char *trieMatchSet(const char *p, const char *pe, char c, int *hit)
+{
+    int neg = 0;
+
+    *hit = 0;
+    p++;
+    if (p < pe && *p == '!') {
+        neg = 1;
+        p++;
+    }
+    while (p < pe && *p != ']') {
+        if (p + 2 < pe && p[1] == '-' && p[2] != ']') {
+            if ((p[0] <= c && c <= p[2]) || (p[2] <= c && c <= p[0])) {
+                *hit = 1;
+            }
+            p += 3;
+        }
+        else {
+            if (*p == c) {
+                *hit = 1;
+            }
+            p++;
+        }
+    }
+    if (p >= pe) {
+        return NULL;
+    }
+    if (neg) {
+        *hit = !*hit;
+    }
+
+    return p + 1;
+}
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////
+// pws_trie.h
+//   OSC アドレスパターン（*, ?, [], {}）の照合
+//
+//   登録したアドレスを '/' 区切りの木にしておき、パターンの区切りごとに子を辿る。
+//   パターン文字の無い区切りは名前順の子を二分探索するだけなので、
+//   通常のアドレスは登録数が増えても区切りの数 × log(子の数) で引ける。
+///////////////////////////////////////////////////////////
+#ifndef __PWS_TRIE_H__
+#define __PWS_TRIE_H__
+
+#define TRIE_PATTERN_MAX    256         // パターンの最大長（越えたら照合しない）
+#define TRIE_WILD_MAX       32          // パターン中の '*'、'{'、',' の最大数（越えたら照合しない）
+#define TRIE_NAME_MAX       64          // パターンで照合する区切りの名前の最大長
+
+//
+// 登録するアドレス（addr は木を使う間そのまま残しておくこと）
+//
+typedef struct {
+    const char *addr;                   // アドレス
+    int         val;                    // 一致したときに返す値（0 以上）
+    int         exact;                  // 1: パターンでは一致させない（完全一致だけ）
+} TRIE_ENTRY;
+
+//
+// 木の節（アドレスの区切り１つ分）
+//
+typedef struct TRIE_NODE {
+    const char         *name;           // 区切りの名前（'/' を含まない、終端なし）
+    int                 len;            // 区切りの名前の長さ
+    int                 val;            // 登録した値（-1: 途中の区切り）
+    int                 exact;          // 1: パターンでは一致させない
+    int                 num;            // 子の数
+    struct TRIE_NODE   *child;          // 子（名前順）
+} TRIE_NODE;
+
+//
+// 木の作成（num 件、失敗したら NULL）
+//
+extern TRIE_NODE *trieBuild(const TRIE_ENTRY *entry, int num);
+
+//
+// 木の破棄
+//
+extern void trieFree(TRIE_NODE *root);
+
+//
+// アドレス（パターン）に一致した値を最大 max 件 val へ（戻り値: 件数）
+//
+extern int trieMatch(const TRIE_NODE *root, const char *pattern, int *val, int max);
+
+#endif  // __PWS_TRIE_H__
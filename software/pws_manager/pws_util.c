@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////
+// pws_util.c
+//   各スレッドで共通の時計と、マネージャー自身・同じ機器のモジュールへの送信
+//
+//   送信はマネージャーの受信ソケットを共有する（送信元が 127.0.0.1:PWS_PORT_MANAGER
+//   になるので、マネージャー自身への通知を外からの偽物と見分けられる）。
+//   UDP の sendto は複数のスレッドから同時に呼んでもよい。
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "pws_util.h"
+#include "pws_debug.h"
+
+static int UtilSock = -1;
+
+//
+// 現在時刻（マイクロ秒、CLOCK_MONOTONIC）
+//
+uint64_t utilNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//
+// 現在時刻（マイクロ秒、CLOCK_BOOTTIME）
+//
+uint64_t utilBootNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//
+// 送信に使うソケットの設定
+//
+void utilSetSocket(int sock)
+{
+    __atomic_store_n(&UtilSock, sock, __ATOMIC_RELEASE);
+}
+
+//
+// 送信
+//
+int utilSend(const struct sockaddr_in *to, const uint8_t *data, int len)
+{
+    int sock, own = 0, ret = 0;
+
+    sock = __atomic_load_n(&UtilSock, __ATOMIC_ACQUIRE);
+    // マネージャーの外（pws_render など）では送信ごとに作る
+    if (sock < 0) {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock == -1) {
+            PWS_DEBUG("ERROR: util socket\n");
+            return -1;
+        }
+        own = 1;
+    }
+    if (sendto(sock, data, len, 0, (const struct sockaddr *)to, sizeof(*to)) != len) {
+        PWS_DEBUG("ERROR: util sendto\n");
+        ret = -1;
+    }
+    if (own) {
+        close(sock);
+    }
+
+    return ret;
+}
+
+//
+// 同じ機器の port への送信
+//
+int utilSendLocal(int port, const uint8_t *data, int len)
+{
+    struct sockaddr_in to;
+
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port        = htons(port);
+
+    return utilSend(&to, data, len);
+}
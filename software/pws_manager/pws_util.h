@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////
+// pws_util.h
+//   各スレッドで共通の時計と、マネージャー自身・同じ機器のモジュールへの送信
+///////////////////////////////////////////////////////////
+#ifndef __PWS_UTIL_H__
+#define __PWS_UTIL_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+//
+// 現在時刻（マイクロ秒、CLOCK_MONOTONIC）
+//
+extern uint64_t utilNow(void);
+
+//
+// 現在時刻（マイクロ秒、CLOCK_BOOTTIME：電源投入から）
+//
+extern uint64_t utilBootNow(void);
+
+//
+// 送信に使うソケットの設定（マネージャーの受信ソケット、-1: 送信ごとに作る）
+//
+extern void utilSetSocket(int sock);
+
+//
+// 送信（設定したソケットから、送信元はマネージャーの受信ポートになる）
+//
+extern int utilSend(const struct sockaddr_in *to, const uint8_t *data, int len);
+
+//
+// 同じ機器（127.0.0.1）の port への送信
+//
+extern int utilSendLocal(int port, const uint8_t *data, int len);
+
+#endif
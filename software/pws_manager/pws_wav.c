@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////
+// pws_wav.c
+///////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pws_wav.h"
+#include "pws_debug.h"
+
+#define WAV_LE16(p)     ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8))
+#define WAV_SET16(p, v)     ((p)[0] = (uint8_t)(v), (p)[1] = (uint8_t)((v) >> 8))
+#define WAV_SET32(p, v)     (WAV_SET16(p, v), WAV_SET16((p) + 2, (v) >> 16))
+#define WAV_LE32(p)     ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+//
+// ヘッダーの解析
+//
+int wavReadHeader(int fd, WAV_INFO *info)
+{
+    int n, fmtFound = 0;
+    uint8_t hdr[12], chunk[8], fmt[40];
+    uint32_t size;
+    off_t ofs;
+    struct stat st;
+
+    memset(info, 0, sizeof(WAV_INFO));
+
+    if (fstat(fd, &st) < 0) {
+        return -1;
+    }
+    info->fileSize = st.st_size;
+
+    // RIFF ヘッダー
+    if (pread(fd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+        memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+    {
+        return -1;
+    }
+
+    // チャンクを辿って fmt / data を探す
+    ofs = sizeof(hdr);
+    for (;;) {
+        if (pread(fd, chunk, sizeof(chunk), ofs) != sizeof(chunk)) {
+            return -1;
+        }
+        size = WAV_LE32(chunk + 4);
+        ofs += sizeof(chunk);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            n = (size < sizeof(fmt)) ? size : sizeof(fmt);
+            if (n < 16 || pread(fd, fmt, n, ofs) != n) {
+                return -1;
+            }
+            info->format   = WAV_LE16(fmt);
+            info->channels = WAV_LE16(fmt + 2);
+            info->rate     = WAV_LE32(fmt + 4);
+            info->align    = WAV_LE16(fmt + 12);
+            info->bits     = WAV_LE16(fmt + 14);
+            if (info->format == WAVE_FORMAT_EXTENSIBLE && n >= 26) {
+                info->format = WAV_LE16(fmt + 24);
+            }
+            fmtFound = 1;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            info->dataOfs  = ofs;
+            info->dataSize = size;
+            break;
+        }
+        ofs += size + (size & 1);
+    }
+
+    if (fmtFound == 0 || info->channels <= 0 || info->rate == 0 || info->align <= 0) {
+        return -1;
+    }
+    if (info->align != info->channels * (info->bits / 8)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+//
+// data チャンクが確定しているか
+//
+int wavIsFinalized(const WAV_INFO *info)
+{
+    return (info->dataSize > 0 && info->dataOfs + (off_t)info->dataSize <= info->fileSize);
+}
+
+//
+// 読込み可能な data チャンクのバイト数
+//
+uint32_t wavDataBytes(const WAV_INFO *info)
+{
+    uint32_t size;
+
+    if (wavIsFinalized(info)) {
+        size = info->dataSize;
+    }
+    else if (info->fileSize > info->dataOfs) {
+        // 録音中／中断されたファイルは実サイズまで
+        size = (uint32_t)(info->fileSize - info->dataOfs);
+    }
+    else {
+        size = 0;
+    }
+
+    return size - (size % info->align);
+}
+
+//
+// サンプルを 16bit 整数へ変換
+//
+int wavToInt16(const WAV_INFO *info, const uint8_t *src, int16_t *dst, int samples)
+{
+    int i;
+    float f;
+
+    if (info->format == WAVE_FORMAT_PCM && info->bits == 16) {
+        memcpy(dst, src, samples * sizeof(int16_t));
+    }
+    else if (info->format == WAVE_FORMAT_PCM && info->bits == 24) {
+        for (i = 0; i < samples; i++, src += 3) {
+            dst[i] = (int16_t)WAV_LE16(src + 1);
+        }
+    }
+    else if (info->format == WAVE_FORMAT_PCM && info->bits == 32) {
+        for (i = 0; i < samples; i++, src += 4) {
+            dst[i] = (int16_t)WAV_LE16(src + 2);
+        }
+    }
+    else if (info->format == WAVE_FORMAT_IEEE_FLOAT && info->bits == 32) {
+        for (i = 0; i < samples; i++, src += 4) {
+            memcpy(&f, src, sizeof(f));
+            if (f >= 1.0f) {
+                dst[i] = 32767;
+            }
+            else if (f <= -1.0f) {
+                dst[i] = -32768;
+            }
+            else {
+                dst[i] = (int16_t)(f * 32768.0f);
+            }
+        }
+    }
+    else {
+        return -1;
+    }
+
+    return samples;
+}
+
+//
+// サンプルを実数へ変換
+//
+int wavToFloat(const WAV_INFO *info, const uint8_t *src, float *dst, int samples)
+{
+    int i;
+
+    if (info->format == WAVE_FORMAT_PCM && info->bits == 16) {
+        for (i = 0; i < samples; i++, src += 2) {
+            dst[i] = (int16_t)WAV_LE16(src) * (1.0f / 32768.0f);
+        }
+    }
+    else if (info->format == WAVE_FORMAT_PCM && info->bits == 24) {
+        for (i = 0; i < samples; i++, src += 3) {
+            dst[i] = ((int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24)) >> 8) * (1.0f / 8388608.0f);
+        }
+    }
+    else if (info->format == WAVE_FORMAT_PCM && info->bits == 32) {
+        for (i = 0; i < samples; i++, src += 4) {
+            dst[i] = (int32_t)WAV_LE32(src) * (1.0f / 2147483648.0f);
+        }
+    }
+    else if (info->format == WAVE_FORMAT_IEEE_FLOAT && info->bits == 32) {
+        memcpy(dst, src, samples * sizeof(float));
+    }
+    else {
+        return -1;
+    }
+
+    return samples;
+}
+
+//
+// PCM の WAVヘッダーを作成
+//
+int wavMakeHeader(uint8_t *hdr, uint32_t rate, int channels, int bits, uint32_t dataSize)
+{
+    int align = channels * (bits / 8);
+
+    if (channels <= 0 || align <= 0 || rate == 0) {
+        return -1;
+    }
+
+    memcpy(hdr, "RIFF", 4);
+    WAV_SET32(hdr + 4, dataSize + WAV_HEADER_SIZE - 8);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    WAV_SET32(hdr + 16, 16);
+    WAV_SET16(hdr + 20, WAVE_FORMAT_PCM);
+    WAV_SET16(hdr + 22, channels);
+    WAV_SET32(hdr + 24, rate);
+    WAV_SET32(hdr + 28, rate * align);
+    WAV_SET16(hdr + 32, align);
+    WAV_SET16(hdr + 34, bits);
+    memcpy(hdr + 36, "data", 4);
+    WAV_SET32(hdr + 40, dataSize);
+
+    return WAV_HEADER_SIZE;
+}
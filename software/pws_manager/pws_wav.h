@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////
+// pws_wav.h
+///////////////////////////////////////////////////////////
+#ifndef __PWS_WAV_H__
+#define __PWS_WAV_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// WAVフォーマット
+#define WAVE_FORMAT_PCM         (0x0001)
+#define WAVE_FORMAT_IEEE_FLOAT  (0x0003)
+#define WAVE_FORMAT_EXTENSIBLE  (0xFFFE)
+
+// wavMakeHeader が作るヘッダーの長さ
+#define WAV_HEADER_SIZE         (44)
+
+//
+// WAVファイルの情報
+//
+typedef struct {
+    int         format;         // フォーマット（PCM／IEEE_FLOAT）
+    int         channels;       // チャンネル数
+    uint32_t    rate;           // サンプリング周波数
+    int         bits;           // 量子化ビット数
+    int         align;          // 1フレームのバイト数
+    off_t       dataOfs;        // data チャンクの先頭位置
+    uint32_t    dataSize;       // data チャンクのサイズ（ヘッダー記載値）
+    off_t       fileSize;       // ファイルサイズ
+} WAV_INFO;
+
+//
+// ヘッダーの解析
+//
+extern int wavReadHeader(int fd, WAV_INFO *info);
+
+//
+// data チャンクが確定しているか（録音中は Pd が仮のサイズを書いている）
+//
+extern int wavIsFinalized(const WAV_INFO *info);
+
+//
+// 読込み可能な data チャンクのバイト数（フレーム境界に切り捨て）
+//
+extern uint32_t wavDataBytes(const WAV_INFO *info);
+
+//
+// サンプルを 16bit 整数へ変換
+//
+extern int wavToInt16(const WAV_INFO *info, const uint8_t *src, int16_t *dst, int samples);
+
+//
+// サンプルを実数（-1.0 ～ 1.0）へ変換
+//
+extern int wavToFloat(const WAV_INFO *info, const uint8_t *src, float *dst, int samples);
+
+//
+// PCM の WAVヘッダー（WAV_HEADER_SIZE byte）を作成
+//
+extern int wavMakeHeader(uint8_t *hdr, uint32_t rate, int channels, int bits, uint32_t dataSize);
+
+#endif // __PWS_WAV_H__
@@ -10,6 +10,8 @@ import traceback
 #from OpenSSL import SSL
 
 from flask import (Flask,
+                   abort,
+                   jsonify,
                    make_response,
                    redirect,
                    render_template,
@@ -19,6 +21,9 @@ from flask import (Flask,
                   )
 
 import submodule.dbox_tool
+import submodule.manager_client
+import submodule.peak_file
+import submodule.take_index
 
 #
 from logging import getLogger, StreamHandler, FileHandler, DEBUG, INFO, WARN, ERROR
@@ -150,6 +155,45 @@ def show_log():
 
   return render_template('log.html', MANAGER_LOG=manager_log, UPLOADER_LOG=uploader_log)
 
+#
+@app.route("/takes")
+def show_takes():
+  index = submodule.take_index.TakeIndex()
+  takes = [take for take in reversed(index.takes) if not take.flags & take.FLAG_INVALID]
+  return render_template('takes.html', TAKES=takes)
+
+#
+@app.route("/peaks/<name>")
+def get_peaks(name):
+  # 録音ディレクトリ外は参照させない
+  name = os.path.basename(name)
+  pathname = os.path.join(os.path.dirname(submodule.take_index.TAKE_INDEX_PATHNAME), name)
+  try:
+    width = max(1, int(request.args.get("width", 800)))
+  except ValueError:
+    width = 800
+
+  peak = submodule.peak_file.PeakFile(submodule.peak_file.get_peak_pathname(pathname))
+  if not peak.open():
+    abort(404)
+  data = peak.read(width)
+  if data is None:
+    abort(404)
+  return jsonify(**data)
+
+#
+@app.route("/meter")
+def show_meter():
+  return render_template('meter.html')
+
+#
+@app.route("/meter/level")
+def get_meter_level():
+  level = submodule.manager_client.query_meter()
+  if level is None:
+    abort(503)
+  return jsonify(**level)
+
 
 #
 if __name__ == "__main__":
@@ -0,0 +1,226 @@
+#!/usr/bin/python
+#coding:utf-8
+
+from __future__ import print_function, unicode_literals
+import socket
+import threading
+import time
+
+import submodule.oscmsg
+
+# pws_manager (def.h) の受信ポート
+PWS_MANAGER_ADDR = "127.0.0.1"
+PWS_MANAGER_PORT = 8001
+
+#
+from logging import getLogger, StreamHandler, FileHandler, DEBUG, INFO, WARN, ERROR
+logger = getLogger(__name__)
+sh = StreamHandler()
+sh.setLevel(WARN)
+logger.setLevel(WARN)
+logger.addHandler(sh)
+
+
+# pws_manager へ問合せて返信を待つ（返信が無ければ None）
+def request(msg, params=None, reply=None, timeout=0.5):
+  osc = submodule.oscmsg.OscMsg()
+  osc.msg = msg
+  if params:
+    osc.params.extend(params)
+
+  sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  sock.settimeout(timeout)
+  try:
+    sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+    while True:
+      data = sock.recv(4096)
+      res = submodule.oscmsg.OscMsg()
+      res.parse(data)
+      if not res.valid:
+        continue
+      if reply is None or res.msg == reply:
+        return res
+  except socket.timeout:
+    logger.warn("no reply for \"{0}\".".format(msg))
+  except socket.error as e:
+    logger.error("request \"{0}\" failed: {1}".format(msg, e))
+  finally:
+    sock.close()
+  return None
+
+
+# 入力レベル（ピーク／RMS は dBFS、age は最後に届いてからのミリ秒、未受信は -1）
+def query_meter():
+  res = request("/pws_manager/meter/query", reply="/pws_manager/meter/level")
+  if res is None or len(res.params) < 5:
+    return None
+  return {
+    "peak": res.params[0],
+    "rms": res.params[1],
+    "clips": res.params[2],
+    "clip_total": res.params[3],
+    "age": res.params[4],
+  }
+
+
+# 状態通知の購読（pattern に一致する通知を届いた順に返す、省略時は全て）
+#   期限（lease 秒）の半分ごとに購読し直す、timeout 秒届かなければ None を返す
+def watch(pattern=None, timeout=1.0):
+  sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  sock.settimeout(timeout)
+  osc = submodule.oscmsg.OscMsg()
+  osc.msg = "/pws_manager/subscribe"
+  osc.params.append(0)
+  if pattern:
+    osc.params.append(pattern)
+  renew = 0
+  try:
+    while True:
+      if time.time() >= renew:
+        sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+        renew = time.time() + 30
+      try:
+        data = sock.recv(4096)
+      except socket.timeout:
+        yield None
+        continue
+      res = submodule.oscmsg.OscMsg()
+      res.parse(data)
+      if not res.valid:
+        continue
+      if res.msg == "/pws_manager/subscribed":
+        if res.params[0] <= 0:
+          logger.warn("subscribe \"{0}\" failed: {1}".format(pattern, res.params[0]))
+          return
+        renew = time.time() + res.params[1] / 2.0
+        continue
+      yield res
+  finally:
+    osc = submodule.oscmsg.OscMsg()
+    osc.msg = "/pws_manager/unsubscribe"
+    osc.params.append(0)
+    sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+    sock.close()
+
+
+# モジュールの登録と心拍（interval ミリ秒ごと、登録し直しを求められたら登録する）
+#   port: 指示を受ける自分のポート、caps: 受け持つ機能（アドレスの先頭の要素）の一覧
+class Heartbeat(threading.Thread):
+  def __init__(self, name, port, caps=None, interval=1000):
+    threading.Thread.__init__(self)
+    self.daemon = True
+    self.stopEvent = threading.Event()
+    self.module = name
+    self.port = port
+    self.caps = ",".join(caps) if caps else name
+    self.interval = interval
+
+  def stop(self):
+    self.stopEvent.set()
+
+  def _send(self, sock, msg, params):
+    osc = submodule.oscmsg.OscMsg()
+    osc.msg = msg
+    osc.params.extend(params)
+    sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+
+  def run(self):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(0)
+    registered = False
+    try:
+      while not self.stopEvent.is_set():
+        if registered:
+          self._send(sock, "/pws_manager/module/heartbeat", [self.interval, self.module])
+        else:
+          self._send(sock, "/pws_manager/module/announce", [self.port, self.module, self.caps])
+        self.stopEvent.wait(self.interval / 1000.0)
+        while True:
+          try:
+            data = sock.recv(4096)
+          except socket.error:
+            break
+          res = submodule.oscmsg.OscMsg()
+          res.parse(data)
+          if res.valid and res.msg == "/pws_manager/module/registered":
+            registered = (res.params[0] == 0)
+    finally:
+      sock.close()
+
+
+# 登録されたモジュールの一覧と停止の検出時間（ミリ秒、返信が無ければ None）
+def query_modules(timeout=0.5):
+  osc = submodule.oscmsg.OscMsg()
+  osc.msg = "/pws_manager/module/query"
+  sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  sock.settimeout(timeout)
+  modules = []
+  try:
+    sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+    while True:
+      res = submodule.oscmsg.OscMsg()
+      res.parse(sock.recv(4096))
+      if not res.valid:
+        continue
+      if res.msg == "/pws_manager/module" and len(res.params) >= 7:
+        modules.append({
+          "name": res.params[0],
+          "port": res.params[1],
+          "caps": res.params[2].split(","),
+          "alive": res.params[3] == "alive",
+          "interval": res.params[4],
+          "age": res.params[5],
+          "lost": res.params[6],
+        })
+      elif res.msg == "/pws_manager/module/detect" and len(res.params) >= 4:
+        return {"modules": modules, "detected": res.params[1], "last": res.params[2], "max": res.params[3]}
+  except socket.timeout:
+    logger.warn("no reply for \"{0}\".".format(osc.msg))
+  except socket.error as e:
+    logger.error("request \"{0}\" failed: {1}".format(osc.msg, e))
+  finally:
+    sock.close()
+  return None
+
+
+# 起動の記録（節目ごとの電源投入からのミリ秒と前の節目からのマイクロ秒、返信が無ければ None）
+def query_boot(timeout=0.5):
+  osc = submodule.oscmsg.OscMsg()
+  osc.msg = "/pws_manager/boot/query"
+  sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  sock.settimeout(timeout)
+  marks = []
+  try:
+    sock.sendto(osc.build(), (PWS_MANAGER_ADDR, PWS_MANAGER_PORT))
+    while True:
+      res = submodule.oscmsg.OscMsg()
+      res.parse(sock.recv(4096))
+      if not res.valid:
+        continue
+      if res.msg == "/pws_manager/boot" and len(res.params) >= 3:
+        marks.append({"name": res.params[0], "ms": res.params[1], "step": res.params[2]})
+      elif res.msg == "/pws_manager/boot/end":
+        return marks
+  except socket.timeout:
+    logger.warn("no reply for \"{0}\".".format(osc.msg))
+  except socket.error as e:
+    logger.error("request \"{0}\" failed: {1}".format(osc.msg, e))
+  finally:
+    sock.close()
+  return None
+
+
+# 省電力の状態（起床回数は 1 秒あたり、消費電力は推定 mW、resume は割込みからのマイクロ秒、返信が無ければ None）
+def query_power():
+  res = request("/pws_manager/power/query", reply="/pws_manager/power")
+  if res is None or len(res.params) < 7:
+    return None
+  return {
+    "mode": res.params[0],
+    "wakeups_active": res.params[1],
+    "wakeups_idle": res.params[2],
+    "mw_active": res.params[3],
+    "mw_idle": res.params[4],
+    "entries": res.params[5],
+    "resume": res.params[6],
+  }
@@ -0,0 +1,70 @@
+#coding:utf-8
+# pws_manager/pws_schema.def から make schema で生成（直接編集しないこと）
+
+IN = {}
+OUT = {}
+
+IN["/system/initialize"] = ""
+IN["/btnmonitor/push/apset"] = ""
+IN["/btnmonitor/push/recbtn"] = ""
+IN["/btnmonitor/push/playbtn"] = ""
+IN["/btnmonitor/push/volupbtn"] = ""
+IN["/btnmonitor/push/voldownbtn"] = ""
+IN["/btnmonitor/push/effectbtn"] = ""
+IN["/btnmonitor/push/tuningbtn"] = ""
+IN["/btnmonitor/push/shutdownbtn"] = ""
+IN["/ap_configurator/configure/configured"] = "i|s"
+IN["/pd_initializer/initialize/finished"] = "i"
+IN["/recorder/record/started"] = "i|s"
+IN["/recorder/record/stopped"] = "i|s"
+IN["/player/playback/started"] = "i"
+IN["/player/playback/stopped"] = "i"
+IN["/tuner/tune/started"] = "i"
+IN["/tuner/tune/stopped"] = "i"
+IN["/tuner/tune/cond"] = "*"
+IN["/uploader/upload/started"] = "s"
+IN["/uploader/upload/stopped"] = "is|s"
+IN["/downloader/download/stopped"] = "i"
+IN["/calibrator/calibrate/stopped"] = "i|s"
+IN["/pws_manager/render/stopped"] = "i|s"
+IN["/pws_manager/meter"] = "iff"
+IN["/pws_manager/command/timeout"] = "is"
+IN["/pws_manager/pd/restarted"] = "is"
+IN["/pws_manager/latency/measured"] = "i"
+IN["/pws_manager/take/finished"] = "is"
+IN["/pws_manager/library/query"] = "|i"
+IN["/pws_manager/latency/calibrate"] = ""
+IN["/pws_manager/latency/query"] = ""
+IN["/pws_manager/latency/align"] = "i"
+IN["/pws_manager/render/start"] = "is"
+IN["/pws_manager/meter/query"] = ""
+IN["/pws_manager/ingress/query"] = ""
+IN["/pws_manager/stats/query"] = "|i"
+IN["/pws_manager/flight/dump"] = ""
+IN["/pws_manager/subscribe"] = "i|s"
+IN["/pws_manager/unsubscribe"] = "i"
+IN["/pws_manager/module/query"] = ""
+IN["/pws_manager/boot/query"] = ""
+IN["/pws_manager/power/query"] = ""
+IN["/pws_manager/module/announce"] = "is|s*"
+IN["/pws_manager/module/heartbeat"] = "is"
+IN["/pws_manager/module/lost"] = "is"
+OUT["/uploader/upload/start"] = "s"
+OUT["/audio_out/dsp"] = "i"
+OUT["/pws_manager/library/count"] = "i"
+OUT["/pws_manager/library/take"] = "isiiiiffis"
+OUT["/pws_manager/latency"] = "iffiii"
+OUT["/pws_manager/render"] = "is|ff"
+OUT["/pws_manager/meter/level"] = "ffiii"
+OUT["/pws_manager/ingress"] = "iiiiiii"
+OUT["/pws_manager/ingress/rejected"] = "iiii"
+OUT["/pws_manager/stats"] = "iiiii"
+OUT["/pws_manager/flight"] = "is"
+OUT["/pws_manager/subscribed"] = "ii"
+OUT["/pws_manager/state"] = "ss"
+OUT["/pws_manager/module/registered"] = "ii"
+OUT["/pws_manager/module"] = "sissiii"
+OUT["/pws_manager/module/detect"] = "iiii"
+OUT["/pws_manager/boot"] = "sii"
+OUT["/pws_manager/boot/end"] = "i"
+OUT["/pws_manager/power"] = "sffiiii"
@@ -5,6 +5,8 @@ from __future__ import print_function, unicode_literals
 import codecs
 import struct
 
+import submodule.osc_schema
+
 #
 from logging import getLogger, StreamHandler, FileHandler, DEBUG, INFO, WARN, ERROR
 logger = getLogger(__name__)
@@ -14,6 +16,43 @@ logger.setLevel(WARN)
 logger.addHandler(sh)
 
 
+# アドレスの引数の型（pws_manager/pws_schema.def、載っていなければ None）
+def schema_types(msg):
+  types = submodule.osc_schema.IN.get(msg)
+  if types is None:
+    types = submodule.osc_schema.OUT.get(msg)
+  return types
+
+
+# 引数を型と照合（pws_manager の oscCheck と同じ規則、数値は型に合わせて変換）
+# 合わなければ None
+def check_params(types, params):
+  result = []
+  idx = 0
+  opt = False
+  for t in types:
+    if '|' == t:
+      opt = True
+      continue
+    if '*' == t:
+      return result + list(params[idx:])
+    if idx >= len(params):
+      return result if opt else None
+    val = params[idx]
+    if 'i' == t and isinstance(val, (int, long, float)):
+      result.append(int(val))
+    elif 'f' == t and isinstance(val, (int, long, float)):
+      result.append(float(val))
+    elif 's' == t and isinstance(val, basestring):
+      result.append(val)
+    else:
+      return None
+    idx += 1
+  if idx != len(params):
+    return None
+  return result
+
+
 #
 class OscMsg(object):
   #
@@ -21,13 +60,20 @@ class OscMsg(object):
     object.__init__(self)
     self.msg = ""
     self.params = []
+    self.valid = True
 
   #
   def build(self):
     logger.debug("build osc msg: {0}".format(self.params))
+    params = self.params
+    types = schema_types(self.msg)
+    if types is not None:
+      params = check_params(types, self.params)
+      if params is None:
+        raise ValueError("params {0} do not match \"{1}\" for \"{2}\"".format(self.params, types, self.msg))
     fmt = str("")
     data = str("")
-    for val in self.params:
+    for val in params:
       if isinstance(val, int) or isinstance(val, long):
         fmt += str("i")
         wk = struct.pack(">i", val)
@@ -66,6 +112,16 @@ class OscMsg(object):
     idx, self.params = self._parse_params(fmt, data, idx)
     logger.debug("> {0}, {1}, {2}, ({3})".format(self.msg, fmt, self.params, codecs.encode(data, "hex_codec")))
 
+    self.valid = True
+    types = schema_types(self.msg)
+    if types is not None:
+      params = check_params(types, self.params)
+      if params is None:
+        logger.warn("params of \"{0}\" do not match \"{1}\": {2}".format(self.msg, types, fmt))
+        self.valid = False
+      else:
+        self.params = params
+
   # get message
   def _parse_msg(self, data):
     msg = ""
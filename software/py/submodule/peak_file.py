@@ -0,0 +1,89 @@
+#!/usr/bin/python
+#coding:utf-8
+
+from __future__ import print_function, unicode_literals
+import os
+import struct
+
+#
+from logging import getLogger, StreamHandler, FileHandler, DEBUG, INFO, WARN, ERROR
+logger = getLogger(__name__)
+sh = StreamHandler()
+sh.setLevel(WARN)
+logger.setLevel(WARN)
+logger.addHandler(sh)
+
+
+#
+def get_peak_pathname(wav_pathname):
+  # pws_manager (pws_peak.h) のピークファイル (*.wav → *.pk)
+  base, ext = os.path.splitext(wav_pathname)
+  if ext != ".wav":
+    base = wav_pathname
+  return base + ".pk"
+
+
+#
+class PeakFile(object):
+  MAGIC = b"PWSP"
+  VERSION = 1
+
+  # PEAK_FILE_HEADER (20 byte) / PEAK_FILE_LEVEL (12 byte)
+  HEADER_FORMAT = str("<4sHHIIHH")
+  LEVEL_FORMAT = str("<III")
+
+  #
+  def __init__(self, pathname):
+    object.__init__(self)
+    self.pathname = pathname
+    self.rate = 0
+    self.frames = 0
+    self.channels = 0
+    self.levels = []
+
+  #
+  def open(self):
+    try:
+      with open(self.pathname, "rb") as f:
+        hdr = f.read(struct.calcsize(PeakFile.HEADER_FORMAT))
+        magic, version, levels, self.rate, self.frames, self.channels, reserved = struct.unpack(PeakFile.HEADER_FORMAT, hdr)
+        if magic != PeakFile.MAGIC or version != PeakFile.VERSION:
+          logger.error("bad peak file \"{0}\"".format(self.pathname))
+          return False
+        self.levels = []
+        size = struct.calcsize(PeakFile.LEVEL_FORMAT)
+        for idx in range(levels):
+          self.levels.append(struct.unpack(PeakFile.LEVEL_FORMAT, f.read(size)))
+        f.close()
+    except:
+      logger.error("can't read peak file \"{0}\"".format(self.pathname))
+      return False
+    return True
+
+  #
+  def read(self, width):
+    # width 以上のビンを持つ一番粗いレベルを選ぶ（無ければ一番細かいレベル）
+    if not self.levels:
+      return None
+    spp, count, offset = self.levels[0]
+    for level in self.levels:
+      if width <= level[1]:
+        spp, count, offset = level
+
+    try:
+      with open(self.pathname, "rb") as f:
+        f.seek(offset)
+        data = f.read(count * 4)
+        f.close()
+    except:
+      logger.error("can't read peak file \"{0}\"".format(self.pathname))
+      return None
+
+    count = len(data) // 4
+    bins = struct.unpack(str("<{0}h").format(count * 2), data[:count * 4])
+    return {"rate": self.rate,
+            "frames": self.frames,
+            "spp": spp,
+            "min": bins[0::2],
+            "max": bins[1::2]
+           }
@@ -0,0 +1,25 @@
+#!/usr/bin/python
+#coding:utf-8
+
+from __future__ import print_function, unicode_literals
+import os
+import socket
+
+
+# systemd への通知（Type=notify のサービス、NOTIFY_SOCKET が無ければ何もしない）
+#   例: notify("READY=1")
+def notify(state):
+  path = os.environ.get("NOTIFY_SOCKET")
+  if not path or path[0] not in "/@":
+    return False
+  # '@' は抽象名前空間
+  if path[0] == "@":
+    path = "\0" + path[1:]
+  sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+  try:
+    sock.sendto(state.encode("utf-8"), path)
+  except socket.error:
+    return False
+  finally:
+    sock.close()
+  return True
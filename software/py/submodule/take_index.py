@@ -0,0 +1,90 @@
+#!/usr/bin/python
+#coding:utf-8
+
+from __future__ import print_function, unicode_literals
+import os
+import struct
+
+# pws_manager (pws_lib.h) の索引ファイル
+TAKE_INDEX_PATHNAME = "/home/pi/pws/.take_index"
+
+#
+from logging import getLogger, StreamHandler, FileHandler, DEBUG, INFO, WARN, ERROR
+logger = getLogger(__name__)
+sh = StreamHandler()
+sh.setLevel(WARN)
+logger.setLevel(WARN)
+logger.addHandler(sh)
+
+
+#
+class TakeInfo(object):
+  UPLOAD_STATE_ERROR = -1
+  UPLOAD_STATE_NONE = 0
+  UPLOAD_STATE_QUEUED = 1
+  UPLOAD_STATE_DONE = 2
+
+  FLAG_SCANNING = 0x0001
+  FLAG_INVALID = 0x0002
+
+  # LIB_TAKE (192 byte)
+  RECORD_FORMAT = str("<128sQIIIIIHHffiI16x")
+
+  #
+  def __init__(self, index, record):
+    object.__init__(self)
+    (path, self.hash, self.mtime, self.size, self.frames, self.duration, self.rate,
+     self.channels, self.bits, self.peak, self.rms, self.upload, self.flags) = struct.unpack(TakeInfo.RECORD_FORMAT, record)
+    self.index = index
+    self.pathname = path.split(b"\0", 1)[0].decode("utf-8", "replace")
+    self.name = os.path.basename(self.pathname)
+
+
+#
+class TakeIndex(object):
+  MAGIC = b"PWSL"
+  VERSION = 1
+
+  # LIB_HEADER (16 byte)
+  HEADER_FORMAT = str("<4sHHII")
+
+  #
+  def __init__(self, pathname=TAKE_INDEX_PATHNAME):
+    object.__init__(self)
+    self.takes = []
+    self.load(pathname)
+
+  #
+  def load(self, pathname):
+    self.takes = []
+    try:
+      # 全件を１回で読む
+      with open(pathname, "rb") as f:
+        data = f.read()
+        f.close()
+    except:
+      logger.error("can't read take index \"{0}\"".format(pathname))
+      return False
+
+    hdrSize = struct.calcsize(TakeIndex.HEADER_FORMAT)
+    recSize = struct.calcsize(TakeInfo.RECORD_FORMAT)
+    if len(data) < hdrSize:
+      return False
+    magic, version, size, count, reserved = struct.unpack_from(TakeIndex.HEADER_FORMAT, data)
+    if magic != TakeIndex.MAGIC or version != TakeIndex.VERSION or size != recSize:
+      logger.error("bad take index \"{0}\"".format(pathname))
+      return False
+
+    for idx in range(count):
+      ofs = hdrSize + idx * recSize
+      if len(data) < ofs + recSize:
+        break
+      self.takes.append(TakeInfo(idx, data[ofs:ofs + recSize]))
+    return True
+
+  #
+  def find(self, name):
+    for take in self.takes:
+      if take.name == name:
+        return take
+    return None
@@ -15,6 +15,8 @@ import traceback
 
 import submodule.oscmsg
 import submodule.upload_queue
+import submodule.manager_client
+import submodule.sd_notify
 
 PWS_MANAGER_ADDR = str(socket.INADDR_LOOPBACK)
 PWS_MANAGER_PORT = 8001
@@ -218,7 +220,16 @@ def main():
 
   reqReceiver = RequestReceiver(UPLOADER_RECEIVE_ADDR, UPLOADER_RECEIVE_PORT)
   reqReceiver.start()
+
+  # 受信できるようになったので systemd へ通知（後続を待たせない）
+  submodule.sd_notify.notify("READY=1")
+
+  # pws_manager へ登録して心拍を送る
+  heartbeat = submodule.manager_client.Heartbeat("uploader", UPLOADER_RECEIVE_PORT)
+  heartbeat.start()
+
   reqReceiver.join()
+  heartbeat.stop()
 
   logger.info("[{0}] leave process.".format(get_log_header()))
 